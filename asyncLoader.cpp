@@ -0,0 +1,388 @@
+/*
+ * asyncLoader.cpp
+ *
+ * AsyncLoader class, loads shapes in the background. The files are read,
+ * parsed, welded and decoded on worker threads, and the results are given
+ * to OpenGL a little at a time by the thread that renders.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "asyncLoader.h"
+#include "meshLoader.h"
+
+#include <chrono>
+#include <utility>
+
+// Checks a future without blocking
+template <typename T>
+static inline bool isFutureReady (const T& future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/*
+ * LoadHandle
+ *
+ * INPUT:
+ *         done - the future set by AsyncLoader when the load finishes.
+ *
+ */
+LoadHandle::LoadHandle () {
+}
+
+LoadHandle::LoadHandle ( const std::shared_future<bool>& done ) : done(done) {
+}
+
+/*
+ * isReady
+ *
+ * RETURN:
+ *         True if the load finished (successfully or not), never blocks.
+ *
+ */
+bool LoadHandle::isReady () const {
+    return done.valid() && isFutureReady(done);
+}
+
+/*
+ * succeeded
+ *
+ * RETURN:
+ *         True if the load finished and every file could be read.
+ *
+ */
+bool LoadHandle::succeeded () const {
+    if (!isReady()) {
+        return false;
+    }
+
+    // a load dropped by ~AsyncLoader never gets a value
+    try {
+        return done.get();
+    } catch (const std::future_error&) {
+        return false;
+    }
+}
+
+/*
+ * getFuture
+ *
+ * RETURN:
+ *         The underlying future. Do not wait on it from the thread that
+ *         calls AsyncLoader::update, it only becomes ready inside update.
+ *
+ */
+std::shared_future<bool> LoadHandle::getFuture () const {
+    return done;
+}
+
+/*
+ * AsyncLoader
+ *
+ * DESCRIPTION:
+ *         Creates a loader with nothing to do.
+ *
+ */
+AsyncLoader::AsyncLoader () {
+}
+
+/*
+ * ~AsyncLoader
+ *
+ * DESCRIPTION:
+ *         Waits for the worker threads that are still running. Loads
+ *         that were not finished by update are dropped.
+ *
+ */
+AsyncLoader::~AsyncLoader () {
+    for (std::list<PendingLoad>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        if (it->cpuWork.valid()) {
+            it->cpuWork.wait();
+        }
+    }
+}
+
+/*
+ * readObjVertTexNorm
+ *
+ * INPUT:
+ *         shape - where the result goes, it must outlive the load.
+ *         filename - the .obj file, faces can use any pattern.
+ *         filetexture - the texture file, .png extension, or NULL to use
+ *                       the "map_Kd" of the first material of the file.
+ *
+ * RETURN:
+ *         The handle of the load.
+ *
+ * DESCRIPTION:
+ *         Same as Shape::readObjVertTexNorm but returns right away, the
+ *         shape is only changed by update once everything is loaded.
+ *
+ */
+LoadHandle AsyncLoader::readObjVertTexNorm ( Shape& shape, const char* filename, const char* filetexture ) {
+    pending.emplace_back();
+    PendingLoad& load = pending.back();
+
+    load.shape = &shape;
+    load.filename = filename;
+    setTextureFile(load, TEXTURE_MAIN, filetexture, MATERIAL_DIFFUSE_MAP);
+    load.withTangents = false;
+
+    return start(load);
+}
+
+/*
+ * readObjLightMap
+ *
+ * INPUT:
+ *         shape - where the result goes, it must outlive the load.
+ *         filename - the .obj file, faces can use any pattern.
+ *         filetextureDiff - the texture file for diffuse map, .png extension, or
+ *                           NULL to use the "map_Kd" of the first material.
+ *         filetextureSpec - the texture file for specular map, .png extension, or
+ *                           NULL to use the "map_Ks" of the first material.
+ *         filetextureNormal - the normal map, .png extension, or NULL for none.
+ *
+ * RETURN:
+ *         The handle of the load.
+ *
+ * DESCRIPTION:
+ *         Same as Shape::readObjLightMap (plus Shape::readNormalMap if
+ *         filetextureNormal is given) but returns right away, the shape
+ *         is only changed by update once everything is loaded.
+ *
+ */
+LoadHandle AsyncLoader::readObjLightMap ( Shape& shape, const char* filename, const char* filetextureDiff,
+                                          const char* filetextureSpec, const char* filetextureNormal ) {
+    pending.emplace_back();
+    PendingLoad& load = pending.back();
+
+    load.shape = &shape;
+    load.filename = filename;
+    setTextureFile(load, TEXTURE_DIFFUSE, filetextureDiff, MATERIAL_DIFFUSE_MAP);
+    setTextureFile(load, TEXTURE_SPECULAR, filetextureSpec, MATERIAL_SPECULAR_MAP);
+    setTextureFile(load, TEXTURE_NORMAL, filetextureNormal, -1);
+    load.withTangents = true;
+
+    return start(load);
+}
+
+/*
+ * setTextureFile
+ *
+ * INPUT:
+ *         load - the load the texture belongs to.
+ *         texture - TEXTURE_MAIN, TEXTURE_DIFFUSE, ...
+ *         filetexture - the file given for it, or NULL.
+ *         materialMap - the map of the first material used when filetexture
+ *                       is NULL, -1 to have no texture then.
+ *
+ * DESCRIPTION:
+ *         Copies the file of a texture, a std::string can not be set from
+ *         NULL. A NULL one is found by the worker once the materials of the
+ *         file are read.
+ *
+ */
+void AsyncLoader::setTextureFile ( PendingLoad& load, int texture, const char* filetexture, int materialMap ) {
+    if (filetexture != NULL) {
+        load.textureFiles[texture] = filetexture;
+        load.materialMaps[texture] = -1;
+    } else {
+        load.textureFiles[texture].clear();
+        load.materialMaps[texture] = materialMap;
+    }
+}
+
+/*
+ * start
+ *
+ * INPUT:
+ *         load - a load with its files set.
+ *
+ * RETURN:
+ *         The handle of the load.
+ *
+ * DESCRIPTION:
+ *         Starts the worker thread of load.
+ *
+ */
+LoadHandle AsyncLoader::start ( PendingLoad& load ) {
+    // the settings are read here, the worker never touches the shape
+    load.useCache = load.shape->getMeshCache();
+    load.numThreads = load.shape->getLoaderThreads();
+    load.nextStep = 0;
+    load.ok = false;
+
+    LoadHandle handle(load.done.get_future().share());
+    load.cpuWork = std::async(std::launch::async, &AsyncLoader::runWorker, &load);
+    return handle;
+}
+
+/*
+ * runWorker
+ *
+ * INPUT:
+ *         load - the load to run.
+ *
+ * RETURN:
+ *         True if every file could be read.
+ *
+ * DESCRIPTION:
+ *         What the worker thread does: reads the mesh (or its cache),
+ *         computes tangents if needed and decodes the textures.
+ *
+ */
+bool AsyncLoader::runWorker ( PendingLoad* load ) {
+    bool ok = loadWeldedObj(load->filename.c_str(), OBJ_ALL, load->withTangents, load->useCache,
+                            load->numThreads, load->mesh);
+    if (!ok) {
+        fprintf(stderr, "error while opening file %s \n", load->filename.c_str());
+    }
+
+    // the textures given as NULL are the maps of the first material, like
+    // Shape::materialTexture does
+    const std::vector<obj::ObjMaterial>& materials = load->mesh.materials;
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        int map = load->materialMaps[i];
+        if (map < 0) {
+            continue;
+        }
+        if (!materials.empty()) {
+            load->textureFiles[i] = (map == MATERIAL_DIFFUSE_MAP) ? materials[0].diffuseMap
+                                                                 : materials[0].specularMap;
+        }
+        if (load->textureFiles[i].empty()) {
+            fprintf(stderr, "%s has no %s map for a texture that was not given\n",
+                    load->filename.c_str(), (map == MATERIAL_DIFFUSE_MAP) ? "map_Kd" : "map_Ks");
+            ok = false;
+        }
+    }
+
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        if (!load->textureFiles[i].empty() && !decode_png(load->textureFiles[i].c_str(), load->images[i])) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/*
+ * uploadStep
+ *
+ * INPUT:
+ *         load - a load whose worker is done.
+ *
+ * RETURN:
+ *         How many bytes were given to OpenGL.
+ *
+ * DESCRIPTION:
+ *         Runs the next upload step of load and frees its CPU copy.
+ *
+ */
+size_t AsyncLoader::uploadStep ( PendingLoad& load ) {
+    int step = load.nextStep++;
+
+    // the geometry, the shape keeps it and the example creates its buffers
+    if (step == 0) {
+        MeshData& mesh = load.mesh;
+        size_t bytes = (mesh.vertices.size() + mesh.normals.size() + mesh.uvtextures.size() +
+                        mesh.tangents.size() + mesh.bitangents.size()) * sizeof(float) +
+                        mesh.elements.size() * sizeof(GLuint);
+
+        load.shape->setMeshData(mesh);
+
+        // mesh now has the previous geometry of the shape, let it go
+        MeshData empty;
+        std::swap(mesh, empty);
+        return bytes;
+    }
+
+    int texture = step - 1;
+    if (load.textureFiles[texture].empty()) {
+        return 0;
+    }
+
+    ImageData& image = load.images[texture];
+    size_t bytes = image.pixels.size();
+    GLuint id = create_texture(image);
+
+    switch (texture) {
+        case TEXTURE_MAIN:
+            load.shape->setTextureID(id);
+            break;
+        case TEXTURE_DIFFUSE:
+            load.shape->setDiffTextureID(id);
+            break;
+        case TEXTURE_SPECULAR:
+            load.shape->setSpecTextureID(id);
+            break;
+        case TEXTURE_NORMAL:
+            load.shape->setTextureNormalMapID(id);
+            break;
+    }
+
+    std::vector<unsigned char>().swap(image.pixels);
+    return bytes;
+}
+
+/*
+ * update
+ *
+ * INPUT:
+ *         budget - about how many bytes we may give to OpenGL.
+ *
+ * RETURN:
+ *         How many loads finished on this call.
+ *
+ * DESCRIPTION:
+ *         Call it once per frame on the thread of the OpenGL context.
+ *         Moves the results of finished workers into their shapes and
+ *         creates their textures, stopping once budget bytes were used.
+ *         A single step is never split, so at least one step runs per
+ *         call even if it is larger than budget.
+ *
+ */
+int AsyncLoader::update ( size_t budget ) {
+    int finished = 0;
+    size_t used = 0;
+
+    std::list<PendingLoad>::iterator it = pending.begin();
+    while (it != pending.end() && (used == 0 || used < budget)) {
+        PendingLoad& load = *it;
+
+        // still on the worker thread, maybe a later one is done
+        if (load.cpuWork.valid()) {
+            if (!isFutureReady(load.cpuWork)) {
+                ++it;
+                continue;
+            }
+            load.ok = load.cpuWork.get();
+        }
+
+        while (load.nextStep <= NUM_TEXTURES && (used == 0 || used < budget)) {
+            used += uploadStep(load);
+        }
+
+        // out of budget in the middle of this load, continue next frame
+        if (load.nextStep <= NUM_TEXTURES) {
+            break;
+        }
+
+        load.done.set_value(load.ok);
+        it = pending.erase(it);
+        ++finished;
+    }
+    return finished;
+}
+
+/*
+ * isIdle
+ *
+ * RETURN:
+ *         True if there are no loads in progress.
+ *
+ */
+bool AsyncLoader::isIdle () {
+    return pending.empty();
+}
@@ -0,0 +1,301 @@
+/*
+ * asyncLoader.h
+ *
+ * AsyncLoader class, loads shapes in the background. The files are read,
+ * parsed, welded and decoded on worker threads, and the results are given
+ * to OpenGL a little at a time by the thread that renders.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _ASYNCLOADER_H
+#define _ASYNCLOADER_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <future>
+#include <list>
+#include <string>
+#include <stddef.h>
+
+#include "shape.h"
+#include "meshData.h"
+#include "imageHelper.h"
+
+// How many bytes AsyncLoader::update gives to OpenGL per call by default,
+// about what a 1024x1024 texture takes
+#define DEFAULT_UPLOAD_BUDGET  (4 << 20)
+
+/*
+ * The LoadHandle class, what the load functions of AsyncLoader return.
+ * It is ready once the shape has its geometry and textures and can be
+ * drawn.
+ */
+class LoadHandle {
+    std::shared_future<bool> done;
+
+public:
+
+    /*
+     * LoadHandle
+     *
+     * INPUT:
+     *         done - the future set by AsyncLoader when the load finishes.
+     *
+     */
+    LoadHandle ();
+    LoadHandle ( const std::shared_future<bool>& done );
+
+    /*
+     * isReady
+     *
+     * RETURN:
+     *         True if the load finished (successfully or not), never blocks.
+     *
+     */
+    bool isReady () const;
+
+    /*
+     * succeeded
+     *
+     * RETURN:
+     *         True if the load finished and every file could be read.
+     *
+     */
+    bool succeeded () const;
+
+    /*
+     * getFuture
+     *
+     * RETURN:
+     *         The underlying future. Do not wait on it from the thread that
+     *         calls AsyncLoader::update, it only becomes ready inside update.
+     *
+     */
+    std::shared_future<bool> getFuture () const;
+};
+
+/*
+ * The AsyncLoader class.
+ */
+class AsyncLoader {
+    // The textures a load can have, in the order they are given to OpenGL
+    enum {
+        TEXTURE_MAIN = 0,
+        TEXTURE_DIFFUSE,
+        TEXTURE_SPECULAR,
+        TEXTURE_NORMAL,
+        NUM_TEXTURES
+    };
+
+    // Everything we know about one load
+    struct PendingLoad {
+        // where the result goes, only touched on the rendering thread
+        Shape* shape;
+
+        // the files, copied so the caller's strings can go away
+        std::string filename;
+        std::string textureFiles[NUM_TEXTURES];
+        bool withTangents;
+
+        // the map of the first material (MATERIAL_DIFFUSE_MAP or
+        // MATERIAL_SPECULAR_MAP) a texture given as NULL comes from, -1
+        // for the textures given and the normal map
+        int materialMaps[NUM_TEXTURES];
+        bool useCache;
+        int numThreads;
+
+        // written by the worker thread, read after cpuWork is ready
+        MeshData mesh;
+        ImageData images[NUM_TEXTURES];
+
+        // true once the worker finished, with the worker's success
+        std::future<bool> cpuWork;
+
+        // next step of the upload, 0 is the geometry and 1 + i texture i
+        int nextStep;
+        bool ok;
+
+        // set when every step is done
+        std::promise<bool> done;
+
+        PendingLoad () {
+            for (int i = 0; i < NUM_TEXTURES; ++i) {
+                materialMaps[i] = -1;
+            }
+        }
+    };
+
+    // loads in the order they were requested, a list so the workers can
+    // keep pointers to their load while others are added and removed
+    std::list<PendingLoad> pending;
+
+    // the copy constructor and assignment are not allowed, the workers
+    // point into pending
+    AsyncLoader (const AsyncLoader&);
+    AsyncLoader& operator= (const AsyncLoader&);
+
+    /*
+     * start
+     *
+     * INPUT:
+     *         load - a load with its files set.
+     *
+     * RETURN:
+     *         The handle of the load.
+     *
+     * DESCRIPTION:
+     *         Starts the worker thread of load.
+     *
+     */
+    LoadHandle start ( PendingLoad& load );
+
+    /*
+     * setTextureFile
+     *
+     * INPUT:
+     *         load - the load the texture belongs to.
+     *         texture - TEXTURE_MAIN, TEXTURE_DIFFUSE, ...
+     *         filetexture - the file given for it, or NULL.
+     *         materialMap - the map of the first material used when filetexture
+     *                       is NULL, -1 to have no texture then.
+     *
+     * DESCRIPTION:
+     *         Copies the file of a texture, a std::string can not be set from
+     *         NULL. A NULL one is found by the worker once the materials of the
+     *         file are read.
+     *
+     */
+    static void setTextureFile ( PendingLoad& load, int texture, const char* filetexture, int materialMap );
+
+    /*
+     * runWorker
+     *
+     * INPUT:
+     *         load - the load to run.
+     *
+     * RETURN:
+     *         True if every file could be read.
+     *
+     * DESCRIPTION:
+     *         What the worker thread does: reads the mesh (or its cache),
+     *         computes tangents if needed and decodes the textures.
+     *
+     */
+    static bool runWorker ( PendingLoad* load );
+
+    /*
+     * uploadStep
+     *
+     * INPUT:
+     *         load - a load whose worker is done.
+     *
+     * RETURN:
+     *         How many bytes were given to OpenGL.
+     *
+     * DESCRIPTION:
+     *         Runs the next upload step of load and frees its CPU copy.
+     *
+     */
+    size_t uploadStep ( PendingLoad& load );
+
+public:
+
+    /*
+     * AsyncLoader
+     *
+     * DESCRIPTION:
+     *         Creates a loader with nothing to do.
+     *
+     */
+    AsyncLoader ();
+
+    /*
+     * ~AsyncLoader
+     *
+     * DESCRIPTION:
+     *         Waits for the worker threads that are still running. Loads
+     *         that were not finished by update are dropped.
+     *
+     */
+    ~AsyncLoader ();
+
+    /*
+     * readObjVertTexNorm
+     *
+     * INPUT:
+     *         shape - where the result goes, it must outlive the load.
+     *         filename - the .obj file, faces can use any pattern.
+     *         filetexture - the texture file, .png extension, or NULL to use
+     *                       the "map_Kd" of the first material of the file.
+     *
+     * RETURN:
+     *         The handle of the load.
+     *
+     * DESCRIPTION:
+     *         Same as Shape::readObjVertTexNorm but returns right away, the
+     *         shape is only changed by update once everything is loaded.
+     *
+     */
+    LoadHandle readObjVertTexNorm ( Shape& shape, const char* filename, const char* filetexture );
+
+    /*
+     * readObjLightMap
+     *
+     * INPUT:
+     *         shape - where the result goes, it must outlive the load.
+     *         filename - the .obj file, faces can use any pattern.
+     *         filetextureDiff - the texture file for diffuse map, .png extension, or
+     *                           NULL to use the "map_Kd" of the first material.
+     *         filetextureSpec - the texture file for specular map, .png extension, or
+     *                           NULL to use the "map_Ks" of the first material.
+     *         filetextureNormal - the normal map, .png extension, or NULL for none.
+     *
+     * RETURN:
+     *         The handle of the load.
+     *
+     * DESCRIPTION:
+     *         Same as Shape::readObjLightMap (plus Shape::readNormalMap if
+     *         filetextureNormal is given) but returns right away, the shape
+     *         is only changed by update once everything is loaded.
+     *
+     */
+    LoadHandle readObjLightMap ( Shape& shape, const char* filename, const char* filetextureDiff,
+                                 const char* filetextureSpec, const char* filetextureNormal = NULL );
+
+    /*
+     * update
+     *
+     * INPUT:
+     *         budget - about how many bytes we may give to OpenGL.
+     *
+     * RETURN:
+     *         How many loads finished on this call.
+     *
+     * DESCRIPTION:
+     *         Call it once per frame on the thread of the OpenGL context.
+     *         Moves the results of finished workers into their shapes and
+     *         creates their textures, stopping once budget bytes were used.
+     *         A single step is never split, so at least one step runs per
+     *         call even if it is larger than budget.
+     *
+     */
+    int update ( size_t budget = DEFAULT_UPLOAD_BUDGET );
+
+    /*
+     * isIdle
+     *
+     * RETURN:
+     *         True if there are no loads in progress.
+     *
+     */
+    bool isIdle ();
+};
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * benchmarkHelper.cpp
+ *
+ * What the benchmarks share: a generator of deterministic .obj files,
+ * peak memory and allocation counters.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "benchmarkHelper.h"
+
+// C libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// C++ libraries
+#include <atomic>
+#include <new>
+#include <vector>
+
+// Bytes written to the file at once by generateObj
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+// The longest line generateObj writes is well under this
+static const size_t MAX_LINE_SIZE = 128;
+
+// Numbers are written from millionths, "%f" style
+static const long MICRO = 1000000;
+
+/*
+ * getPatternName
+ *
+ * INPUT:
+ *         pattern - a face pattern.
+ *
+ * RETURN:
+ *         How its corners look, e.g. "v/vt/vn".
+ *
+ */
+const char* getPatternName(ObjPattern pattern) {
+    switch (pattern) {
+        case PATTERN_V:
+            return "v";
+        case PATTERN_VN:
+            return "v//vn";
+        case PATTERN_VTN:
+            return "v/vt/vn";
+        default:
+            return "?";
+    }
+}
+
+// Appends a positive integer
+static inline void appendInt (char*& p, size_t value) {
+    char digits[24];
+    int count = 0;
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (count > 0) {
+        *p++ = digits[--count];
+    }
+}
+
+// Appends micro / 1000000 with 6 decimals, like "%f" does
+static inline void appendFixed (char*& p, long micro) {
+    if (micro < 0) {
+        *p++ = '-';
+        micro = -micro;
+    }
+    appendInt(p, micro / MICRO);
+    *p++ = '.';
+
+    long fraction = micro % MICRO;
+    for (long digit = MICRO / 10; digit > 0; digit /= 10) {
+        *p++ = (char) ('0' + (fraction / digit) % 10);
+    }
+}
+
+static inline void appendText (char*& p, const char* text) {
+    while (*text) {
+        *p++ = *text++;
+    }
+}
+
+// Appends one corner of a face in the pattern
+static inline void appendCorner (char*& p, size_t index, ObjPattern pattern) {
+    *p++ = ' ';
+    appendInt(p, index);
+    if (pattern == PATTERN_VN) {
+        appendText(p, "//");
+        appendInt(p, index);
+    } else if (pattern == PATTERN_VTN) {
+        *p++ = '/';
+        appendInt(p, index);
+        *p++ = '/';
+        appendInt(p, index);
+    }
+}
+
+/*
+ * A buffer that is written to the file once it is almost full.
+ */
+struct ObjWriter {
+    FILE* fp;
+    std::vector<char> buffer;
+    char* p;
+    size_t written;
+
+    ObjWriter (FILE* fp) : fp(fp), buffer(WRITE_BUFFER_SIZE), p(&buffer[0]), written(0) {
+    }
+
+    // Room for one more line
+    void reserveLine () {
+        if ((size_t) (&buffer[0] + buffer.size() - p) < MAX_LINE_SIZE) {
+            flush();
+        }
+    }
+
+    void flush () {
+        size_t length = p - &buffer[0];
+        written += fwrite(&buffer[0], 1, length, fp);
+        p = &buffer[0];
+    }
+};
+
+/*
+ * generateObj
+ *
+ * INPUT:
+ *         filename - the file that is written.
+ *         faces - how many triangles it has.
+ *         pattern - what the corners of the faces have.
+ *
+ * RETURN:
+ *         The size of the file in bytes, 0 if it could not be written.
+ *
+ * DESCRIPTION:
+ *         Writes a grid of quads (two triangles each) over a bumpy
+ *         terrain, cut at the wanted number of faces. Every vertex has its
+ *         own texture coordinate and normal when the pattern has them.
+ *         The numbers are written from integers, so the same arguments
+ *         give the same file byte for byte on every machine, and quickly
+ *         enough for files of tens of millions of faces.
+ *
+ */
+size_t generateObj(const char* filename, size_t faces, ObjPattern pattern) {
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    // a square grid, the last row is only as long as needed
+    size_t quads = (faces + 1) / 2;
+    size_t width = (size_t) ceil(sqrt((double) quads));
+    if (width == 0) {
+        width = 1;
+    }
+    size_t rows = (quads + width - 1) / width;
+    size_t row = width + 1;
+
+    ObjWriter writer(fp);
+    char*& p = writer.p;
+
+    writer.reserveLine();
+    appendText(p, "# generated by benchmarkHelper, ");
+    appendInt(p, faces);
+    appendText(p, " faces\n");
+
+    // positions, heights from a deterministic pseudo random sequence
+    unsigned int seed = 12345;
+    for (size_t j = 0; j <= rows; ++j) {
+        for (size_t i = 0; i <= width; ++i) {
+            seed = seed * 1103515245u + 12345u;
+
+            writer.reserveLine();
+            appendText(p, "v ");
+            appendFixed(p, (long) (i * 2 * MICRO / width) - MICRO);
+            *p++ = ' ';
+            appendFixed(p, (long) ((seed >> 16) % (MICRO / 10)));
+            *p++ = ' ';
+            appendFixed(p, (long) (j * 2 * MICRO / width) - MICRO);
+            *p++ = '\n';
+        }
+    }
+
+    if (pattern == PATTERN_VTN) {
+        for (size_t j = 0; j <= rows; ++j) {
+            for (size_t i = 0; i <= width; ++i) {
+                writer.reserveLine();
+                appendText(p, "vt ");
+                appendFixed(p, (long) (i * MICRO / width));
+                *p++ = ' ';
+                appendFixed(p, (long) (j * MICRO / width));
+                *p++ = '\n';
+            }
+        }
+    }
+
+    // normals leaning a little, also pseudo random
+    if (pattern == PATTERN_VN || pattern == PATTERN_VTN) {
+        for (size_t j = 0; j <= rows; ++j) {
+            for (size_t i = 0; i <= width; ++i) {
+                seed = seed * 1103515245u + 12345u;
+                long x = (long) ((seed >> 8) % (MICRO / 5)) - MICRO / 10;
+                long z = (long) ((seed >> 12) % (MICRO / 5)) - MICRO / 10;
+
+                writer.reserveLine();
+                appendText(p, "vn ");
+                appendFixed(p, x);
+                *p++ = ' ';
+                appendFixed(p, MICRO - (x * x + z * z) / (2 * MICRO));
+                *p++ = ' ';
+                appendFixed(p, z);
+                *p++ = '\n';
+            }
+        }
+    }
+
+    // two triangles per quad, the last quad may only have one
+    size_t written = 0;
+    for (size_t j = 0; j < rows && written < faces; ++j) {
+        for (size_t i = 0; i < width && written < faces; ++i) {
+            size_t a = j * row + i + 1;
+            size_t b = a + 1;
+            size_t c = a + row;
+            size_t d = c + 1;
+
+            writer.reserveLine();
+            *p++ = 'f';
+            appendCorner(p, a, pattern);
+            appendCorner(p, c, pattern);
+            appendCorner(p, b, pattern);
+            *p++ = '\n';
+            ++written;
+
+            if (written < faces) {
+                writer.reserveLine();
+                *p++ = 'f';
+                appendCorner(p, b, pattern);
+                appendCorner(p, c, pattern);
+                appendCorner(p, d, pattern);
+                *p++ = '\n';
+                ++written;
+            }
+        }
+    }
+
+    writer.flush();
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+    return ok ? writer.written : 0;
+}
+
+/*
+ * readStatusMB
+ *
+ * INPUT:
+ *         name - a field of /proc/self/status, e.g. "VmRSS".
+ *
+ * RETURN:
+ *         Its value in MB, -1 where there is no /proc.
+ *
+ */
+double readStatusMB(const char* name) {
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return -1.0;
+    }
+
+    char line[256];
+    double value = -1.0;
+    size_t length = strlen(name);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, name, length) == 0 && line[length] == ':') {
+            value = atof(line + length + 1) / 1024.0;
+            break;
+        }
+    }
+    fclose(fp);
+    return value;
+}
+
+/*
+ * resetPeakMemory
+ *
+ * RETURN:
+ *         False if the peak could not be reset.
+ *
+ * DESCRIPTION:
+ *         Makes the peak of peakMemoryMB start again from the current
+ *         resident memory. Only possible on Linux with a writable
+ *         /proc/self/clear_refs, when it fails the peak is still the one
+ *         since the program started.
+ *
+ */
+bool resetPeakMemory() {
+    FILE* fp = fopen("/proc/self/clear_refs", "w");
+    if (fp == NULL) {
+        return false;
+    }
+    bool reset = fputs("5", fp) >= 0;
+    return fclose(fp) == 0 && reset;
+}
+
+/*
+ * peakMemoryMB
+ *
+ * RETURN:
+ *         Peak resident memory of the process in MB, see resetPeakMemory.
+ *
+ */
+double peakMemoryMB() {
+    double peak = readStatusMB("VmHWM");
+#ifndef _WIN32
+    if (peak < 0.0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        // bytes on macOS, kilobytes elsewhere
+        peak = usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+        peak = usage.ru_maxrss / 1024.0;
+#endif
+    }
+#endif
+    return peak;
+}
+
+// Every operator new and delete of the program goes through these, the
+// array and sized forms too, so each allocation is counted once and freed
+// by the same free whatever the library would pick
+static std::atomic<size_t> allocations(0);
+static std::atomic<size_t> allocatedBytes(0);
+
+// Counts and makes one allocation
+static void* countedAllocation (size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new (size_t size) {
+    return countedAllocation(size);
+}
+
+void* operator new[] (size_t size) {
+    return countedAllocation(size);
+}
+
+void operator delete (void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[] (void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete (void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[] (void* memory, size_t) noexcept {
+    free(memory);
+}
+
+/*
+ * resetAllocations
+ *
+ * DESCRIPTION:
+ *         Sets the counters of getAllocations and getAllocatedBytes to 0.
+ *         Every operator new of a program linked with benchmarkHelper.cpp
+ *         is counted.
+ *
+ */
+void resetAllocations() {
+    allocations = 0;
+    allocatedBytes = 0;
+}
+
+/*
+ * getAllocations
+ *
+ * RETURN:
+ *         How many times operator new was called since resetAllocations.
+ *
+ */
+size_t getAllocations() {
+    return allocations;
+}
+
+/*
+ * getAllocatedBytes
+ *
+ * RETURN:
+ *         How many bytes operator new gave since resetAllocations.
+ *
+ */
+size_t getAllocatedBytes() {
+    return allocatedBytes;
+}
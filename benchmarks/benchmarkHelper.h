@@ -0,0 +1,123 @@
+/*
+ * benchmarkHelper.h
+ *
+ * What the benchmarks share: a generator of deterministic .obj files,
+ * peak memory and allocation counters.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _BENCHMARKHELPER_H
+#define _BENCHMARKHELPER_H
+
+#include <stddef.h>
+
+// The face patterns the generator can write
+enum ObjPattern {
+    PATTERN_V = 0,      // "f 1 2 3"
+    PATTERN_VN,         // "f 1//1 2//2 3//3"
+    PATTERN_VTN,        // "f 1/1/1 2/2/2 3/3/3"
+    NUM_PATTERNS
+};
+
+/*
+ * getPatternName
+ *
+ * INPUT:
+ *         pattern - a face pattern.
+ *
+ * RETURN:
+ *         How its corners look, e.g. "v/vt/vn".
+ *
+ */
+const char* getPatternName(ObjPattern pattern);
+
+/*
+ * generateObj
+ *
+ * INPUT:
+ *         filename - the file that is written.
+ *         faces - how many triangles it has.
+ *         pattern - what the corners of the faces have.
+ *
+ * RETURN:
+ *         The size of the file in bytes, 0 if it could not be written.
+ *
+ * DESCRIPTION:
+ *         Writes a grid of quads (two triangles each) over a bumpy
+ *         terrain, cut at the wanted number of faces. Every vertex has its
+ *         own texture coordinate and normal when the pattern has them.
+ *         The numbers are written from integers, so the same arguments
+ *         give the same file byte for byte on every machine, and quickly
+ *         enough for files of tens of millions of faces.
+ *
+ */
+size_t generateObj(const char* filename, size_t faces, ObjPattern pattern);
+
+/*
+ * readStatusMB
+ *
+ * INPUT:
+ *         name - a field of /proc/self/status, e.g. "VmRSS".
+ *
+ * RETURN:
+ *         Its value in MB, -1 where there is no /proc.
+ *
+ */
+double readStatusMB(const char* name);
+
+/*
+ * resetPeakMemory
+ *
+ * RETURN:
+ *         False if the peak could not be reset.
+ *
+ * DESCRIPTION:
+ *         Makes the peak of peakMemoryMB start again from the current
+ *         resident memory. Only possible on Linux with a writable
+ *         /proc/self/clear_refs, when it fails the peak is still the one
+ *         since the program started.
+ *
+ */
+bool resetPeakMemory();
+
+/*
+ * peakMemoryMB
+ *
+ * RETURN:
+ *         Peak resident memory of the process in MB, see resetPeakMemory.
+ *
+ */
+double peakMemoryMB();
+
+/*
+ * resetAllocations
+ *
+ * DESCRIPTION:
+ *         Sets the counters of getAllocations and getAllocatedBytes to 0.
+ *         Every operator new of a program linked with benchmarkHelper.cpp
+ *         is counted.
+ *
+ */
+void resetAllocations();
+
+/*
+ * getAllocations
+ *
+ * RETURN:
+ *         How many times operator new was called since resetAllocations.
+ *
+ */
+size_t getAllocations();
+
+/*
+ * getAllocatedBytes
+ *
+ * RETURN:
+ *         How many bytes operator new gave since resetAllocations.
+ *
+ */
+size_t getAllocatedBytes();
+
+#endif
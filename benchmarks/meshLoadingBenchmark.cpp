@@ -0,0 +1,278 @@
+/*
+ * meshLoadingBenchmark.cpp
+ *
+ * Measures every way a mesh is loaded. For each size asked for, one .obj
+ * file is generated per face pattern ("v", "v//vn" and "v/vt/vn") and read
+ * by each path: the obj::readObjFile parser (serially and on every core),
+ * the CPU side of each Shape::readObj* function (parse, weld, sort by
+ * material, tangents) and a load from the mesh cache. Each path reports
+ * its throughput, how many allocations it made and its peak memory.
+ * First, a small file with face indices that point nowhere is loaded with
+ * every mask, and every element it gets has to be one of its vertices.
+ *
+ * Usage: meshBenchmark [faces] [faces] ...
+ *        The sizes go from 10000 to 50000000 faces (the default is 10000,
+ *        100000 and 1000000). The largest files take a few GB of disk and
+ *        memory.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+// C libraries
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ libraries
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmarkHelper.h"
+#include "meshCache.h"
+#include "meshLoader.h"
+#include "objReader.h"
+
+using namespace std;
+
+// The sizes this benchmark is meant for
+static const size_t MIN_FACES = 10000;
+static const size_t MAX_FACES = 50000000;
+
+// Above this many faces a path runs once, below it the best of a few runs
+static const size_t MAX_FACES_REPEATED = 1000000;
+static const int REPEATED_RUNS = 3;
+
+/*
+ * A way of loading a mesh: the parser alone, or one of the readObj*
+ * functions without the OpenGL part.
+ */
+struct LoadPath {
+    const char* name;
+
+    // attributes the file needs, the path is skipped for the others
+    unsigned int needs;
+
+    // 0 for obj::readObjFile, otherwise the mask of loadWeldedObj
+    unsigned int attributes;
+    bool withTangents;
+    bool useCache;
+
+    // threads that parse the file, 0 is every core
+    int numThreads;
+};
+
+static const LoadPath paths[] = {
+    { "obj::readObjFile",           OBJ_POSITION,               0,                          false, false, 1 },
+    { "obj::readObjFile all cores", OBJ_POSITION,               0,                          false, false, 0 },
+    { "readObjVert",                OBJ_POSITION,               OBJ_POSITION,               false, false, 1 },
+    { "readObjVertNorm",            OBJ_POSITION | OBJ_NORMAL,  OBJ_POSITION | OBJ_NORMAL,  false, false, 1 },
+    { "readObjVertTexNorm",         OBJ_ALL,                    OBJ_ALL,                    false, false, 1 },
+    { "readObjLightMap",            OBJ_ALL,                    OBJ_ALL,                    true,  false, 1 },
+    { "readObjLightMap from cache", OBJ_ALL,                    OBJ_ALL,                    true,  true,  1 }
+};
+static const int NUM_PATHS = sizeof(paths) / sizeof(paths[0]);
+
+// The attributes each pattern has
+static unsigned int patternAttributes (ObjPattern pattern) {
+    switch (pattern) {
+        case PATTERN_VN:
+            return OBJ_POSITION | OBJ_NORMAL;
+        case PATTERN_VTN:
+            return OBJ_ALL;
+        default:
+            return OBJ_POSITION;
+    }
+}
+
+/*
+ * What one run of a path measured.
+ */
+struct LoadResult {
+    bool ok;
+    double seconds;
+    size_t allocations;
+    size_t allocatedBytes;
+
+    // the peak is -1 when it could not be reset before the run, it would
+    // be the one of the whole program
+    double peakMB;
+};
+
+// Loads filename once with path
+static LoadResult runPath (const LoadPath& path, const char* filename) {
+    LoadResult result;
+
+    bool peakReset = resetPeakMemory();
+    double before = readStatusMB("VmRSS");
+    resetAllocations();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // the result stays alive until the peak is read
+    obj::ObjData data;
+    MeshData mesh;
+    if (path.attributes == 0) {
+        result.ok = obj::readObjFile(filename, data, path.numThreads);
+    } else {
+        result.ok = loadWeldedObj(filename, path.attributes, path.withTangents, path.useCache,
+                                  path.numThreads, mesh);
+    }
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.allocations = getAllocations();
+    result.allocatedBytes = getAllocatedBytes();
+    result.peakMB = peakReset ? peakMemoryMB() - before : -1.0;
+    return result;
+}
+
+// The best time of a few runs, the counters of the last one
+static LoadResult measurePath (const LoadPath& path, const char* filename, int runs) {
+    LoadResult best = runPath(path, filename);
+    for (int i = 1; i < runs && best.ok; ++i) {
+        LoadResult result = runPath(path, filename);
+        result.seconds = (result.seconds < best.seconds) ? result.seconds : best.seconds;
+        best = result;
+    }
+    return best;
+}
+
+// Faces whose indices are 0, past the last record or relative past the
+// first one, with every pattern: they must load without crashing and get
+// only elements of vertices the mesh has
+static const char* MALFORMED_OBJ =
+    "v 0 0 0\n"
+    "v 1 0 0\n"
+    "v 0 1 0\n"
+    "vt 0 0\n"
+    "vn 0 0 1\n"
+    "f 1 2 900000\n"
+    "f 0 1 2\n"
+    "f -5 1 2\n"
+    "f 1/1/1 2/1/1 3/900/1\n"
+    "f 1//1 2//900 3//1\n"
+    "f 1/1 900/1 3/0\n";
+static const size_t MALFORMED_FACES = 6;
+
+// Loads MALFORMED_OBJ with every mask of attributes (and with tangents
+// when it has uvs), and checks the elements. Returns true if all of them
+// are fine
+static bool checkMalformedFile () {
+    const char* filename = "meshBenchmark_malformed.obj";
+    FILE* file = fopen(filename, "w");
+    if (file == NULL || fputs(MALFORMED_OBJ, file) < 0) {
+        fprintf(stderr, "could not write %s\n", filename);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+    fclose(file);
+
+    printf("malformed face indices:");
+    bool ok = true;
+    for (unsigned int attributes = OBJ_POSITION; attributes <= OBJ_ALL; ++attributes) {
+        if (!(attributes & OBJ_POSITION)) {
+            continue;
+        }
+        int withTangents = (attributes & OBJ_TEXCOORD) ? 1 : 0;
+        for (int tangents = 0; tangents <= withTangents; ++tangents) {
+            MeshData mesh;
+            bool loaded = loadWeldedObj(filename, attributes, tangents != 0, false, 1, mesh);
+            bool valid = loaded && mesh.elements.size() == MALFORMED_FACES * 3;
+            for (size_t i = 0; valid && i < mesh.elements.size(); ++i) {
+                valid = mesh.elements[i] < mesh.vertices.size() / 3;
+            }
+            if (!valid) {
+                printf(" mask %u%s FAILED", attributes, tangents ? " with tangents" : "");
+                ok = false;
+            }
+        }
+    }
+    printf(ok ? " ok\n" : "\n");
+
+    remove(filename);
+    return ok;
+}
+
+int main ( int argc, char **argv ) {
+    vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        size_t faces = strtoull(argv[i], NULL, 10);
+        if (faces < MIN_FACES || faces > MAX_FACES) {
+            fprintf(stderr, "the sizes go from %zu to %zu faces, %s is out\n", MIN_FACES, MAX_FACES, argv[i]);
+            return 1;
+        }
+        sizes.push_back(faces);
+    }
+    if (sizes.empty()) {
+        sizes.push_back(10000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+
+    printf("%u cores on this machine\n", thread::hardware_concurrency());
+    bool allOk = checkMalformedFile();
+
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        for (int p = 0; p < NUM_PATTERNS; ++p) {
+            ObjPattern pattern = (ObjPattern) p;
+            size_t faces = sizes[s];
+
+            char filename[64];
+            snprintf(filename, sizeof(filename), "meshBenchmark_%zu_%d.obj", faces, p);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            size_t bytes = generateObj(filename, faces, pattern);
+            double generating = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (bytes == 0) {
+                fprintf(stderr, "could not write %s\n", filename);
+                return 1;
+            }
+
+            double megabytes = bytes / (1024.0 * 1024.0);
+            printf("\n%zu faces, %s: %.1f MB (generated in %.2f s)\n", faces, getPatternName(pattern),
+                   megabytes, generating);
+            printf("%-28s %9s %9s %10s %12s %10s %9s\n", "path", "seconds", "MB/s", "Mfaces/s",
+                   "allocations", "alloc MB", "peak MB");
+
+            int runs = (faces > MAX_FACES_REPEATED) ? 1 : REPEATED_RUNS;
+
+            for (int i = 0; i < NUM_PATHS; ++i) {
+                const LoadPath& path = paths[i];
+                if ((path.needs & patternAttributes(pattern)) != path.needs) {
+                    continue;
+                }
+                std::string cachePath = getMeshCachePath(filename, path.attributes, path.withTangents);
+
+                // the cache is written by a load that is not measured
+                remove(cachePath.c_str());
+                if (path.useCache) {
+                    MeshData mesh;
+                    loadWeldedObj(filename, path.attributes, path.withTangents, true, path.numThreads, mesh);
+                }
+
+                LoadResult result = measurePath(path, filename, runs);
+                remove(cachePath.c_str());
+                if (!result.ok) {
+                    printf("%-28s failed\n", path.name);
+                    allOk = false;
+                    continue;
+                }
+
+                printf("%-28s %9.3f %9.1f %10.2f %12zu %10.1f", path.name, result.seconds,
+                       megabytes / result.seconds, faces / 1e6 / result.seconds, result.allocations,
+                       result.allocatedBytes / (1024.0 * 1024.0));
+                if (result.peakMB < 0.0) {
+                    printf(" %9s\n", "no reset");
+                } else {
+                    printf(" %9.1f\n", result.peakMB);
+                }
+            }
+
+            remove(filename);
+        }
+    }
+
+    return allOk ? 0 : 1;
+}
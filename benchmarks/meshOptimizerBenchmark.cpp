@@ -0,0 +1,381 @@
+/*
+ * meshOptimizerBenchmark.cpp
+ *
+ * Measures the passes of meshOptimizer.h on the CPU, no GPU is needed: for
+ * a generated grid (in the row order it is written, and with its triangles
+ * and vertices shuffled) and for any .obj file given, it reports the ACMR
+ * of the simulated post-transform cache before and after
+ * optimizeVertexCache, how long the pass takes, and the overfetch of the
+ * vertex buffer before and after optimizeVertexFetch. For the .obj files
+ * it also reports the overdraw after optimizeOverdraw with a few
+ * thresholds, against the ACMR it costs. Then it builds a chain of levels
+ * of detail of every mesh and reports their triangles, their error and
+ * how long the chain took. Last, it splits every mesh in meshlets and
+ * reports their size, what they cost in ACMR, and how many of them are
+ * culled when the mesh is seen from its six sides, from far and from up
+ * close.
+ *
+ * Usage: optimizerBenchmark [faces] [file.obj] [file.obj] ...
+ *        The grid has 1000000 faces by default.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+// C libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+// C++ libraries
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "benchmarkHelper.h"
+#include "mathHelper.h"
+#include "meshLoader.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "meshlet.h"
+#include "objReader.h"
+
+using namespace std;
+
+// Cache sizes the ACMR is reported for
+static const int SMALL_CACHE = 16;
+static const int LARGE_CACHE = 32;
+
+// Moves the triangles of mesh to a deterministic random order, the worst
+// case for the cache
+static void shuffleTriangles (MeshData& mesh) {
+    size_t numTriangles = mesh.elements.size() / 3;
+    unsigned int seed = 12345;
+    for (size_t i = numTriangles; i > 1; --i) {
+        seed = seed * 1103515245u + 12345u;
+        size_t j = ((size_t) (seed >> 8) * 131071u + (seed >> 16)) % i;
+        for (int c = 0; c < 3; ++c) {
+            std::swap(mesh.elements[(i - 1) * 3 + c], mesh.elements[j * 3 + c]);
+        }
+    }
+}
+
+// Moves the vertices of mesh to a deterministic random order, as if they
+// were written in no particular order
+static void shuffleVertices (MeshData& mesh) {
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    vector<GLuint> remap(numVertices);
+    for (GLuint v = 0; v < numVertices; ++v) {
+        remap[v] = v;
+    }
+
+    unsigned int seed = 54321;
+    for (GLuint i = numVertices; i > 1; --i) {
+        seed = seed * 1103515245u + 12345u;
+        GLuint j = (GLuint) (((size_t) (seed >> 8) * 131071u + (seed >> 16)) % i);
+        std::swap(remap[i - 1], remap[j]);
+    }
+
+    remapVertexArray(mesh.vertices, 3, remap);
+    remapVertexArray(mesh.normals, 3, remap);
+    remapVertexArray(mesh.uvtextures, 2, remap);
+    for (size_t i = 0; i < mesh.elements.size(); ++i) {
+        mesh.elements[i] = remap[mesh.elements[i]];
+    }
+}
+
+static float meshAcmr (const MeshData& mesh, int cacheSize) {
+    if (mesh.elements.empty()) {
+        return 0.0f;
+    }
+    return computeAcmr(&mesh.elements[0], mesh.elements.size(), (GLuint) (mesh.vertices.size() / 3),
+                       cacheSize);
+}
+
+// Optimizes mesh for the vertex cache and then for the vertex fetch, and
+// prints one line of the report
+static void measure (const char* name, MeshData& mesh) {
+    size_t triangles = mesh.elements.size() / 3;
+    float before16 = meshAcmr(mesh, SMALL_CACHE);
+    float before32 = meshAcmr(mesh, LARGE_CACHE);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    optimizeVertexCache(mesh);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    float after16 = meshAcmr(mesh, SMALL_CACHE);
+    float after32 = meshAcmr(mesh, LARGE_CACHE);
+
+    VertexFetchStats fetch = optimizeVertexFetch(mesh);
+
+    printf("%-24s %10zu %10zu %8.3f %8.3f %8.3f %8.3f %9.3f %9.2f %8.3f %8.3f\n", name, triangles,
+           mesh.vertices.size() / 3, before16, after16, before32, after32, seconds,
+           triangles / 1e6 / seconds, fetch.overfetchBefore, fetch.overfetchAfter);
+}
+
+// Thresholds the overdraw pass is measured with
+static const float overdrawThresholds[] = { 1.0f, 1.05f, 1.2f, 2.0f };
+
+// Sorts the clusters of mesh (already optimized for the cache) with every
+// threshold, and prints one line of the report for each
+static void measureOverdraw (const char* name, const MeshData& mesh) {
+    for (size_t i = 0; i < sizeof(overdrawThresholds) / sizeof(overdrawThresholds[0]); ++i) {
+        MeshData sorted = mesh;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        OverdrawStats stats = optimizeOverdraw(sorted, overdrawThresholds[i]);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        printf("%-24s %10.2f %9.3f %8.3f %8.3f %8.3f %9.3f\n", name, overdrawThresholds[i],
+               stats.overdrawBefore, stats.overdrawAfter, stats.acmrBefore, stats.acmrAfter, seconds);
+    }
+}
+
+// Levels of detail built after the full mesh, each one with half the
+// triangles of the one before
+static const int LOD_LEVELS = 5;
+
+// Builds the levels of detail of a copy of mesh and prints one line of
+// the report for each level
+static void measureLods (const char* name, const MeshData& mesh) {
+    MeshData chain = mesh;
+    vector<MeshLod> lods;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    buildLodChain(chain, LOD_LEVELS, LOD_REDUCTION, lods);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // the time is for the whole chain, it goes on the first line
+    printf("%-24s %6d %10u %10.5f %9.3f\n", name, 0, lods[0].numElements / 3, lods[0].error, seconds);
+    for (size_t i = 1; i < lods.size(); ++i) {
+        printf("%-24s %6zu %10u %10.5f\n", name, i, lods[i].numElements / 3, lods[i].error);
+    }
+}
+
+// Writes a sphere of radius 1 with about faces triangles to mesh, rings
+// of quads from pole to pole with the seam of the uvs doubled, a smooth
+// surface like the scanned meshes the meshlets are made for
+static void makeSphereMesh (MeshData& mesh, size_t faces) {
+    mesh.clear();
+    int rings = std::max((int) sqrt(faces / 4.0), 2);
+    int segments = rings * 2;
+
+    for (int r = 0; r <= rings; ++r) {
+        float theta = (float) (PI * r / rings);
+        for (int s = 0; s <= segments; ++s) {
+            float phi = (float) (2.0 * PI * s / segments);
+            float normal[3] = { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+            for (int c = 0; c < 3; ++c) {
+                mesh.vertices.push_back(normal[c]);
+                mesh.normals.push_back(normal[c]);
+            }
+            mesh.uvtextures.push_back(s / (float) segments);
+            mesh.uvtextures.push_back(r / (float) rings);
+        }
+    }
+
+    // counterclockwise seen from outside
+    for (int r = 0; r < rings; ++r) {
+        for (int s = 0; s < segments; ++s) {
+            GLuint a = r * (segments + 1) + s;
+            GLuint b = a + segments + 1;
+            GLuint quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+            mesh.elements.insert(mesh.elements.end(), quad, quad + 6);
+        }
+    }
+}
+
+// How far the cameras of the culling report are from the center of the
+// mesh, in diagonals of its bounding box: far sees all of it, near only
+// the middle of one side
+static const float FAR_VIEW = 1.5f;
+static const float NEAR_VIEW = 0.6f;
+
+// Culls the meshlets of mesh from its six sides at distance diagonals of
+// its bounding box from its center, and prints one line of the report
+// with the averages
+static void measureCulling (const char* name, const char* view, const MeshData& mesh,
+                            const vector<Meshlet>& meshlets, float distance) {
+    float low[3];
+    float high[3];
+    for (int c = 0; c < 3; ++c) {
+        low[c] = high[c] = mesh.vertices[c];
+    }
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        low[i % 3] = std::min(low[i % 3], mesh.vertices[i]);
+        high[i % 3] = std::max(high[i % 3], mesh.vertices[i]);
+    }
+    float center[3];
+    float diagonal = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+        center[c] = (low[c] + high[c]) * 0.5f;
+        diagonal += (high[c] - low[c]) * (high[c] - low[c]);
+    }
+    diagonal = sqrtf(diagonal);
+
+    // the same projection as the camera of the examples
+    Matrix4 projection = makePerspectiveMatrix(60.0f, 1.0f, 1.0f, diagonal * 0.01f, diagonal * 10.0f);
+
+    double backface = 0.0;
+    double frustum = 0.0;
+    double visible = 0.0;
+    double visibleTriangles = 0.0;
+    double draws = 0.0;
+    double seconds = 0.0;
+    vector<DrawElementsIndirectCommand> commands;
+
+    for (int side = 0; side < 6; ++side) {
+        float eye[3] = { center[0], center[1], center[2] };
+        eye[side / 2] += ((side % 2) ? -1.0f : 1.0f) * diagonal * distance;
+        float target[3] = { center[0], center[1], center[2] };
+        float up[3] = { 0.0f, 1.0f, 0.0f };
+        if (side / 2 == 1) {
+            up[1] = 0.0f;
+            up[2] = 1.0f;
+        }
+        Matrix4 viewProjection = projection * makeViewMatrix(eye, target, up);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        MeshletCullStats stats = cullMeshlets(meshlets, eye, &viewProjection[0][0], commands);
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        backface += stats.backfaceCulled / (double) stats.numMeshlets;
+        frustum += stats.frustumCulled / (double) stats.numMeshlets;
+        visible += stats.visibleMeshlets / (double) stats.numMeshlets;
+        visibleTriangles += stats.visibleTriangles / (double) stats.numTriangles;
+        draws += stats.numDraws;
+    }
+
+    printf("%-24s %6s %9.1f%% %9.1f%% %9.1f%% %9.1f%% %8.1f %10.1f\n", name, view, backface / 6 * 100,
+           frustum / 6 * 100, visible / 6 * 100, visibleTriangles / 6 * 100, draws / 6, seconds / 6 * 1e6);
+}
+
+// Splits mesh (already optimized for the cache) in meshlets and prints one
+// line of the report
+static void measureMeshlets (const char* name, MeshData& mesh, vector<Meshlet>& meshlets) {
+    float before = meshAcmr(mesh, SMALL_CACHE);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    buildMeshlets(mesh, meshlets);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    float after = meshAcmr(mesh, SMALL_CACHE);
+
+    size_t vertices = 0;
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        vertices += meshlets[i].numVertices;
+    }
+    size_t count = std::max(meshlets.size(), (size_t) 1);
+    printf("%-24s %9zu %8.1f %8.1f %8.3f %8.3f %9.3f\n", name, meshlets.size(),
+           vertices / (double) count, mesh.elements.size() / 3.0 / count, before, after, seconds);
+}
+
+// Reads filename welded with every attribute, in the order of the file
+static bool readMesh (const char* filename, MeshData& mesh) {
+    obj::ObjData data;
+    if (!obj::readObjFile(filename, data, 0)) {
+        return false;
+    }
+    weldObjData(data, OBJ_ALL, mesh);
+    return true;
+}
+
+int main ( int argc, char **argv ) {
+    size_t faces = 1000000;
+    vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (isdigit((unsigned char) argv[i][0])) {
+            faces = strtoull(argv[i], NULL, 10);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    const char* gridFile = "optimizerBenchmark.obj";
+    if (generateObj(gridFile, faces, PATTERN_VTN) == 0) {
+        fprintf(stderr, "could not write %s\n", gridFile);
+        return 1;
+    }
+
+    printf("%-24s %10s %10s %8s %8s %8s %8s %9s %9s %8s %8s\n", "mesh", "triangles", "vertices",
+           "acmr16", "after", "acmr32", "after", "seconds", "Mtris/s", "fetch", "after");
+
+    MeshData mesh;
+    if (!readMesh(gridFile, mesh)) {
+        fprintf(stderr, "could not read %s\n", gridFile);
+        return 1;
+    }
+    remove(gridFile);
+
+    MeshData grid = mesh;
+    MeshData shuffled = mesh;
+    shuffleTriangles(shuffled);
+    shuffleVertices(shuffled);
+
+    measure("grid, file order", mesh);
+    measure("grid, shuffled", shuffled);
+
+    bool allOk = true;
+    vector<MeshData> meshes(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!readMesh(files[i], meshes[i])) {
+            printf("%-24s could not be read\n", files[i]);
+            allOk = false;
+            continue;
+        }
+        measure(files[i], meshes[i]);
+    }
+
+    if (!files.empty()) {
+        printf("\n%-24s %10s %9s %8s %8s %8s %9s\n", "mesh", "threshold", "overdraw", "after",
+               "acmr16", "after", "seconds");
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!meshes[i].elements.empty()) {
+            measureOverdraw(files[i], meshes[i]);
+        }
+    }
+
+    printf("\n%-24s %6s %10s %10s %9s\n", "mesh", "level", "triangles", "error", "seconds");
+    measureLods("grid", grid);
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!meshes[i].elements.empty()) {
+            measureLods(files[i], meshes[i]);
+        }
+    }
+
+    // the meshes measured above are optimized for the cache, the grid in
+    // file order goes with the files
+    MeshData sphere;
+    makeSphereMesh(sphere, faces);
+    optimizeVertexCache(sphere);
+    optimizeVertexFetch(sphere);
+
+    vector<const char*> names(1, "grid");
+    vector<MeshData*> split(1, &mesh);
+    names.push_back("sphere");
+    split.push_back(&sphere);
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!meshes[i].elements.empty()) {
+            names.push_back(files[i]);
+            split.push_back(&meshes[i]);
+        }
+    }
+
+    printf("\n%-24s %9s %8s %8s %8s %8s %9s\n", "mesh", "meshlets", "vertices", "tris",
+           "acmr16", "after", "seconds");
+    vector< vector<Meshlet> > meshlets(split.size());
+    for (size_t i = 0; i < split.size(); ++i) {
+        measureMeshlets(names[i], *split[i], meshlets[i]);
+    }
+
+    // backface, frustum and visible are fractions of the meshlets, visible
+    // tris of the triangles
+    printf("\n%-24s %6s %10s %10s %10s %10s %8s %10s\n", "mesh", "view", "backface", "frustum",
+           "visible", "vis tris", "draws", "cull us");
+    for (size_t i = 0; i < split.size(); ++i) {
+        measureCulling(names[i], "far", *split[i], meshlets[i], FAR_VIEW);
+        measureCulling(names[i], "near", *split[i], meshlets[i], NEAR_VIEW);
+    }
+
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+/*
+ * numberParsingBenchmark.cpp
+ *
+ * Measures how fast parseFloat reads numbers compared to strtof and to
+ * istringstream, on the kinds of numbers asset files have. Before timing,
+ * every number of every set is checked bit by bit against strtof (in the
+ * "C" locale), including the numbers that are exactly half way between
+ * two floats and the ones parseFloat gives to its slow path.
+ *
+ * Usage: numberBenchmark [numbers per set]
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+// C libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+#include <locale.h>
+
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+// C++ libraries
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "numberParser.h"
+
+using namespace std;
+
+/*
+ * A set of numbers, all in one buffer separated by spaces like they are
+ * on a file.
+ */
+struct NumberSet {
+    const char* name;
+    string text;
+    size_t count;
+};
+
+void addNumber (NumberSet& set, const char* format, double value) {
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), format, value);
+    set.text += buffer;
+    set.text += ' ';
+    ++set.count;
+}
+
+void addText (NumberSet& set, const char* text) {
+    set.text += text;
+    set.text += ' ';
+    ++set.count;
+}
+
+float randomFloatBits (mt19937& random) {
+    float value;
+    do {
+        uint32_t bits = random();
+        memcpy(&value, &bits, sizeof(value));
+    } while (!isfinite(value));
+    return value;
+}
+
+/*
+ * The sets: what .obj exporters write (%f and %.6g), floats written with
+ * every digit they need (%.9g, over every magnitude), doubles (%.17g),
+ * the values half way between two floats written exactly, and a few
+ * special cases.
+ */
+vector<NumberSet> makeSets (size_t count) {
+    mt19937 random(12345);
+    uniform_real_distribution<double> coordinates(-100.0, 100.0);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+
+    vector<NumberSet> sets(6);
+    sets[0].name = "obj %f";
+    sets[1].name = "obj %.6g";
+    sets[2].name = "float %.9g";
+    sets[3].name = "double %.17g";
+    sets[4].name = "half way";
+    sets[5].name = "special";
+    for (size_t i = 0; i < sets.size(); ++i) {
+        sets[i].count = 0;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        addNumber(sets[0], "%f", coordinates(random));
+        addNumber(sets[1], "%.6g", unit(random));
+        addNumber(sets[2], "%.9g", randomFloatBits(random));
+        addNumber(sets[3], "%.17g", coordinates(random));
+    }
+
+    // the exact decimal value half way between a float and the next one,
+    // and the numbers right next to it
+    for (size_t i = 0; i < count / 8; ++i) {
+        float below = fabsf(randomFloatBits(random));
+        float above = nextafterf(below, INFINITY);
+        if (!isfinite(above)) {
+            continue;
+        }
+        double middle = ((double) below + (double) above) / 2.0;
+        addNumber(sets[4], "%.60g", middle);
+        addNumber(sets[4], "%.17g", middle);
+        addNumber(sets[4], "%.17g", nextafter(middle, 0.0));
+        addNumber(sets[4], "%.17g", nextafter(middle, INFINITY));
+    }
+
+    const char* special[] = {
+        "0", "-0", "+0.0", "0e10", "1", "-1", ".5", "5.", "-.25e+1", "1E3",
+        "3.4028235e38", "3.4028236e38", "1e39", "-1e39", "1.17549435e-38",
+        "1.4e-45", "7e-46", "1e-50", "1e-300", "1e300", "1e99999", "1e-99999",
+        "0.000000000000000000000000000000000000000000001401298464324817",
+        "123456789012345678901234567890", "0.1234567890123456789012345",
+        "1.00000000000000000000000000001", "0.30000001192092896", "16777217",
+        "33554431", "9007199254740993", "1e22", "1e23", "1e-22", "1e-23",
+        "2.5e", "2.5e+", "-", "+.", "."
+    };
+    for (size_t i = 0; i < sizeof(special) / sizeof(special[0]); ++i) {
+        addText(sets[5], special[i]);
+    }
+
+    return sets;
+}
+
+// strtof in the "C" locale, what parseFloat has to agree with
+locale_t cLocale;
+
+/*
+ * Reads every number of set with parseFloat and with strtof, and counts
+ * the ones whose bits differ. The number of characters each one used
+ * has to be the same too.
+ */
+size_t countMismatches (const NumberSet& set) {
+    const char* p = set.text.c_str();
+    const char* end = p + set.text.size();
+    size_t mismatches = 0;
+
+    while (p < end) {
+        float fast = 0.0f;
+        const char* fastEnd = parseFloat(p, end, fast);
+
+        char* exactEnd;
+        float exact = strtof_l(p, &exactEnd, cLocale);
+
+        uint32_t fastBits, exactBits;
+        memcpy(&fastBits, &fast, sizeof(fast));
+        memcpy(&exactBits, &exact, sizeof(exact));
+
+        // parseFloat leaves malformed exponents ("2.5e") out, like strtof
+        bool sameEnd = (fastEnd == exactEnd) || (fastEnd == p && exactEnd == p);
+        if ((fastEnd != p && fastBits != exactBits) || !sameEnd) {
+            if (mismatches < 10) {
+                const char* space = strchr(p, ' ');
+                printf("  mismatch: \"%.*s\" parseFloat %.9g, strtof %.9g\n",
+                       (int) (space - p), p, fast, exact);
+            }
+            ++mismatches;
+        }
+
+        p = strchr(p, ' ') + 1;
+    }
+    return mismatches;
+}
+
+float sink = 0.0f;
+
+double timeParseFloat (const NumberSet& set) {
+    const char* end = set.text.c_str() + set.text.size();
+    float sum = 0.0f;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (const char* p = set.text.c_str(); p < end; ++p) {
+        float value;
+        p = parseFloat(p, end, value);
+        sum += value;
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    sink += sum;
+    return elapsed.count();
+}
+
+double timeStrtof (const NumberSet& set) {
+    const char* end = set.text.c_str() + set.text.size();
+    float sum = 0.0f;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (const char* p = set.text.c_str(); p < end; ++p) {
+        char* next;
+        sum += strtof_l(p, &next, cLocale);
+        p = next;
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    sink += sum;
+    return elapsed.count();
+}
+
+double timeStream (const NumberSet& set) {
+    float sum = 0.0f;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    istringstream stream(set.text);
+    float value;
+    while (stream >> value) {
+        sum += value;
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    sink += sum;
+    return elapsed.count();
+}
+
+// Best time of a few runs
+double bestOf (double (*parser)(const NumberSet&), const NumberSet& set, int runs) {
+    double best = 0.0;
+    for (int i = 0; i < runs; ++i) {
+        double time = parser(set);
+        if (i == 0 || time < best) {
+            best = time;
+        }
+    }
+    return best;
+}
+
+int main ( int argc, char **argv ) {
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    cLocale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+
+    vector<NumberSet> sets = makeSets(count);
+
+    // Correctness first, every number has to be exactly what strtof gives
+    printf("bit exact check against strtof:\n");
+    size_t totalMismatches = 0;
+    for (size_t i = 0; i < sets.size(); ++i) {
+        size_t mismatches = countMismatches(sets[i]);
+        printf("%-14s %9zu numbers  %s\n", sets[i].name, sets[i].count,
+               mismatches == 0 ? "ok" : "MISMATCH");
+        totalMismatches += mismatches;
+    }
+    if (totalMismatches != 0) {
+        fprintf(stderr, "%zu numbers differ from strtof\n", totalMismatches);
+        return 1;
+    }
+
+    // Speed, in millions of numbers per second
+    printf("\n%-14s %12s %12s %12s %9s\n", "set", "parseFloat", "strtof", "istream", "speedup");
+    for (size_t i = 0; i < 4; ++i) {
+        const NumberSet& set = sets[i];
+        double millions = set.count / 1e6;
+
+        double fast = bestOf(timeParseFloat, set, 5);
+        double exact = bestOf(timeStrtof, set, 5);
+        double stream = bestOf(timeStream, set, 3);
+
+        printf("%-14s %8.1f M/s %8.1f M/s %8.1f M/s %8.1fx\n", set.name, millions / fast,
+               millions / exact, millions / stream, exact / fast);
+    }
+
+    return sink == 12345.0f ? 2 : 0;
+}
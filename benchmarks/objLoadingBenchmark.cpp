@@ -0,0 +1,221 @@
+/*
+ * objLoadingBenchmark.cpp
+ *
+ * Measures how fast .obj files are parsed. A deterministic .obj file is
+ * generated (see generateObj, with "v/vt/vn" faces) and then read with
+ * the old getline/istringstream loop and with the obj::readObjFile engine,
+ * serially and then split across 1, 4, 16 and 32 threads. At the end the
+ * peak resident memory of a single load is reported for each parser, each
+ * one measured on its own child process.
+ *
+ * Usage: objBenchmark [faces] [output file]
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+// C libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// C++ libraries
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmarkHelper.h"
+#include "objReader.h"
+
+using namespace std;
+
+/*
+ * The loop the readObj* functions used before obj::readObjFile, kept here
+ * as the baseline.
+ */
+void legacyParse (const char* filename, obj::ObjData& data) {
+    std::ifstream ifs(filename, std::ifstream::in);
+    std::string line, firstWord, aux, aux2;
+    float values[3];
+
+    while(std::getline(ifs, line)) {
+        if(!line.empty()) {
+            std::istringstream ss(line);
+            ss >> firstWord;
+
+            if (!firstWord.compare("v")) {
+                ss >> values[0] >> values[1] >> values[2];
+                data.vertices.insert(data.vertices.end(), values, values + 3);
+            } else if (!firstWord.compare("vt")) {
+                ss >> values[0] >> values[1];
+                data.uvtextures.insert(data.uvtextures.end(), values, values + 2);
+            } else if (!firstWord.compare("vn")) {
+                ss >> values[0] >> values[1] >> values[2];
+                data.normals.insert(data.normals.end(), values, values + 3);
+            } else if (!firstWord.compare("f")) {
+                while(ss >> aux) {
+                    std::istringstream ss2(aux);
+                    while(std::getline(ss2, aux2, '/')) {
+                        data.elements.push_back( atoi(aux2.c_str()) - 1);
+                    }
+                }
+            }
+        }
+        firstWord.clear();
+    }
+}
+
+/*
+ * Runs the parser a few times and returns the best time, in seconds.
+ */
+template <typename Parser>
+double timeParser (Parser parser, const char* filename, int runs, obj::ObjData& data) {
+    double best = 1e30;
+
+    for (int i = 0; i < runs; ++i) {
+        data.clear();
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        parser(filename, data);
+        std::chrono::high_resolution_clock::time_point stop = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+bool newParse (const char* filename, obj::ObjData& data) {
+    return obj::readObjFile(filename, data);
+}
+
+// number of threads used by threadedParse
+int parseThreads = 1;
+
+bool threadedParse (const char* filename, obj::ObjData& data) {
+    return obj::readObjFile(filename, data, parseThreads);
+}
+
+/*
+ * Runs the parser once on a child process and returns how much its
+ * resident memory grew at its peak, in MB, or -1 if it could not be
+ * measured. A new process starts its peak from the memory it has, so
+ * nothing this one did before counts. The mapped file counts too, its
+ * pages are resident while they are read.
+ */
+template <typename Parser>
+double measurePeak (Parser parser, const char* filename) {
+    double peak = -1.0;
+#ifndef _WIN32
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return peak;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        obj::ObjData data;
+        double before = peakMemoryMB();
+        parser(filename, data);
+        peak = peakMemoryMB() - before;
+        _exit(write(fds[1], &peak, sizeof(peak)) == sizeof(peak) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (pid < 0 || read(fds[0], &peak, sizeof(peak)) != sizeof(peak)) {
+        peak = -1.0;
+    }
+    close(fds[0]);
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+#endif
+    return peak;
+}
+
+bool sameData (const obj::ObjData& a, const obj::ObjData& b) {
+    return a.vertices == b.vertices && a.uvtextures == b.uvtextures &&
+           a.normals == b.normals && a.elements == b.elements;
+}
+
+int main ( int argc, char **argv ) {
+    size_t faces = (argc > 1) ? strtoull(argv[1], NULL, 10) : 500000;
+    const char* filename = (argc > 2) ? argv[2] : "objBenchmark.obj";
+
+    size_t bytes = generateObj(filename, faces, PATTERN_VTN);
+    if (bytes == 0) {
+        fprintf(stderr, "could not write %s\n", filename);
+        return 1;
+    }
+
+    double megabytes = bytes / (1024.0 * 1024.0);
+    printf("file: %s, %.1f MB, %zu faces\n", filename, megabytes, faces);
+
+    // Peak memory of one load, measured before this process parses
+    // anything so the children do not reuse memory freed by other runs
+    int threadCounts[] = { 1, 4, 16, 32 };
+    double legacyPeak = measurePeak(legacyParse, filename);
+    double newPeak = measurePeak(newParse, filename);
+    double threadedPeaks[4];
+    for (int i = 0; i < 4; ++i) {
+        parseThreads = threadCounts[i];
+        threadedPeaks[i] = measurePeak(threadedParse, filename);
+    }
+
+    obj::ObjData legacyData, newData;
+    double legacyTime = timeParser(legacyParse, filename, 3, legacyData);
+    double newTime = timeParser(newParse, filename, 3, newData);
+
+    printf("getline/istringstream: %8.3f s  %8.1f MB/s\n", legacyTime, megabytes / legacyTime);
+    printf("obj::readObjFile:      %8.3f s  %8.1f MB/s\n", newTime, megabytes / newTime);
+    printf("speedup:               %8.1fx\n", legacyTime / newTime);
+
+    // both parsers have to agree on what is in the file
+    if (!sameData(legacyData, newData)) {
+        fprintf(stderr, "parsers disagree on the contents of %s\n", filename);
+        return 1;
+    }
+
+    // Scaling with the number of threads, the merged result has to be the
+    // same as the serial one
+    printf("\nthreads (%u cores on this machine):\n", std::thread::hardware_concurrency());
+    for (int i = 0; i < 4; ++i) {
+        obj::ObjData threadedData;
+        parseThreads = threadCounts[i];
+        double threadedTime = timeParser(threadedParse, filename, 3, threadedData);
+
+        printf("%2d: %8.3f s  %8.1f MB/s  %5.2fx%s\n", parseThreads, threadedTime,
+               megabytes / threadedTime, newTime / threadedTime,
+               sameData(newData, threadedData) ? "" : "  MISMATCH");
+    }
+
+    double finalSize = (newData.vertices.size() + newData.uvtextures.size() +
+                        newData.normals.size()) * sizeof(float) +
+                        newData.elements.size() * sizeof(int);
+
+    printf("\npeak resident memory of one load (the result is %.1f MB, the file %.1f MB):\n",
+           finalSize / (1024.0 * 1024.0), megabytes);
+    if (legacyPeak < 0.0) {
+        printf("could not be measured on this system\n");
+    } else {
+        printf("getline/istringstream: %8.1f MB\n", legacyPeak);
+        printf("obj::readObjFile:      %8.1f MB\n", newPeak);
+        for (int i = 0; i < 4; ++i) {
+            printf("%2d threads:            %8.1f MB\n", threadCounts[i], threadedPeaks[i]);
+        }
+    }
+
+    remove(filename);
+    return 0;
+}
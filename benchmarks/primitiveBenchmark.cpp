@@ -0,0 +1,153 @@
+/*
+ * primitiveBenchmark.cpp
+ *
+ * Measures how long the cube, cylinder and sphere of primitives.h take to
+ * make at large subdivisions, on one thread and on more, and checks that
+ * every thread count gives exactly the same vertices, normals and
+ * elements as one thread.
+ *
+ * Usage: primitiveBenchmark [threads] [threads] ...
+ *        The thread counts compared with one thread (the default is 2, 4
+ *        and every core).
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+// C libraries
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ libraries
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "primitives.h"
+
+using namespace std;
+
+// Every primitive is made this many times, the best time counts
+static const int RUNS = 3;
+
+/*
+ * A primitive and its parameters.
+ */
+struct PrimitiveCase {
+    const char* name;
+
+    // 0 cube, 1 cylinder, 2 sphere
+    int type;
+    int subDiv;
+    int subDivHeight;
+    int normalType;
+};
+
+static const PrimitiveCase cases[] = {
+    { "cube 1024",                0, 1024, 0,   FLAT   },
+    { "cylinder 4096x512 smooth", 1, 4096, 512, SMOOTH },
+    { "cylinder 4096x512 flat",   1, 4096, 512, FLAT   },
+    { "sphere 7 smooth",          2, 7,    0,   SMOOTH },
+    { "sphere 8 smooth",          2, 8,    0,   SMOOTH },
+    { "sphere 9 smooth",          2, 9,    0,   SMOOTH },
+    { "sphere 8 flat",            2, 8,    0,   FLAT   }
+};
+static const int NUM_CASES = sizeof(cases) / sizeof(cases[0]);
+
+/*
+ * The arrays a primitive was made into.
+ */
+struct PrimitiveArrays {
+    vector<float> vertices;
+    vector<float> normals;
+    vector<GLuint> elements;
+};
+
+// Makes the primitive with numThreads threads, returns the best time in seconds
+static double makePrimitive (const PrimitiveCase& c, int numThreads, PrimitiveArrays& arrays) {
+    size_t numVertices, numElements;
+    if (c.type == 0) {
+        getCubeSize(c.subDiv, numVertices, numElements);
+    } else if (c.type == 1) {
+        getCylinderSize(c.subDiv, c.subDivHeight, c.normalType, numVertices, numElements);
+    } else {
+        getSphereSize(c.subDiv, c.normalType, numVertices, numElements);
+    }
+
+    arrays.vertices.assign(numVertices * 3, 0.0f);
+    arrays.normals.assign(numVertices * 3, 0.0f);
+    arrays.elements.assign(numElements, 0);
+
+    PrimitiveTarget target;
+    target.vertices = &arrays.vertices[0];
+    target.normals = &arrays.normals[0];
+    target.elements = &arrays.elements[0];
+    target.firstVertex = 0;
+
+    double best = 0.0;
+    for (int run = 0; run < RUNS; ++run) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (c.type == 0) {
+            makeCubeGeometry(c.subDiv, target, numThreads);
+        } else if (c.type == 1) {
+            makeCylinderGeometry(c.subDiv, c.subDivHeight, c.normalType, target, numThreads);
+        } else {
+            makeSphereGeometry(c.subDiv, c.normalType, target, numThreads);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int main ( int argc, char **argv ) {
+    vector<int> threads;
+    for (int i = 1; i < argc; ++i) {
+        int numThreads = atoi(argv[i]);
+        if (numThreads < 1) {
+            fprintf(stderr, "%s is not a thread count\n", argv[i]);
+            return 1;
+        }
+        threads.push_back(numThreads);
+    }
+
+    unsigned int cores = thread::hardware_concurrency();
+    if (threads.empty()) {
+        threads.push_back(2);
+        threads.push_back(4);
+        if (cores > 4) {
+            threads.push_back((int) cores);
+        }
+    }
+
+    printf("%u cores on this machine\n\n", cores);
+    printf("%-26s %10s %9s %8s %9s %8s %7s\n", "primitive", "triangles", "vertices", "threads",
+           "ms", "Mtri/s", "same");
+
+    bool allSame = true;
+    for (int i = 0; i < NUM_CASES; ++i) {
+        const PrimitiveCase& c = cases[i];
+
+        PrimitiveArrays serial;
+        double serialSeconds = makePrimitive(c, 1, serial);
+        size_t numTriangles = serial.elements.size() / 3;
+        printf("%-26s %10zu %9zu %8d %9.1f %8.1f %7s\n", c.name, numTriangles,
+               serial.vertices.size() / 3, 1, serialSeconds * 1e3,
+               numTriangles / serialSeconds * 1e-6, "-");
+
+        for (size_t t = 0; t < threads.size(); ++t) {
+            PrimitiveArrays parallel;
+            double seconds = makePrimitive(c, threads[t], parallel);
+            bool same = parallel.vertices == serial.vertices && parallel.normals == serial.normals &&
+                        parallel.elements == serial.elements;
+            allSame = allSame && same;
+
+            printf("%-26s %10s %9s %8d %9.1f %8.1f %7s\n", "", "", "", threads[t], seconds * 1e3,
+                   numTriangles / seconds * 1e-6, same ? "yes" : "NO");
+        }
+    }
+
+    return allSame ? 0 : 1;
+}
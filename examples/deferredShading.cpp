@@ -30,9 +30,6 @@ void renderGBufferToQuad(const GLuint &targetProgram);
 
 using namespace std;
 
-// How to calculate an offset into the vertex buffer
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
-
 // PROGRAM ID
 GLuint programGeometryPass;
 GLuint programLightPass;
@@ -42,8 +39,8 @@ GLuint programScreen; // debugging
 Shape shape;
 
 // BUFFERS
-GLuint vbuffer;
-GLuint ebuffer;
+ShapeBuffers shapeBuffers;
+ShapeBuffers screenQuadBuffers;
 
 GLuint vaoShape;
 GLuint vaoScreenQuad;
@@ -52,10 +49,7 @@ GLuint vaoScreenQuad;
 GLuint gBuffer;
 GLuint gPosition, gNormal, gColorAlb, gColorSpec;
 
-GLuint screenQuadElementByteOffset; // used on the draw
-
 // Total number of elements that will be draw
-int shapeNumElements;
 int screenQuadNumElements;
 
 // Our Camera
@@ -72,6 +66,12 @@ float lightUp[] = { 0.0f, 1.0f, 0.0f };
 // Shape positions
 vector<vector<float>> shapePositions;
 
+// The meshlets of the shape left after culling, and what glMultiDrawElements
+// needs to draw them
+vector<DrawElementsIndirectCommand> shapeDraws;
+vector<GLsizei> shapeDrawCounts;
+vector<GLvoid*> shapeDrawOffsets;
+
 // x, y and z vectors for rotation
 float xVec[] = {1,0,0};
 float yVec[] = {0,1,0};
@@ -107,22 +107,16 @@ void init () {
                            "objects/Final_Pokemon_Diffuse.png",
                            "objects/Final_Pokemon_Specular.png" );
 
-    int vShapeDataSize = shape.getNumVertices()*3*sizeof(GLfloat);
-    int nShapeDataSize = shape.getNumNormals()*3*sizeof(GLfloat);
-    int uvShapeDataSize = shape.getNumUV()*2*sizeof(GLfloat);
-    int eShapeDataSize = shape.getNumElements()*sizeof(GLshort);
-
-    int totalShapeDataSize = vShapeDataSize + nShapeDataSize + uvShapeDataSize;
+    // the gBuffer pass writes four targets per fragment, so the triangles
+    // in front are drawn first and hide more of the ones behind them
+    shape.optimizeOverdraw();
+    shape.optimizeVertexFetch();
 
-    // Screen Quad
-    int vScreenQuadDataSize = 4*2*sizeof(GLfloat);
-    int uvScreenQuadDataSize = 4*2*sizeof(GLfloat);
-    int eScreenQuadDataSize = 6*sizeof(GLshort);
-
-    int totalScreenQuadDataSize = vScreenQuadDataSize + uvScreenQuadDataSize;
+    // the meshlets out of the view or facing away are not drawn
+    shape.buildMeshlets();
 
     // Load shaders
-    programGeometryPass = shader::makeShaderProgram( "shaders/gBufferGeometryVert.glsl",
+    programGeometryPass = shader::makeShaderProgram( "shaders/gBufferGeometryPackedVert.glsl",
                                                      "shaders/gBufferGeometryFrag.glsl" );
     programLightPass = shader::makeShaderProgram( "shaders/deferredShadingVert.glsl",
                                                   "shaders/deferredShadingFrag.glsl" );
@@ -130,85 +124,25 @@ void init () {
                                                "shaders/quadScreenFrag.glsl" );
 
     //
-    // VERTEX ARRAY BUFFER
+    // VERTEX AND ELEMENT BUFFERS
     //
 
-    // Create Vertex Array Buffer
-    glGenBuffers(1, &vbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // Create space for the data, load the data
-    // Data looks like
-    //    shape 1              shape 2 (quad)
-    // (VVVV) (NNNN) (UVUV) | (VVVV) (UVUV) | ...
-    glBufferData( GL_ARRAY_BUFFER, totalShapeDataSize +
-                                   totalScreenQuadDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, vShapeDataSize, shape.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize, nShapeDataSize, shape.getNormals() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize + nShapeDataSize, uvShapeDataSize, shape.getUV() );
-    glBufferSubData( GL_ARRAY_BUFFER, totalShapeDataSize, vScreenQuadDataSize, quadVertices );
-    glBufferSubData( GL_ARRAY_BUFFER, totalShapeDataSize + vScreenQuadDataSize, uvScreenQuadDataSize, quadTextures );
+    // One vertex and one element buffer per shape, the vertices are
+    // interleaved: (V N UV) (V N UV) ... The shape is packed, 16 bytes a
+    // vertex instead of 32, and the geometry pass decodes it
+    shapeBuffers = uploadShape( shape, VERTEX_POSITION | VERTEX_NORMAL | VERTEX_UV | VERTEX_PACKED );
+    screenQuadBuffers = uploadScreenQuad();
 
-    //
-    // ELEMENT ARRAY BUFFER
-    //
-
-    // Create the element buffer
-    glGenBuffers( 1, &ebuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Create space for the data, load the data
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, eShapeDataSize +
-                                           eScreenQuadDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, eShapeDataSize, shape.getElements() );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, eShapeDataSize, eScreenQuadDataSize, quadElements );
-
-    shapeNumElements = shape.getNumElements();
-
-    screenQuadNumElements = 6;
-    screenQuadElementByteOffset = eShapeDataSize ; // screen quad starts after shape
+    screenQuadNumElements = screenQuadBuffers.numElements;
 
     //
     // VERTEX ARRAY OBJECTS
     //
 
-    glGenVertexArrays(1, &vaoShape);
-    glGenVertexArrays(1, &vaoScreenQuad);
-
-    //
-    // Shape
-    glBindVertexArray(vaoShape);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // vertex position
-    glEnableVertexAttribArray( 0 );
-    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-    // normals
-    glEnableVertexAttribArray( 1 );
-    glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize) );
-
-    // texture coords
-    glEnableVertexAttribArray( 2 );
-    glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize + nShapeDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    //
-    // Screen Quad
-    glBindVertexArray(vaoScreenQuad);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // vertex position
-    glEnableVertexAttribArray( 0 );
-    glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalShapeDataSize) );
-
-    // texture coords
-    glEnableVertexAttribArray( 1 );
-    glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalShapeDataSize + vScreenQuadDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
+    // the passes that draw each of them read the attributes from the
+    // same locations
+    vaoShape = makeVertexArray( shapeBuffers, programGeometryPass );
+    vaoScreenQuad = makeVertexArray( screenQuadBuffers, programScreen );
 
     //
     // Set up shapes positions
@@ -325,6 +259,7 @@ void display () {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glUseProgram( programGeometryPass );
+    setPackedVertexUniforms( programGeometryPass, shapeBuffers.layout );
 
     //glCullFace(GL_FRONT);
     renderScene( programGeometryPass );
@@ -368,7 +303,7 @@ void display () {
     GLuint textureID = glGetUniformLocation(programScreen, "screenTexture");
     glUniform1i(textureID, 0);
 
-    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)screenQuadElementByteOffset);
+    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)0);
 */
     // swap the buffers
     glutSwapBuffers();
@@ -416,8 +351,18 @@ void renderScene ( const GLuint &targetProgram ) {
         mTransform = translate(pos[0],pos[1],pos[2]) * rotate(0, zVec) * rotate(180.0f, yVec) * rotate(0, xVec);
         glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
-        // Drawing elements
-        glDrawElements( GL_TRIANGLES, shapeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+        // Drawing the meshlets this copy shows
+        shape.cullMeshlets( mViewMatrix * mTransform, mProjMatrix, shapeDraws );
+        shapeDrawCounts.clear();
+        shapeDrawOffsets.clear();
+        for (size_t d = 0; d < shapeDraws.size(); ++d) {
+            shapeDrawCounts.push_back( shapeDraws[d].count );
+            shapeDrawOffsets.push_back( shape.getElementOffset( shapeDraws[d].firstIndex ) );
+        }
+        if (!shapeDraws.empty()) {
+            glMultiDrawElements( GL_TRIANGLES, &shapeDrawCounts[0], shape.getElementType(),
+                                 (const GLvoid* const*) &shapeDrawOffsets[0], shapeDraws.size() );
+        }
     }
 
 }
@@ -463,7 +408,7 @@ void renderGBufferToQuad (const GLuint &targetProgram) {
 
     glBindVertexArray(vaoScreenQuad);
 
-    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)screenQuadElementByteOffset);
+    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)0);
 }
 
 // to use the keyboard
@@ -23,9 +23,6 @@
 
 using namespace std;
 
-// How to calculate an offset into the vertex buffer
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
-
 // PROGRAM ID
 GLuint program;
 
@@ -35,8 +32,7 @@ Shape shape;
 // BUFFERS
 bool bufferInit = false;
 
-GLuint vbuffer;
-GLuint ebuffer;
+ShapeBuffers shapeBuffers;
 
 GLuint vaoShape;
 
@@ -80,10 +76,6 @@ void createShapes(int normalType, int shaders, int materials) {
                            0.89f, 0.0f, 0.0f, 0.7f,
                            1.0f, 1.0f, 1.0f, 1.0f, 10.0f);
 
-    int vShapeDataSize = shape.getNumVertices()*3*sizeof(GLfloat);
-    int nShapeDataSize = shape.getNumNormals()*3*sizeof(GLfloat);
-    int eShapeDataSize = shape.getNumElements()*sizeof(GLshort);
-
     // Load shaders
     if (shaders == 0)
         program = shader::makeShaderProgram( "shaders/flatLightingVert.glsl",
@@ -93,38 +85,16 @@ void createShapes(int normalType, int shaders, int materials) {
                                              "shaders/phongLightingFrag.glsl" );
 
     //
-    // VERTEX ARRAY BUFFER
+    // VERTEX AND ELEMENT BUFFERS
     //
 
     if( bufferInit ) {
-        glDeleteBuffers( 1, &vbuffer );
-        glDeleteBuffers( 1, &ebuffer );
+        deleteShapeBuffers( shapeBuffers );
         glDeleteVertexArrays( 1, &vaoShape );
     }
 
-    // Create Vertex Array Buffer
-    glGenBuffers(1, &vbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // Create space for the data, load the data
-    // This example, just vertex data
-    glBufferData( GL_ARRAY_BUFFER, vShapeDataSize+nShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, vShapeDataSize, shape.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize, nShapeDataSize, shape.getNormals() );
-
-    //
-    // ELEMENT ARRAY BUFFER
-    //
-
-    // Create the element buffer
-    glGenBuffers( 1, &ebuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Create space for the data, load the data
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, eShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, eShapeDataSize, shape.getElements() );
-
-    shapeNumElements = shape.getNumElements();
+    shapeBuffers = uploadShape( shape, VERTEX_POSITION | VERTEX_NORMAL );
+    shapeNumElements = shapeBuffers.numElements;
 
     //
     // SETTING UP THE SHADER
@@ -137,25 +107,7 @@ void createShapes(int normalType, int shaders, int materials) {
     // VERTEX ARRAY OBJECTS
     //
 
-    // Setting up vertex array object
-    GLuint vPosition;
-    GLuint vNormal;
-
-    glGenVertexArrays(1, &vaoShape);
-
-    // Shape
-    glBindVertexArray(vaoShape);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    vPosition = glGetAttribLocation( program , "vPosition" );
-    glEnableVertexAttribArray( vPosition );
-    glVertexAttribPointer( vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-    vNormal = glGetAttribLocation( program, "vNormal" );
-    glEnableVertexAttribArray( vNormal );
-    glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    vaoShape = makeVertexArray( shapeBuffers, program );
 
     // Buffers were created, need to destroy if we use them again
     bufferInit = true;
@@ -208,7 +160,7 @@ void display () {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, shapeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, shapeNumElements, shape.getElementType(), (void*)0);
 
 
     // swap the buffers
@@ -20,23 +20,25 @@
 #include "shape.h"
 #include "camera.h"
 #include "lighting.h"
+#include "asyncLoader.h"
 
 using namespace std;
 
-// How to calculate an offset into the vertex buffer
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
-
 // PROGRAM ID
 GLuint program;
 
 // Shapes we will use
 Shape shape;
 
+// Loads the shape in the background while we already render, and the
+// handle that tells us when it is ready
+AsyncLoader loader;
+LoadHandle shapeLoad;
+
 // BUFFERS
 bool bufferInit = false;
 
-GLuint vbuffer;
-GLuint ebuffer;
+ShapeBuffers shapeBuffers;
 
 GLuint vaoShape;
 
@@ -59,56 +61,27 @@ float xtheta = 60.0f;
 float ytheta = 30.0f;
 float ztheta = 30.0f;
 
-void createShape() {
+void loadShape() {
     //
     // SHAPE
     //
     shape.clearShape();
-    shape.readObjLightMap( "objects/BrickWall.obj" , "objects/Brick_RedNormal_1k_d.png", "objects/Brick_RedNormal_1k_g.png" );
-    shape.readNormalMap ( "objects/Brick_RedNormal_1k_n.png" );
-
-    int vShapeDataSize = shape.getNumVertices()*3*sizeof(GLfloat);
-    int nShapeDataSize = shape.getNumNormals()*3*sizeof(GLfloat);
-    int uvShapeDataSize = shape.getNumUV()*2*sizeof(GLfloat);
-    int tanShapeDataSize = shape.getNumTangents()*3*sizeof(GLfloat);
-    int bitanShapeDataSize = shape.getNumBitangents()*3*sizeof(GLfloat);
-    int eShapeDataSize = shape.getNumElements()*sizeof(GLshort);
+    shapeLoad = loader.readObjLightMap( shape, "objects/BrickWall.obj" , "objects/Brick_RedNormal_1k_d.png",
+                                        "objects/Brick_RedNormal_1k_g.png", "objects/Brick_RedNormal_1k_n.png" );
 
     // Load shaders
     program = shader::makeShaderProgram( "shaders/phongNormalMapVert.glsl",
                                          "shaders/phongNormalMapFrag.glsl" );
+}
 
+// Called once the loader is done with the shape
+void createShape() {
     //
-    // VERTEX ARRAY BUFFER
-    //
-
-    // Create Vertex Array Buffer
-    glGenBuffers(1, &vbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // Create space for the data, load the data
-    // This example, vertex data, normals, texture, tangent and bitangent values
-    // V / N / UV / T / B
-    glBufferData( GL_ARRAY_BUFFER, vShapeDataSize + nShapeDataSize + uvShapeDataSize + tanShapeDataSize + bitanShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, vShapeDataSize, shape.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize, nShapeDataSize, shape.getNormals() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize + nShapeDataSize, uvShapeDataSize, shape.getUV() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize + nShapeDataSize + uvShapeDataSize, tanShapeDataSize, shape.getTangents() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize + nShapeDataSize + uvShapeDataSize + tanShapeDataSize, bitanShapeDataSize, shape.getBitangents() );
-
-    //
-    // ELEMENT ARRAY BUFFER
+    // VERTEX AND ELEMENT BUFFERS
     //
 
-    // Create the element buffer
-    glGenBuffers( 1, &ebuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Create space for the data, load the data
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, eShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, eShapeDataSize, shape.getElements() );
-
-    shapeNumElements = shape.getNumElements();
+    shapeBuffers = uploadShape( shape, VERTEX_POSITION | VERTEX_NORMAL | VERTEX_UV | VERTEX_TANGENT | VERTEX_BITANGENT );
+    shapeNumElements = shapeBuffers.numElements;
 
     //
     // SETTING UP THE SHADER
@@ -121,38 +94,7 @@ void createShape() {
     // VERTEX ARRAY OBJECTS
     //
 
-    // Setting up vertex array object
-    GLuint vPosition;
-    GLuint vNormal;
-    GLuint vTexCoords;
-    GLuint vTangent;
-    GLuint vBitangent;
-
-    glGenVertexArrays(1, &vaoShape);
-
-    // Shape
-    glBindVertexArray(vaoShape);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    vPosition = glGetAttribLocation( program , "vPosition" );
-    glEnableVertexAttribArray( vPosition );
-    glVertexAttribPointer( vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-    vNormal = glGetAttribLocation( program, "vNormal" );
-    glEnableVertexAttribArray( vNormal );
-    glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize) );
-
-    vTexCoords = glGetAttribLocation( program , "vTexCoord" );
-    glEnableVertexAttribArray( vTexCoords );
-    glVertexAttribPointer( vTexCoords , 2 , GL_FLOAT , GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize + nShapeDataSize) );
-
-    vTangent = glGetAttribLocation( program , "vTangent" );
-    glEnableVertexAttribArray( vTangent );
-    glVertexAttribPointer( vTangent , 3 , GL_FLOAT , GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize + nShapeDataSize + uvShapeDataSize) );
-
-    vBitangent = glGetAttribLocation( program , "vBitangent" );
-    glEnableVertexAttribArray( vBitangent );
-    glVertexAttribPointer( vBitangent , 3 , GL_FLOAT , GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize + nShapeDataSize + uvShapeDataSize + tanShapeDataSize) );
+    vaoShape = makeVertexArray( shapeBuffers, program );
 
     // set up textures
     glActiveTexture(GL_TEXTURE0);
@@ -191,12 +133,12 @@ void createShape() {
 
     light.setPhongIllumination(program);
 
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    bufferInit = true;
 }
 
 void init () {
-    // Create the shapes
-    createShape();
+    // Start loading the shapes, they show up once they are ready
+    loadShape();
 
     // Some openGL initialization
     glEnable( GL_DEPTH_TEST );
@@ -206,9 +148,25 @@ void init () {
 }
 
 void display () {
+    // give a bit of the loaded data to OpenGL every frame
+    loader.update();
+    if (!bufferInit && shapeLoad.isReady()) {
+        if (!shapeLoad.succeeded()) {
+            printf( "Error loading the shape\n" );
+            exit( 1 );
+        }
+        createShape();
+    }
+
     // clear
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+    // nothing to draw yet
+    if (!bufferInit) {
+        glutSwapBuffers();
+        return;
+    }
+
     // Set up the transforms
     Matrix mTransform = translate(0,0.5f,-2.0f) * rotate(0, zVec) * rotate(0, yVec) * rotate(90.0f, xVec);
     GLuint mTransformID = glGetUniformLocation(program, "mTransform");
@@ -230,7 +188,7 @@ void display () {
     glBindVertexArray(vaoShape);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, shapeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, shapeNumElements, shape.getElementType(), (void*)0);
 
     // swap the buffers
     glutSwapBuffers();
@@ -23,9 +23,6 @@
 
 using namespace std;
 
-// How to calculate an offset into the vertex buffer
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
-
 // PROGRAM ID
 GLuint program;
 
@@ -35,8 +32,7 @@ Shape shape;
 // BUFFERS
 bool bufferInit = false;
 
-GLuint vbuffer;
-GLuint ebuffer;
+ShapeBuffers shapeBuffers;
 
 GLuint vaoShape;
 
@@ -64,43 +60,18 @@ void createShape() {
     // SHAPE
     //
     shape.clearShape();
-    shape.readObjVertTexNorm( "objects/cube.obj" , "objects/cubebmponline.bmp" );
-
-    int vShapeDataSize = shape.getNumVertices()*3*sizeof(GLfloat);
-    int uvShapeDataSize = shape.getNumUV()*2*sizeof(GLfloat);
-    int eShapeDataSize = shape.getNumElements()*sizeof(GLshort);
+    shape.readObjVertTexNorm( "objects/cube.zip/cube.obj" , "objects/cube.zip/cube.png" );
 
     // Load shaders
     program = shader::makeShaderProgram( "shaders/simpleTextureVert.glsl",
                                          "shaders/simpleTextureFrag.glsl" );
 
     //
-    // VERTEX ARRAY BUFFER
+    // VERTEX AND ELEMENT BUFFERS
     //
 
-    // Create Vertex Array Buffer
-    glGenBuffers(1, &vbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // Create space for the data, load the data
-    // This example, vertex data and texture coordinates
-    glBufferData( GL_ARRAY_BUFFER, vShapeDataSize + uvShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, vShapeDataSize, shape.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, vShapeDataSize, uvShapeDataSize, shape.getUV() );
-
-    //
-    // ELEMENT ARRAY BUFFER
-    //
-
-    // Create the element buffer
-    glGenBuffers( 1, &ebuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Create space for the data, load the data
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, eShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, eShapeDataSize, shape.getElements() );
-
-    shapeNumElements = shape.getNumElements();
+    shapeBuffers = uploadShape( shape, VERTEX_POSITION | VERTEX_UV );
+    shapeNumElements = shapeBuffers.numElements;
 
     //
     // SETTING UP THE SHADER
@@ -113,28 +84,10 @@ void createShape() {
     // VERTEX ARRAY OBJECTS
     //
 
-    // Setting up vertex array object
-    GLuint vPosition;
-    GLuint vTexCoords;
-
-    glGenVertexArrays(1, &vaoShape);
-
-    // Shape
-    glBindVertexArray(vaoShape);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    vPosition = glGetAttribLocation( program , "vPosition" );
-    glEnableVertexAttribArray( vPosition );
-    glVertexAttribPointer( vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-    vTexCoords = glGetAttribLocation( program , "vTexCoord" );
-    glEnableVertexAttribArray( vTexCoords );
-    glVertexAttribPointer( vTexCoords , 2 , GL_FLOAT , GL_FALSE, 0, BUFFER_OFFSET(vShapeDataSize) );
+    vaoShape = makeVertexArray( shapeBuffers, program );
 
     // set up textures
     //shape.setUpTexture( program, "textureSampler" );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
 }
 
 void init () {
@@ -174,7 +127,7 @@ void display () {
     glBindVertexArray(vaoShape);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, shapeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, shapeNumElements, shape.getElementType(), (void*)0);
 
     // swap the buffers
     glutSwapBuffers();
@@ -18,9 +18,6 @@
 
 using namespace std;
 
-// How to calculate an offset into the vertex buffer
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
-
 // PROGRAM ID
 GLuint program;
 
@@ -30,8 +27,7 @@ Shape shape;
 // BUFFERS
 bool bufferInit = false;
 
-GLuint vbuffer;
-GLuint ebuffer;
+ShapeBuffers shapeBuffers;
 
 GLuint vaoShape;
 
@@ -59,41 +55,18 @@ void createShape() {
     // SHAPE 
     //
     shape.clearShape();
-    shape.readObjVert( "objects/teapot.obj" ); 
-
-    int vShapeDataSize = shape.getNumVertices()*3*sizeof(GLfloat);
-    int eShapeDataSize = shape.getNumElements()*sizeof(GLshort);
+    shape.readObjVert( "objects/teapot.zip/teapot.obj" ); 
 
     // Load shaders
     program = shader::makeShaderProgram( "shaders/simpleVert.glsl", 
                                          "shaders/simpleFrag.glsl" );
 
     //
-    // VERTEX ARRAY BUFFER
-    //
-
-    // Create Vertex Array Buffer
-    glGenBuffers(1, &vbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    // Create space for the data, load the data
-    // This example, just vertex data
-    glBufferData( GL_ARRAY_BUFFER, vShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, vShapeDataSize, shape.getVertices() );
-
-    //
-    // ELEMENT ARRAY BUFFER
+    // VERTEX AND ELEMENT BUFFERS
     //
 
-    // Create the element buffer
-    glGenBuffers( 1, &ebuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Create space for the data, load the data
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, eShapeDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, eShapeDataSize, shape.getElements() );
-
-    shapeNumElements = shape.getNumElements();
+    shapeBuffers = uploadShape( shape, VERTEX_POSITION );
+    shapeNumElements = shapeBuffers.numElements;
 
     //
     // SETTING UP THE SHADER
@@ -106,20 +79,7 @@ void createShape() {
     // VERTEX ARRAY OBJECTS
     //
 
-    // Setting up vertex array object
-    GLuint vPosition;
-
-    glGenVertexArrays(1, &vaoShape);
-
-    // Shape
-    glBindVertexArray(vaoShape);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    vPosition = glGetAttribLocation( program , "vPosition" );
-    glEnableVertexAttribArray( vPosition );
-    glVertexAttribPointer( vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    vaoShape = makeVertexArray( shapeBuffers, program );
 }
 
 void init () {
@@ -160,7 +120,7 @@ void display () {
     glBindVertexArray(vaoShape);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, shapeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, shapeNumElements, shape.getElementType(), (void*)0);
 
     // swap the buffers
     glutSwapBuffers();
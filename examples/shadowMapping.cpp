@@ -29,9 +29,6 @@ void renderScene(const GLuint &targetProgram);
 
 using namespace std;
 
-// How to calculate an offset into the vertex buffer
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
-
 // PROGRAM ID
 GLuint programShadowMap;
 GLuint programScreen;
@@ -43,8 +40,10 @@ Shape sphere;
 Shape cylinder;
 
 // BUFFERS
-GLuint vbuffer;
-GLuint ebuffer;
+ShapeBuffers cubeBuffers;
+ShapeBuffers sphereBuffers;
+ShapeBuffers cylinderBuffers;
+ShapeBuffers screenQuadBuffers;
 
 GLuint vaoCube;
 GLuint vaoSphere;
@@ -55,10 +54,6 @@ GLuint depthMapFBO;
 
 GLuint texDepthBuffer; // screen quad buffer
 
-GLuint sphereElementByteOffset; // used on the draw
-GLuint cylinderElementByteOffset; // used on the draw
-GLuint screenQuadElementByteOffset; // used on the draw
-
 // Total number of elements that will be draw
 int cubeNumElements;
 int sphereNumElements;
@@ -104,43 +99,18 @@ void init () {
                       0.89f, 0.0f, 0.0f, 0.7f,
                       1.0f, 1.0f, 1.0f, 1.0f, 10.0f);
 
-    int vCubeDataSize = cube.getNumVertices()*3*sizeof(GLfloat);
-    int nCubeDataSize = cube.getNumNormals()*3*sizeof(GLfloat);
-    int eCubeDataSize = cube.getNumElements()*sizeof(GLshort);
-
-    int totalCubeDataSize = vCubeDataSize + nCubeDataSize;
-
     // Second: sphere
     sphere.makeSphere(3, SMOOTH);
     sphere.setMaterials(0.1f, 0.5f, 0.9f, 0.5f,
                         0.0f, 0.0f, 0.5f, 0.9f,
                         1.0f, 1.0f, 1.0f, 1.0f, 10.0f);
 
-    int vSphereDataSize = sphere.getNumVertices()*3*sizeof(GLfloat);
-    int nSphereDataSize = sphere.getNumNormals()*3*sizeof(GLfloat);
-    int eSphereDataSize = sphere.getNumElements()*sizeof(GLshort);
-
-    int totalSphereDataSize = vSphereDataSize + nSphereDataSize;
-
     // Third: Cylinder
     cylinder.makeCylinder(16,5, SMOOTH);
     cylinder.setMaterials(0.5f, 0.9f, 0.2f, 0.5f,
                           0.0f, 1.0f, 0.5f, 0.6f,
                           1.0f, 1.0f, 1.0f, 1.0f, 10.0f);
 
-    int vCylinderDataSize = cylinder.getNumVertices()*3*sizeof(GLfloat);
-    int nCylinderDataSize = cylinder.getNumNormals()*3*sizeof(GLfloat);
-    int eCylinderDataSize = cylinder.getNumElements()*sizeof(GLshort);
-
-    int totalCylinderDataSize = vCylinderDataSize + nCylinderDataSize;
-
-    // Screen Quad
-    int vScreenQuadDataSize = 4*2*sizeof(GLfloat);
-    int uvScreenQuadDataSize = 4*2*sizeof(GLfloat);
-    int eScreenQuadDataSize = 6*sizeof(GLshort);
-
-    int totalScreenQuadDataSize = vScreenQuadDataSize + uvScreenQuadDataSize + eScreenQuadDataSize;
-
     // Load shaders
     programShadowMap = shader::makeShaderProgram( "shaders/phongLightingShadowVert.glsl",
                                                   "shaders/phongLightingShadowFrag.glsl" );
@@ -150,132 +120,31 @@ void init () {
                                                  "shaders/shadowMappingDepthFrag.glsl" );
 
     //
-    // VERTEX ARRAY BUFFER
+    // VERTEX AND ELEMENT BUFFERS
     //
 
-    // Create Vertex Array Buffer
-    glGenBuffers(1, &vbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
+    // One vertex and one element buffer per shape, the vertices are
+    // interleaved: (V N) (V N) ...
+    cubeBuffers = uploadShape( cube, VERTEX_POSITION | VERTEX_NORMAL );
+    sphereBuffers = uploadShape( sphere, VERTEX_POSITION | VERTEX_NORMAL );
+    cylinderBuffers = uploadShape( cylinder, VERTEX_POSITION | VERTEX_NORMAL );
+    screenQuadBuffers = uploadScreenQuad();
 
-    // Create space for the data, load the data
-    // Data looks like
-    //    shape 1        shape 2
-    // (VVVV) (NNNN) | (VVVV) (NNNN) | ...
-    glBufferData( GL_ARRAY_BUFFER, totalCubeDataSize +
-                                   totalSphereDataSize +
-                                   totalCylinderDataSize +
-                                   totalScreenQuadDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, vCubeDataSize, cube.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, vCubeDataSize, nCubeDataSize, cube.getNormals() );
-    glBufferSubData( GL_ARRAY_BUFFER, totalCubeDataSize, vSphereDataSize, sphere.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, totalCubeDataSize + vSphereDataSize, nSphereDataSize, sphere.getNormals() );
-    glBufferSubData( GL_ARRAY_BUFFER, totalCubeDataSize + totalSphereDataSize, vCylinderDataSize, cylinder.getVertices() );
-    glBufferSubData( GL_ARRAY_BUFFER, totalCubeDataSize + totalSphereDataSize + vCylinderDataSize, nCylinderDataSize, cylinder.getNormals() );
-    glBufferSubData( GL_ARRAY_BUFFER, totalCubeDataSize + totalSphereDataSize + totalCylinderDataSize, vScreenQuadDataSize, quadVertices );
-    glBufferSubData( GL_ARRAY_BUFFER, totalCubeDataSize + totalSphereDataSize + totalCylinderDataSize + vScreenQuadDataSize, uvScreenQuadDataSize, quadTextures );
-
-    //
-    // ELEMENT ARRAY BUFFER
-    //
-
-    // Create the element buffer
-    glGenBuffers( 1, &ebuffer );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Create space for the data, load the data
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, eCubeDataSize +
-                                           eSphereDataSize +
-                                           eCylinderDataSize +
-                                           eScreenQuadDataSize, NULL, GL_STATIC_DRAW );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, eCubeDataSize, cube.getElements() );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, eCubeDataSize, eSphereDataSize, sphere.getElements() );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, eCubeDataSize + eSphereDataSize, eCylinderDataSize, cylinder.getElements() );
-    glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, eCubeDataSize + eSphereDataSize + eCylinderDataSize, eScreenQuadDataSize, quadElements );
-
-    cubeNumElements = cube.getNumElements();
-
-    sphereNumElements = sphere.getNumElements();
-    sphereElementByteOffset = eCubeDataSize; // sphere starts after cube
-
-    cylinderNumElements = cylinder.getNumElements();
-    cylinderElementByteOffset = eCubeDataSize + eSphereDataSize; // cylinder starts after cube and sphere
-
-    screenQuadNumElements = 6;
-    screenQuadElementByteOffset = eCubeDataSize + eSphereDataSize + eCylinderDataSize; // screen quade after cube, sphere, cylinder
+    cubeNumElements = cubeBuffers.numElements;
+    sphereNumElements = sphereBuffers.numElements;
+    cylinderNumElements = cylinderBuffers.numElements;
+    screenQuadNumElements = screenQuadBuffers.numElements;
 
     //
     // VERTEX ARRAY OBJECTS
     //
 
-    // Setting up vertex array object
-    GLuint vPosition;
-    GLuint vNormal;
-    GLuint vTexCoord;
-
-    glGenVertexArrays(1, &vaoCube);
-    glGenVertexArrays(1, &vaoSphere);
-    glGenVertexArrays(1, &vaoCylinder);
-    glGenVertexArrays(1, &vaoScreenQuad);
-
-    // Cube
-    glBindVertexArray(vaoCube);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    //vPosition = glGetAttribLocation( programDepthMap , "vPosition" );
-    //glEnableVertexAttribArray( vPosition );
-    glEnableVertexAttribArray( 0 );
-    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0) );
-
-    vNormal = glGetAttribLocation( programShadowMap, "vNormal" );
-    glEnableVertexAttribArray( vNormal );
-    glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(vCubeDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Sphere
-    glBindVertexArray(vaoSphere);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    //vPosition = glGetAttribLocation( programDepthMap , "vPosition" );
-    //glEnableVertexAttribArray( vPosition );
-    glEnableVertexAttribArray( 0 );
-    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalCubeDataSize) );
-
-    vNormal = glGetAttribLocation( programShadowMap, "vNormal" );
-    glEnableVertexAttribArray( vNormal );
-    glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalCubeDataSize + vSphereDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Cylinder
-    glBindVertexArray(vaoCylinder);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    //vPosition = glGetAttribLocation( programDepthMap , "vPosition" );
-    //glEnableVertexAttribArray( vPosition );
-    glEnableVertexAttribArray( 0 );
-    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalCubeDataSize + totalSphereDataSize) );
-
-    vNormal = glGetAttribLocation( programShadowMap, "vNormal" );
-    glEnableVertexAttribArray( vNormal );
-    glVertexAttribPointer( vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalCubeDataSize + totalSphereDataSize + vCylinderDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
-
-    // Screen Quad
-    glBindVertexArray(vaoScreenQuad);
-    glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-
-    //vPosition = glGetAttribLocation( programScreen , "vPosition" );
-    //glEnableVertexAttribArray( vPosition );
-    glEnableVertexAttribArray( 0 );
-    glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalCubeDataSize + totalSphereDataSize + totalCylinderDataSize) );
-
-    vTexCoord = glGetAttribLocation( programScreen, "vTexCoord" );
-    glEnableVertexAttribArray( vTexCoord );
-    glVertexAttribPointer( vTexCoord, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(totalCubeDataSize + totalSphereDataSize + totalCylinderDataSize + vScreenQuadDataSize) );
-
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    // the depth pass reads vPosition from the same location as the
+    // shadow pass, so both use these
+    vaoCube = makeVertexArray( cubeBuffers, programShadowMap );
+    vaoSphere = makeVertexArray( sphereBuffers, programShadowMap );
+    vaoCylinder = makeVertexArray( cylinderBuffers, programShadowMap );
+    vaoScreenQuad = makeVertexArray( screenQuadBuffers, programScreen );
 
     // Wireframe test
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -404,7 +273,7 @@ void display () {
 
     glBindVertexArray(vaoScreenQuad);
     glBindTexture(GL_TEXTURE_2D, texDepthBuffer); // render depth map to quad for debugging
-    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)screenQuadElementByteOffset);
+    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)0);
 */
 /*
     //
@@ -424,7 +293,7 @@ void display () {
     glBindVertexArray(vaoScreenQuad);
     glBindTexture(GL_TEXTURE_2D, texDepthBuffer); // render depth map to quad for debugging
     //glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)screenQuadElementByteOffset);
+    glDrawElements( GL_TRIANGLES, screenQuadNumElements, GL_UNSIGNED_SHORT, (void*)0);
 */
     // swap the buffers
     glutSwapBuffers();
@@ -453,7 +322,7 @@ void renderScene(const GLuint &targetProgram ) {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, cubeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, cubeNumElements, cube.getElementType(), (void*)0);
 
     //
     // Now the sphere
@@ -467,7 +336,7 @@ void renderScene(const GLuint &targetProgram ) {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, sphereNumElements, GL_UNSIGNED_SHORT, (void*)sphereElementByteOffset);
+    glDrawElements( GL_TRIANGLES, sphereNumElements, sphere.getElementType(), (void*)0);
 
     //
     // Another the cube
@@ -481,7 +350,7 @@ void renderScene(const GLuint &targetProgram ) {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, cubeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, cubeNumElements, cube.getElementType(), (void*)0);
 
     //
     // Finally the cylinder
@@ -495,7 +364,7 @@ void renderScene(const GLuint &targetProgram ) {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, cylinderNumElements, GL_UNSIGNED_SHORT, (void*)cylinderElementByteOffset);
+    glDrawElements( GL_TRIANGLES, cylinderNumElements, cylinder.getElementType(), (void*)0);
 
     // Wall and floor
 
@@ -516,7 +385,7 @@ void renderScene(const GLuint &targetProgram ) {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, cubeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, cubeNumElements, cube.getElementType(), (void*)0);
 
     //
     // Another cube, scaled behind the scene as a sort of plane (floor)
@@ -531,7 +400,7 @@ void renderScene(const GLuint &targetProgram ) {
     glUniformMatrix4fv(mTransformID, 1, GL_TRUE, &mTransform[0][0]);
 
     // Drawing elements
-    glDrawElements( GL_TRIANGLES, cubeNumElements, GL_UNSIGNED_SHORT, (void*)0);
+    glDrawElements( GL_TRIANGLES, cubeNumElements, cube.getElementType(), (void*)0);
 }
 
 // to use the keyboard
@@ -7,6 +7,7 @@
  *
  */
 #include "imageHelper.h"
+#include "zipArchive.h"
 
 /*
  * load_bmp
@@ -116,46 +117,95 @@ GLuint load_bmp(char const* filename) {
  *         http://www.libpng.org/pub/png/libpng-manual.txt
  */
 GLuint load_png(char const* filename) {
+    ImageData image;
+    if (!decode_png(filename, image)) {
+        return 0;
+    }
+    return create_texture(image);
+}
+
+// Reads the png from an entry of a .zip archive, see png_set_read_fn
+static void readZipPng(png_structp pngStruct, png_bytep data, png_size_t length) {
+    ZipEntryReader* zipEntry = (ZipEntryReader*) png_get_io_ptr(pngStruct);
+    if (zipEntry->read((char*) data, length) != length) {
+        png_error(pngStruct, "the zip entry ended too soon");
+    }
+}
+
+// Zip entries have no FILE, their reader closes itself
+static void closeFile(FILE* file) {
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+/*
+ * decode_png
+ *
+ * INPUT:
+ *         Filename - path to the texture file.
+ *         image - where the decoded pixels are written.
+ *
+ * RETURN:
+ *         True if the file could be read.
+ *
+ * DESCRIPTION:
+ *         The first half of load_png: reads the png file into 8 bit RGBA
+ *         pixels. It does not call OpenGL, so it can run on any thread.
+ *         The file can be an entry of a .zip archive (e.g.
+ *         "objects/cube.zip/cube.png"), it is inflated while it is read.
+ *
+ */
+bool decode_png(char const* filename, ImageData& image) {
     png_byte header[8];
 
-    FILE * file = fopen(filename,"rb");
-    if (!file) {
+    // an entry of a .zip archive is inflated while libpng reads it. file
+    // is set once here, it must not change after the setjmp below
+    bool zipped = isZipPath(filename);
+    FILE * const file = zipped ? NULL : fopen(filename,"rb");
+    ZipEntryReader zipEntry;
+
+    if (zipped ? !zipEntry.open(filename) : file == NULL) {
         printf("Image could not be opened: %s \n", filename);
-        return 0;
+        return false;
     }
 
     // read the header
-    fread(header, 1, 8, file);
-    if (png_sig_cmp(header, 0, 8)) {
+    size_t headerSize = zipped ? zipEntry.read((char*) header, 8) : fread(header, 1, 8, file);
+    if (headerSize != 8 || png_sig_cmp(header, 0, 8)) {
         fprintf(stderr, "error: %s is not a PNG.\n", filename);
-        fclose(file);
-        return 0;
+        closeFile(file);
+        return false;
     }
 
     png_structp pngStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!pngStruct) {
         fprintf(stderr, "error: reading png struct.\n");
-        fclose(file);
-        return 0;
+        closeFile(file);
+        return false;
     }
 
     png_infop pngInfo = png_create_info_struct(pngStruct);
     if (!pngInfo) {
         fprintf(stderr, "error: reading png info.\n");
         png_destroy_read_struct(&pngStruct, &pngInfo, NULL);
-        fclose(file);
-        return 0;
+        closeFile(file);
+        return false;
     }
 
     // Set up error handling, usual method
     if(setjmp(png_jmpbuf(pngStruct))) {
         png_destroy_read_struct(&pngStruct, &pngInfo, NULL);
-        fclose(file);
-        return 0;
+        closeFile(file);
+        return false;
     }
 
     // control output
-    png_init_io(pngStruct, file);
+    if (zipped) {
+        png_set_read_fn(pngStruct, &zipEntry, readZipPng);
+    } else {
+        png_init_io(pngStruct, file);
+    }
     png_set_sig_bytes(pngStruct, 8);
     png_read_info(pngStruct, pngInfo);
 
@@ -193,23 +243,19 @@ GLuint load_png(char const* filename) {
     // Row size in bytes.
     int rowbytes = png_get_rowbytes(pngStruct, pngInfo);
 
-    // Allocate the image_data as a big block, to be given to opengl
-    png_byte* image_data = (png_byte*)malloc(rowbytes * height * sizeof(png_byte));
-    if (image_data == NULL) {
-        fprintf(stderr, "error: could not allocate memory for PNG image data\n");
-        png_destroy_read_struct(&pngStruct, &pngInfo, NULL);
-        fclose(file);
-        return 0;
-    }
+    // Allocate the image data as a big block, to be given to opengl
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(rowbytes * height);
+    png_byte* image_data = &image.pixels[0];
 
     // Row_pointers is for pointing to image_data for reading the png with libpng
     png_bytep* row_pointers = (png_bytep*)malloc(height * sizeof(png_bytep));
     if (row_pointers == NULL) {
         fprintf(stderr, "error: could not allocate memory for PNG row pointers\n");
         png_destroy_read_struct(&pngStruct, &pngInfo, NULL);
-        fclose(file);
-        free(image_data);
-        return 0;
+        closeFile(file);
+        return false;
     }
 
     // set the individual row_pointers to point at the correct offsets of image_data
@@ -223,6 +269,34 @@ GLuint load_png(char const* filename) {
 
     png_read_image(pngStruct, row_pointers);
 
+    // Clean up
+    png_destroy_read_struct(&pngStruct, &pngInfo, NULL);
+    closeFile(file);
+    free(row_pointers);
+
+    return true;
+}
+
+/*
+ * create_texture
+ *
+ * INPUT:
+ *         image - a decoded image.
+ *
+ * RETURN:
+ *         The textureID of the new texture, 0 if the image is empty.
+ *
+ * DESCRIPTION:
+ *         The second half of load_png: gives the pixels to OpenGL with
+ *         trilinear filtering. It has to run on the thread of the OpenGL
+ *         context.
+ *
+ */
+GLuint create_texture(const ImageData& image) {
+    if (image.pixels.empty()) {
+        return 0;
+    }
+
     // Create one OpenGL texture
     GLuint textureID;
     glGenTextures(1, &textureID);
@@ -231,7 +305,7 @@ GLuint load_png(char const* filename) {
     glBindTexture(GL_TEXTURE_2D, textureID);
 
     // Give the image to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0]);
 
     // Nice trilinear filtering.
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -240,11 +314,5 @@ GLuint load_png(char const* filename) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glGenerateMipmap(GL_TEXTURE_2D);
 
-    // Clean up
-    png_destroy_read_struct(&pngStruct, &pngInfo, NULL);
-    fclose(file);
-    free(image_data);
-    free(row_pointers);
-
     return textureID;
 }
@@ -22,6 +22,19 @@
 #include <stdio.h>
 #include <png.h>
 #include <iostream>
+#include <vector>
+
+/*
+ * The ImageData struct, a decoded image that was not given to OpenGL yet.
+ * Pixels are 8 bit RGBA, rows from bottom to top like OpenGL expects.
+ */
+struct ImageData {
+    GLsizei width;
+    GLsizei height;
+    std::vector<unsigned char> pixels;
+
+    ImageData () : width(0), height(0) {}
+};
 
 /*
  * load_bmp
@@ -66,4 +79,40 @@ GLuint load_bmp(char const* filename);
  */
 GLuint load_png(char const* filename);
 
+/*
+ * decode_png
+ *
+ * INPUT:
+ *         Filename - path to the texture file.
+ *         image - where the decoded pixels are written.
+ *
+ * RETURN:
+ *         True if the file could be read.
+ *
+ * DESCRIPTION:
+ *         The first half of load_png: reads the png file into 8 bit RGBA
+ *         pixels. It does not call OpenGL, so it can run on any thread.
+ *         The file can be an entry of a .zip archive (e.g.
+ *         "objects/cube.zip/cube.png"), it is inflated while it is read.
+ *
+ */
+bool decode_png(char const* filename, ImageData& image);
+
+/*
+ * create_texture
+ *
+ * INPUT:
+ *         image - a decoded image.
+ *
+ * RETURN:
+ *         The textureID of the new texture, 0 if the image is empty.
+ *
+ * DESCRIPTION:
+ *         The second half of load_png: gives the pixels to OpenGL with
+ *         trilinear filtering. It has to run on the thread of the OpenGL
+ *         context.
+ *
+ */
+GLuint create_texture(const ImageData& image);
+
 #endif
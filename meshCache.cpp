@@ -0,0 +1,457 @@
+/*
+ * meshCache.cpp
+ *
+ * Binary mesh cache. The welded geometry of an .obj file is saved next to
+ * it, so the next time it is loaded we skip the parsing and the welding.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "meshCache.h"
+#include "objReader.h"
+#include "zipArchive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#include <functional>
+#include <thread>
+#endif
+
+#include <algorithm>
+
+// Identifies our files, and the byte order they were written with
+static const char MESH_CACHE_MAGIC[8] = { 'O', 'G', 'L', 'M', 'E', 'S', 'H', 1 };
+
+// The arrays of the file, in the order they are written
+enum MeshCacheArray {
+    CACHE_VERTICES = 0,
+    CACHE_NORMALS,
+    CACHE_UVTEXTURES,
+    CACHE_TANGENTS,
+    CACHE_BITANGENTS,
+    CACHE_ELEMENTS,
+    CACHE_SUBMESHES,
+    CACHE_NAMES,
+    CACHE_MATERIALS,
+    CACHE_LIBRARIES,
+    CACHE_NUM_ARRAYS
+};
+
+// Submeshes are written as they are in memory, four 4 byte values each
+static_assert(sizeof(Submesh) == 16, "Submesh must be four 4 byte values");
+
+// The header at the start of every cache file
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t sourceHash;
+
+    // where each array starts (in bytes from the start of the file) and how
+    // many 4 byte values it has
+    uint64_t offsets[CACHE_NUM_ARRAYS];
+    uint64_t counts[CACHE_NUM_ARRAYS];
+};
+
+// Constants of the hash
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+
+static inline uint64_t rotateLeft (uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static inline uint64_t readWord (const char* p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline uint64_t mixWord (uint64_t lane, uint64_t word) {
+    lane += word * PRIME2;
+    lane = rotateLeft(lane, 31);
+    return lane * PRIME1;
+}
+
+static inline size_t alignOffset (size_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~((size_t) MESH_CACHE_ALIGNMENT - 1);
+}
+
+// A list of strings as 4 byte values: how many strings there are, then
+// every string with its '\0', then zeros up to a multiple of 4 bytes
+static void packStrings (const std::vector<std::string>& strings, std::vector<uint32_t>& packed) {
+    size_t bytes = sizeof(uint32_t);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        bytes += strings[i].size() + 1;
+    }
+
+    packed.assign((bytes + 3) / 4, 0);
+    char* p = (char*) &packed[0];
+    uint32_t count = (uint32_t) strings.size();
+    memcpy(p, &count, sizeof(count));
+    p += sizeof(count);
+
+    for (size_t i = 0; i < strings.size(); ++i) {
+        memcpy(p, strings[i].c_str(), strings[i].size() + 1);
+        p += strings[i].size() + 1;
+    }
+}
+
+// The opposite of packStrings, false if the bytes are not a valid list
+static bool unpackStrings (const char* p, size_t bytes, std::vector<std::string>& strings) {
+    uint32_t count;
+    if (bytes < sizeof(count)) {
+        return false;
+    }
+    memcpy(&count, p, sizeof(count));
+
+    const char* end = p + bytes;
+    p += sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const char* stringEnd = (const char*) memchr(p, '\0', end - p);
+        if (stringEnd == NULL) {
+            return false;
+        }
+        strings.push_back(std::string(p, stringEnd));
+        p = stringEnd + 1;
+    }
+    return true;
+}
+
+/*
+ * hashBytes
+ *
+ * INPUT:
+ *         data - the bytes we want to hash.
+ *         size - how many bytes.
+ *
+ * RETURN:
+ *         A 64 bit hash of the bytes.
+ *
+ * DESCRIPTION:
+ *         Fast non cryptographic hash, it reads 8 bytes at a time. It is
+ *         used to know if the source of a cache file changed.
+ *
+ *         Four independent lanes consume 32 bytes per step so the
+ *         multiplications do not wait on each other.
+ *
+ */
+unsigned long long hashBytes(const char* data, size_t size) {
+    const char* p = data;
+    const char* end = data + size;
+
+    uint64_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, (uint64_t) 0 - PRIME1 };
+    while (end - p >= 32) {
+        lanes[0] = mixWord(lanes[0], readWord(p));
+        lanes[1] = mixWord(lanes[1], readWord(p + 8));
+        lanes[2] = mixWord(lanes[2], readWord(p + 16));
+        lanes[3] = mixWord(lanes[3], readWord(p + 24));
+        p += 32;
+    }
+
+    uint64_t h = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+                 rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+    h += (uint64_t) size;
+
+    while (end - p >= 8) {
+        h ^= mixWord(0, readWord(p));
+        h = rotateLeft(h, 27) * PRIME1 + PRIME3;
+        p += 8;
+    }
+    while (p < end) {
+        h ^= (unsigned char) *p * PRIME3;
+        h = rotateLeft(h, 11) * PRIME1;
+        ++p;
+    }
+
+    // final avalanche
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/*
+ * getMeshCachePath
+ *
+ * INPUT:
+ *         filename - the source asset, e.g. "objects/teapot.obj".
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL
+ *                      the asset is read with.
+ *         withTangents - true if the tangents are computed too.
+ *
+ * RETURN:
+ *         The path of its cache file, the mask and a "t" for the tangents
+ *         go before the extension, e.g. "objects/teapot.obj.7t.meshcache".
+ *         Entries of .zip archives get theirs next to the archive, e.g.
+ *         "objects/teapot.zip/teapot.obj" gives
+ *         "objects/teapot.zip.teapot.obj.7t.meshcache".
+ *
+ */
+std::string getMeshCachePath(const char* filename, unsigned int attributes, bool withTangents) {
+    // every way of reading the same asset has its own file, so loading it
+    // once with tangents and once without does not overwrite the other
+    char variant[32];
+    snprintf(variant, sizeof(variant), ".%u%s.meshcache", attributes, withTangents ? "t" : "");
+
+    std::string archivePath, entryName;
+    if (splitZipPath(filename, archivePath, entryName)) {
+        std::replace(entryName.begin(), entryName.end(), '/', '_');
+        return archivePath + "." + entryName + variant;
+    }
+    return std::string(filename) + variant;
+}
+
+// True if every per vertex array of mesh is empty or has one entry per
+// vertex and every element and submesh is inside the arrays, so a damaged
+// cache file is never handed to the optimizers or to OpenGL
+static bool isValidMesh (const MeshData& mesh, size_t numMaterials) {
+    size_t numVertices = mesh.vertices.size() / 3;
+    if (mesh.vertices.size() % 3 != 0 ||
+        (!mesh.normals.empty() && mesh.normals.size() != numVertices * 3) ||
+        (!mesh.uvtextures.empty() && mesh.uvtextures.size() != numVertices * 2) ||
+        (!mesh.tangents.empty() && mesh.tangents.size() != numVertices * 3) ||
+        (!mesh.bitangents.empty() && mesh.bitangents.size() != numVertices * 3) ||
+        mesh.elements.size() % 3 != 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < mesh.elements.size(); ++i) {
+        if (mesh.elements[i] >= numVertices) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < mesh.submeshes.size(); ++i) {
+        const Submesh& submesh = mesh.submeshes[i];
+        if (submesh.firstElement > mesh.elements.size() ||
+            submesh.numElements > mesh.elements.size() - submesh.firstElement ||
+            submesh.name >= (GLint) mesh.names.size() ||
+            submesh.material >= (GLint) numMaterials) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * readMeshCache
+ *
+ * INPUT:
+ *         filename - the cache file.
+ *         sourceHash - hash of the current contents of the source asset.
+ *         mesh - where the geometry is written.
+ *
+ * RETURN:
+ *         True if the file exists, has the current version, was made from
+ *         a source with the same hash and its arrays are consistent (sizes
+ *         that match the vertices, elements and submeshes inside them).
+ *         False otherwise, and then mesh is left empty.
+ *
+ * DESCRIPTION:
+ *         The file is mapped once and every array is copied straight from
+ *         the mapping into mesh. They are copied, not uploaded from the
+ *         mapping, because a shape keeps its arrays in memory after the
+ *         upload too.
+ *
+ */
+bool readMeshCache(const char* filename, unsigned long long sourceHash, MeshData& mesh) {
+    obj::MappedFile file;
+
+    mesh.clear();
+    if (!file.open(filename) || file.getSize() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memcpy(&header, file.begin(), sizeof(header));
+
+    if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MESH_CACHE_VERSION ||
+        header.headerSize != sizeof(MeshCacheHeader) ||
+        header.sourceHash != sourceHash) {
+        return false;
+    }
+
+    // every array has to be inside the file
+    for (int i = 0; i < CACHE_NUM_ARRAYS; ++i) {
+        if (header.offsets[i] > file.getSize() ||
+            header.counts[i] > (file.getSize() - header.offsets[i]) / 4) {
+            return false;
+        }
+    }
+
+    const char* base = file.begin();
+    std::vector<float>* floatArrays[] = { &mesh.vertices, &mesh.normals, &mesh.uvtextures,
+                                          &mesh.tangents, &mesh.bitangents };
+
+    for (int i = 0; i < CACHE_ELEMENTS; ++i) {
+        const float* values = (const float*) (base + header.offsets[i]);
+        floatArrays[i]->assign(values, values + header.counts[i]);
+    }
+
+    const GLuint* elements = (const GLuint*) (base + header.offsets[CACHE_ELEMENTS]);
+    mesh.elements.assign(elements, elements + header.counts[CACHE_ELEMENTS]);
+
+    const Submesh* submeshes = (const Submesh*) (base + header.offsets[CACHE_SUBMESHES]);
+    mesh.submeshes.assign(submeshes, submeshes + header.counts[CACHE_SUBMESHES] / 4);
+
+    // only the names of the materials are saved, they are read from their
+    // .mtl files every time
+    std::vector<std::string> materials;
+    if (!unpackStrings(base + header.offsets[CACHE_NAMES], header.counts[CACHE_NAMES] * 4, mesh.names) ||
+        !unpackStrings(base + header.offsets[CACHE_MATERIALS], header.counts[CACHE_MATERIALS] * 4,
+                       materials) ||
+        !unpackStrings(base + header.offsets[CACHE_LIBRARIES], header.counts[CACHE_LIBRARIES] * 4,
+                       mesh.materialLibraries)) {
+        mesh.clear();
+        return false;
+    }
+
+    if (!isValidMesh(mesh, materials.size())) {
+        mesh.clear();
+        return false;
+    }
+
+    mesh.materials.resize(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        mesh.materials[i].name.swap(materials[i]);
+    }
+    return true;
+}
+
+// Creates a new file next to filename to write it first, with a name no
+// other writer gets, so two loads of the same file at the same time (on
+// two threads or in two programs) never write the same one
+static FILE* openTemporaryFile (const char* filename, std::string& temporary) {
+#ifndef _WIN32
+    temporary = std::string(filename) + ".XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // mkstemp only lets the owner read it, the cache is as readable as the
+    // files fopen makes
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    FILE* fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        ::close(fd);
+        remove(temporary.c_str());
+    }
+    return fp;
+#else
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%d.%zu.tmp", _getpid(),
+             std::hash<std::thread::id>()(std::this_thread::get_id()));
+    temporary = std::string(filename) + suffix;
+    return fopen(temporary.c_str(), "wb");
+#endif
+}
+
+/*
+ * writeMeshCache
+ *
+ * INPUT:
+ *         filename - the cache file.
+ *         sourceHash - hash of the contents of the source asset.
+ *         mesh - the geometry we want to save.
+ *
+ * RETURN:
+ *         True if the file could be written.
+ *
+ * DESCRIPTION:
+ *         Writes a header followed by every array of mesh, each one aligned
+ *         to MESH_CACHE_ALIGNMENT bytes so it can be handed to OpenGL as is.
+ *         The submeshes, their names and the names of their materials and
+ *         .mtl files are written after the elements.
+ *
+ */
+bool writeMeshCache(const char* filename, unsigned long long sourceHash, const MeshData& mesh) {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.headerSize = sizeof(MeshCacheHeader);
+    header.sourceHash = sourceHash;
+
+    std::vector<std::string> materialNames;
+    for (size_t i = 0; i < mesh.materials.size(); ++i) {
+        materialNames.push_back(mesh.materials[i].name);
+    }
+
+    std::vector<uint32_t> names, materials, libraries;
+    packStrings(mesh.names, names);
+    packStrings(materialNames, materials);
+    packStrings(mesh.materialLibraries, libraries);
+
+    const void* arrays[CACHE_NUM_ARRAYS] = {
+        mesh.vertices.empty() ? NULL : &mesh.vertices[0],
+        mesh.normals.empty() ? NULL : &mesh.normals[0],
+        mesh.uvtextures.empty() ? NULL : &mesh.uvtextures[0],
+        mesh.tangents.empty() ? NULL : &mesh.tangents[0],
+        mesh.bitangents.empty() ? NULL : &mesh.bitangents[0],
+        mesh.elements.empty() ? NULL : &mesh.elements[0],
+        mesh.submeshes.empty() ? NULL : &mesh.submeshes[0],
+        &names[0],
+        &materials[0],
+        &libraries[0]
+    };
+    header.counts[CACHE_VERTICES] = mesh.vertices.size();
+    header.counts[CACHE_NORMALS] = mesh.normals.size();
+    header.counts[CACHE_UVTEXTURES] = mesh.uvtextures.size();
+    header.counts[CACHE_TANGENTS] = mesh.tangents.size();
+    header.counts[CACHE_BITANGENTS] = mesh.bitangents.size();
+    header.counts[CACHE_ELEMENTS] = mesh.elements.size();
+    header.counts[CACHE_SUBMESHES] = mesh.submeshes.size() * 4;
+    header.counts[CACHE_NAMES] = names.size();
+    header.counts[CACHE_MATERIALS] = materials.size();
+    header.counts[CACHE_LIBRARIES] = libraries.size();
+
+    size_t offset = alignOffset(sizeof(header));
+    for (int i = 0; i < CACHE_NUM_ARRAYS; ++i) {
+        header.offsets[i] = offset;
+        offset = alignOffset(offset + header.counts[i] * 4);
+    }
+
+    // write to a temporary file first, so a reader never sees half a file
+    std::string temporary;
+    FILE* fp = openTemporaryFile(filename, temporary);
+    if (fp == NULL) {
+        return false;
+    }
+
+    static const char padding[MESH_CACHE_ALIGNMENT] = { 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    size_t written = sizeof(header);
+
+    for (int i = 0; i < CACHE_NUM_ARRAYS && ok; ++i) {
+        ok = fwrite(padding, 1, header.offsets[i] - written, fp) == header.offsets[i] - written;
+        written = header.offsets[i];
+
+        if (ok && header.counts[i] > 0) {
+            ok = fwrite(arrays[i], 4, header.counts[i], fp) == header.counts[i];
+            written += header.counts[i] * 4;
+        }
+    }
+
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(temporary.c_str(), filename) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
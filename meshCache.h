@@ -0,0 +1,105 @@
+/*
+ * meshCache.h
+ *
+ * Binary mesh cache. The welded geometry of an .obj file is saved next to
+ * it, so the next time it is loaded we skip the parsing and the welding.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _MESHCACHE_H
+#define _MESHCACHE_H
+
+#include <string>
+#include <stddef.h>
+
+#include "meshData.h"
+
+// Increase this every time the layout of the cache file changes, old
+// files are then simply ignored and written again
+#define MESH_CACHE_VERSION  6
+
+// Every array in the file starts at a multiple of this many bytes
+#define MESH_CACHE_ALIGNMENT  64
+
+/*
+ * hashBytes
+ *
+ * INPUT:
+ *         data - the bytes we want to hash.
+ *         size - how many bytes.
+ *
+ * RETURN:
+ *         A 64 bit hash of the bytes.
+ *
+ * DESCRIPTION:
+ *         Fast non cryptographic hash, it reads 8 bytes at a time. It is
+ *         used to know if the source of a cache file changed.
+ *
+ */
+unsigned long long hashBytes(const char* data, size_t size);
+
+/*
+ * getMeshCachePath
+ *
+ * INPUT:
+ *         filename - the source asset, e.g. "objects/teapot.obj".
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL
+ *                      the asset is read with.
+ *         withTangents - true if the tangents are computed too.
+ *
+ * RETURN:
+ *         The path of its cache file, the mask and a "t" for the tangents
+ *         go before the extension, e.g. "objects/teapot.obj.7t.meshcache".
+ *         Entries of .zip archives get theirs next to the archive, e.g.
+ *         "objects/teapot.zip/teapot.obj" gives
+ *         "objects/teapot.zip.teapot.obj.7t.meshcache".
+ *
+ */
+std::string getMeshCachePath(const char* filename, unsigned int attributes, bool withTangents);
+
+/*
+ * readMeshCache
+ *
+ * INPUT:
+ *         filename - the cache file.
+ *         sourceHash - hash of the current contents of the source asset.
+ *         mesh - where the geometry is written.
+ *
+ * RETURN:
+ *         True if the file exists, has the current version, was made from
+ *         a source with the same hash and its arrays are consistent (sizes
+ *         that match the vertices, elements and submeshes inside them).
+ *         False otherwise, and then mesh is left empty.
+ *
+ * DESCRIPTION:
+ *         The file is mapped once and every array is copied straight from
+ *         the mapping into mesh. They are copied, not uploaded from the
+ *         mapping, because a shape keeps its arrays in memory after the
+ *         upload too.
+ *
+ */
+bool readMeshCache(const char* filename, unsigned long long sourceHash, MeshData& mesh);
+
+/*
+ * writeMeshCache
+ *
+ * INPUT:
+ *         filename - the cache file.
+ *         sourceHash - hash of the contents of the source asset.
+ *         mesh - the geometry we want to save.
+ *
+ * RETURN:
+ *         True if the file could be written.
+ *
+ * DESCRIPTION:
+ *         Writes a header followed by every array of mesh, each one aligned
+ *         to MESH_CACHE_ALIGNMENT bytes so it can be handed to OpenGL as is.
+ *         The submeshes, their names and the names of their materials and
+ *         .mtl files are written after the elements.
+ *
+ */
+bool writeMeshCache(const char* filename, unsigned long long sourceHash, const MeshData& mesh);
+
+#endif
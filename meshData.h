@@ -0,0 +1,97 @@
+/*
+ * meshData.h
+ *
+ * The CPU side geometry of a mesh, the same arrays a Shape holds. It is
+ * used to move geometry between the loaders, the mesh cache and Shape.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _MESHDATA_H
+#define _MESHDATA_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <vector>
+#include <string>
+
+#include "objReader.h"
+
+/*
+ * A range of the elements of a mesh drawn with the same material, e.g.
+ * one object or group of an .obj file.
+ */
+struct Submesh {
+    // the first element of the range and how many elements it has
+    GLuint firstElement;
+    GLuint numElements;
+
+    // index on MeshData::names and MeshData::materials, -1 if the range
+    // has no name or no material
+    GLint name;
+    GLint material;
+};
+
+/*
+ * The MeshData struct. Every per vertex array is either empty or has one
+ * entry (3 or 2 floats) per vertex.
+ */
+struct MeshData {
+    // x y z of each vertex
+    std::vector<float> vertices;
+
+    // x y z of the normal of each vertex
+    std::vector<float> normals;
+
+    // u v of each vertex
+    std::vector<float> uvtextures;
+
+    // x y z of the tangent and bitangent of each vertex
+    std::vector<float> tangents;
+    std::vector<float> bitangents;
+
+    // three elements per triangle
+    std::vector<GLuint> elements;
+
+    // the ranges of elements, in order and covering all of them. Empty
+    // if the mesh is only one piece
+    std::vector<Submesh> submeshes;
+
+    // the names of the submeshes
+    std::vector<std::string> names;
+
+    // the materials of the submeshes, their texture files are relative to
+    // the working directory
+    std::vector<obj::ObjMaterial> materials;
+
+    // the .mtl files the materials come from, relative to the mesh file
+    std::vector<std::string> materialLibraries;
+
+    /*
+     * clear
+     *
+     * DESCRIPTION:
+     *         Empties every vector.
+     *
+     */
+    void clear () {
+        vertices.clear();
+        normals.clear();
+        uvtextures.clear();
+        tangents.clear();
+        bitangents.clear();
+        elements.clear();
+        submeshes.clear();
+        names.clear();
+        materials.clear();
+        materialLibraries.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,495 @@
+/*
+ * meshLoader.cpp
+ *
+ * CPU side loading of meshes: parsing, welding, tangents and the mesh
+ * cache. Nothing here touches OpenGL or a Shape, so these functions can
+ * run on any thread.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "meshLoader.h"
+#include "meshCache.h"
+#include "meshOptimizer.h"
+#include "vertexWelder.h"
+#include "mathHelper.h"
+#include "zipArchive.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <stdio.h>
+
+// Added to the attributes in the hash of a cache made with tangents
+#define CACHE_WITH_TANGENTS  (OBJ_ALL + 1)
+
+// Copies count floats of list, starting at record index, or zeros if the
+// corner does not have the attribute
+static inline void copyRecord (float* target, const std::vector<float>& list, int index, int count) {
+    if (index < 0 || (size_t) (index + 1) * count > list.size()) {
+        std::fill(target, target + count, 0.0f);
+    } else {
+        std::copy(list.begin() + index * count, list.begin() + (index + 1) * count, target);
+    }
+}
+
+// Orders submesh indices by the material of the submeshes
+struct SubmeshMaterialLess {
+    const std::vector<Submesh>& submeshes;
+
+    SubmeshMaterialLess (const std::vector<Submesh>& submeshes) : submeshes(submeshes) {
+    }
+
+    bool operator() (size_t a, size_t b) const {
+        return submeshes[a].material < submeshes[b].material;
+    }
+};
+
+/*
+ * weldCorners
+ *
+ * DESCRIPTION:
+ *         The body of weldObjData for one mask of attributes. Attributes
+ *         is a template argument so every test on it is resolved when the
+ *         function is compiled.
+ *
+ */
+template <unsigned int Attributes>
+static void weldCorners (obj::ObjData& data, MeshData& mesh) {
+    const bool wantTextures = (Attributes & OBJ_TEXCOORD) != 0;
+    const bool wantNormals = (Attributes & OBJ_NORMAL) != 0;
+
+    size_t numCorners = data.elements.size() / 3;
+    mesh.elements.reserve(numCorners);
+
+    // with positions only every "v" is already a unique vertex, they are
+    // used exactly as they are on the file. A corner with no "v" of its
+    // own (0 or past the last one) uses a vertex at the origin added after
+    // them, like copyRecord gives the welded corners
+    if (!wantTextures && !wantNormals) {
+        mesh.vertices.swap(data.vertices);
+        GLuint numFileVertices = (GLuint) (mesh.vertices.size() / 3);
+        bool hasMissing = false;
+        for (size_t i = 0; i < data.elements.size(); i += 3) {
+            int index = data.elements[i];
+            if (index < 0 || (size_t) index >= numFileVertices) {
+                mesh.elements.push_back(numFileVertices);
+                hasMissing = true;
+            } else {
+                mesh.elements.push_back((GLuint) index);
+            }
+        }
+        if (hasMissing) {
+            mesh.vertices.resize(mesh.vertices.size() + 3, 0.0f);
+        }
+        return;
+    }
+
+    // Filling the index the correct way, every "1/2/3" we see for the first time becomes
+    // a new vertex of the mesh, if we see it again the welder gives us the index it got
+    VertexWelder welder(std::max(data.vertices.size()/3, data.normals.size()/3));
+    bool isNew;
+
+    // every face corner is "vertex, texture, normal" on data.elements, the
+    // ones we do not want are already -1
+    for (size_t i = 0; i < data.elements.size(); i += 3) {
+        mesh.elements.push_back(welder.weld(data.elements[i], data.elements[i+1], data.elements[i+2], isNew));
+    }
+
+    // Now we know how many vertices there are, so every array is allocated
+    // once. New vertices got the indices 0, 1, 2, ... in corner order, so the
+    // first corner of each one is the one whose index is the next we expect
+    size_t numVertices = welder.getNumVertices();
+    mesh.vertices.resize(numVertices * 3);
+    if (wantTextures) mesh.uvtextures.resize(numVertices * 2);
+    if (wantNormals)  mesh.normals.resize(numVertices * 3);
+
+    GLuint next = 0;
+    for (size_t corner = 0; corner < numCorners && next < numVertices; ++corner) {
+        if (mesh.elements[corner] != next) {
+            continue;
+        }
+
+        const int* indices = &data.elements[corner * 3];
+        copyRecord(&mesh.vertices[next * 3], data.vertices, indices[0], 3);
+        if (wantTextures) copyRecord(&mesh.uvtextures[next * 2], data.uvtextures, indices[1], 2);
+        if (wantNormals)  copyRecord(&mesh.normals[next * 3], data.normals, indices[2], 3);
+        ++next;
+    }
+}
+
+// One welder for every mask of attributes, indexed by the mask
+typedef void (*CornerWelder) (obj::ObjData&, MeshData&);
+
+static const CornerWelder cornerWelders[OBJ_ALL + 1] = {
+    weldCorners<0>, weldCorners<1>, weldCorners<2>, weldCorners<3>,
+    weldCorners<4>, weldCorners<5>, weldCorners<6>, weldCorners<7>
+};
+
+/*
+ * weldObjData
+ *
+ * INPUT:
+ *         data - the raw contents of an .obj file.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL,
+ *                      the per vertex arrays mesh will have.
+ *         mesh - where the welded geometry is written.
+ *
+ * DESCRIPTION:
+ *         Creates the vertices (plus uvtextures and normals, if asked for)
+ *         and elements of mesh from the face corners of an .obj file. Every
+ *         distinct combination of the wanted indices becomes one vertex of
+ *         the mesh, repeated ones reuse the same index. Corners missing a
+ *         wanted attribute (e.g. "1//3" when textures are wanted) get zeros.
+ *         The submeshes of data become the submeshes of mesh.
+ *
+ *         With positions only the vertices of the file are used as they
+ *         are, nothing is welded, and they are moved out of data. Corners
+ *         whose "v" is 0 or past the last one get one more vertex at the
+ *         origin.
+ *
+ */
+void weldObjData(obj::ObjData& data, unsigned int attributes, MeshData& mesh) {
+    mesh.clear();
+    cornerWelders[attributes & OBJ_ALL](data, mesh);
+
+    // corner i of the file is element i of the mesh, the ranges stay the same
+    mesh.submeshes.resize(data.submeshes.size());
+    for (size_t i = 0; i < data.submeshes.size(); ++i) {
+        const obj::ObjSubmesh& submesh = data.submeshes[i];
+        mesh.submeshes[i].firstElement = (GLuint) submesh.firstCorner;
+        mesh.submeshes[i].numElements = (GLuint) submesh.numCorners;
+        mesh.submeshes[i].name = submesh.name;
+        mesh.submeshes[i].material = submesh.material;
+    }
+    mesh.names.swap(data.names);
+    mesh.materialLibraries.swap(data.materialLibraries);
+
+    // only the names are known here, loadMaterials reads the rest
+    mesh.materials.resize(data.materials.size());
+    for (size_t i = 0; i < data.materials.size(); ++i) {
+        mesh.materials[i].name.swap(data.materials[i]);
+    }
+}
+
+/*
+ * computeTangents
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices, uvtextures and elements.
+ *
+ * DESCRIPTION:
+ *         Calculates the tangent and bitangent of every vertex from the
+ *         positions and texture coordinates of the triangles around it.
+ *         They are needed for normal mapping.
+ *
+ */
+void computeTangents(MeshData& mesh) {
+    // bitangent and tangent will have the same size as the mesh's vertices
+    mesh.tangents.assign(mesh.vertices.size(), 0.0f);
+    mesh.bitangents.assign(mesh.vertices.size(), 0.0f);
+
+    // iterate through elements, every 3 elements is a triangle face
+    for( size_t i = 0; i < mesh.elements.size(); i+=3 ) {
+        int vecPos1 = mesh.elements[i]*3;
+        int texPos1 = mesh.elements[i]*2;
+        float pos1[] = { mesh.vertices[vecPos1], mesh.vertices[vecPos1+1] , mesh.vertices[vecPos1+2]};
+        float uv1[] = { mesh.uvtextures[texPos1], mesh.uvtextures[texPos1+1] };
+
+        int vecPos2 = mesh.elements[i+1]*3;
+        int texPos2 = mesh.elements[i+1]*2;
+        float pos2[] = { mesh.vertices[vecPos2], mesh.vertices[vecPos2+1] , mesh.vertices[vecPos2+2]};
+        float uv2[] = { mesh.uvtextures[texPos2], mesh.uvtextures[texPos2+1] };
+
+        int vecPos3 = mesh.elements[i+2]*3;
+        int texPos3 = mesh.elements[i+2]*2;
+        float pos3[] = { mesh.vertices[vecPos3], mesh.vertices[vecPos3+1] , mesh.vertices[vecPos3+2]};
+        float uv3[] = { mesh.uvtextures[texPos3], mesh.uvtextures[texPos3+1] };
+
+        // Our actual values used for the canculations of tangent and bitangent
+        float edge1[] =  { pos2[0] -  pos1[0], pos2[1] -  pos1[1], pos2[2] -  pos1[2] };
+        float edge2[] =  { pos3[0] -  pos1[0], pos3[1] -  pos1[1], pos3[2] -  pos1[2] };
+        float deltaUV1[] =  { uv2[0] -  uv1[0], uv2[1] -  uv1[1] };
+        float deltaUV2[] =  { uv3[0] -  uv1[0], uv3[1] -  uv1[1] };
+
+        // Calculating it
+        float f = 1.0f / (deltaUV1[0] * deltaUV2[1] - deltaUV2[0] * deltaUV1[1]);
+
+        float tangent[] = {
+            f * (deltaUV2[1] * edge1[0] - deltaUV1[1] * edge2[0]),
+            f * (deltaUV2[1] * edge1[1] - deltaUV1[1] * edge2[1]),
+            f * (deltaUV2[1] * edge1[2] - deltaUV1[1] * edge2[2]) };
+        normalize(tangent);
+
+        float bitangent[] = {
+            f * (-deltaUV2[0] * edge1[0] + deltaUV1[0] * edge2[0]),
+            f * (-deltaUV2[0] * edge1[1] + deltaUV1[0] * edge2[1]),
+            f * (-deltaUV2[0] * edge1[2] + deltaUV1[0] * edge2[2]) };
+        normalize(bitangent);
+
+        // all three mesh.vertices from the triangle will share the same
+        // tangent and bitangent, so we add those values three times
+        for (int j = 0; j < 3; ++j) {
+            // if element = 0, index used will be 0, 1, 2
+            // if element = 1, index used will be 3, 4, 5
+            int index = mesh.elements[i+j]*3;
+
+            // TODO: actually double check these averages
+            mesh.tangents[index] = (mesh.tangents[index] + tangent[0]) / 2.0f;
+            mesh.tangents[index+1] = (mesh.tangents[index+1] + tangent[1]) / 2.0f;
+            mesh.tangents[index+2] = (mesh.tangents[index+2] + tangent[2]) / 2.0f;
+
+            mesh.bitangents[index] = (mesh.bitangents[index] + bitangent[0]) / 2.0f;
+            mesh.bitangents[index+1] = (mesh.bitangents[index+1] + bitangent[1]) / 2.0f;
+            mesh.bitangents[index+2] = (mesh.bitangents[index+2] + bitangent[2]) / 2.0f;
+
+        }
+    }
+}
+
+/*
+ * sortByMaterial
+ *
+ * INPUT:
+ *         mesh - a mesh with submeshes.
+ *
+ * DESCRIPTION:
+ *         Moves the triangles of mesh so the submeshes are sorted by
+ *         material, the ones with the same material keep the order they
+ *         had. Consecutive submeshes that end up with the same name and
+ *         material become one. Every material is then a single range of
+ *         elements, see getMaterialBatches.
+ *
+ */
+void sortByMaterial(MeshData& mesh) {
+    if (mesh.submeshes.size() < 2) {
+        return;
+    }
+
+    // the order of the submeshes, by material (the ones without one first)
+    std::vector<size_t> order(mesh.submeshes.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), SubmeshMaterialLess(mesh.submeshes));
+
+    std::vector<GLuint> elements(mesh.elements.size());
+    std::vector<Submesh> submeshes;
+    submeshes.reserve(mesh.submeshes.size());
+
+    GLuint next = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        Submesh submesh = mesh.submeshes[order[i]];
+        std::copy(mesh.elements.begin() + submesh.firstElement,
+                  mesh.elements.begin() + submesh.firstElement + submesh.numElements,
+                  elements.begin() + next);
+        submesh.firstElement = next;
+        next += submesh.numElements;
+
+        if (!submeshes.empty() && submeshes.back().name == submesh.name &&
+            submeshes.back().material == submesh.material) {
+            submeshes.back().numElements += submesh.numElements;
+        } else {
+            submeshes.push_back(submesh);
+        }
+    }
+
+    mesh.elements.swap(elements);
+    mesh.submeshes.swap(submeshes);
+}
+
+/*
+ * getMaterialBatches
+ *
+ * INPUT:
+ *         submeshes - the submeshes of a mesh.
+ *         batches - where the batches are written.
+ *
+ * DESCRIPTION:
+ *         Joins the consecutive submeshes with the same material, what is
+ *         left is one range (name -1) per material if the mesh was sorted
+ *         with sortByMaterial. Each batch is drawn with one glDrawElements
+ *         and its textures bound once.
+ *
+ */
+void getMaterialBatches(const std::vector<Submesh>& submeshes, std::vector<Submesh>& batches) {
+    batches.clear();
+    for (size_t i = 0; i < submeshes.size(); ++i) {
+        const Submesh& submesh = submeshes[i];
+        if (!batches.empty() && batches.back().material == submesh.material &&
+            batches.back().firstElement + batches.back().numElements == submesh.firstElement) {
+            batches.back().numElements += submesh.numElements;
+            continue;
+        }
+
+        Submesh batch = { submesh.firstElement, submesh.numElements, -1, submesh.material };
+        batches.push_back(batch);
+    }
+}
+
+// The directory of a file, with its "/" at the end, or "" if there is none
+static std::string getDirectory (const std::string& filename) {
+    size_t slash = filename.find_last_of('/');
+    return slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+}
+
+// A file written on an .mtl, relative to the working directory
+static std::string resolvePath (const std::string& directory, const std::string& file) {
+    if (file.empty() || file[0] == '/') {
+        return file;
+    }
+    return directory + file;
+}
+
+/*
+ * loadMaterials
+ *
+ * INPUT:
+ *         filename - the mesh file, the .mtl files are relative to it.
+ *         mesh - a mesh whose materials only have their names.
+ *
+ * RETURN:
+ *         False if one of the .mtl files could not be read.
+ *
+ * DESCRIPTION:
+ *         Reads the .mtl files of mesh and fills its materials with the
+ *         values found there. The texture files are made relative to the
+ *         working directory. Materials that are on none of the files keep
+ *         the defaults of obj::ObjMaterial.
+ *
+ */
+bool loadMaterials(const char* filename, MeshData& mesh) {
+    if (mesh.materials.empty()) {
+        return true;
+    }
+
+    std::map<std::string, size_t> indices;
+    for (size_t i = 0; i < mesh.materials.size(); ++i) {
+        indices[mesh.materials[i].name] = i;
+    }
+
+    bool ok = true;
+    std::string directory = getDirectory(filename);
+
+    for (size_t i = 0; i < mesh.materialLibraries.size(); ++i) {
+        std::string library = resolvePath(directory, mesh.materialLibraries[i]);
+        std::string libraryDirectory = getDirectory(library);
+
+        std::vector<obj::ObjMaterial> found;
+        if (!obj::readMtlFile(library.c_str(), found)) {
+            fprintf(stderr, "error while opening file %s \n", library.c_str());
+            ok = false;
+            continue;
+        }
+
+        // the first definition of a name wins
+        for (size_t j = 0; j < found.size(); ++j) {
+            std::map<std::string, size_t>::iterator it = indices.find(found[j].name);
+            if (it == indices.end()) {
+                continue;
+            }
+
+            obj::ObjMaterial& material = mesh.materials[it->second];
+            material = found[j];
+            material.diffuseMap = resolvePath(libraryDirectory, material.diffuseMap);
+            material.specularMap = resolvePath(libraryDirectory, material.specularMap);
+            material.normalMap = resolvePath(libraryDirectory, material.normalMap);
+            indices.erase(it);
+        }
+    }
+    return ok;
+}
+
+/*
+ * loadWeldedObj
+ *
+ * INPUT:
+ *         filename - the .obj file, faces can use any pattern.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *         withTangents - true if the tangents and bitangents are also needed,
+ *                        it needs OBJ_TEXCOORD.
+ *         useCache - true to read and write the binary mesh cache.
+ *         numThreads - how many threads parse the file (0 means every core).
+ *         mesh - where the geometry is written.
+ *
+ * RETURN:
+ *         False if the file could not be read.
+ *
+ * DESCRIPTION:
+ *         Fills mesh with the welded contents of the .obj file. If useCache
+ *         is true and the cache file next to the .obj was made from the same
+ *         contents and attributes, the geometry comes from it. Otherwise the
+ *         file is parsed, welded, sorted by material, its triangles
+ *         reordered for the vertex cache and its vertices put in the order
+ *         the triangles use them, and the cache is written. The materials
+ *         are always read from their .mtl files.
+ *
+ *         filename can be an entry of a .zip archive (e.g.
+ *         "objects/teapot.zip/teapot.obj"), it is parsed while it is
+ *         inflated. Its .mtl files and textures are then looked for in the
+ *         same archive.
+ *
+ */
+bool loadWeldedObj(const char* filename, unsigned int attributes, bool withTangents,
+                   bool useCache, int numThreads, MeshData& mesh) {
+    mesh.clear();
+
+    // entries of a .zip are known by the CRC and size on its directory,
+    // a cache hit does not even inflate them
+    bool zipped = isZipPath(filename);
+    ZipEntry entry;
+    obj::MappedFile file;
+    if (zipped ? !findZipEntry(filename, entry) : !file.open(filename)) {
+        return false;
+    }
+
+    unsigned long long sourceHash = 0;
+    std::string cachePath;
+
+    if (useCache) {
+        // the same file read with other attributes or with tangents is
+        // another mesh, with another file and hash
+        unsigned long long variant = attributes | (withTangents ? CACHE_WITH_TANGENTS : 0);
+        if (zipped) {
+            unsigned long long identity[2] = { entry.crc, entry.size };
+            sourceHash = hashBytes((const char*) identity, sizeof(identity)) ^ variant;
+        } else {
+            sourceHash = hashBytes(file.begin(), file.getSize()) ^ variant;
+        }
+        cachePath = getMeshCachePath(filename, attributes, withTangents);
+
+        if (readMeshCache(cachePath.c_str(), sourceHash, mesh)) {
+            loadMaterials(filename, mesh);
+            return true;
+        }
+    }
+
+    obj::ObjData data;
+    if (zipped) {
+        // inflated while it is parsed
+        if (!obj::readObjFile(filename, data, numThreads, attributes)) {
+            return false;
+        }
+    } else {
+        obj::parseObjFile(file, data, numThreads, attributes);
+        file.close();
+    }
+
+    weldObjData(data, attributes, mesh);
+    data = obj::ObjData();
+    sortByMaterial(mesh);
+    if (withTangents) {
+        computeTangents(mesh);
+    }
+    optimizeVertexCache(mesh);
+    optimizeVertexFetch(mesh);
+
+    if (useCache) {
+        writeMeshCache(cachePath.c_str(), sourceHash, mesh);
+    }
+
+    // a missing .mtl only leaves the default materials
+    loadMaterials(filename, mesh);
+    return true;
+}
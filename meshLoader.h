@@ -0,0 +1,141 @@
+/*
+ * meshLoader.h
+ *
+ * CPU side loading of meshes: parsing, welding, tangents and the mesh
+ * cache. Nothing here touches OpenGL or a Shape, so these functions can
+ * run on any thread.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _MESHLOADER_H
+#define _MESHLOADER_H
+
+#include "meshData.h"
+#include "objReader.h"
+
+/*
+ * weldObjData
+ *
+ * INPUT:
+ *         data - the raw contents of an .obj file.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL,
+ *                      the per vertex arrays mesh will have.
+ *         mesh - where the welded geometry is written.
+ *
+ * DESCRIPTION:
+ *         Creates the vertices (plus uvtextures and normals, if asked for)
+ *         and elements of mesh from the face corners of an .obj file. Every
+ *         distinct combination of the wanted indices becomes one vertex of
+ *         the mesh, repeated ones reuse the same index. Corners missing a
+ *         wanted attribute (e.g. "1//3" when textures are wanted) get zeros.
+ *         The submeshes of data become the submeshes of mesh.
+ *
+ *         With positions only the vertices of the file are used as they
+ *         are, nothing is welded, and they are moved out of data. Corners
+ *         whose "v" is 0 or past the last one get one more vertex at the
+ *         origin.
+ *
+ */
+void weldObjData(obj::ObjData& data, unsigned int attributes, MeshData& mesh);
+
+/*
+ * computeTangents
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices, uvtextures and elements.
+ *
+ * DESCRIPTION:
+ *         Calculates the tangent and bitangent of every vertex from the
+ *         positions and texture coordinates of the triangles around it.
+ *         They are needed for normal mapping.
+ *
+ */
+void computeTangents(MeshData& mesh);
+
+/*
+ * sortByMaterial
+ *
+ * INPUT:
+ *         mesh - a mesh with submeshes.
+ *
+ * DESCRIPTION:
+ *         Moves the triangles of mesh so the submeshes are sorted by
+ *         material, the ones with the same material keep the order they
+ *         had. Consecutive submeshes that end up with the same name and
+ *         material become one. Every material is then a single range of
+ *         elements, see getMaterialBatches.
+ *
+ */
+void sortByMaterial(MeshData& mesh);
+
+/*
+ * getMaterialBatches
+ *
+ * INPUT:
+ *         submeshes - the submeshes of a mesh.
+ *         batches - where the batches are written.
+ *
+ * DESCRIPTION:
+ *         Joins the consecutive submeshes with the same material, what is
+ *         left is one range (name -1) per material if the mesh was sorted
+ *         with sortByMaterial. Each batch is drawn with one glDrawElements
+ *         and its textures bound once.
+ *
+ */
+void getMaterialBatches(const std::vector<Submesh>& submeshes, std::vector<Submesh>& batches);
+
+/*
+ * loadMaterials
+ *
+ * INPUT:
+ *         filename - the mesh file, the .mtl files are relative to it.
+ *         mesh - a mesh whose materials only have their names.
+ *
+ * RETURN:
+ *         False if one of the .mtl files could not be read.
+ *
+ * DESCRIPTION:
+ *         Reads the .mtl files of mesh and fills its materials with the
+ *         values found there. The texture files are made relative to the
+ *         working directory. Materials that are on none of the files keep
+ *         the defaults of obj::ObjMaterial.
+ *
+ */
+bool loadMaterials(const char* filename, MeshData& mesh);
+
+/*
+ * loadWeldedObj
+ *
+ * INPUT:
+ *         filename - the .obj file, faces can use any pattern.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *         withTangents - true if the tangents and bitangents are also needed,
+ *                        it needs OBJ_TEXCOORD.
+ *         useCache - true to read and write the binary mesh cache.
+ *         numThreads - how many threads parse the file (0 means every core).
+ *         mesh - where the geometry is written.
+ *
+ * RETURN:
+ *         False if the file could not be read.
+ *
+ * DESCRIPTION:
+ *         Fills mesh with the welded contents of the .obj file. If useCache
+ *         is true and the cache file next to the .obj was made from the same
+ *         contents and attributes, the geometry comes from it. Otherwise the
+ *         file is parsed, welded, sorted by material, its triangles
+ *         reordered for the vertex cache and its vertices put in the order
+ *         the triangles use them, and the cache is written. The materials
+ *         are always read from their .mtl files.
+ *
+ *         filename can be an entry of a .zip archive (e.g.
+ *         "objects/teapot.zip/teapot.obj"), it is parsed while it is
+ *         inflated. Its .mtl files and textures are then looked for in the
+ *         same archive.
+ *
+ */
+bool loadWeldedObj(const char* filename, unsigned int attributes, bool withTangents,
+                   bool useCache, int numThreads, MeshData& mesh);
+
+#endif
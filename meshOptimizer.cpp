@@ -0,0 +1,950 @@
+/*
+ * meshOptimizer.cpp
+ *
+ * Passes that reorder the triangles of a mesh so the GPU draws it faster
+ * without changing how it looks, plus the CPU simulations that measure
+ * them. Nothing here touches OpenGL, so they can run on any thread.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "meshOptimizer.h"
+
+// C libraries
+#include <math.h>
+#include <float.h>
+
+// C++ libraries
+#include <vector>
+#include <algorithm>
+
+// The LRU cache the scores of optimizeVertexCache are made for, it is a
+// bit larger than the FIFO of computeAcmr on purpose (it works well for
+// every cache size up to it)
+static const int SCORE_CACHE_SIZE = 32;
+
+// The scoring of Forsyth's article: the vertices of the last triangle get
+// a fixed score (so the next triangle does not simply reuse the same
+// edge), the others less the older they are, and vertices with few
+// triangles left get a boost so they are finished and leave the cache
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+// Valences up to this get their boost from a table
+static const int MAX_TABLE_VALENCE = 64;
+
+// The side, in pixels, of the images computeOverdraw renders
+static const int OVERDRAW_IMAGE_SIZE = 256;
+
+// The views computeOverdraw renders from, looking at each side of the
+// bounding box: the axes (0 x, 1 y, 2 z) that go to the right and up on
+// the image, and the one that points to the camera with its sign. All of
+// them keep the winding of the triangles.
+static const int overdrawViews[6][4] = {
+    { 0, 1, 2,  1 }, { 1, 2, 0,  1 }, { 2, 0, 1,  1 },
+    { 1, 0, 2, -1 }, { 2, 1, 0, -1 }, { 0, 2, 1, -1 }
+};
+
+// The memory cache computeOverfetch simulates for the vertex fetch: lines
+// of 64 bytes and room for 64 of them (4 KB), in FIFO order
+static const size_t FETCH_LINE_SIZE = 64;
+static const size_t FETCH_CACHE_LINES = 64;
+
+/*
+ * computeAcmr
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *         cacheSize - the entries of the simulated cache.
+ *
+ * RETURN:
+ *         The ACMR (average cache miss ratio) of the triangles: how many
+ *         vertices the vertex shader runs per triangle with a FIFO cache
+ *         of cacheSize entries. 3 is the worst, about 0.5 the best a
+ *         regular grid can get, 0 if there are no triangles.
+ *
+ */
+float computeAcmr(const GLuint* elements, size_t numElements, GLuint numVertices, int cacheSize) {
+    size_t numTriangles = numElements / 3;
+    if (numTriangles == 0) {
+        return 0.0f;
+    }
+
+    // a vertex is in the FIFO if less than cacheSize vertices came in
+    // after it, so only the time it came in is kept
+    std::vector<size_t> insertedAt(numVertices, 0);
+    size_t clock = cacheSize + 1;
+    size_t misses = 0;
+
+    for (size_t i = 0; i < numTriangles * 3; ++i) {
+        GLuint vertex = elements[i];
+        if (clock - insertedAt[vertex] > (size_t) cacheSize) {
+            insertedAt[vertex] = clock++;
+            ++misses;
+        }
+    }
+    return (float) misses / numTriangles;
+}
+
+/*
+ * The scores of optimizeVertexCache, one table for the position in the
+ * cache and one for the valence (triangles not drawn yet).
+ */
+struct VertexScores {
+    float cache[SCORE_CACHE_SIZE];
+    float valence[MAX_TABLE_VALENCE + 1];
+
+    VertexScores () {
+        for (int i = 0; i < SCORE_CACHE_SIZE; ++i) {
+            if (i < 3) {
+                cache[i] = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+                cache[i] = powf(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        valence[0] = 0.0f;
+        for (int i = 1; i <= MAX_TABLE_VALENCE; ++i) {
+            valence[i] = VALENCE_BOOST_SCALE * powf((float) i, -VALENCE_BOOST_POWER);
+        }
+    }
+
+    // The score of a vertex at cachePosition (-1 if it is not in the
+    // cache) with liveTriangles left, -1 if it has none
+    float get (int cachePosition, GLuint liveTriangles) const {
+        if (liveTriangles == 0) {
+            return -1.0f;
+        }
+
+        float score = (cachePosition < 0) ? 0.0f : cache[cachePosition];
+        if (liveTriangles <= (GLuint) MAX_TABLE_VALENCE) {
+            score += valence[liveTriangles];
+        } else {
+            score += VALENCE_BOOST_SCALE * powf((float) liveTriangles, -VALENCE_BOOST_POWER);
+        }
+        return score;
+    }
+};
+
+static const VertexScores vertexScores;
+
+/*
+ * optimizeVertexCache
+ *
+ * INPUT:
+ *         elements - three elements per triangle, reordered in place.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *
+ * DESCRIPTION:
+ *         Changes the order of the triangles so the vertices they share
+ *         are still in the post-transform cache when they are used again
+ *         (Forsyth's linear speed vertex cache optimisation). Every
+ *         triangle keeps its corners and winding. It takes linear time.
+ *
+ */
+void optimizeVertexCache(GLuint* elements, size_t numElements, GLuint numVertices) {
+    size_t numTriangles = numElements / 3;
+    if (numTriangles < 2) {
+        return;
+    }
+
+    // the triangles of every vertex, the first liveTriangles[v] of them
+    // are the ones not drawn yet
+    std::vector<GLuint> liveTriangles(numVertices, 0);
+    for (size_t i = 0; i < numTriangles * 3; ++i) {
+        ++liveTriangles[elements[i]];
+    }
+
+    std::vector<size_t> firstTriangle(numVertices + 1);
+    firstTriangle[0] = 0;
+    for (GLuint v = 0; v < numVertices; ++v) {
+        firstTriangle[v + 1] = firstTriangle[v] + liveTriangles[v];
+    }
+
+    std::vector<GLuint> vertexTriangles(numTriangles * 3);
+    std::vector<size_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < numTriangles * 3; ++i) {
+        vertexTriangles[filled[elements[i]]++] = (GLuint) (i / 3);
+    }
+
+    std::vector<float> vertexScore(numVertices);
+    for (GLuint v = 0; v < numVertices; ++v) {
+        vertexScore[v] = vertexScores.get(-1, liveTriangles[v]);
+    }
+
+    // a triangle scores the sum of its vertices, the first one drawn is
+    // the best of all
+    std::vector<float> triangleScore(numTriangles);
+    std::vector<bool> drawn(numTriangles, false);
+    size_t best = 0;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < numTriangles; ++t) {
+        const GLuint* corners = elements + t * 3;
+        triangleScore[t] = vertexScore[corners[0]] + vertexScore[corners[1]] + vertexScore[corners[2]];
+        if (triangleScore[t] > bestScore) {
+            bestScore = triangleScore[t];
+            best = t;
+        }
+    }
+
+    std::vector<GLuint> output(numTriangles * 3);
+
+    // the simulated LRU cache, plus room for the 3 vertices that come in
+    GLuint cache[SCORE_CACHE_SIZE + 3];
+    GLuint newCache[SCORE_CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    // where the search for a triangle goes when none of the cache is left
+    size_t nextUndrawn = 0;
+
+    for (size_t emitted = 0; emitted < numTriangles; ++emitted) {
+        if (drawn[best]) {
+            while (drawn[nextUndrawn]) {
+                ++nextUndrawn;
+            }
+            best = nextUndrawn;
+        }
+
+        const GLuint* corners = elements + best * 3;
+        output[emitted * 3 + 0] = corners[0];
+        output[emitted * 3 + 1] = corners[1];
+        output[emitted * 3 + 2] = corners[2];
+        drawn[best] = true;
+
+        // take the triangle out of the live ones of its vertices
+        int newCount = 0;
+        for (int c = 0; c < 3; ++c) {
+            GLuint vertex = corners[c];
+            GLuint* triangles = &vertexTriangles[firstTriangle[vertex]];
+            GLuint live = liveTriangles[vertex];
+            for (GLuint i = 0; i < live; ++i) {
+                if (triangles[i] == best) {
+                    triangles[i] = triangles[live - 1];
+                    triangles[live - 1] = (GLuint) best;
+                    break;
+                }
+            }
+            --liveTriangles[vertex];
+
+            // a degenerate triangle has a vertex twice
+            bool repeated = false;
+            for (int i = 0; i < newCount; ++i) {
+                repeated = repeated || (newCache[i] == vertex);
+            }
+            if (!repeated) {
+                newCache[newCount++] = vertex;
+            }
+        }
+
+        // the vertices of the triangle go to the front of the cache
+        int triangleVertices = newCount;
+        for (int i = 0; i < cacheCount; ++i) {
+            GLuint vertex = cache[i];
+            bool inTriangle = false;
+            for (int j = 0; j < triangleVertices; ++j) {
+                inTriangle = inTriangle || (newCache[j] == vertex);
+            }
+            if (!inTriangle) {
+                newCache[newCount++] = vertex;
+            }
+        }
+
+        // only the vertices in the cache (and the ones pushed out of it,
+        // now scored as not in it) changed score, their triangles get the
+        // difference
+        for (int i = 0; i < newCount; ++i) {
+            GLuint vertex = newCache[i];
+            float score = vertexScores.get((i < SCORE_CACHE_SIZE) ? i : -1, liveTriangles[vertex]);
+            float change = score - vertexScore[vertex];
+            vertexScore[vertex] = score;
+
+            const GLuint* triangles = &vertexTriangles[firstTriangle[vertex]];
+            for (GLuint j = 0; j < liveTriangles[vertex]; ++j) {
+                triangleScore[triangles[j]] += change;
+            }
+        }
+
+        // the best of those triangles is the next one
+        bestScore = -1.0f;
+        for (int i = 0; i < newCount; ++i) {
+            GLuint vertex = newCache[i];
+            const GLuint* triangles = &vertexTriangles[firstTriangle[vertex]];
+            for (GLuint j = 0; j < liveTriangles[vertex]; ++j) {
+                GLuint t = triangles[j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = (newCount < SCORE_CACHE_SIZE) ? newCount : SCORE_CACHE_SIZE;
+        for (int i = 0; i < cacheCount; ++i) {
+            cache[i] = newCache[i];
+        }
+    }
+
+    for (size_t i = 0; i < numTriangles * 3; ++i) {
+        elements[i] = output[i];
+    }
+}
+
+/*
+ * getElementRanges
+ *
+ * INPUT:
+ *         mesh - a mesh with elements.
+ *         ranges - where the ranges are written.
+ *
+ * DESCRIPTION:
+ *         The ranges of elements the passes work on: the submeshes of the
+ *         mesh, or all the elements if it is only one piece.
+ *
+ */
+void getElementRanges(const MeshData& mesh, std::vector<Submesh>& ranges) {
+    ranges = mesh.submeshes;
+    if (ranges.empty()) {
+        Submesh all;
+        all.firstElement = 0;
+        all.numElements = (GLuint) mesh.elements.size();
+        all.name = -1;
+        all.material = -1;
+        ranges.push_back(all);
+    }
+}
+
+/*
+ * hasValidElements
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements.
+ *
+ * RETURN:
+ *         True if every element is a vertex of the mesh, the passes use
+ *         the elements as indices of the vertex arrays.
+ *
+ */
+bool hasValidElements(const MeshData& mesh) {
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    for (size_t i = 0; i < mesh.elements.size(); ++i) {
+        if (mesh.elements[i] >= numVertices) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * localizeRange
+ *
+ * INPUT:
+ *         range - the elements of a range of a mesh.
+ *         count - how many elements it has.
+ *         localIndex - NO_VERTEX for every vertex of the mesh, it is left
+ *                      that way.
+ *         meshIndex - where the vertex of the mesh of every local vertex
+ *                     is written.
+ *         local - where the elements are written with the local vertices.
+ *
+ * RETURN:
+ *         How many vertices the range uses.
+ *
+ * DESCRIPTION:
+ *         Numbers the vertices of a range from 0, in the order they are
+ *         used, so a pass over the range does not depend on the size of
+ *         the whole mesh.
+ *
+ */
+GLuint localizeRange(const GLuint* range, size_t count, std::vector<GLuint>& localIndex,
+                     std::vector<GLuint>& meshIndex, std::vector<GLuint>& local) {
+    meshIndex.clear();
+    local.resize(count);
+    for (size_t j = 0; j < count; ++j) {
+        if (localIndex[range[j]] == NO_VERTEX) {
+            localIndex[range[j]] = (GLuint) meshIndex.size();
+            meshIndex.push_back(range[j]);
+        }
+        local[j] = localIndex[range[j]];
+    }
+    for (size_t j = 0; j < meshIndex.size(); ++j) {
+        localIndex[meshIndex[j]] = NO_VERTEX;
+    }
+    return (GLuint) meshIndex.size();
+}
+
+/*
+ * optimizeVertexCache
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements.
+ *
+ * RETURN:
+ *         The ACMR of the mesh before and after.
+ *
+ * DESCRIPTION:
+ *         Optimizes every submesh on its own, so the triangles never move
+ *         from one submesh to another. A submesh whose triangles are
+ *         already in a better order than the one found (e.g. the strips of
+ *         a tessellated patch) keeps its order, so the ACMR never goes up.
+ *         A mesh with an element past its last vertex is left alone and
+ *         both ACMRs are 0.
+ *
+ */
+VertexCacheStats optimizeVertexCache(MeshData& mesh) {
+    VertexCacheStats stats;
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    if (mesh.elements.empty() || !hasValidElements(mesh)) {
+        stats.acmrBefore = 0.0f;
+        stats.acmrAfter = 0.0f;
+        return stats;
+    }
+
+    GLuint* elements = &mesh.elements[0];
+    stats.acmrBefore = computeAcmr(elements, mesh.elements.size(), numVertices);
+
+    std::vector<Submesh> ranges;
+    getElementRanges(mesh, ranges);
+
+    // each range is optimized with its vertices numbered from 0, so the
+    // work is the size of the range and not of the whole mesh
+    std::vector<GLuint> localIndex(numVertices, NO_VERTEX);
+    std::vector<GLuint> meshIndex;
+    std::vector<GLuint> local;
+    std::vector<GLuint> original;
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        GLuint* range = elements + ranges[i].firstElement;
+        size_t count = ranges[i].numElements;
+        if (count < 6) {
+            continue;
+        }
+
+        GLuint rangeVertices = localizeRange(range, count, localIndex, meshIndex, local);
+        original = local;
+        optimizeVertexCache(&local[0], count, rangeVertices);
+        if (computeAcmr(&local[0], count, rangeVertices) >=
+            computeAcmr(&original[0], count, rangeVertices)) {
+            continue;
+        }
+
+        for (size_t j = 0; j < count; ++j) {
+            range[j] = meshIndex[local[j]];
+        }
+    }
+
+    stats.acmrAfter = computeAcmr(elements, mesh.elements.size(), numVertices);
+    return stats;
+}
+
+/*
+ * computeOverfetch
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *         vertexSize - the bytes of a vertex in the vertex buffer.
+ *
+ * RETURN:
+ *         How many bytes of the vertex buffer are read from memory per
+ *         byte it has when the triangles are drawn: 1 if every vertex is
+ *         read once, more if the vertices the shader runs for are spread
+ *         over the buffer and their cache lines are read again. 0 if there
+ *         are no triangles.
+ *
+ */
+float computeOverfetch(const GLuint* elements, size_t numElements, GLuint numVertices,
+                       size_t vertexSize) {
+    size_t bufferSize = (size_t) numVertices * vertexSize;
+    if (numElements < 3 || bufferSize == 0) {
+        return 0.0f;
+    }
+
+    // the same clocks as computeAcmr, one for the post-transform cache
+    // (only its misses are fetched) and one for the lines of memory
+    std::vector<size_t> vertexInsertedAt(numVertices, 0);
+    std::vector<size_t> lineInsertedAt((bufferSize + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE, 0);
+    size_t vertexClock = VERTEX_CACHE_SIZE + 1;
+    size_t lineClock = FETCH_CACHE_LINES + 1;
+    size_t fetched = 0;
+
+    for (size_t i = 0; i < numElements / 3 * 3; ++i) {
+        GLuint vertex = elements[i];
+        if (vertexClock - vertexInsertedAt[vertex] <= (size_t) VERTEX_CACHE_SIZE) {
+            continue;
+        }
+        vertexInsertedAt[vertex] = vertexClock++;
+
+        size_t firstLine = vertex * vertexSize / FETCH_LINE_SIZE;
+        size_t lastLine = ((vertex + 1) * vertexSize - 1) / FETCH_LINE_SIZE;
+        for (size_t line = firstLine; line <= lastLine; ++line) {
+            if (lineClock - lineInsertedAt[line] > FETCH_CACHE_LINES) {
+                lineInsertedAt[line] = lineClock++;
+                fetched += FETCH_LINE_SIZE;
+            }
+        }
+    }
+    return (float) ((double) fetched / bufferSize);
+}
+
+/*
+ * buildVertexFetchRemap
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *         remap - where the new index of every vertex is written.
+ *
+ * DESCRIPTION:
+ *         Numbers the vertices in the order the elements use them first,
+ *         so drawing the triangles walks the vertex buffer forward. The
+ *         vertices no element uses go last, in the order they had.
+ *
+ */
+void buildVertexFetchRemap(const GLuint* elements, size_t numElements, GLuint numVertices,
+                           std::vector<GLuint>& remap) {
+    remap.assign(numVertices, NO_VERTEX);
+    GLuint next = 0;
+
+    for (size_t i = 0; i < numElements; ++i) {
+        if (remap[elements[i]] == NO_VERTEX) {
+            remap[elements[i]] = next++;
+        }
+    }
+    for (GLuint v = 0; v < numVertices; ++v) {
+        if (remap[v] == NO_VERTEX) {
+            remap[v] = next++;
+        }
+    }
+}
+
+/*
+ * remapVertexArray
+ *
+ * INPUT:
+ *         values - a per vertex array, moved to the new order in place.
+ *         components - the floats of each vertex.
+ *         remap - the new index of every vertex.
+ *
+ * DESCRIPTION:
+ *         Moves the values of every vertex to its new index. An array that
+ *         does not have one entry per vertex of remap is left alone.
+ *
+ */
+void remapVertexArray(std::vector<float>& values, int components, const std::vector<GLuint>& remap) {
+    if (values.size() != remap.size() * components) {
+        return;
+    }
+
+    std::vector<float> moved(values.size());
+    for (size_t v = 0; v < remap.size(); ++v) {
+        const float* source = &values[v * components];
+        float* destination = &moved[(size_t) remap[v] * components];
+        for (int c = 0; c < components; ++c) {
+            destination[c] = source[c];
+        }
+    }
+    values.swap(moved);
+}
+
+/*
+ * optimizeVertexFetch
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements.
+ *
+ * RETURN:
+ *         The overfetch of the mesh (see computeOverfetch) before and
+ *         after, for a vertex with all the attributes the mesh has.
+ *
+ * DESCRIPTION:
+ *         Moves the vertices and every attribute of them to the order the
+ *         elements use them first, and rewrites the elements to match.
+ *         The triangles and the submeshes do not change, so it goes after
+ *         optimizeVertexCache. The mesh is left alone if the new order
+ *         would not read less of the vertex buffer, or if an element is
+ *         past its last vertex (both overfetches are then 0).
+ *
+ */
+VertexFetchStats optimizeVertexFetch(MeshData& mesh) {
+    VertexFetchStats stats;
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    if (mesh.elements.empty() || !hasValidElements(mesh)) {
+        stats.overfetchBefore = 0.0f;
+        stats.overfetchAfter = 0.0f;
+        return stats;
+    }
+
+    size_t vertexSize = (mesh.vertices.size() + mesh.normals.size() + mesh.uvtextures.size() +
+                         mesh.tangents.size() + mesh.bitangents.size()) / numVertices * sizeof(float);
+    GLuint* elements = &mesh.elements[0];
+    size_t numElements = mesh.elements.size();
+    stats.overfetchBefore = computeOverfetch(elements, numElements, numVertices, vertexSize);
+
+    std::vector<GLuint> remap;
+    buildVertexFetchRemap(elements, numElements, numVertices, remap);
+
+    std::vector<GLuint> remapped(numElements);
+    for (size_t i = 0; i < numElements; ++i) {
+        remapped[i] = remap[elements[i]];
+    }
+
+    // vertices written in an order close to the one they are used (e.g.
+    // the rows of a grid) can already be read with less overfetch
+    stats.overfetchAfter = computeOverfetch(&remapped[0], numElements, numVertices, vertexSize);
+    if (stats.overfetchAfter >= stats.overfetchBefore) {
+        stats.overfetchAfter = stats.overfetchBefore;
+        return stats;
+    }
+
+    remapVertexArray(mesh.vertices, 3, remap);
+    remapVertexArray(mesh.normals, 3, remap);
+    remapVertexArray(mesh.uvtextures, 2, remap);
+    remapVertexArray(mesh.tangents, 3, remap);
+    remapVertexArray(mesh.bitangents, 3, remap);
+    mesh.elements.swap(remapped);
+    return stats;
+}
+
+/*
+ * computeOverdraw
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *
+ * RETURN:
+ *         How many times the fragment shader runs per pixel the mesh
+ *         covers, 1 if no pixel is shaded twice. The triangles are drawn
+ *         in order with back face culling and a depth test on the CPU,
+ *         from the six sides of the bounding box. 0 if nothing is drawn.
+ *
+ */
+float computeOverdraw(const GLuint* elements, size_t numElements, const float* vertices,
+                      GLuint numVertices) {
+    size_t numTriangles = numElements / 3;
+    if (numTriangles == 0 || numVertices == 0) {
+        return 0.0f;
+    }
+
+    std::vector<float> depth(OVERDRAW_IMAGE_SIZE * OVERDRAW_IMAGE_SIZE);
+    size_t shaded = 0;
+    size_t covered = 0;
+
+    for (int view = 0; view < 6; ++view) {
+        int right = overdrawViews[view][0];
+        int up = overdrawViews[view][1];
+        int toCamera = overdrawViews[view][2];
+        float sign = (float) overdrawViews[view][3];
+
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (GLuint v = 0; v < numVertices; ++v) {
+            minX = std::min(minX, vertices[v * 3 + right]);
+            maxX = std::max(maxX, vertices[v * 3 + right]);
+            minY = std::min(minY, vertices[v * 3 + up]);
+            maxY = std::max(maxY, vertices[v * 3 + up]);
+        }
+        float extent = std::max(maxX - minX, maxY - minY);
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float scale = OVERDRAW_IMAGE_SIZE * 0.999f / extent;
+
+        std::fill(depth.begin(), depth.end(), -FLT_MAX);
+
+        for (size_t t = 0; t < numTriangles; ++t) {
+            float x[3], y[3], z[3];
+            for (int c = 0; c < 3; ++c) {
+                const float* vertex = vertices + elements[t * 3 + c] * 3;
+                x[c] = (vertex[right] - minX) * scale;
+                y[c] = (vertex[up] - minY) * scale;
+                z[c] = vertex[toCamera] * sign;
+            }
+
+            // twice the area, negative for the triangles facing away
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (area <= 0.0f) {
+                continue;
+            }
+
+            int firstX = (int) std::min(std::min(x[0], x[1]), x[2]);
+            int lastX = std::min((int) std::max(std::max(x[0], x[1]), x[2]), OVERDRAW_IMAGE_SIZE - 1);
+            int firstY = (int) std::min(std::min(y[0], y[1]), y[2]);
+            int lastY = std::min((int) std::max(std::max(y[0], y[1]), y[2]), OVERDRAW_IMAGE_SIZE - 1);
+
+            for (int py = firstY; py <= lastY; ++py) {
+                float centerY = py + 0.5f;
+                for (int px = firstX; px <= lastX; ++px) {
+                    float centerX = px + 0.5f;
+
+                    // the pixel center is inside if it is on the left of
+                    // every edge, the weights also interpolate the depth
+                    float w0 = (x[2] - x[1]) * (centerY - y[1]) - (y[2] - y[1]) * (centerX - x[1]);
+                    float w1 = (x[0] - x[2]) * (centerY - y[2]) - (y[0] - y[2]) * (centerX - x[2]);
+                    float w2 = (x[1] - x[0]) * (centerY - y[0]) - (y[1] - y[0]) * (centerX - x[0]);
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                        continue;
+                    }
+
+                    float fragment = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+                    float& stored = depth[py * OVERDRAW_IMAGE_SIZE + px];
+                    if (fragment > stored) {
+                        if (stored == -FLT_MAX) {
+                            ++covered;
+                        }
+                        stored = fragment;
+                        ++shaded;
+                    }
+                }
+            }
+        }
+    }
+
+    return (covered == 0) ? 0.0f : (float) shaded / covered;
+}
+
+/*
+ * Orders clusters by their sort key, the largest first.
+ */
+struct ClusterOrder {
+    const std::vector<float>& keys;
+
+    ClusterOrder (const std::vector<float>& clusterKeys) : keys(clusterKeys) {}
+
+    bool operator() (size_t a, size_t b) const {
+        return keys[a] > keys[b];
+    }
+};
+
+/*
+ * optimizeOverdraw
+ *
+ * INPUT:
+ *         elements - three elements per triangle, in the order of
+ *                    optimizeVertexCache, reordered in place.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *         threshold - how much the ACMR may grow, 1.05 lets it grow about
+ *                     5%. The larger, the smaller the clusters and the
+ *                     better they are sorted.
+ *
+ * DESCRIPTION:
+ *         Splits the triangles in clusters where the vertex cache starts
+ *         over anyway (all the vertices of a triangle miss), and more
+ *         where the ACMR of a cluster so far is within threshold of the
+ *         whole cluster. Then the clusters that face away from the center
+ *         of the mesh, the ones that are in front of the others from most
+ *         directions, are drawn first (Sander et al., Fast Triangle
+ *         Reordering for Vertex Locality and Reduced Overdraw), so the
+ *         depth test rejects more of the fragments behind them.
+ *
+ */
+void optimizeOverdraw(GLuint* elements, size_t numElements, const float* vertices,
+                      GLuint numVertices, float threshold) {
+    size_t numTriangles = numElements / 3;
+    if (numTriangles < 2) {
+        return;
+    }
+
+    // the triangles where the cache starts over
+    std::vector<size_t> hardStarts;
+    std::vector<size_t> insertedAt(numVertices, 0);
+    size_t clock = VERTEX_CACHE_SIZE + 1;
+    std::vector<unsigned char> misses(numTriangles);
+
+    for (size_t t = 0; t < numTriangles; ++t) {
+        misses[t] = 0;
+        for (int c = 0; c < 3; ++c) {
+            GLuint vertex = elements[t * 3 + c];
+            if (clock - insertedAt[vertex] > (size_t) VERTEX_CACHE_SIZE) {
+                insertedAt[vertex] = clock++;
+                ++misses[t];
+            }
+        }
+        if (t == 0 || misses[t] == 3) {
+            hardStarts.push_back(t);
+        }
+    }
+    hardStarts.push_back(numTriangles);
+
+    // every cluster is split again where the part so far has an ACMR
+    // within threshold of the whole, the cache starts empty on each part
+    std::vector<size_t> starts;
+    for (size_t h = 0; h + 1 < hardStarts.size(); ++h) {
+        size_t first = hardStarts[h];
+        size_t end = hardStarts[h + 1];
+
+        size_t clusterMisses = 0;
+        for (size_t t = first; t < end; ++t) {
+            clusterMisses += misses[t];
+        }
+        float limit = threshold * clusterMisses / (end - first);
+
+        starts.push_back(first);
+        clock += VERTEX_CACHE_SIZE + 1;
+        size_t partStart = first;
+        size_t partMisses = 0;
+        for (size_t t = first; t < end; ++t) {
+            for (int c = 0; c < 3; ++c) {
+                GLuint vertex = elements[t * 3 + c];
+                if (clock - insertedAt[vertex] > (size_t) VERTEX_CACHE_SIZE) {
+                    insertedAt[vertex] = clock++;
+                    ++partMisses;
+                }
+            }
+
+            if (t + 1 < end && (float) partMisses / (t + 1 - partStart) <= limit) {
+                starts.push_back(t + 1);
+                clock += VERTEX_CACHE_SIZE + 1;
+                partStart = t + 1;
+                partMisses = 0;
+            }
+        }
+    }
+    size_t numClusters = starts.size();
+    starts.push_back(numTriangles);
+
+    // the center of the mesh and, for every cluster, its center and
+    // normal, all weighted by the area of the triangles
+    std::vector<float> clusterData(numClusters * 6, 0.0f);
+    std::vector<float> clusterArea(numClusters, 0.0f);
+    float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+
+    for (size_t k = 0; k < numClusters; ++k) {
+        float* center = &clusterData[k * 6];
+        float* normal = center + 3;
+        for (size_t t = starts[k]; t < starts[k + 1]; ++t) {
+            const float* a = vertices + elements[t * 3 + 0] * 3;
+            const float* b = vertices + elements[t * 3 + 1] * 3;
+            const float* c = vertices + elements[t * 3 + 2] * 3;
+
+            float n[3];
+            n[0] = (b[1] - a[1]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[1] - a[1]);
+            n[1] = (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]);
+            n[2] = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int i = 0; i < 3; ++i) {
+                float centroid = (a[i] + b[i] + c[i]) / 3.0f;
+                center[i] += centroid * area;
+                normal[i] += n[i];
+                meshCenter[i] += centroid * area;
+            }
+            clusterArea[k] += area;
+            meshArea += area;
+        }
+    }
+    if (meshArea > 0.0f) {
+        for (int i = 0; i < 3; ++i) {
+            meshCenter[i] /= meshArea;
+        }
+    }
+
+    std::vector<float> keys(numClusters, 0.0f);
+    std::vector<size_t> order(numClusters);
+    for (size_t k = 0; k < numClusters; ++k) {
+        order[k] = k;
+
+        const float* center = &clusterData[k * 6];
+        const float* normal = center + 3;
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (clusterArea[k] <= 0.0f || length <= 0.0f) {
+            continue;
+        }
+        for (int i = 0; i < 3; ++i) {
+            keys[k] += (center[i] / clusterArea[k] - meshCenter[i]) * normal[i] / length;
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), ClusterOrder(keys));
+
+    std::vector<GLuint> output;
+    output.reserve(numTriangles * 3);
+    for (size_t k = 0; k < numClusters; ++k) {
+        output.insert(output.end(), elements + starts[order[k]] * 3, elements + starts[order[k] + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), elements);
+}
+
+/*
+ * optimizeOverdraw
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements, in the order of
+ *                optimizeVertexCache.
+ *         threshold - how much the ACMR may grow, see the function above.
+ *
+ * RETURN:
+ *         The overdraw and the ACMR of the mesh before and after.
+ *
+ * DESCRIPTION:
+ *         Sorts the clusters of every submesh on its own. A submesh whose
+ *         overdraw would not go down keeps its order. The vertices do not
+ *         move, so optimizeVertexFetch goes after it.
+ *
+ */
+OverdrawStats optimizeOverdraw(MeshData& mesh, float threshold) {
+    OverdrawStats stats;
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    if (mesh.elements.empty()) {
+        stats.overdrawBefore = stats.overdrawAfter = 0.0f;
+        stats.acmrBefore = stats.acmrAfter = 0.0f;
+        return stats;
+    }
+
+    GLuint* elements = &mesh.elements[0];
+    size_t numElements = mesh.elements.size();
+    stats.overdrawBefore = computeOverdraw(elements, numElements, &mesh.vertices[0], numVertices);
+    stats.acmrBefore = computeAcmr(elements, numElements, numVertices);
+
+    std::vector<Submesh> ranges;
+    getElementRanges(mesh, ranges);
+
+    std::vector<GLuint> localIndex(numVertices, NO_VERTEX);
+    std::vector<GLuint> meshIndex;
+    std::vector<GLuint> local;
+    std::vector<GLuint> original;
+    std::vector<float> positions;
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        GLuint* range = elements + ranges[i].firstElement;
+        size_t count = ranges[i].numElements;
+        if (count < 6) {
+            continue;
+        }
+
+        GLuint rangeVertices = localizeRange(range, count, localIndex, meshIndex, local);
+        positions.resize(rangeVertices * 3);
+        for (GLuint v = 0; v < rangeVertices; ++v) {
+            for (int c = 0; c < 3; ++c) {
+                positions[v * 3 + c] = mesh.vertices[meshIndex[v] * 3 + c];
+            }
+        }
+
+        original = local;
+        optimizeOverdraw(&local[0], count, &positions[0], rangeVertices, threshold);
+        if (computeOverdraw(&local[0], count, &positions[0], rangeVertices) >=
+            computeOverdraw(&original[0], count, &positions[0], rangeVertices)) {
+            continue;
+        }
+
+        for (size_t j = 0; j < count; ++j) {
+            range[j] = meshIndex[local[j]];
+        }
+    }
+
+    stats.overdrawAfter = computeOverdraw(elements, numElements, &mesh.vertices[0], numVertices);
+    stats.acmrAfter = computeAcmr(elements, numElements, numVertices);
+    return stats;
+}
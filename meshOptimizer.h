@@ -0,0 +1,311 @@
+/*
+ * meshOptimizer.h
+ *
+ * Passes that reorder the triangles of a mesh so the GPU draws it faster
+ * without changing how it looks, plus the CPU simulations that measure
+ * them. Nothing here touches OpenGL, so they can run on any thread.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _MESHOPTIMIZER_H
+#define _MESHOPTIMIZER_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "meshData.h"
+
+// Entries of the FIFO post-transform cache computeAcmr simulates, about
+// what the GPUs we draw on keep
+#define VERTEX_CACHE_SIZE  16
+
+// How much optimizeOverdraw lets the ACMR grow by default
+#define OVERDRAW_THRESHOLD  1.05f
+
+// A vertex that has no new index yet
+#define NO_VERTEX  0xFFFFFFFFu
+
+/*
+ * The average cache miss ratio of a mesh before and after a pass.
+ */
+struct VertexCacheStats {
+    float acmrBefore;
+    float acmrAfter;
+};
+
+/*
+ * The bytes read from the vertex buffer per byte it has, before and after
+ * a pass.
+ */
+struct VertexFetchStats {
+    float overfetchBefore;
+    float overfetchAfter;
+};
+
+/*
+ * The overdraw and the ACMR of a mesh before and after a pass.
+ */
+struct OverdrawStats {
+    float overdrawBefore;
+    float overdrawAfter;
+    float acmrBefore;
+    float acmrAfter;
+};
+
+/*
+ * computeAcmr
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *         cacheSize - the entries of the simulated cache.
+ *
+ * RETURN:
+ *         The ACMR (average cache miss ratio) of the triangles: how many
+ *         vertices the vertex shader runs per triangle with a FIFO cache
+ *         of cacheSize entries. 3 is the worst, about 0.5 the best a
+ *         regular grid can get, 0 if there are no triangles.
+ *
+ */
+float computeAcmr(const GLuint* elements, size_t numElements, GLuint numVertices,
+                  int cacheSize = VERTEX_CACHE_SIZE);
+
+/*
+ * optimizeVertexCache
+ *
+ * INPUT:
+ *         elements - three elements per triangle, reordered in place.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *
+ * DESCRIPTION:
+ *         Changes the order of the triangles so the vertices they share
+ *         are still in the post-transform cache when they are used again
+ *         (Forsyth's linear speed vertex cache optimisation). Every
+ *         triangle keeps its corners and winding. It takes linear time.
+ *
+ */
+void optimizeVertexCache(GLuint* elements, size_t numElements, GLuint numVertices);
+
+/*
+ * getElementRanges
+ *
+ * INPUT:
+ *         mesh - a mesh with elements.
+ *         ranges - where the ranges are written.
+ *
+ * DESCRIPTION:
+ *         The ranges of elements the passes work on: the submeshes of the
+ *         mesh, or all the elements if it is only one piece.
+ *
+ */
+void getElementRanges(const MeshData& mesh, std::vector<Submesh>& ranges);
+
+/*
+ * hasValidElements
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements.
+ *
+ * RETURN:
+ *         True if every element is a vertex of the mesh, the passes use
+ *         the elements as indices of the vertex arrays.
+ *
+ */
+bool hasValidElements(const MeshData& mesh);
+
+/*
+ * localizeRange
+ *
+ * INPUT:
+ *         range - the elements of a range of a mesh.
+ *         count - how many elements it has.
+ *         localIndex - NO_VERTEX for every vertex of the mesh, it is left
+ *                      that way.
+ *         meshIndex - where the vertex of the mesh of every local vertex
+ *                     is written.
+ *         local - where the elements are written with the local vertices.
+ *
+ * RETURN:
+ *         How many vertices the range uses.
+ *
+ * DESCRIPTION:
+ *         Numbers the vertices of a range from 0, in the order they are
+ *         used, so a pass over the range does not depend on the size of
+ *         the whole mesh.
+ *
+ */
+GLuint localizeRange(const GLuint* range, size_t count, std::vector<GLuint>& localIndex,
+                     std::vector<GLuint>& meshIndex, std::vector<GLuint>& local);
+
+/*
+ * optimizeVertexCache
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements.
+ *
+ * RETURN:
+ *         The ACMR of the mesh before and after.
+ *
+ * DESCRIPTION:
+ *         Optimizes every submesh on its own, so the triangles never move
+ *         from one submesh to another. A submesh whose triangles are
+ *         already in a better order than the one found (e.g. the strips of
+ *         a tessellated patch) keeps its order, so the ACMR never goes up.
+ *         A mesh with an element past its last vertex is left alone and
+ *         both ACMRs are 0.
+ *
+ */
+VertexCacheStats optimizeVertexCache(MeshData& mesh);
+
+/*
+ * computeOverfetch
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *         vertexSize - the bytes of a vertex in the vertex buffer.
+ *
+ * RETURN:
+ *         How many bytes of the vertex buffer are read from memory per
+ *         byte it has when the triangles are drawn: 1 if every vertex is
+ *         read once, more if the vertices the shader runs for are spread
+ *         over the buffer and their cache lines are read again. 0 if there
+ *         are no triangles.
+ *
+ */
+float computeOverfetch(const GLuint* elements, size_t numElements, GLuint numVertices,
+                       size_t vertexSize);
+
+/*
+ * buildVertexFetchRemap
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         numVertices - one more than the largest element.
+ *         remap - where the new index of every vertex is written.
+ *
+ * DESCRIPTION:
+ *         Numbers the vertices in the order the elements use them first,
+ *         so drawing the triangles walks the vertex buffer forward. The
+ *         vertices no element uses go last, in the order they had.
+ *
+ */
+void buildVertexFetchRemap(const GLuint* elements, size_t numElements, GLuint numVertices,
+                           std::vector<GLuint>& remap);
+
+/*
+ * remapVertexArray
+ *
+ * INPUT:
+ *         values - a per vertex array, moved to the new order in place.
+ *         components - the floats of each vertex.
+ *         remap - the new index of every vertex.
+ *
+ * DESCRIPTION:
+ *         Moves the values of every vertex to its new index. An array that
+ *         does not have one entry per vertex of remap is left alone.
+ *
+ */
+void remapVertexArray(std::vector<float>& values, int components, const std::vector<GLuint>& remap);
+
+/*
+ * optimizeVertexFetch
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements.
+ *
+ * RETURN:
+ *         The overfetch of the mesh (see computeOverfetch) before and
+ *         after, for a vertex with all the attributes the mesh has.
+ *
+ * DESCRIPTION:
+ *         Moves the vertices and every attribute of them to the order the
+ *         elements use them first, and rewrites the elements to match.
+ *         The triangles and the submeshes do not change, so it goes after
+ *         optimizeVertexCache. The mesh is left alone if the new order
+ *         would not read less of the vertex buffer, or if an element is
+ *         past its last vertex (both overfetches are then 0).
+ *
+ */
+VertexFetchStats optimizeVertexFetch(MeshData& mesh);
+
+/*
+ * computeOverdraw
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *
+ * RETURN:
+ *         How many times the fragment shader runs per pixel the mesh
+ *         covers, 1 if no pixel is shaded twice. The triangles are drawn
+ *         in order with back face culling and a depth test on the CPU,
+ *         from the six sides of the bounding box. 0 if nothing is drawn.
+ *
+ */
+float computeOverdraw(const GLuint* elements, size_t numElements, const float* vertices,
+                      GLuint numVertices);
+
+/*
+ * optimizeOverdraw
+ *
+ * INPUT:
+ *         elements - three elements per triangle, in the order of
+ *                    optimizeVertexCache, reordered in place.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *         threshold - how much the ACMR may grow, 1.05 lets it grow about
+ *                     5%. The larger, the smaller the clusters and the
+ *                     better they are sorted.
+ *
+ * DESCRIPTION:
+ *         Splits the triangles in clusters where the vertex cache starts
+ *         over anyway (all the vertices of a triangle miss), and more
+ *         where the ACMR of a cluster so far is within threshold of the
+ *         whole cluster. Then the clusters that face away from the center
+ *         of the mesh, the ones that are in front of the others from most
+ *         directions, are drawn first (Sander et al., Fast Triangle
+ *         Reordering for Vertex Locality and Reduced Overdraw), so the
+ *         depth test rejects more of the fragments behind them.
+ *
+ */
+void optimizeOverdraw(GLuint* elements, size_t numElements, const float* vertices,
+                      GLuint numVertices, float threshold = OVERDRAW_THRESHOLD);
+
+/*
+ * optimizeOverdraw
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements, in the order of
+ *                optimizeVertexCache.
+ *         threshold - how much the ACMR may grow, see the function above.
+ *
+ * RETURN:
+ *         The overdraw and the ACMR of the mesh before and after.
+ *
+ * DESCRIPTION:
+ *         Sorts the clusters of every submesh on its own. A submesh whose
+ *         overdraw would not go down keeps its order. The vertices do not
+ *         move, so optimizeVertexFetch goes after it.
+ *
+ */
+OverdrawStats optimizeOverdraw(MeshData& mesh, float threshold = OVERDRAW_THRESHOLD);
+
+#endif
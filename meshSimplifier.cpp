@@ -0,0 +1,657 @@
+/*
+ * meshSimplifier.cpp
+ *
+ * Quadric error simplification of meshes and the levels of detail made
+ * with it. The levels only have elements, they use the vertices of the
+ * full mesh, so a shape keeps one vertex buffer for all of them.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "meshSimplifier.h"
+
+// C libraries
+#include <math.h>
+
+// C++ libraries
+#include <vector>
+#include <algorithm>
+
+#include "meshOptimizer.h"
+
+// How much more a border or a seam resists moving away from itself than
+// the surface around it
+static const double BORDER_WEIGHT = 10.0;
+
+// A collapse is not made if it turns a triangle so much that the cosine
+// between its normals before and after is below this (about 75 degrees)
+static const double FLIP_LIMIT = 0.25;
+
+/*
+ * A quadric: the sum of the squared distances to a set of planes, each one
+ * with a weight. weight is the sum of the weights, so the error divided by
+ * it is a squared distance.
+ */
+struct Quadric {
+    double xx, xy, xz, yy, yz, zz;
+    double x, y, z, c;
+    double weight;
+
+    Quadric () : xx(0), xy(0), xz(0), yy(0), yz(0), zz(0), x(0), y(0), z(0), c(0), weight(0) {}
+
+    // Adds the plane n . p + d = 0, n of length 1
+    void addPlane (const double n[3], double d, double w) {
+        xx += w * n[0] * n[0];
+        xy += w * n[0] * n[1];
+        xz += w * n[0] * n[2];
+        yy += w * n[1] * n[1];
+        yz += w * n[1] * n[2];
+        zz += w * n[2] * n[2];
+        x += w * n[0] * d;
+        y += w * n[1] * d;
+        z += w * n[2] * d;
+        c += w * d * d;
+    }
+
+    void add (const Quadric& q) {
+        xx += q.xx; xy += q.xy; xz += q.xz;
+        yy += q.yy; yz += q.yz; zz += q.zz;
+        x += q.x; y += q.y; z += q.z; c += q.c;
+        weight += q.weight;
+    }
+
+    // The weighted sum of the squared distances of p to the planes
+    double error (const float* p) const {
+        double px = p[0], py = p[1], pz = p[2];
+        double e = xx * px * px + yy * py * py + zz * pz * pz +
+                   2.0 * (xy * px * py + xz * px * pz + yz * py * pz) +
+                   2.0 * (x * px + y * py + z * pz) + c;
+        return (e > 0.0) ? e : 0.0;
+    }
+};
+
+/*
+ * Orders vertices by their position, so vertices in the same place end up
+ * next to each other.
+ */
+struct PositionOrder {
+    const float* vertices;
+
+    PositionOrder (const float* meshVertices) : vertices(meshVertices) {}
+
+    bool operator() (GLuint a, GLuint b) const {
+        const float* pa = vertices + (size_t) a * 3;
+        const float* pb = vertices + (size_t) b * 3;
+        if (pa[0] != pb[0]) {
+            return pa[0] < pb[0];
+        }
+        if (pa[1] != pb[1]) {
+            return pa[1] < pb[1];
+        }
+        if (pa[2] != pb[2]) {
+            return pa[2] < pb[2];
+        }
+        return a < b;
+    }
+};
+
+/*
+ * An edge that can be collapsed: from is moved onto to.
+ */
+struct Collapse {
+    GLuint from;
+    GLuint to;
+    double cost;
+};
+
+/*
+ * Orders collapses by cost, the cheapest first.
+ */
+struct CollapseOrder {
+    bool operator() (const Collapse& a, const Collapse& b) const {
+        return a.cost < b.cost;
+    }
+};
+
+// Twice the area of a triangle, as a vector perpendicular to it
+static void triangleNormal(const float* a, const float* b, const float* c, double n[3]) {
+    double u[3] = { (double) b[0] - a[0], (double) b[1] - a[1], (double) b[2] - a[2] };
+    double v[3] = { (double) c[0] - a[0], (double) c[1] - a[1], (double) c[2] - a[2] };
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+// An edge as one key, to sort and search edges
+static unsigned long long edgeKey(GLuint a, GLuint b) {
+    return ((unsigned long long) a << 32) | b;
+}
+
+static bool hasEdge(const std::vector<unsigned long long>& edges, GLuint a, GLuint b) {
+    return std::binary_search(edges.begin(), edges.end(), edgeKey(a, b));
+}
+
+/*
+ * simplifyToTargets
+ *
+ * INPUT:
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *         targets - how many elements every result should have, from the
+ *                   most to the fewest.
+ *         results - where the elements of every result are written.
+ *         errors - where the error of every result is written.
+ *
+ * DESCRIPTION:
+ *         The simplification of simplifyMesh, for several targets in one
+ *         go: the mesh is copied out every time it gets to a target, so a
+ *         chain of levels costs about as much as its coarsest level.
+ *
+ */
+static void simplifyToTargets(const GLuint* elements, size_t numElements, const float* vertices,
+                              GLuint numVertices, const std::vector<size_t>& targets,
+                              std::vector< std::vector<GLuint> >& results, std::vector<float>& errors) {
+    std::vector<GLuint> triangles(elements, elements + numElements / 3 * 3);
+    double maxError = 0.0;
+
+    // the vertices in the same place share one position, the smallest
+    // vertex of them
+    std::vector<GLuint> position(numVertices);
+    std::vector<GLuint> order(numVertices);
+    for (GLuint v = 0; v < numVertices; ++v) {
+        order[v] = v;
+    }
+    std::sort(order.begin(), order.end(), PositionOrder(vertices));
+    for (GLuint i = 0; i < numVertices; ++i) {
+        const float* p = vertices + (size_t) order[i] * 3;
+        const float* previous = (i > 0) ? vertices + (size_t) order[i - 1] * 3 : NULL;
+        if (previous != NULL && p[0] == previous[0] && p[1] == previous[1] && p[2] == previous[2]) {
+            position[order[i]] = position[order[i - 1]];
+        } else {
+            position[order[i]] = order[i];
+        }
+    }
+
+    // the quadric of every position: the planes of its triangles, plus a
+    // plane across every edge with a different vertex on each side (open
+    // borders and seams), so those keep their shape
+    std::vector<unsigned long long> edges;
+    edges.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (int c = 0; c < 3; ++c) {
+            edges.push_back(edgeKey(triangles[i + c], triangles[i + (c + 1) % 3]));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<Quadric> quadrics(numVertices);
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        const float* corners[3];
+        for (int c = 0; c < 3; ++c) {
+            corners[c] = vertices + (size_t) triangles[i + c] * 3;
+        }
+
+        double n[3];
+        triangleNormal(corners[0], corners[1], corners[2], n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) {
+            continue;
+        }
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * corners[0][0] + n[1] * corners[0][1] + n[2] * corners[0][2]);
+        double area = length * 0.5;
+
+        for (int c = 0; c < 3; ++c) {
+            Quadric& q = quadrics[position[triangles[i + c]]];
+            q.addPlane(n, d, area);
+            q.weight += area;
+        }
+
+        for (int c = 0; c < 3; ++c) {
+            GLuint a = triangles[i + c];
+            GLuint b = triangles[i + (c + 1) % 3];
+            if (hasEdge(edges, b, a)) {
+                continue;
+            }
+
+            const float* pa = corners[c];
+            const float* pb = corners[(c + 1) % 3];
+            double e[3] = { (double) pb[0] - pa[0], (double) pb[1] - pa[1], (double) pb[2] - pa[2] };
+            double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+            double mLength = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+            if (mLength == 0.0) {
+                continue;
+            }
+            m[0] /= mLength;
+            m[1] /= mLength;
+            m[2] /= mLength;
+            double md = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+            double weight = (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]) * BORDER_WEIGHT;
+
+            quadrics[position[a]].addPlane(m, md, weight);
+            quadrics[position[a]].weight += weight;
+            quadrics[position[b]].addPlane(m, md, weight);
+            quadrics[position[b]].weight += weight;
+        }
+    }
+
+    std::vector<size_t> firstTriangle(numVertices + 1);
+    std::vector<GLuint> vertexTriangles;
+    std::vector<unsigned long long> positionEdges;
+    std::vector<bool> onBorder(numVertices);
+    std::vector<bool> locked(numVertices);
+    std::vector<GLuint> remap(numVertices);
+    std::vector<Collapse> collapses;
+    std::vector<GLuint> wedges;
+
+    results.assign(targets.size(), std::vector<GLuint>());
+    errors.assign(targets.size(), 0.0f);
+    size_t next = 0;
+
+    // every pass collapses the cheapest edges that do not touch each
+    // other, until there are few enough triangles for the next target
+    while (next < targets.size()) {
+        size_t targetElements = targets[next];
+        if (triangles.size() <= targetElements) {
+            results[next] = triangles;
+            errors[next] = (float) sqrt(maxError);
+            ++next;
+            continue;
+        }
+        size_t numTriangles = triangles.size() / 3;
+
+        // the triangles around every position
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            ++firstTriangle[position[triangles[i]] + 1];
+        }
+        for (GLuint v = 0; v < numVertices; ++v) {
+            firstTriangle[v + 1] += firstTriangle[v];
+        }
+        vertexTriangles.resize(triangles.size());
+        std::vector<size_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            vertexTriangles[filled[position[triangles[i]]]++] = (GLuint) (i / 3);
+        }
+
+        // an edge between positions with a triangle on one side only is
+        // an open border
+        positionEdges.clear();
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+            for (int c = 0; c < 3; ++c) {
+                positionEdges.push_back(edgeKey(position[triangles[i + c]],
+                                                position[triangles[i + (c + 1) % 3]]));
+            }
+        }
+        std::sort(positionEdges.begin(), positionEdges.end());
+
+        std::fill(onBorder.begin(), onBorder.end(), false);
+        for (size_t i = 0; i < positionEdges.size(); ++i) {
+            GLuint a = (GLuint) (positionEdges[i] >> 32);
+            GLuint b = (GLuint) (positionEdges[i] & 0xFFFFFFFFu);
+            if (!hasEdge(positionEdges, b, a)) {
+                onBorder[a] = true;
+                onBorder[b] = true;
+            }
+        }
+
+        // every edge once, moving the end that costs less; a border
+        // vertex only moves along the border
+        collapses.clear();
+        for (size_t i = 0; i < positionEdges.size(); ++i) {
+            GLuint a = (GLuint) (positionEdges[i] >> 32);
+            GLuint b = (GLuint) (positionEdges[i] & 0xFFFFFFFFu);
+            bool border = !hasEdge(positionEdges, b, a);
+            if (a == b || (a > b && !border) || (i > 0 && positionEdges[i] == positionEdges[i - 1])) {
+                continue;
+            }
+
+            Quadric q = quadrics[a];
+            q.add(quadrics[b]);
+            double weight = (q.weight > 0.0) ? q.weight : 1.0;
+
+            Collapse collapse;
+            collapse.cost = -1.0;
+            if (!onBorder[a] || border) {
+                collapse.from = a;
+                collapse.to = b;
+                collapse.cost = q.error(vertices + (size_t) b * 3) / weight;
+            }
+            if (!onBorder[b] || border) {
+                double cost = q.error(vertices + (size_t) a * 3) / weight;
+                if (collapse.cost < 0.0 || cost < collapse.cost) {
+                    collapse.from = b;
+                    collapse.to = a;
+                    collapse.cost = cost;
+                }
+            }
+            if (collapse.cost >= 0.0) {
+                collapses.push_back(collapse);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), CollapseOrder());
+
+        std::fill(locked.begin(), locked.end(), false);
+        for (GLuint v = 0; v < numVertices; ++v) {
+            remap[v] = v;
+        }
+
+        size_t toRemove = (triangles.size() - targetElements + 2) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+
+        for (size_t i = 0; i < collapses.size() && removed < toRemove; ++i) {
+            GLuint from = collapses[i].from;
+            GLuint to = collapses[i].to;
+            if (locked[from] || locked[to]) {
+                continue;
+            }
+
+            // every vertex of from goes to the vertex of to it shares a
+            // triangle with, the pairs are kept in wedges
+            const GLuint* around = &vertexTriangles[firstTriangle[from]];
+            size_t numAround = firstTriangle[from + 1] - firstTriangle[from];
+            size_t lost = 0;
+            wedges.clear();
+            for (size_t j = 0; j < numAround; ++j) {
+                const GLuint* corners = &triangles[(size_t) around[j] * 3];
+                GLuint moved = NO_VERTEX, target = NO_VERTEX;
+                for (int c = 0; c < 3; ++c) {
+                    if (position[corners[c]] == from) {
+                        moved = corners[c];
+                    } else if (position[corners[c]] == to) {
+                        target = corners[c];
+                    }
+                }
+                if (target != NO_VERTEX) {
+                    wedges.push_back(moved);
+                    wedges.push_back(target);
+                    ++lost;
+                }
+            }
+
+            bool valid = (lost > 0);
+            for (size_t j = 0; j < numAround && valid; ++j) {
+                const GLuint* corners = &triangles[(size_t) around[j] * 3];
+                int movedCorner = -1;
+                bool hasTarget = false;
+                for (int c = 0; c < 3; ++c) {
+                    if (position[corners[c]] == from) {
+                        movedCorner = c;
+                    } else if (position[corners[c]] == to) {
+                        hasTarget = true;
+                    }
+                }
+                if (hasTarget) {
+                    continue;
+                }
+
+                // a vertex of from that would have nowhere to go, e.g. the
+                // other side of a seam when moving across it
+                bool paired = false;
+                for (size_t w = 0; w < wedges.size(); w += 2) {
+                    paired = paired || (wedges[w] == corners[movedCorner]);
+                }
+
+                // the triangle must not turn too much
+                const float* p[3];
+                for (int c = 0; c < 3; ++c) {
+                    p[c] = vertices + (size_t) corners[c] * 3;
+                }
+                double before[3], after[3];
+                triangleNormal(p[0], p[1], p[2], before);
+                p[movedCorner] = vertices + (size_t) to * 3;
+                triangleNormal(p[0], p[1], p[2], after);
+                double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                double lengths = sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                                      (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+
+                valid = paired && dot >= FLIP_LIMIT * lengths;
+            }
+            if (!valid) {
+                continue;
+            }
+
+            for (size_t w = 0; w < wedges.size(); w += 2) {
+                if (remap[wedges[w]] == wedges[w]) {
+                    remap[wedges[w]] = wedges[w + 1];
+                }
+            }
+            for (size_t j = 0; j < numAround; ++j) {
+                const GLuint* corners = &triangles[(size_t) around[j] * 3];
+                for (int c = 0; c < 3; ++c) {
+                    locked[position[corners[c]]] = true;
+                }
+            }
+            locked[to] = true;
+
+            quadrics[to].add(quadrics[from]);
+            maxError = std::max(maxError, collapses[i].cost);
+            removed += lost;
+            ++applied;
+        }
+
+        // nothing else can be collapsed, the targets left get the mesh
+        // as it is
+        if (applied == 0) {
+            for (; next < targets.size(); ++next) {
+                results[next] = triangles;
+                errors[next] = (float) sqrt(maxError);
+            }
+            break;
+        }
+
+        // move the vertices and drop the triangles that lost an edge
+        size_t kept = 0;
+        for (size_t t = 0; t < numTriangles; ++t) {
+            GLuint a = remap[triangles[t * 3 + 0]];
+            GLuint b = remap[triangles[t * 3 + 1]];
+            GLuint c = remap[triangles[t * 3 + 2]];
+            if (position[a] == position[b] || position[b] == position[c] || position[c] == position[a]) {
+                continue;
+            }
+            triangles[kept * 3 + 0] = a;
+            triangles[kept * 3 + 1] = b;
+            triangles[kept * 3 + 2] = c;
+            ++kept;
+        }
+        triangles.resize(kept * 3);
+    }
+
+}
+
+/*
+ * simplifyMesh
+ *
+ * INPUT:
+ *         destination - where the elements of the simplified mesh are
+ *                       written, room for numElements.
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *         targetElements - how many elements the simplified mesh should
+ *                          have.
+ *         error - if not NULL, the largest distance a vertex was moved
+ *                 from the surface is written here.
+ *
+ * RETURN:
+ *         How many elements were written. It can be more than
+ *         targetElements if no more edges can be collapsed.
+ *
+ * DESCRIPTION:
+ *         Collapses edges of the mesh (Garland and Heckbert, Surface
+ *         Simplification Using Quadric Error Metrics), the cheapest ones
+ *         first. A vertex is only moved onto one of its neighbours, so no
+ *         vertex is created and the result uses the same vertices.
+ *
+ *         Vertices with the same position and different attributes (UV
+ *         seams and hard normals) are moved together, and only along the
+ *         seam, so the attributes on both sides stay where they were. Open
+ *         borders only move along themselves, and collapses that turn a
+ *         triangle too much are not made.
+ *
+ */
+size_t simplifyMesh(GLuint* destination, const GLuint* elements, size_t numElements,
+                    const float* vertices, GLuint numVertices, size_t targetElements,
+                    float* error) {
+    std::vector<size_t> targets(1, targetElements);
+    std::vector< std::vector<GLuint> > results;
+    std::vector<float> errors;
+    simplifyToTargets(elements, numElements, vertices, numVertices, targets, results, errors);
+
+    std::copy(results[0].begin(), results[0].end(), destination);
+    if (error != NULL) {
+        *error = errors[0];
+    }
+    return results[0].size();
+}
+
+/*
+ * buildLodChain
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements, the elements of the
+ *                levels are added after its own.
+ *         numLevels - how many levels after the full mesh are wanted.
+ *         reduction - how many of the triangles of a level the next one
+ *                     keeps (0.5 keeps half).
+ *         lods - where the levels are written, the first one is the full
+ *                mesh.
+ *
+ * RETURN:
+ *         How many levels were made, including the full mesh. It stops
+ *         early if a level could not have fewer triangles than the one
+ *         before it.
+ *
+ * DESCRIPTION:
+ *         Simplifies every submesh of the mesh for every level, always
+ *         from the full mesh, and optimizes the triangles of every level
+ *         for the vertex cache. If the mesh had no submeshes it gets one
+ *         with all its elements, so the passes that work per submesh do
+ *         not mix the full mesh with the levels.
+ *
+ */
+size_t buildLodChain(MeshData& mesh, int numLevels, float reduction, std::vector<MeshLod>& lods) {
+    lods.clear();
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    if (mesh.submeshes.empty()) {
+        getElementRanges(mesh, mesh.submeshes);
+    }
+
+    MeshLod full;
+    full.firstElement = 0;
+    full.numElements = (GLuint) mesh.elements.size();
+    full.error = 0.0f;
+    full.submeshes = mesh.submeshes;
+    lods.push_back(full);
+    if (numLevels <= 0) {
+        return lods.size();
+    }
+
+    // every submesh is simplified to every level in one go, with its
+    // vertices numbered from 0
+    size_t numSubmeshes = full.submeshes.size();
+    std::vector< std::vector< std::vector<GLuint> > > levels(numSubmeshes);
+    std::vector< std::vector<float> > errors(numSubmeshes);
+
+    std::vector<GLuint> localIndex(numVertices, NO_VERTEX);
+    std::vector<GLuint> meshIndex;
+    std::vector<GLuint> local;
+    std::vector<float> positions;
+    std::vector<size_t> targets(numLevels);
+
+    for (size_t i = 0; i < numSubmeshes; ++i) {
+        const Submesh& submesh = full.submeshes[i];
+        size_t count = submesh.numElements;
+        if (count == 0) {
+            levels[i].assign(numLevels, std::vector<GLuint>());
+            errors[i].assign(numLevels, 0.0f);
+            continue;
+        }
+
+        GLuint rangeVertices = localizeRange(&mesh.elements[submesh.firstElement], count,
+                                             localIndex, meshIndex, local);
+        positions.resize((size_t) rangeVertices * 3);
+        for (GLuint v = 0; v < rangeVertices; ++v) {
+            for (int c = 0; c < 3; ++c) {
+                positions[v * 3 + c] = mesh.vertices[(size_t) meshIndex[v] * 3 + c];
+            }
+        }
+
+        float keep = 1.0f;
+        for (int level = 0; level < numLevels; ++level) {
+            keep *= reduction;
+            targets[level] = (size_t) (count / 3 * keep) * 3;
+        }
+        simplifyToTargets(&local[0], count, &positions[0], rangeVertices, targets, levels[i], errors[i]);
+
+        for (int level = 0; level < numLevels; ++level) {
+            std::vector<GLuint>& simplified = levels[i][level];
+            if (!simplified.empty()) {
+                optimizeVertexCache(&simplified[0], simplified.size(), rangeVertices);
+            }
+            for (size_t j = 0; j < simplified.size(); ++j) {
+                simplified[j] = meshIndex[simplified[j]];
+            }
+        }
+    }
+
+    for (int level = 0; level < numLevels; ++level) {
+        MeshLod lod;
+        lod.firstElement = (GLuint) mesh.elements.size();
+        lod.error = 0.0f;
+
+        for (size_t i = 0; i < numSubmeshes; ++i) {
+            const std::vector<GLuint>& simplified = levels[i][level];
+
+            Submesh range = full.submeshes[i];
+            range.firstElement = (GLuint) mesh.elements.size();
+            range.numElements = (GLuint) simplified.size();
+            lod.submeshes.push_back(range);
+
+            mesh.elements.insert(mesh.elements.end(), simplified.begin(), simplified.end());
+            lod.error = std::max(lod.error, errors[i][level]);
+        }
+        lod.numElements = (GLuint) mesh.elements.size() - lod.firstElement;
+
+        // no point in a level that is not smaller than the one before
+        if (lod.numElements >= lods.back().numElements) {
+            mesh.elements.resize(lod.firstElement);
+            break;
+        }
+
+        // a coarser level is never reported as closer than a finer one
+        lod.error = std::max(lod.error, lods.back().error);
+        lods.push_back(lod);
+    }
+
+    return lods.size();
+}
+
+/*
+ * computeScreenSize
+ *
+ * INPUT:
+ *         diameter - the size of the object.
+ *         distance - how far the object is from the camera.
+ *         fovY - the vertical field of view of the camera, in degrees.
+ *         viewportHeight - the height of the viewport, in pixels.
+ *
+ * RETURN:
+ *         How many pixels the diameter covers on the screen with a
+ *         perspective projection.
+ *
+ */
+float computeScreenSize(float diameter, float distance, float fovY, float viewportHeight) {
+    if (distance <= 0.0f) {
+        return viewportHeight;
+    }
+    float halfFov = fovY * 0.5f * 3.14159265f / 180.0f;
+    return diameter / (2.0f * distance * tanf(halfFov)) * viewportHeight;
+}
@@ -0,0 +1,129 @@
+/*
+ * meshSimplifier.h
+ *
+ * Quadric error simplification of meshes and the levels of detail made
+ * with it. The levels only have elements, they use the vertices of the
+ * full mesh, so a shape keeps one vertex buffer for all of them.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _MESHSIMPLIFIER_H
+#define _MESHSIMPLIFIER_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "meshData.h"
+
+// How many triangles each level of detail keeps from the one before it
+#define LOD_REDUCTION  0.5f
+
+// How far, in pixels, a level may be from the full mesh on the screen
+#define LOD_PIXEL_ERROR  1.0f
+
+/*
+ * A level of detail of a mesh: a range of its elements, plus the ranges
+ * of its submeshes inside it (in the same order as the submeshes of the
+ * full mesh) and how far the level may be from the full mesh.
+ */
+struct MeshLod {
+    GLuint firstElement;
+    GLuint numElements;
+
+    // the largest distance, in the units of the mesh, a vertex was moved
+    // from the surface of the full mesh (measured with the quadrics)
+    float error;
+
+    std::vector<Submesh> submeshes;
+};
+
+/*
+ * simplifyMesh
+ *
+ * INPUT:
+ *         destination - where the elements of the simplified mesh are
+ *                       written, room for numElements.
+ *         elements - three elements per triangle.
+ *         numElements - how many elements there are.
+ *         vertices - x y z of every vertex.
+ *         numVertices - one more than the largest element.
+ *         targetElements - how many elements the simplified mesh should
+ *                          have.
+ *         error - if not NULL, the largest distance a vertex was moved
+ *                 from the surface is written here.
+ *
+ * RETURN:
+ *         How many elements were written. It can be more than
+ *         targetElements if no more edges can be collapsed.
+ *
+ * DESCRIPTION:
+ *         Collapses edges of the mesh (Garland and Heckbert, Surface
+ *         Simplification Using Quadric Error Metrics), the cheapest ones
+ *         first. A vertex is only moved onto one of its neighbours, so no
+ *         vertex is created and the result uses the same vertices.
+ *
+ *         Vertices with the same position and different attributes (UV
+ *         seams and hard normals) are moved together, and only along the
+ *         seam, so the attributes on both sides stay where they were. Open
+ *         borders only move along themselves, and collapses that turn a
+ *         triangle too much are not made.
+ *
+ */
+size_t simplifyMesh(GLuint* destination, const GLuint* elements, size_t numElements,
+                    const float* vertices, GLuint numVertices, size_t targetElements,
+                    float* error);
+
+/*
+ * buildLodChain
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements, the elements of the
+ *                levels are added after its own.
+ *         numLevels - how many levels after the full mesh are wanted.
+ *         reduction - how many of the triangles of a level the next one
+ *                     keeps (0.5 keeps half).
+ *         lods - where the levels are written, the first one is the full
+ *                mesh.
+ *
+ * RETURN:
+ *         How many levels were made, including the full mesh. It stops
+ *         early if a level could not have fewer triangles than the one
+ *         before it.
+ *
+ * DESCRIPTION:
+ *         Simplifies every submesh of the mesh for every level, always
+ *         from the full mesh, and optimizes the triangles of every level
+ *         for the vertex cache. If the mesh had no submeshes it gets one
+ *         with all its elements, so the passes that work per submesh do
+ *         not mix the full mesh with the levels.
+ *
+ */
+size_t buildLodChain(MeshData& mesh, int numLevels, float reduction, std::vector<MeshLod>& lods);
+
+/*
+ * computeScreenSize
+ *
+ * INPUT:
+ *         diameter - the size of the object.
+ *         distance - how far the object is from the camera.
+ *         fovY - the vertical field of view of the camera, in degrees.
+ *         viewportHeight - the height of the viewport, in pixels.
+ *
+ * RETURN:
+ *         How many pixels the diameter covers on the screen with a
+ *         perspective projection.
+ *
+ */
+float computeScreenSize(float diameter, float distance, float fovY, float viewportHeight);
+
+#endif
@@ -0,0 +1,560 @@
+/*
+ * meshlet.cpp
+ *
+ * Meshlets: small clusters of triangles of a mesh, each with a bounding
+ * sphere and a cone of the normals of its triangles, so the clusters that
+ * are outside of the view or face away from the camera can be dropped on
+ * the CPU before they are drawn. Nothing here touches OpenGL.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "meshlet.h"
+
+// C libraries
+#include <math.h>
+#include <float.h>
+
+// C++ libraries
+#include <vector>
+#include <algorithm>
+
+#include "meshOptimizer.h"
+
+// Below this cosine between the axis of the cone and a normal (about 84
+// degrees) the cone is too wide to ever cull the meshlet
+static const float MIN_CONE_COSINE = 0.1f;
+
+// A triangle that is not in any meshlet yet
+static const GLuint NO_TRIANGLE = 0xFFFFFFFFu;
+
+// Orders the vertices of a range by their position, to find the ones
+// that are in the same place
+struct PositionLess {
+    const float* positions;
+
+    bool operator() (GLuint a, GLuint b) const {
+        const float* pa = positions + (size_t) a * 3;
+        const float* pb = positions + (size_t) b * 3;
+        if (pa[0] != pb[0]) {
+            return pa[0] < pb[0];
+        }
+        if (pa[1] != pb[1]) {
+            return pa[1] < pb[1];
+        }
+        return pa[2] < pb[2];
+    }
+};
+
+/*
+ * buildMeshlets
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements, in the order of
+ *                optimizeVertexCache.
+ *         meshlets - where the meshlets are written.
+ *         maxVertices - the most vertices of a meshlet.
+ *         maxTriangles - the most triangles of a meshlet.
+ *
+ * RETURN:
+ *         How many meshlets were made.
+ *
+ * DESCRIPTION:
+ *         Splits every submesh of the mesh in meshlets and moves the
+ *         triangles of every meshlet next to each other, so a meshlet is
+ *         a range of elements. A meshlet grows from a triangle onto the
+ *         triangles around it, first those that add no vertex and then
+ *         the closest ones, so it stays round and its normals close
+ *         together. Then the triangles of every meshlet are ordered for
+ *         the vertex cache on their own. The elements outside of the
+ *         submeshes (e.g. levels of detail) do not move.
+ *
+ */
+size_t buildMeshlets(MeshData& mesh, std::vector<Meshlet>& meshlets, GLuint maxVertices,
+                     GLuint maxTriangles) {
+    meshlets.clear();
+    maxVertices = std::max(maxVertices, (GLuint) 3);
+    maxTriangles = std::max(maxTriangles, (GLuint) 1);
+
+    std::vector<Submesh> ranges;
+    getElementRanges(mesh, ranges);
+
+    GLuint numVertices = (GLuint) (mesh.vertices.size() / 3);
+    std::vector<GLuint> localIndex(numVertices, NO_VERTEX);
+    std::vector<GLuint> meshIndex;
+    std::vector<GLuint> local;
+
+    std::vector<float> positions;
+    std::vector<GLuint> byPosition;
+    std::vector<GLuint> corner;
+    std::vector<GLuint> firstTriangle;
+    std::vector<GLuint> filled;
+    std::vector<GLuint> cornerTriangles;
+    std::vector<GLuint> liveTriangles;
+    std::vector<float> centroids;
+    std::vector<char> used;
+    std::vector<GLuint> vertexMeshlet;
+    std::vector<GLuint> candidateMeshlet;
+    std::vector<GLuint> candidates;
+    std::vector<GLuint> triangles;
+    std::vector<GLuint> sorted;
+
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        const Submesh& range = ranges[r];
+        size_t count = range.numElements - range.numElements % 3;
+        if (count == 0) {
+            continue;
+        }
+
+        GLuint* elements = &mesh.elements[range.firstElement];
+        GLuint rangeVertices = localizeRange(elements, count, localIndex, meshIndex, local);
+        GLuint numTriangles = (GLuint) (count / 3);
+
+        positions.resize((size_t) rangeVertices * 3);
+        for (GLuint v = 0; v < rangeVertices; ++v) {
+            for (int c = 0; c < 3; ++c) {
+                positions[v * 3 + c] = mesh.vertices[(size_t) meshIndex[v] * 3 + c];
+            }
+        }
+
+        // the triangles are neighbours if they share a position, so the
+        // vertices split by a seam or by hard normals do not stop a meshlet
+        byPosition.resize(rangeVertices);
+        for (GLuint v = 0; v < rangeVertices; ++v) {
+            byPosition[v] = v;
+        }
+        PositionLess less;
+        less.positions = &positions[0];
+        std::sort(byPosition.begin(), byPosition.end(), less);
+
+        corner.resize(rangeVertices);
+        GLuint numCorners = 0;
+        for (GLuint i = 0; i < rangeVertices; ++i) {
+            if (i > 0 && less(byPosition[i - 1], byPosition[i])) {
+                ++numCorners;
+            }
+            corner[byPosition[i]] = numCorners;
+        }
+        ++numCorners;
+
+        // the triangles of every position, in one array
+        firstTriangle.assign(numCorners + 1, 0);
+        for (size_t i = 0; i < count; ++i) {
+            ++firstTriangle[corner[local[i]] + 1];
+        }
+        for (GLuint v = 0; v < numCorners; ++v) {
+            firstTriangle[v + 1] += firstTriangle[v];
+        }
+        filled.assign(firstTriangle.begin(), firstTriangle.end() - 1);
+        cornerTriangles.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            cornerTriangles[filled[corner[local[i]]]++] = (GLuint) (i / 3);
+        }
+        liveTriangles.resize(numCorners);
+        for (GLuint v = 0; v < numCorners; ++v) {
+            liveTriangles[v] = firstTriangle[v + 1] - firstTriangle[v];
+        }
+
+        centroids.resize((size_t) numTriangles * 3);
+        for (GLuint t = 0; t < numTriangles; ++t) {
+            for (int c = 0; c < 3; ++c) {
+                float sum = 0.0f;
+                for (int k = 0; k < 3; ++k) {
+                    sum += positions[(size_t) local[t * 3 + k] * 3 + c];
+                }
+                centroids[t * 3 + c] = sum / 3.0f;
+            }
+        }
+
+        used.assign(numTriangles, 0);
+        vertexMeshlet.assign(rangeVertices, NO_TRIANGLE);
+        candidateMeshlet.assign(numTriangles, NO_TRIANGLE);
+        sorted.clear();
+        sorted.reserve(count);
+        candidates.clear();
+
+        GLuint scan = 0;
+        size_t placed = 0;
+        while (placed < numTriangles) {
+            // the next meshlet starts next to the last one if it can, so
+            // no small pieces are left behind, else at the first triangle
+            // left in the order of the range
+            GLuint next = NO_TRIANGLE;
+            for (size_t j = 0; j < candidates.size() && next == NO_TRIANGLE; ++j) {
+                if (!used[candidates[j]]) {
+                    next = candidates[j];
+                }
+            }
+            if (next == NO_TRIANGLE) {
+                while (used[scan]) {
+                    ++scan;
+                }
+                next = scan;
+            }
+
+            // the meshlets are told apart by their index
+            GLuint id = (GLuint) meshlets.size();
+            GLuint meshletVertices = 0;
+            float sum[3] = { 0.0f, 0.0f, 0.0f };
+            triangles.clear();
+            candidates.clear();
+
+            while (next != NO_TRIANGLE) {
+                used[next] = 1;
+                triangles.push_back(next);
+                for (int c = 0; c < 3; ++c) {
+                    sum[c] += centroids[next * 3 + c];
+                }
+
+                // the new vertices bring the triangles around them
+                for (int k = 0; k < 3; ++k) {
+                    GLuint v = local[next * 3 + k];
+                    GLuint p = corner[v];
+                    --liveTriangles[p];
+                    if (vertexMeshlet[v] == id) {
+                        continue;
+                    }
+                    vertexMeshlet[v] = id;
+                    ++meshletVertices;
+                    for (GLuint j = firstTriangle[p]; j < firstTriangle[p + 1]; ++j) {
+                        GLuint t = cornerTriangles[j];
+                        if (!used[t] && candidateMeshlet[t] != id) {
+                            candidateMeshlet[t] = id;
+                            candidates.push_back(t);
+                        }
+                    }
+                }
+
+                next = NO_TRIANGLE;
+                if (triangles.size() >= maxTriangles) {
+                    break;
+                }
+
+                float center[3];
+                for (int c = 0; c < 3; ++c) {
+                    center[c] = sum[c] / triangles.size();
+                }
+
+                // the triangle with the fewest new vertices, of those the
+                // one whose corners have the fewest triangles left (so
+                // they are finished), then the closest one
+                int bestExtra = 4;
+                GLuint bestLive = NO_TRIANGLE;
+                float bestDistance = FLT_MAX;
+                for (size_t j = 0; j < candidates.size(); ) {
+                    GLuint t = candidates[j];
+                    if (used[t]) {
+                        candidates[j] = candidates.back();
+                        candidates.pop_back();
+                        continue;
+                    }
+                    ++j;
+
+                    int extra = 0;
+                    GLuint live = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        GLuint v = local[t * 3 + k];
+                        extra += (vertexMeshlet[v] != id) ? 1 : 0;
+                        live += liveTriangles[corner[v]];
+                    }
+                    if (meshletVertices + extra > maxVertices || extra > bestExtra ||
+                        (extra == bestExtra && live > bestLive)) {
+                        continue;
+                    }
+
+                    float distance = 0.0f;
+                    for (int c = 0; c < 3; ++c) {
+                        float d = centroids[t * 3 + c] - center[c];
+                        distance += d * d;
+                    }
+                    if (extra < bestExtra || live < bestLive || distance < bestDistance) {
+                        next = t;
+                        bestExtra = extra;
+                        bestLive = live;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            // the triangles go back to the order they had
+            std::sort(triangles.begin(), triangles.end());
+
+            Meshlet meshlet;
+            meshlet.firstElement = range.firstElement + (GLuint) sorted.size();
+            meshlet.numElements = (GLuint) triangles.size() * 3;
+            for (size_t j = 0; j < triangles.size(); ++j) {
+                for (int k = 0; k < 3; ++k) {
+                    sorted.push_back(elements[triangles[j] * 3 + k]);
+                }
+            }
+            meshlets.push_back(meshlet);
+            placed += triangles.size();
+        }
+
+        std::copy(sorted.begin(), sorted.end(), elements);
+    }
+
+    // the cache starts over at every meshlet, so each one is optimized on
+    // its own, and keeps its order if that is not better
+    std::vector<GLuint> optimized;
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        GLuint* range = &mesh.elements[meshlets[i].firstElement];
+        size_t count = meshlets[i].numElements;
+        GLuint rangeVertices = localizeRange(range, count, localIndex, meshIndex, local);
+
+        optimized = local;
+        optimizeVertexCache(&optimized[0], count, rangeVertices);
+        if (computeAcmr(&optimized[0], count, rangeVertices) <
+            computeAcmr(&local[0], count, rangeVertices)) {
+            for (size_t j = 0; j < count; ++j) {
+                range[j] = meshIndex[optimized[j]];
+            }
+        }
+    }
+
+    // the bounds are computed once the elements are in place
+    const float* vertices = mesh.vertices.empty() ? NULL : &mesh.vertices[0];
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        computeMeshletBounds(&mesh.elements[0], vertices, meshlets[i]);
+    }
+    return meshlets.size();
+}
+
+/*
+ * computeMeshletBounds
+ *
+ * INPUT:
+ *         elements - the elements of the mesh.
+ *         vertices - x y z of every vertex of the mesh.
+ *         meshlet - a meshlet whose range is set, its vertices and bounds
+ *                   are written.
+ *
+ */
+void computeMeshletBounds(const GLuint* elements, const float* vertices, Meshlet& meshlet) {
+    const GLuint* range = elements + meshlet.firstElement;
+    GLuint count = meshlet.numElements;
+
+    // the sphere is centered on the bounding box
+    float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    std::vector<GLuint> distinct(range, range + count);
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    meshlet.numVertices = (GLuint) distinct.size();
+
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        const float* p = vertices + (size_t) distinct[i] * 3;
+        for (int c = 0; c < 3; ++c) {
+            low[c] = std::min(low[c], p[c]);
+            high[c] = std::max(high[c], p[c]);
+        }
+    }
+
+    float radius = 0.0f;
+    for (int c = 0; c < 3; ++c) {
+        meshlet.center[c] = distinct.empty() ? 0.0f : (low[c] + high[c]) * 0.5f;
+    }
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        const float* p = vertices + (size_t) distinct[i] * 3;
+        float dx = p[0] - meshlet.center[0];
+        float dy = p[1] - meshlet.center[1];
+        float dz = p[2] - meshlet.center[2];
+        radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+    }
+    meshlet.radius = sqrtf(radius);
+
+    // the normals of the triangles, the ones with no area left out
+    std::vector<float> normals;
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (GLuint i = 0; i + 2 < count; i += 3) {
+        const float* p0 = vertices + (size_t) range[i] * 3;
+        const float* p1 = vertices + (size_t) range[i + 1] * 3;
+        const float* p2 = vertices + (size_t) range[i + 2] * 3;
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1],
+                       e1[2] * e2[0] - e1[0] * e2[2],
+                       e1[0] * e2[1] - e1[1] * e2[0] };
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f) {
+            continue;
+        }
+        for (int c = 0; c < 3; ++c) {
+            normals.push_back(n[c] / length);
+            axis[c] += n[c] / length;
+        }
+    }
+
+    float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float minCosine = -1.0f;
+    if (length > 0.0f) {
+        minCosine = 1.0f;
+        for (int c = 0; c < 3; ++c) {
+            axis[c] /= length;
+        }
+        for (size_t i = 0; i < normals.size(); i += 3) {
+            float cosine = normals[i] * axis[0] + normals[i + 1] * axis[1] + normals[i + 2] * axis[2];
+            minCosine = std::min(minCosine, cosine);
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        meshlet.coneAxis[c] = axis[c];
+    }
+    if (minCosine < MIN_CONE_COSINE) {
+        meshlet.coneCutoff = 1.0f;
+    } else {
+        meshlet.coneCutoff = sqrtf(1.0f - minCosine * minCosine);
+    }
+}
+
+/*
+ * getFrustumPlanes
+ *
+ * INPUT:
+ *         matrix - a projection times a view (times a model) matrix, 16
+ *                  floats row after row like the matrices of mathHelper.h.
+ *         planes - where the a b c d of the six planes are written, the
+ *                  inside of the frustum is where a x + b y + c z + d >= 0.
+ *
+ * DESCRIPTION:
+ *         The planes of the frustum in the space the matrix starts from
+ *         (Gribb and Hartmann, Fast Extraction of Viewing Frustum Planes
+ *         from the World-View-Projection Matrix).
+ *
+ */
+void getFrustumPlanes(const float* matrix, float planes[6][4]) {
+    // a point is inside if -w <= x, y, z <= w, every side is the last row
+    // plus or minus one of the others
+    const float* w = matrix + 12;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float* row = matrix + axis * 4;
+        for (int c = 0; c < 4; ++c) {
+            planes[axis * 2][c] = w[c] + row[c];
+            planes[axis * 2 + 1][c] = w[c] - row[c];
+        }
+    }
+}
+
+/*
+ * cullMeshlets
+ *
+ * INPUT:
+ *         meshlets - the meshlets of a mesh.
+ *         cameraPosition - x y z of the camera in the space of the mesh,
+ *                          NULL to keep the meshlets that face away.
+ *         modelViewProjection - see getFrustumPlanes, NULL to keep the
+ *                               meshlets outside of the frustum.
+ *         draws - where the draws of the visible meshlets are written.
+ *
+ * RETURN:
+ *         How many meshlets were culled and how many were kept.
+ *
+ * DESCRIPTION:
+ *         Drops the meshlets whose sphere is outside of a plane of the
+ *         frustum, and those whose every triangle faces away from the
+ *         camera from any point of the sphere. The visible meshlets next
+ *         to each other in the element buffer become one draw, ready for
+ *         glMultiDrawElements or an indirect draw buffer.
+ *
+ */
+MeshletCullStats cullMeshlets(const std::vector<Meshlet>& meshlets, const float* cameraPosition,
+                              const float* modelViewProjection,
+                              std::vector<DrawElementsIndirectCommand>& draws) {
+    MeshletCullStats stats;
+    stats.numMeshlets = (GLuint) meshlets.size();
+    stats.numTriangles = 0;
+    stats.frustumCulled = 0;
+    stats.backfaceCulled = 0;
+    stats.visibleMeshlets = 0;
+    stats.visibleTriangles = 0;
+    draws.clear();
+
+    float planes[6][4];
+    float planeLengths[6];
+    if (modelViewProjection != NULL) {
+        getFrustumPlanes(modelViewProjection, planes);
+        for (int p = 0; p < 6; ++p) {
+            planeLengths[p] = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] +
+                                    planes[p][2] * planes[p][2]);
+        }
+    }
+
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        stats.numTriangles += meshlet.numElements / 3;
+
+        if (modelViewProjection != NULL) {
+            bool outside = false;
+            for (int p = 0; p < 6 && !outside; ++p) {
+                float distance = planes[p][0] * meshlet.center[0] + planes[p][1] * meshlet.center[1] +
+                                 planes[p][2] * meshlet.center[2] + planes[p][3];
+                outside = distance < -meshlet.radius * planeLengths[p];
+            }
+            if (outside) {
+                ++stats.frustumCulled;
+                continue;
+            }
+        }
+
+        // the camera sees the back of every triangle if the direction to
+        // any point of the sphere is within 90 degrees minus the angle of
+        // the cone from its axis
+        if (cameraPosition != NULL && meshlet.coneCutoff < 1.0f) {
+            float toCenter[3];
+            for (int c = 0; c < 3; ++c) {
+                toCenter[c] = meshlet.center[c] - cameraPosition[c];
+            }
+            float distance = sqrtf(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] +
+                                   toCenter[2] * toCenter[2]);
+            float along = toCenter[0] * meshlet.coneAxis[0] + toCenter[1] * meshlet.coneAxis[1] +
+                          toCenter[2] * meshlet.coneAxis[2];
+            if (along >= meshlet.coneCutoff * distance + meshlet.radius * (1.0f + meshlet.coneCutoff)) {
+                ++stats.backfaceCulled;
+                continue;
+            }
+        }
+
+        ++stats.visibleMeshlets;
+        stats.visibleTriangles += meshlet.numElements / 3;
+
+        if (!draws.empty() && draws.back().firstIndex + draws.back().count == meshlet.firstElement) {
+            draws.back().count += meshlet.numElements;
+        } else {
+            DrawElementsIndirectCommand draw;
+            draw.count = meshlet.numElements;
+            draw.instanceCount = 1;
+            draw.firstIndex = meshlet.firstElement;
+            draw.baseVertex = 0;
+            draw.baseInstance = 0;
+            draws.push_back(draw);
+        }
+    }
+
+    stats.numDraws = (GLuint) draws.size();
+    return stats;
+}
+
+/*
+ * compactElements
+ *
+ * INPUT:
+ *         elements - the elements of the mesh.
+ *         draws - the draws of cullMeshlets.
+ *         compacted - where the elements of every draw are written, one
+ *                     after the other.
+ *
+ * DESCRIPTION:
+ *         The elements of the visible meshlets as one list, for a single
+ *         glDrawElements from a buffer streamed every frame.
+ *
+ */
+void compactElements(const GLuint* elements, const std::vector<DrawElementsIndirectCommand>& draws,
+                     std::vector<GLuint>& compacted) {
+    compacted.clear();
+    for (size_t i = 0; i < draws.size(); ++i) {
+        compacted.insert(compacted.end(), elements + draws[i].firstIndex,
+                         elements + draws[i].firstIndex + draws[i].count);
+    }
+}
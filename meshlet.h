@@ -0,0 +1,187 @@
+/*
+ * meshlet.h
+ *
+ * Meshlets: small clusters of triangles of a mesh, each with a bounding
+ * sphere and a cone of the normals of its triangles, so the clusters that
+ * are outside of the view or face away from the camera can be dropped on
+ * the CPU before they are drawn. Nothing here touches OpenGL.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _MESHLET_H
+#define _MESHLET_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "meshData.h"
+
+// The most vertices and triangles a meshlet has, the sizes mesh shaders
+// are usually given
+#define MESHLET_MAX_VERTICES   64
+#define MESHLET_MAX_TRIANGLES  124
+
+/*
+ * A meshlet: a range of elements of the mesh, the triangles of one
+ * submesh that share vertices, and the bounds they are culled with.
+ */
+struct Meshlet {
+    GLuint firstElement;
+    GLuint numElements;
+
+    // how many different vertices its triangles use
+    GLuint numVertices;
+
+    // the sphere around its vertices
+    float center[3];
+    float radius;
+
+    // the average of the normals of its triangles and the sine of the
+    // largest angle between them and it, 1 if the triangles face too many
+    // ways for the cluster to be culled as a whole
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+/*
+ * One draw of glDrawElementsIndirect, in the layout OpenGL reads it from
+ * GL_DRAW_INDIRECT_BUFFER. firstIndex counts elements, not bytes.
+ */
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/*
+ * What a cull of the meshlets of a mesh left, for profiling.
+ */
+struct MeshletCullStats {
+    GLuint numMeshlets;
+    GLuint numTriangles;
+
+    // the meshlets outside of the frustum, and those inside that face away
+    // from the camera
+    GLuint frustumCulled;
+    GLuint backfaceCulled;
+
+    GLuint visibleMeshlets;
+    GLuint visibleTriangles;
+
+    // how many draws the visible meshlets were merged into
+    GLuint numDraws;
+};
+
+/*
+ * buildMeshlets
+ *
+ * INPUT:
+ *         mesh - a mesh with vertices and elements, in the order of
+ *                optimizeVertexCache.
+ *         meshlets - where the meshlets are written.
+ *         maxVertices - the most vertices of a meshlet.
+ *         maxTriangles - the most triangles of a meshlet.
+ *
+ * RETURN:
+ *         How many meshlets were made.
+ *
+ * DESCRIPTION:
+ *         Splits every submesh of the mesh in meshlets and moves the
+ *         triangles of every meshlet next to each other, so a meshlet is
+ *         a range of elements. A meshlet grows from a triangle onto the
+ *         triangles around it, first those that add no vertex and then
+ *         the closest ones, so it stays round and its normals close
+ *         together. Then the triangles of every meshlet are ordered for
+ *         the vertex cache on their own. The elements outside of the
+ *         submeshes (e.g. levels of detail) do not move.
+ *
+ */
+size_t buildMeshlets(MeshData& mesh, std::vector<Meshlet>& meshlets,
+                     GLuint maxVertices = MESHLET_MAX_VERTICES,
+                     GLuint maxTriangles = MESHLET_MAX_TRIANGLES);
+
+/*
+ * computeMeshletBounds
+ *
+ * INPUT:
+ *         elements - the elements of the mesh.
+ *         vertices - x y z of every vertex of the mesh.
+ *         meshlet - a meshlet whose range is set, its vertices and bounds
+ *                   are written.
+ *
+ */
+void computeMeshletBounds(const GLuint* elements, const float* vertices, Meshlet& meshlet);
+
+/*
+ * getFrustumPlanes
+ *
+ * INPUT:
+ *         matrix - a projection times a view (times a model) matrix, 16
+ *                  floats row after row like the matrices of mathHelper.h.
+ *         planes - where the a b c d of the six planes are written, the
+ *                  inside of the frustum is where a x + b y + c z + d >= 0.
+ *
+ * DESCRIPTION:
+ *         The planes of the frustum in the space the matrix starts from
+ *         (Gribb and Hartmann, Fast Extraction of Viewing Frustum Planes
+ *         from the World-View-Projection Matrix).
+ *
+ */
+void getFrustumPlanes(const float* matrix, float planes[6][4]);
+
+/*
+ * cullMeshlets
+ *
+ * INPUT:
+ *         meshlets - the meshlets of a mesh.
+ *         cameraPosition - x y z of the camera in the space of the mesh,
+ *                          NULL to keep the meshlets that face away.
+ *         modelViewProjection - see getFrustumPlanes, NULL to keep the
+ *                               meshlets outside of the frustum.
+ *         draws - where the draws of the visible meshlets are written.
+ *
+ * RETURN:
+ *         How many meshlets were culled and how many were kept.
+ *
+ * DESCRIPTION:
+ *         Drops the meshlets whose sphere is outside of a plane of the
+ *         frustum, and those whose every triangle faces away from the
+ *         camera from any point of the sphere. The visible meshlets next
+ *         to each other in the element buffer become one draw, ready for
+ *         glMultiDrawElements or an indirect draw buffer.
+ *
+ */
+MeshletCullStats cullMeshlets(const std::vector<Meshlet>& meshlets, const float* cameraPosition,
+                              const float* modelViewProjection,
+                              std::vector<DrawElementsIndirectCommand>& draws);
+
+/*
+ * compactElements
+ *
+ * INPUT:
+ *         elements - the elements of the mesh.
+ *         draws - the draws of cullMeshlets.
+ *         compacted - where the elements of every draw are written, one
+ *                     after the other.
+ *
+ * DESCRIPTION:
+ *         The elements of the visible meshlets as one list, for a single
+ *         glDrawElements from a buffer streamed every frame.
+ *
+ */
+void compactElements(const GLuint* elements, const std::vector<DrawElementsIndirectCommand>& draws,
+                     std::vector<GLuint>& compacted);
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ * numberParser.cpp
+ *
+ * Locale independent parsing of the numbers of text files (.obj, .mtl,
+ * ...). Numbers are read straight from a buffer, no strings are created.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "numberParser.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <float.h>
+#include <locale.h>
+#include <string>
+
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+// Eight characters are tested and converted at once with 64 bit
+// arithmetic, it needs the first character on the lowest byte
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NUMBER_PARSER_SWAR  1
+#endif
+
+// Powers of 10 as doubles, up to 1e22 they are exact
+static const double powersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+    1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29,
+    1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+    1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47, 1e48, 1e49,
+    1e50, 1e51, 1e52, 1e53, 1e54, 1e55, 1e56, 1e57, 1e58, 1e59,
+    1e60, 1e61, 1e62, 1e63, 1e64
+};
+static const int MAX_POWER_OF_TEN = 64;
+
+// Digits that always fit in 64 bits
+static const int MAX_MANTISSA_DIGITS = 19;
+
+static const unsigned long long powersOfTenInt[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL
+};
+
+// The float a double rounds to depends on its low 29 bits, how close to
+// half way between two floats is too close to trust
+static const uint64_t FLOAT_ROUNDING_BITS = 0x1FFFFFFF;
+static const uint64_t FLOAT_HALF_WAY = 0x10000000;
+static const uint64_t FLOAT_HALF_WAY_MARGIN = 8;
+
+static inline bool isDigit (char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+/*
+ * scanDigits
+ *
+ * INPUT:
+ *         p - where the digits start.
+ *         end - the end of the buffer.
+ *         mantissa - the digits are appended to it.
+ *         digits - how many digits mantissa has, -1 once there are more
+ *                  than MAX_MANTISSA_DIGITS.
+ *
+ * RETURN:
+ *         Pointer to the first character that is not a digit.
+ *
+ * DESCRIPTION:
+ *         Reads a run of digits one at a time, the best for the short
+ *         runs (the integer part of most numbers).
+ *
+ */
+static inline const char* scanDigits (const char* p, const char* end,
+                                      unsigned long long& mantissa, int& digits) {
+    while (p < end && isDigit(*p)) {
+        if (digits >= 0 && digits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (*p - '0');
+            ++digits;
+        } else {
+            digits = -1;
+        }
+        ++p;
+    }
+    return p;
+}
+
+/*
+ * scanManyDigits
+ *
+ * INPUT:
+ *         p - where the digits start.
+ *         end - the end of the buffer.
+ *         mantissa - the digits are appended to it.
+ *         digits - how many digits mantissa has, -1 once there are more
+ *                  than MAX_MANTISSA_DIGITS.
+ *
+ * RETURN:
+ *         Pointer to the first character that is not a digit.
+ *
+ * DESCRIPTION:
+ *         Same as scanDigits, but reads the run 8 characters at a time:
+ *         the characters that are not digits are found with a few masks,
+ *         the digits before them are moved to the top of the word (as if
+ *         they had leading zeros) and converted with three multiplications.
+ *         A fractional part like "123456" takes no loop over its digits,
+ *         whatever its length.
+ *
+ */
+static inline const char* scanManyDigits (const char* p, const char* end,
+                                          unsigned long long& mantissa, int& digits) {
+#ifdef NUMBER_PARSER_SWAR
+    while (end - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+
+        // a byte is a digit if its high half is 3 and adding 6 keeps it 3,
+        // nonDigits has the high bit of every other byte set
+        uint64_t high = (chunk & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL;
+        uint64_t carried = ((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL;
+        uint64_t wrong = high | carried;
+        uint64_t nonDigits = (((wrong & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | wrong) &
+                             0x8080808080808080ULL;
+
+        int count = (nonDigits == 0) ? 8 : __builtin_ctzll(nonDigits) / 8;
+        if (count == 0) {
+            return p;
+        }
+
+        if (digits >= 0 && digits + count <= MAX_MANTISSA_DIGITS) {
+            // pairs, then groups of four, then all eight digits
+            chunk <<= (8 - count) * 8;
+            chunk = ((chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+            chunk = ((chunk & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+            chunk = ((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+
+            mantissa = mantissa * powersOfTenInt[count] + chunk;
+            digits += count;
+        } else {
+            digits = -1;
+        }
+
+        p += count;
+        if (count < 8) {
+            return p;
+        }
+    }
+#endif
+
+    return scanDigits(p, end, mantissa, digits);
+}
+
+// The "C" locale, created once
+static locale_t getCLocale () {
+    static locale_t cLocale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+    return cLocale;
+}
+
+// The exact fallback, strtof on a copy of the number
+static float parseFloatSlow (const char* begin, const char* end) {
+    char buffer[64];
+    size_t length = end - begin;
+
+    if (length < sizeof(buffer)) {
+        memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+        return strtof_l(buffer, NULL, getCLocale());
+    }
+
+    std::string copy(begin, end);
+    return strtof_l(copy.c_str(), NULL, getCLocale());
+}
+
+/*
+ * parseFloat
+ *
+ * INPUT:
+ *         p - where the number starts.
+ *         end - the end of the buffer.
+ *         value - where the result is written.
+ *
+ * RETURN:
+ *         Pointer to the first character after the number, or p itself
+ *         if there was no number there.
+ *
+ * DESCRIPTION:
+ *         Scans a decimal number ([+-]digits[.digits][e[+-]digits]). It
+ *         does not depend on the locale, never reads past end and gives
+ *         exactly the float strtof gives for the same characters (in the
+ *         "C" locale).
+ *
+ *         Up to 19 digits go to a 64 bit integer (the fractional part
+ *         eight at a time), which is scaled once by a power of 10 as a
+ *         double. That double is at most a few units away from the
+ *         exact value, so rounding it to float gives the right answer
+ *         unless it is very close to half way between two floats. Those
+ *         numbers, and the ones with more digits or exponents out of the
+ *         table, are given to strtof.
+ *
+ */
+const char* parseFloat (const char* p, const char* end, float& value) {
+    const char* start = p;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+
+    // integer part
+    const char* integer = p;
+    p = scanDigits(p, end, mantissa, digits);
+    bool anyDigit = (p != integer);
+
+    // fractional part, every digit moves the exponent
+    int exponent = 0;
+    if (p < end && *p == '.') {
+        const char* fraction = p + 1;
+        p = scanManyDigits(fraction, end, mantissa, digits);
+        exponent = -(int) (p - fraction);
+        anyDigit = anyDigit || (p != fraction);
+    }
+
+    if (!anyDigit) {
+        return start;
+    }
+
+    // exponent, only consumed if it is well formed
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExp = false;
+
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExp = (*q == '-');
+            ++q;
+        }
+
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+            while (q < end && isDigit(*q)) {
+                if (e < 10000) {
+                    e = e * 10 + (*q - '0');
+                }
+                ++q;
+            }
+            exponent += negativeExp ? -e : e;
+            p = q;
+        }
+    }
+
+    // too many digits, or too far from 1
+    if (digits < 0 || exponent < -MAX_POWER_OF_TEN || exponent > MAX_POWER_OF_TEN) {
+        value = parseFloatSlow(start, p);
+        return p;
+    }
+
+    if (mantissa == 0) {
+        value = negative ? -0.0f : 0.0f;
+        return p;
+    }
+
+    double result = (double) mantissa;
+    result = (exponent < 0) ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+
+    // the double is a few units away from the exact value at most, that
+    // only matters if it is close to half way between two floats (or the
+    // float would be denormal, their half ways are elsewhere)
+    uint64_t bits;
+    memcpy(&bits, &result, sizeof(bits));
+    uint64_t rounding = bits & FLOAT_ROUNDING_BITS;
+    if (result < FLT_MIN || (rounding + FLOAT_HALF_WAY_MARGIN >= FLOAT_HALF_WAY &&
+                             rounding <= FLOAT_HALF_WAY + FLOAT_HALF_WAY_MARGIN)) {
+        value = parseFloatSlow(start, p);
+        return p;
+    }
+
+    value = (float) (negative ? -result : result);
+    return p;
+}
+
+/*
+ * parseInt
+ *
+ * INPUT:
+ *         p - where the number starts.
+ *         end - the end of the buffer.
+ *         value - where the result is written.
+ *
+ * RETURN:
+ *         Pointer to the first character after the number, or p itself
+ *         if there was no number there.
+ *
+ * DESCRIPTION:
+ *         Scans a signed decimal integer.
+ *
+ */
+const char* parseInt (const char* p, const char* end, int& value) {
+    const char* start = p;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    if (p >= end || !isDigit(*p)) {
+        return start;
+    }
+
+    int result = 0;
+    while (p < end && isDigit(*p)) {
+        result = result * 10 + (*p - '0');
+        ++p;
+    }
+
+    value = negative ? -result : result;
+    return p;
+}
@@ -0,0 +1,53 @@
+/*
+ * numberParser.h
+ *
+ * Locale independent parsing of the numbers of text files (.obj, .mtl,
+ * ...). Numbers are read straight from a buffer, no strings are created.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _NUMBERPARSER_H
+#define _NUMBERPARSER_H
+
+/*
+ * parseFloat
+ *
+ * INPUT:
+ *         p - where the number starts.
+ *         end - the end of the buffer.
+ *         value - where the result is written.
+ *
+ * RETURN:
+ *         Pointer to the first character after the number, or p itself
+ *         if there was no number there.
+ *
+ * DESCRIPTION:
+ *         Scans a decimal number ([+-]digits[.digits][e[+-]digits]). It
+ *         does not depend on the locale, never reads past end and gives
+ *         exactly the float strtof gives for the same characters (in the
+ *         "C" locale).
+ *
+ */
+const char* parseFloat (const char* p, const char* end, float& value);
+
+/*
+ * parseInt
+ *
+ * INPUT:
+ *         p - where the number starts.
+ *         end - the end of the buffer.
+ *         value - where the result is written.
+ *
+ * RETURN:
+ *         Pointer to the first character after the number, or p itself
+ *         if there was no number there.
+ *
+ * DESCRIPTION:
+ *         Scans a signed decimal integer.
+ *
+ */
+const char* parseInt (const char* p, const char* end, int& value);
+
+#endif
@@ -0,0 +1,1397 @@
+/*
+ * objReader.cpp
+ *
+ * Wavefront .obj parsing engine. The file is memory mapped and tokenized
+ * in place, so no strings or streams are created while reading it.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "objReader.h"
+#include "numberParser.h"
+#include "zipArchive.h"
+
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace obj
+{
+
+// Chunks smaller than this are not worth a thread of their own
+static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+// Size of the blocks a streamed file is inflated in, and how many of
+// them exist (one being parsed, the others being inflated or waiting)
+static const size_t STREAM_BLOCK_SIZE = 1 << 20;
+static const size_t STREAM_BLOCKS = 3;
+
+// How much more than the estimate of a streamed file is reserved
+static const double STREAM_RESERVE_MARGIN = 1.05;
+
+// Helpers for the scanners
+static inline bool isBlank (char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline const char* skipBlanks (const char* p, const char* end) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+// True if the record at p is keyword, followed by a blank or the end of the line
+static inline bool isKeyword (const char* p, const char* end, const char* keyword, size_t length) {
+    if ((size_t) (end - p) < length || memcmp(p, keyword, length) != 0) {
+        return false;
+    }
+    return p + length == end || isBlank(p[length]) || p[length] == '\r' || p[length] == '\n';
+}
+
+// The text of a record, from p (right after the keyword) to lineEnd
+// without the blanks around it. Returns where it ends
+static inline const char* recordText (const char* p, const char* lineEnd, const char*& text) {
+    text = skipBlanks(p, lineEnd);
+    while (lineEnd > text && (isBlank(lineEnd[-1]) || lineEnd[-1] == '\r')) {
+        --lineEnd;
+    }
+    return lineEnd;
+}
+
+static inline const char* skipLine (const char* p, const char* end) {
+    const char* newline = (const char*) memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// Helpers for the counting pass, they look at 8 characters at a time
+static const uint64_t LOW_BITS = 0x0101010101010101ull;
+static const uint64_t HIGH_BITS = 0x8080808080808080ull;
+
+// 0x80 on every byte of word that is zero, 0 on the others
+static inline uint64_t zeroBytes (uint64_t word) {
+    uint64_t low = word & ~HIGH_BITS;
+    return ~((low + ~HIGH_BITS) | word | ~HIGH_BITS);
+}
+
+// 0x80 on every byte of word that is a blank (or the '\r' of a "\r\n")
+static inline uint64_t blankBytes (uint64_t word) {
+    return zeroBytes(word ^ (LOW_BITS * ' ')) | zeroBytes(word ^ (LOW_BITS * '\t')) |
+           zeroBytes(word ^ (LOW_BITS * '\r'));
+}
+
+// How many bytes of mask are 0x80
+static inline int countMarked (uint64_t mask) {
+    return (int) (((mask >> 7) * LOW_BITS) >> 56);
+}
+
+// Counts the groups of non blank characters between p and end, e.g. the
+// corners of a face line. The text before p counts as blank
+static size_t countWords (const char* p, const char* end) {
+    size_t words = 0;
+    uint64_t previousBlank = 0x80;
+
+    // a word starts on every non blank byte right after a blank one
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+
+        uint64_t blank = blankBytes(word);
+        uint64_t starts = ~blank & HIGH_BITS & ((blank << 8) | previousBlank);
+        words += countMarked(starts);
+
+        previousBlank = (blank >> 56) & 0x80;
+        p += 8;
+    }
+
+    bool blank = previousBlank != 0;
+    for (; p < end; ++p) {
+        bool current = isBlank(*p) || *p == '\r';
+        if (!current && blank) {
+            ++words;
+        }
+        blank = current;
+    }
+    return words;
+}
+
+// Wavefront .obj files start counting from 1, negative values are relative
+// to the end of the list read so far, and 0 means "not there"
+static inline int resolveIndex (int index, size_t count) {
+    if (index > 0) {
+        return index - 1;
+    } else if (index < 0) {
+        return (int) count + index;
+    }
+    return -1;
+}
+
+/*
+ * MappedFile
+ *
+ * DESCRIPTION:
+ *         Default constructor, creates an empty view.
+ *
+ */
+MappedFile::MappedFile () : data(NULL), size(0), mapped(false) {
+}
+
+/*
+ * ~MappedFile
+ *
+ * DESCRIPTION:
+ *         Unmaps the file, if one is open.
+ *
+ */
+MappedFile::~MappedFile () {
+    close();
+}
+
+/*
+ * open
+ *
+ * INPUT:
+ *         filename - the file we want to map.
+ *
+ * RETURN:
+ *         True if the file could be opened, false otherwise.
+ *
+ * DESCRIPTION:
+ *         Maps the whole file in memory. If mmap is not available (or
+ *         fails, e.g. for empty files) the file is read into a buffer
+ *         instead, so callers never have to care which one happened.
+ *         Entries of .zip archives (see zipArchive.h) are inflated into
+ *         the buffer.
+ *
+ */
+bool MappedFile::open (const char* filename) {
+    close();
+
+    if (filename == NULL) {
+        return false;
+    }
+
+    if (isZipPath(filename)) {
+        if (!readZipEntry(filename, buffer)) {
+            return false;
+        }
+        data = buffer.empty() ? NULL : &buffer[0];
+        size = buffer.size();
+        return true;
+    }
+
+#ifndef _WIN32
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            // we only walk forward through the file
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+
+            data = (const char*) address;
+            size = info.st_size;
+            mapped = true;
+            ::close(fd);
+            return true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    // Fallback, read the whole file at once
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (length > 0) {
+        buffer.resize(length);
+        length = fread(&buffer[0], 1, length, fp);
+        buffer.resize(length);
+    }
+    fclose(fp);
+
+    data = buffer.empty() ? NULL : &buffer[0];
+    size = buffer.size();
+    return true;
+}
+
+/*
+ * close
+ *
+ * DESCRIPTION:
+ *         Releases the mapping (or the buffer).
+ *
+ */
+void MappedFile::close () {
+#ifndef _WIN32
+    if (mapped) {
+        munmap((void*) data, size);
+    }
+#endif
+    std::vector<char>().swap(buffer);
+    data = NULL;
+    size = 0;
+    mapped = false;
+}
+
+/*
+ * begin
+ *
+ * RETURN:
+ *         Pointer to the first byte of the file.
+ *
+ */
+const char* MappedFile::begin () const {
+    return data;
+}
+
+/*
+ * end
+ *
+ * RETURN:
+ *         Pointer one past the last byte of the file. The data is NOT
+ *         null terminated, every scan has to stop here.
+ *
+ */
+const char* MappedFile::end () const {
+    return data + size;
+}
+
+/*
+ * getSize
+ *
+ * RETURN:
+ *         The size of the file in bytes.
+ *
+ */
+size_t MappedFile::getSize () const {
+    return size;
+}
+
+/*
+ * clear
+ *
+ * DESCRIPTION:
+ *         Empties every vector.
+ *
+ */
+void ObjData::clear () {
+    vertices.clear();
+    uvtextures.clear();
+    normals.clear();
+    elements.clear();
+    names.clear();
+    materials.clear();
+    materialLibraries.clear();
+    submeshes.clear();
+}
+
+/*
+ * ObjMaterial
+ *
+ * DESCRIPTION:
+ *         Creates a material with the defaults of the .mtl format (Ka
+ *         0.2, Kd 0.8), no specular and no textures.
+ *
+ */
+ObjMaterial::ObjMaterial () {
+    for (int i = 0; i < 3; ++i) {
+        ambient[i] = 0.2f;
+        diffuse[i] = 0.8f;
+        specular[i] = 0.0f;
+    }
+    specExp = 1.0f;
+}
+
+/*
+ * countObjRecords
+ *
+ * INPUT:
+ *         begin - the first character of the text.
+ *         end - one past the last character of the text.
+ *         counts - where the numbers of records are written.
+ *
+ * DESCRIPTION:
+ *         The first pass of the parser. Counts the "v", "vt" and "vn"
+ *         records, the triangles the faces become, the faces with more
+ *         than 3 corners and the "o", "g", "usemtl" and "mtllib" records,
+ *         without converting any number, so the arrays can be allocated
+ *         once at their final size.
+ *         Lines are found with memchr, and only face lines are scanned, 8
+ *         characters at a time (every group of non blank characters after
+ *         the "f" is a corner).
+ *
+ */
+void countObjRecords (const char* begin, const char* end, ObjCounts& counts) {
+    counts.vertices = 0;
+    counts.uvtextures = 0;
+    counts.normals = 0;
+    counts.corners = 0;
+    counts.polygons = 0;
+    counts.marks = 0;
+
+    const char* p = begin;
+    while (p < end) {
+        p = skipBlanks(p, end);
+        if (p >= end) {
+            break;
+        }
+
+        const char* lineEnd = (const char*) memchr(p, '\n', end - p);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+
+        // the same tests parseRecords does
+        char first = *p;
+        char second = (p + 1 < end) ? p[1] : '\n';
+
+        if (first == 'v') {
+            if (isBlank(second)) {
+                ++counts.vertices;
+            } else if (second == 't' && p + 2 < end && isBlank(p[2])) {
+                ++counts.uvtextures;
+            } else if (second == 'n' && p + 2 < end && isBlank(p[2])) {
+                ++counts.normals;
+            }
+        } else if (first == 'f' && isBlank(second)) {
+            // a face of n corners becomes n - 2 triangles
+            size_t corners = countWords(p + 1, lineEnd);
+            if (corners >= 3) {
+                counts.corners += (corners - 2) * 3;
+            }
+            if (corners >= 4) {
+                ++counts.polygons;
+            }
+        } else if (isKeyword(p, lineEnd, "o", 1) || isKeyword(p, lineEnd, "g", 1) ||
+                   isKeyword(p, lineEnd, "usemtl", 6) || isKeyword(p, lineEnd, "mtllib", 6)) {
+            ++counts.marks;
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+/*
+ * A face with more than 3 corners, already written as a fan of triangles
+ * (0 1 2, 0 2 3, 0 3 4, ...) starting at elements.
+ */
+struct ObjPolygon {
+    int* elements;
+    int corners;
+};
+
+// The records that are kept as marks
+enum ObjMarkType {
+    MARK_NAME = 0,
+    MARK_MATERIAL,
+    MARK_LIBRARY
+};
+
+/*
+ * An "o", "g", "usemtl" or "mtllib" record. The triangles from corner on
+ * (counted from where the parse started) have the name or material of
+ * text, a library is just a file to read.
+ */
+struct ObjMark {
+    size_t corner;
+    ObjMarkType type;
+    const char* text;
+    const char* textEnd;
+};
+
+/*
+ * Where parseRecords writes, every pointer is the next free position of
+ * an array that was already allocated with the counts of the first pass.
+ */
+struct ObjTarget {
+    float* vertices;
+    float* uvtextures;
+    float* normals;
+    int* elements;
+
+    // elements never goes past this, in case a malformed face line had
+    // more corners than the first pass saw
+    int* elementsEnd;
+
+    // faces with more than 3 corners, to be checked by clipPolygons once
+    // every position is known
+    ObjPolygon* polygons;
+    ObjPolygon* polygonsEnd;
+
+    // "o", "g" and "usemtl" records, turned into submeshes at the end
+    ObjMark* marks;
+    ObjMark* marksEnd;
+
+    // records before the current position, for relative indices
+    size_t numVertices, numTextures, numNormals;
+};
+
+// Parses up to count floats of a record into values, missing ones are 0
+static inline const char* parseValues (const char* p, const char* end, float* values, int count) {
+    for (int i = 0; i < count; ++i) {
+        values[i] = 0.0f;
+        p = parseFloat(skipBlanks(p, end), end, values[i]);
+    }
+    return p;
+}
+
+/*
+ * parseRecords
+ *
+ * DESCRIPTION:
+ *         The second pass of parseObjBuffer, for one mask of attributes.
+ *         Attributes is a template argument so every test on it is
+ *         resolved when the function is compiled.
+ *
+ */
+template <unsigned int Attributes>
+static void parseRecords (const char* begin, const char* end, ObjTarget& target) {
+    const bool wantPositions = (Attributes & OBJ_POSITION) != 0;
+    const bool wantTextures = (Attributes & OBJ_TEXCOORD) != 0;
+    const bool wantNormals = (Attributes & OBJ_NORMAL) != 0;
+
+    int* const elementsBegin = target.elements;
+    const char* p = begin;
+
+    while (p < end) {
+        p = skipBlanks(p, end);
+        if (p >= end) {
+            break;
+        }
+
+        char first = *p;
+        char second = (p + 1 < end) ? p[1] : '\n';
+
+        // vertices, textures and normals
+        if (first == 'v') {
+            if (isBlank(second)) {
+                if (wantPositions) {
+                    p = parseValues(p + 1, end, target.vertices, 3);
+                    target.vertices += 3;
+                    ++target.numVertices;
+                }
+            } else if (second == 't' && p + 2 < end && isBlank(p[2])) {
+                if (wantTextures) {
+                    p = parseValues(p + 2, end, target.uvtextures, 2);
+                    target.uvtextures += 2;
+                    ++target.numTextures;
+                }
+            } else if (second == 'n' && p + 2 < end && isBlank(p[2])) {
+                if (wantNormals) {
+                    p = parseValues(p + 2, end, target.normals, 3);
+                    target.normals += 3;
+                    ++target.numNormals;
+                }
+            }
+        } // faces
+        else if (first == 'f' && isBlank(second)) {
+            // the face is written as a fan while it is read, every corner
+            // after the second one closes the triangle (first, previous, it)
+            int* faceElements = target.elements;
+            int firstCorner[3], previousCorner[3], corner[3];
+            int numCorners = 0;
+
+            p += 1;
+            while (true) {
+                p = skipBlanks(p, end);
+
+                // every corner is like "1", "1/2", "1//3" or "1/2/3"
+                int v = 0, vt = 0, vn = 0;
+                const char* next = parseInt(p, end, v);
+                if (next == p) {
+                    break;
+                }
+                p = next;
+
+                if (p < end && *p == '/') {
+                    ++p;
+                    p = parseInt(p, end, vt);
+                    if (p < end && *p == '/') {
+                        ++p;
+                        p = parseInt(p, end, vn);
+                    }
+                }
+
+                // the attributes we do not want are simply missing
+                corner[0] = wantPositions ? resolveIndex(v, target.numVertices) : -1;
+                corner[1] = wantTextures ? resolveIndex(vt, target.numTextures) : -1;
+                corner[2] = wantNormals ? resolveIndex(vn, target.numNormals) : -1;
+
+                if (numCorners == 0) {
+                    std::copy(corner, corner + 3, firstCorner);
+                } else if (numCorners >= 2) {
+                    if (target.elementsEnd - target.elements < 9) {
+                        break;
+                    }
+                    std::copy(firstCorner, firstCorner + 3, target.elements);
+                    std::copy(previousCorner, previousCorner + 3, target.elements + 3);
+                    std::copy(corner, corner + 3, target.elements + 6);
+                    target.elements += 9;
+                }
+
+                std::copy(corner, corner + 3, previousCorner);
+                ++numCorners;
+            }
+
+            // the fan is only right for convex faces, check it later
+            int written = (int) (target.elements - faceElements) / 9 + 2;
+            if (written >= 4 && target.polygons < target.polygonsEnd) {
+                target.polygons->elements = faceElements;
+                target.polygons->corners = written;
+                ++target.polygons;
+            }
+        } // objects, groups and materials
+        else if (first == 'o' || first == 'g' || first == 'u' || first == 'm') {
+            const char* lineEnd = (const char*) memchr(p, '\n', end - p);
+            if (lineEnd == NULL) {
+                lineEnd = end;
+            }
+
+            int keywordLength = 0;
+            ObjMarkType type = MARK_NAME;
+            if (isKeyword(p, lineEnd, "o", 1) || isKeyword(p, lineEnd, "g", 1)) {
+                keywordLength = 1;
+            } else if (isKeyword(p, lineEnd, "usemtl", 6)) {
+                keywordLength = 6;
+                type = MARK_MATERIAL;
+            } else if (isKeyword(p, lineEnd, "mtllib", 6)) {
+                keywordLength = 6;
+                type = MARK_LIBRARY;
+            }
+
+            if (keywordLength > 0 && target.marks < target.marksEnd) {
+                target.marks->corner = (target.elements - elementsBegin) / 3;
+                target.marks->type = type;
+                target.marks->textEnd = recordText(p + keywordLength, lineEnd, target.marks->text);
+                ++target.marks;
+            }
+            p = lineEnd;
+        }
+
+        p = skipLine(p, end);
+    }
+}
+
+// One parser for every mask of attributes, indexed by the mask
+typedef void (*RecordParser) (const char*, const char*, ObjTarget&);
+
+static const RecordParser recordParsers[OBJ_ALL + 1] = {
+    parseRecords<0>, parseRecords<1>, parseRecords<2>, parseRecords<3>,
+    parseRecords<4>, parseRecords<5>, parseRecords<6>, parseRecords<7>
+};
+
+// Makes room on data (and polygons and marks) for the records of counts,
+// keeping what is already on data, and returns where the new ones go
+static ObjTarget allocateRecords (ObjData& data, std::vector<ObjPolygon>& polygons,
+                                  std::vector<ObjMark>& marks, const ObjCounts& counts,
+                                  unsigned int attributes) {
+    size_t vertexStart = data.vertices.size();
+    size_t textureStart = data.uvtextures.size();
+    size_t normalStart = data.normals.size();
+    size_t elementStart = data.elements.size();
+
+    if (attributes & OBJ_POSITION) data.vertices.resize(vertexStart + counts.vertices * 3);
+    if (attributes & OBJ_TEXCOORD) data.uvtextures.resize(textureStart + counts.uvtextures * 2);
+    if (attributes & OBJ_NORMAL)   data.normals.resize(normalStart + counts.normals * 3);
+    data.elements.resize(elementStart + counts.corners * 3);
+
+    ObjTarget target;
+    target.vertices = data.vertices.empty() ? NULL : &data.vertices[0] + vertexStart;
+    target.uvtextures = data.uvtextures.empty() ? NULL : &data.uvtextures[0] + textureStart;
+    target.normals = data.normals.empty() ? NULL : &data.normals[0] + normalStart;
+    target.elements = data.elements.empty() ? NULL : &data.elements[0] + elementStart;
+    target.elementsEnd = target.elements + counts.corners * 3;
+
+    polygons.resize(counts.polygons);
+    target.polygons = polygons.empty() ? NULL : &polygons[0];
+    target.polygonsEnd = target.polygons + polygons.size();
+
+    marks.resize(counts.marks);
+    target.marks = marks.empty() ? NULL : &marks[0];
+    target.marksEnd = target.marks + marks.size();
+
+    target.numVertices = vertexStart / 3;
+    target.numTextures = textureStart / 2;
+    target.numNormals = normalStart / 3;
+    return target;
+}
+
+// Faces with more corners than this keep their fan
+static const int MAX_POLYGON_CORNERS = 64;
+
+// Twice the signed area of the 2D triangle a b c, positive if counter clockwise
+static inline float cross2D (const float* a, const float* b, const float* c) {
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+/*
+ * clipPolygon
+ *
+ * INPUT:
+ *         polygon - a face that parseRecords wrote as a fan.
+ *         vertices - every position of the file.
+ *
+ * DESCRIPTION:
+ *         Convex faces are left as they are, the fan is already right. The
+ *         others are triangulated again by ear clipping, in the same place
+ *         (n - 2 triangles either way) and with the same winding. Everything
+ *         lives on the stack, no memory is allocated per face.
+ *
+ */
+static void clipPolygon (const ObjPolygon& polygon, const std::vector<float>& vertices) {
+    int n = polygon.corners;
+    if (n > MAX_POLYGON_CORNERS) {
+        return;
+    }
+
+    // the corners, out of the fan: the first triangle has 0 1 2 and
+    // triangle i ends with corner i + 2
+    int corners[MAX_POLYGON_CORNERS][3];
+    std::copy(polygon.elements, polygon.elements + 6, &corners[0][0]);
+    for (int i = 0; i < n - 2; ++i) {
+        std::copy(polygon.elements + i * 9 + 6, polygon.elements + i * 9 + 9, corners[i + 2]);
+    }
+
+    // their positions
+    const float* positions[MAX_POLYGON_CORNERS];
+    for (int i = 0; i < n; ++i) {
+        int v = corners[i][0];
+        if (v < 0 || (size_t) v * 3 + 2 >= vertices.size()) {
+            return;
+        }
+        positions[i] = &vertices[v * 3];
+    }
+
+    // normal of the face (Newell's method), we work on the plane of the
+    // two axes where it is the largest
+    float normal[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < n; ++i) {
+        const float* a = positions[i];
+        const float* b = positions[(i + 1) % n];
+        normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+        normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+        normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+    }
+
+    int drop = 0;
+    if (fabs(normal[1]) > fabs(normal[drop])) drop = 1;
+    if (fabs(normal[2]) > fabs(normal[drop])) drop = 2;
+    int axisU = (drop + 1) % 3;
+    int axisV = (drop + 2) % 3;
+
+    // the corners on that plane, oriented so the face is counter clockwise
+    float flat[MAX_POLYGON_CORNERS][2];
+    float orientation = normal[drop] < 0.0f ? -1.0f : 1.0f;
+    if (normal[drop] == 0.0f) {
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        flat[i][0] = positions[i][axisU];
+        flat[i][1] = positions[i][axisV] * orientation;
+    }
+
+    // convex, the fan stays
+    bool convex = true;
+    for (int i = 0; i < n && convex; ++i) {
+        convex = cross2D(flat[i], flat[(i + 1) % n], flat[(i + 2) % n]) >= 0.0f;
+    }
+    if (convex) {
+        return;
+    }
+
+    // Ear clipping: cut a convex corner whose triangle has no other corner
+    // inside, until only one triangle is left
+    int remaining[MAX_POLYGON_CORNERS];
+    for (int i = 0; i < n; ++i) {
+        remaining[i] = i;
+    }
+
+    int* out = polygon.elements;
+    for (int count = n; count >= 3; --count) {
+        int ear = 0;
+
+        for (int i = 0; i < count && count > 3; ++i) {
+            int a = remaining[(i + count - 1) % count];
+            int b = remaining[i];
+            int c = remaining[(i + 1) % count];
+            if (cross2D(flat[a], flat[b], flat[c]) <= 0.0f) {
+                continue;
+            }
+
+            bool empty = true;
+            for (int j = 0; j < count && empty; ++j) {
+                int r = remaining[j];
+                if (r == a || r == b || r == c) {
+                    continue;
+                }
+                empty = !(cross2D(flat[a], flat[b], flat[r]) >= 0.0f &&
+                          cross2D(flat[b], flat[c], flat[r]) >= 0.0f &&
+                          cross2D(flat[c], flat[a], flat[r]) >= 0.0f);
+            }
+
+            if (empty) {
+                ear = i;
+                break;
+            }
+        }
+
+        // with no ear (degenerate faces) we cut the first corner anyway
+        int a = remaining[(ear + count - 1) % count];
+        int b = remaining[ear];
+        int c = remaining[(ear + 1) % count];
+        std::copy(corners[a], corners[a] + 3, out);
+        std::copy(corners[b], corners[b] + 3, out + 3);
+        std::copy(corners[c], corners[c] + 3, out + 6);
+        out += 9;
+
+        std::copy(remaining + ear + 1, remaining + count, remaining + ear);
+    }
+}
+
+// Runs clipPolygon on a list of polygons
+static void clipPolygons (const ObjPolygon* begin, const ObjPolygon* end,
+                          const std::vector<float>& vertices) {
+    for (const ObjPolygon* polygon = begin; polygon < end; ++polygon) {
+        clipPolygon(*polygon, vertices);
+    }
+}
+
+/*
+ * How the submeshes are built from the marks: the triangles from start
+ * on have the current name and material, until the next mark.
+ */
+struct ObjSubmeshState {
+    size_t start;
+    int name;
+    int material;
+
+    // what each text is on ObjData::names and ObjData::materials
+    std::map<std::string, int> nameIndices;
+    std::map<std::string, int> materialIndices;
+};
+
+// Index of text on list, it is added if it is not there yet
+static int findName (std::vector<std::string>& list, std::map<std::string, int>& indices,
+                     const std::string& text) {
+    std::map<std::string, int>::iterator it = indices.find(text);
+    if (it != indices.end()) {
+        return it->second;
+    }
+
+    int index = (int) list.size();
+    list.push_back(text);
+    indices[text] = index;
+    return index;
+}
+
+// Closes the submesh of state at corner, empty ones are not kept and the
+// last one is extended if it has the same name and material
+static void closeSubmesh (ObjData& data, ObjSubmeshState& state, size_t corner) {
+    if (corner > state.start) {
+        ObjSubmesh* last = data.submeshes.empty() ? NULL : &data.submeshes.back();
+        if (last != NULL && last->name == state.name && last->material == state.material &&
+            last->firstCorner + last->numCorners == state.start) {
+            last->numCorners += corner - state.start;
+        } else {
+            ObjSubmesh submesh = { state.start, corner - state.start, state.name, state.material };
+            data.submeshes.push_back(submesh);
+        }
+    }
+    state.start = corner;
+}
+
+// Starts the submeshes of a parse whose first corner is start, the faces
+// keep the name and material of the last submesh already on data
+static void beginSubmeshes (ObjData& data, ObjSubmeshState& state, size_t start) {
+    state.start = start;
+    state.name = data.submeshes.empty() ? -1 : data.submeshes.back().name;
+    state.material = data.submeshes.empty() ? -1 : data.submeshes.back().material;
+
+    for (size_t i = 0; i < data.names.size(); ++i) {
+        state.nameIndices[data.names[i]] = (int) i;
+    }
+    for (size_t i = 0; i < data.materials.size(); ++i) {
+        state.materialIndices[data.materials[i]] = (int) i;
+    }
+}
+
+// Adds the files of a "mtllib" record that are not on data yet
+static void addLibraries (ObjData& data, const char* p, const char* end) {
+    while (p < end) {
+        const char* fileEnd = p;
+        while (fileEnd < end && !isBlank(*fileEnd)) {
+            ++fileEnd;
+        }
+
+        std::string library(p, fileEnd);
+        if (std::find(data.materialLibraries.begin(), data.materialLibraries.end(), library) ==
+            data.materialLibraries.end()) {
+            data.materialLibraries.push_back(library);
+        }
+        p = skipBlanks(fileEnd, end);
+    }
+}
+
+// Applies the marks of a parse whose corners start at firstCorner
+static void addSubmeshes (ObjData& data, ObjSubmeshState& state, const ObjMark* begin,
+                          const ObjMark* end, size_t firstCorner) {
+    for (const ObjMark* mark = begin; mark < end; ++mark) {
+        if (mark->type == MARK_LIBRARY) {
+            addLibraries(data, mark->text, mark->textEnd);
+            continue;
+        }
+
+        closeSubmesh(data, state, firstCorner + mark->corner);
+
+        std::string text(mark->text, mark->textEnd);
+        if (mark->type == MARK_MATERIAL) {
+            state.material = findName(data.materials, state.materialIndices, text);
+        } else {
+            state.name = findName(data.names, state.nameIndices, text);
+        }
+    }
+}
+
+/*
+ * parseObjBuffer
+ *
+ * INPUT:
+ *         begin - the first character of the text.
+ *         end - one past the last character of the text.
+ *         data - where the records are appended.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * DESCRIPTION:
+ *         Tokenizes the .obj text in place and appends its "v", "vt", "vn"
+ *         and "f" records to data. The "o", "g" and "usemtl" records split
+ *         the triangles in data.submeshes, a new submesh starts whenever
+ *         the name or the material changes (the same name or material used
+ *         again gets the same index). The files of the "mtllib" records
+ *         go to data.materialLibraries. Every other record is skipped, and so
+ *         are the records and corner indices of attributes not in the
+ *         mask. Faces can mix the patterns "1", "1/2", "1//3" and "1/2/3".
+ *         Negative (relative) face indices are resolved against what is
+ *         already in data, so the same ObjData can be fed several
+ *         consecutive buffers.
+ *
+ *         Faces with more than 3 corners are triangulated while they are
+ *         read, as a fan from their first corner. Once the positions are
+ *         all known the concave ones are triangulated again by ear
+ *         clipping, in place. Faces with less than 3 corners are dropped.
+ *
+ *         The text is read twice: countObjRecords sizes every array of
+ *         data once, then the records are written straight into them.
+ *         There is one parser per mask, chosen once per call, so the
+ *         inner loop never checks the mask.
+ *
+ */
+void parseObjBuffer (const char* begin, const char* end, ObjData& data, unsigned int attributes) {
+    ObjCounts counts;
+    countObjRecords(begin, end, counts);
+
+    size_t firstCorner = data.elements.size() / 3;
+
+    std::vector<ObjPolygon> polygons;
+    std::vector<ObjMark> marks;
+    ObjTarget target = allocateRecords(data, polygons, marks, counts, attributes);
+    recordParsers[attributes & OBJ_ALL](begin, end, target);
+
+    if (!polygons.empty()) {
+        clipPolygons(&polygons[0], target.polygons, data.vertices);
+    }
+
+    // only a malformed face line leaves elements unused
+    size_t unused = target.elementsEnd - target.elements;
+    data.elements.resize(data.elements.size() - unused);
+
+    ObjSubmeshState state;
+    beginSubmeshes(data, state, firstCorner);
+    if (!marks.empty()) {
+        addSubmeshes(data, state, &marks[0], target.marks, firstCorner);
+    }
+    closeSubmesh(data, state, data.elements.size() / 3);
+}
+
+/*
+ * One chunk of the file, parsed on its own thread straight into its part
+ * of the final arrays.
+ */
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    unsigned int attributes;
+    ObjCounts counts;
+    ObjTarget target;
+
+    // polygons of the chunk start at target.polygonsEnd - counts.polygons
+    const std::vector<float>* vertices;
+};
+
+// First pass of one chunk, run by the worker threads
+static void countChunk (ObjChunk* chunk) {
+    countObjRecords(chunk->begin, chunk->end, chunk->counts);
+}
+
+// Second pass of one chunk, run by the worker threads
+static void parseChunk (ObjChunk* chunk) {
+    recordParsers[chunk->attributes & OBJ_ALL](chunk->begin, chunk->end, chunk->target);
+}
+
+// Ear clipping of the polygons of one chunk, run once every chunk is parsed
+static void clipChunk (ObjChunk* chunk) {
+    const ObjTarget& target = chunk->target;
+    clipPolygons(target.polygonsEnd - chunk->counts.polygons, target.polygons, *chunk->vertices);
+}
+
+// Runs function on every chunk, the last one on this thread
+static void runOnChunks (void (*function)(ObjChunk*), std::vector<ObjChunk>& chunks) {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < chunks.size(); ++i) {
+        workers.push_back(std::thread(function, &chunks[i]));
+    }
+    function(&chunks.back());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+/*
+ * parseObjFile
+ *
+ * INPUT:
+ *         file - an .obj file that is already mapped.
+ *         data - where the records are written.
+ *         numThreads - how many threads parse the file. 1 parses it on the
+ *                      calling thread, 0 uses every core of the machine.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * DESCRIPTION:
+ *         Runs parseObjBuffer over all of the file. With more than one
+ *         thread the file is split in chunks at newline boundaries and
+ *         both passes run on every chunk in parallel. In between, the
+ *         counts tell where each chunk starts on the final arrays, so the
+ *         chunks are parsed straight into place and data ends up exactly
+ *         the same as on the serial parse.
+ *
+ */
+void parseObjFile (const MappedFile& file, ObjData& data, int numThreads,
+                   unsigned int attributes) {
+    data.clear();
+
+    if (numThreads <= 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+
+    // small files are not worth splitting
+    size_t maxChunks = file.getSize() / MIN_CHUNK_SIZE;
+    if ((size_t) numThreads > maxChunks) {
+        numThreads = (int) maxChunks;
+    }
+
+    if (numThreads <= 1) {
+        parseObjBuffer(file.begin(), file.end(), data, attributes);
+        return;
+    }
+
+    // Splitting the file, every chunk ends right after a newline
+    std::vector<ObjChunk> chunks(numThreads);
+    const char* start = file.begin();
+    for (int i = 0; i < numThreads; ++i) {
+        const char* stop = file.begin() + (file.getSize() * (i + 1)) / numThreads;
+        if (i == numThreads - 1 || stop >= file.end()) {
+            stop = file.end();
+        } else {
+            const char* newline = (const char*) memchr(stop, '\n', file.end() - stop);
+            stop = newline ? newline + 1 : file.end();
+        }
+
+        chunks[i].begin = start;
+        chunks[i].end = stop < start ? start : stop;
+        chunks[i].attributes = attributes;
+        start = chunks[i].end;
+    }
+
+    // First pass
+    runOnChunks(countChunk, chunks);
+
+    // Every array is allocated once, and every chunk gets its part of it
+    ObjCounts total = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < numThreads; ++i) {
+        total.vertices += chunks[i].counts.vertices;
+        total.uvtextures += chunks[i].counts.uvtextures;
+        total.normals += chunks[i].counts.normals;
+        total.corners += chunks[i].counts.corners;
+        total.polygons += chunks[i].counts.polygons;
+        total.marks += chunks[i].counts.marks;
+    }
+
+    std::vector<ObjPolygon> polygons;
+    std::vector<ObjMark> marks;
+    ObjTarget next = allocateRecords(data, polygons, marks, total, attributes);
+    for (int i = 0; i < numThreads; ++i) {
+        const ObjCounts& counts = chunks[i].counts;
+        ObjTarget& target = chunks[i].target;
+
+        target = next;
+        target.elementsEnd = target.elements + counts.corners * 3;
+        target.polygonsEnd = target.polygons + counts.polygons;
+        target.marksEnd = target.marks + counts.marks;
+
+        if (attributes & OBJ_POSITION) {
+            next.vertices += counts.vertices * 3;
+            next.numVertices += counts.vertices;
+        }
+        if (attributes & OBJ_TEXCOORD) {
+            next.uvtextures += counts.uvtextures * 2;
+            next.numTextures += counts.uvtextures;
+        }
+        if (attributes & OBJ_NORMAL) {
+            next.normals += counts.normals * 3;
+            next.numNormals += counts.normals;
+        }
+        next.elements = target.elementsEnd;
+        next.polygons = target.polygonsEnd;
+        next.marks = target.marksEnd;
+    }
+
+    // Second pass
+    runOnChunks(parseChunk, chunks);
+
+    // the concave faces need the positions of every chunk
+    if (!polygons.empty()) {
+        for (int i = 0; i < numThreads; ++i) {
+            chunks[i].vertices = &data.vertices;
+        }
+        runOnChunks(clipChunk, chunks);
+    }
+
+    // only a malformed face line leaves elements unused, close the gaps.
+    // The marks of every chunk are counted from where it ends up
+    ObjSubmeshState state;
+    beginSubmeshes(data, state, 0);
+
+    int* first = data.elements.empty() ? NULL : &data.elements[0];
+    int* write = first;
+    for (int i = 0; i < numThreads; ++i) {
+        const ObjTarget& target = chunks[i].target;
+        int* chunkBegin = target.elementsEnd - chunks[i].counts.corners * 3;
+        if (write != chunkBegin) {
+            memmove(write, chunkBegin, (target.elements - chunkBegin) * sizeof(int));
+        }
+
+        addSubmeshes(data, state, target.marksEnd - chunks[i].counts.marks, target.marks,
+                     (write - first) / 3);
+        write += target.elements - chunkBegin;
+    }
+    data.elements.resize(write - first);
+    closeSubmesh(data, state, data.elements.size() / 3);
+}
+
+/*
+ * The blocks of a streamed file, passed between the thread that inflates
+ * them and the one that parses them.
+ */
+struct ObjStreamQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    // whole lines, waiting to be parsed
+    std::deque<std::vector<char> > full;
+
+    // parsed, waiting to be filled again
+    std::vector<std::vector<char> > empty;
+
+    // no more blocks will be added to full
+    bool done;
+};
+
+// Moves a block from one list of the queue to the other
+static void pushBlock (ObjStreamQueue& queue, std::vector<char>& block, bool full) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (full) {
+        queue.full.push_back(std::vector<char>());
+        queue.full.back().swap(block);
+    } else {
+        queue.empty.push_back(std::vector<char>());
+        queue.empty.back().swap(block);
+    }
+    queue.changed.notify_all();
+}
+
+/*
+ * inflateBlocks
+ *
+ * INPUT:
+ *         reader - the entry being streamed.
+ *         queue - where the blocks go.
+ *
+ * DESCRIPTION:
+ *         What the inflating thread does: fills the empty blocks of queue
+ *         with the next part of the entry. A block always ends at the end
+ *         of a line, the rest is carried to the start of the next one.
+ *
+ */
+static void inflateBlocks (ZipEntryReader* reader, ObjStreamQueue* queue) {
+    std::vector<char> carry;
+    std::vector<char> block;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            while (queue->empty.empty()) {
+                queue->changed.wait(lock);
+            }
+            block.swap(queue->empty.back());
+            queue->empty.pop_back();
+        }
+
+        block.assign(carry.begin(), carry.end());
+        size_t start = block.size();
+        block.resize(start + STREAM_BLOCK_SIZE);
+        size_t length = reader->read(&block[start], STREAM_BLOCK_SIZE);
+        block.resize(start + length);
+
+        // the end of the entry, whatever is left is the last line
+        if (length < STREAM_BLOCK_SIZE) {
+            carry.clear();
+            pushBlock(*queue, block, !block.empty());
+
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->done = true;
+            queue->changed.notify_all();
+            return;
+        }
+
+        // a line longer than a block keeps growing the carry
+        const char* first = &block[0];
+        const char* last = first + block.size();
+        while (last > first && last[-1] != '\n') {
+            --last;
+        }
+        carry.assign(last, first + block.size());
+        block.resize(last - first);
+        pushBlock(*queue, block, !block.empty());
+    }
+}
+
+/*
+ * parseObjStream
+ *
+ * INPUT:
+ *         reader - an entry of a .zip archive, open and not read yet.
+ *         data - where the records are appended.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * RETURN:
+ *         False if the entry could not be inflated.
+ *
+ * DESCRIPTION:
+ *         Parses an .obj while it is inflated. A second thread inflates
+ *         the entry in blocks of whole lines while this one runs
+ *         parseObjBuffer on the block before, so inflating overlaps
+ *         parsing and the whole text is never in memory. data ends up the
+ *         same as if the text was parsed at once, except for concave faces
+ *         using positions that come after them on the file (they keep
+ *         their fan).
+ *
+ */
+bool parseObjStream (ZipEntryReader& reader, ObjData& data, unsigned int attributes) {
+    ObjStreamQueue queue;
+    queue.empty.resize(STREAM_BLOCKS);
+    queue.done = false;
+
+    std::thread inflating(inflateBlocks, &reader, &queue);
+
+    std::vector<char> block;
+    size_t parsed = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            while (queue.full.empty() && !queue.done) {
+                queue.changed.wait(lock);
+            }
+            if (queue.full.empty()) {
+                break;
+            }
+            block.swap(queue.full.front());
+            queue.full.pop_front();
+        }
+
+        parseObjBuffer(&block[0], &block[0] + block.size(), data, attributes);
+        parsed += block.size();
+        pushBlock(queue, block, false);
+
+        // the rest of the file probably looks like the first block, the
+        // arrays are reserved once instead of growing block after block
+        if (parsed < reader.getSize() && data.vertices.capacity() == data.vertices.size()) {
+            double scale = (double) reader.getSize() / parsed * STREAM_RESERVE_MARGIN;
+            data.vertices.reserve((size_t) (data.vertices.size() * scale));
+            data.uvtextures.reserve((size_t) (data.uvtextures.size() * scale));
+            data.normals.reserve((size_t) (data.normals.size() * scale));
+            data.elements.reserve((size_t) (data.elements.size() * scale));
+        }
+    }
+
+    inflating.join();
+    return !reader.hasFailed();
+}
+
+/*
+ * readObjFile
+ *
+ * INPUT:
+ *         filename - the .obj file we want to read.
+ *         data - where the records are written.
+ *         numThreads - how many threads parse the file. 1 parses it on the
+ *                      calling thread, 0 uses every core of the machine.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * RETURN:
+ *         True if the file could be read, false otherwise.
+ *
+ * DESCRIPTION:
+ *         Maps the file and parses it with parseObjFile. Entries of .zip
+ *         archives (e.g. "objects/teapot.zip/teapot.obj") are parsed while
+ *         they are inflated, with parseObjStream.
+ *
+ */
+bool readObjFile (const char* filename, ObjData& data, int numThreads,
+                  unsigned int attributes) {
+    MappedFile file;
+
+    data.clear();
+    if (isZipPath(filename)) {
+        ZipEntryReader reader;
+        return reader.open(filename) && parseObjStream(reader, data, attributes);
+    }
+
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    parseObjFile(file, data, numThreads, attributes);
+    return true;
+}
+
+// The file of a texture record, the last word of its text
+static std::string textureFile (const char* text, const char* textEnd) {
+    const char* file = textEnd;
+    while (file > text && !isBlank(file[-1])) {
+        --file;
+    }
+    return std::string(file, textEnd);
+}
+
+/*
+ * parseMtlBuffer
+ *
+ * INPUT:
+ *         begin - the first character of the text.
+ *         end - one past the last character of the text.
+ *         materials - where the materials are appended.
+ *
+ * DESCRIPTION:
+ *         Reads the "newmtl" records of an .mtl text and the colors,
+ *         exponent and texture files of each one. Values a material does
+ *         not have keep the defaults of ObjMaterial. The options of the texture records (e.g. "-s 1 1 1")
+ *         are skipped, the file is the last word of the line.
+ *
+ */
+void parseMtlBuffer (const char* begin, const char* end, std::vector<ObjMaterial>& materials) {
+    ObjMaterial* material = NULL;
+
+    const char* p = begin;
+    while (p < end) {
+        p = skipBlanks(p, end);
+        const char* lineEnd = (const char*) memchr(p, '\n', end - p);
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+
+        const char* text;
+        const char* textEnd;
+
+        if (isKeyword(p, lineEnd, "newmtl", 6)) {
+            textEnd = recordText(p + 6, lineEnd, text);
+            materials.push_back(ObjMaterial());
+            material = &materials.back();
+            material->name.assign(text, textEnd);
+        } else if (material == NULL) {
+            // nothing before the first material matters
+        } else if (isKeyword(p, lineEnd, "Ka", 2)) {
+            parseValues(p + 2, lineEnd, material->ambient, 3);
+        } else if (isKeyword(p, lineEnd, "Kd", 2)) {
+            parseValues(p + 2, lineEnd, material->diffuse, 3);
+        } else if (isKeyword(p, lineEnd, "Ks", 2)) {
+            parseValues(p + 2, lineEnd, material->specular, 3);
+        } else if (isKeyword(p, lineEnd, "Ns", 2)) {
+            parseValues(p + 2, lineEnd, &material->specExp, 1);
+        } else if (isKeyword(p, lineEnd, "map_Kd", 6)) {
+            textEnd = recordText(p + 6, lineEnd, text);
+            material->diffuseMap = textureFile(text, textEnd);
+        } else if (isKeyword(p, lineEnd, "map_Ks", 6)) {
+            textEnd = recordText(p + 6, lineEnd, text);
+            material->specularMap = textureFile(text, textEnd);
+        } else if (isKeyword(p, lineEnd, "map_Bump", 8) || isKeyword(p, lineEnd, "map_bump", 8)) {
+            textEnd = recordText(p + 8, lineEnd, text);
+            material->normalMap = textureFile(text, textEnd);
+        } else if (isKeyword(p, lineEnd, "bump", 4) || isKeyword(p, lineEnd, "norm", 4)) {
+            textEnd = recordText(p + 4, lineEnd, text);
+            material->normalMap = textureFile(text, textEnd);
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+/*
+ * readMtlFile
+ *
+ * INPUT:
+ *         filename - the .mtl file we want to read.
+ *         materials - where the materials are appended.
+ *
+ * RETURN:
+ *         True if the file could be read, false otherwise.
+ *
+ * DESCRIPTION:
+ *         Maps the file and parses it with parseMtlBuffer.
+ *
+ */
+bool readMtlFile (const char* filename, std::vector<ObjMaterial>& materials) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    parseMtlBuffer(file.begin(), file.end(), materials);
+    return true;
+}
+
+} // end namespace
@@ -0,0 +1,391 @@
+/*
+ * objReader.h
+ *
+ * Wavefront .obj parsing engine. The file is memory mapped and tokenized
+ * in place, so no strings or streams are created while reading it.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _OBJREADER_H
+#define _OBJREADER_H
+
+#include <vector>
+#include <string>
+#include <stddef.h>
+#include <stdio.h>
+
+class ZipEntryReader;
+
+// The attributes of a face corner, combined in a mask to tell the parser
+// which ones we want. The ones left out are not even stored
+#define OBJ_POSITION  1
+#define OBJ_TEXCOORD  2
+#define OBJ_NORMAL    4
+#define OBJ_ALL       (OBJ_POSITION | OBJ_TEXCOORD | OBJ_NORMAL)
+
+namespace obj
+{
+
+/*
+ * The MappedFile class, a read only view of a whole file in memory.
+ */
+class MappedFile {
+    // the first byte of the file and its size in bytes
+    const char* data;
+    size_t size;
+
+    // true if data came from mmap, false if we had to read it into a buffer
+    bool mapped;
+
+    // backing storage used when the file could not be mapped
+    std::vector<char> buffer;
+
+    // the copy constructor and assignment are not allowed, the mapping
+    // is owned by a single object
+    MappedFile (const MappedFile&);
+    MappedFile& operator= (const MappedFile&);
+
+public:
+
+    /*
+     * MappedFile
+     *
+     * DESCRIPTION:
+     *         Default constructor, creates an empty view.
+     *
+     */
+    MappedFile ();
+
+    /*
+     * ~MappedFile
+     *
+     * DESCRIPTION:
+     *         Unmaps the file, if one is open.
+     *
+     */
+    ~MappedFile ();
+
+    /*
+     * open
+     *
+     * INPUT:
+     *         filename - the file we want to map.
+     *
+     * RETURN:
+     *         True if the file could be opened, false otherwise.
+     *
+     * DESCRIPTION:
+     *         Maps the whole file in memory. If mmap is not available (or
+     *         fails, e.g. for empty files) the file is read into a buffer
+     *         instead, so callers never have to care which one happened.
+     *         Entries of .zip archives (see zipArchive.h) are inflated into
+     *         the buffer.
+     *
+     */
+    bool open (const char* filename);
+
+    /*
+     * close
+     *
+     * DESCRIPTION:
+     *         Releases the mapping (or the buffer).
+     *
+     */
+    void close ();
+
+    /*
+     * begin
+     *
+     * RETURN:
+     *         Pointer to the first byte of the file.
+     *
+     */
+    const char* begin () const;
+
+    /*
+     * end
+     *
+     * RETURN:
+     *         Pointer one past the last byte of the file. The data is NOT
+     *         null terminated, every scan has to stop here.
+     *
+     */
+    const char* end () const;
+
+    /*
+     * getSize
+     *
+     * RETURN:
+     *         The size of the file in bytes.
+     *
+     */
+    size_t getSize () const;
+};
+
+/*
+ * A range of consecutive triangles of an .obj file with the same object
+ * or group ("o" and "g" records) and the same material ("usemtl").
+ */
+struct ObjSubmesh {
+    // the corners of the range on ObjData::elements, the first one and
+    // how many
+    size_t firstCorner;
+    size_t numCorners;
+
+    // index on ObjData::names and ObjData::materials, -1 for the faces
+    // before the first "o"/"g" or "usemtl" record
+    int name;
+    int material;
+};
+
+/*
+ * The raw contents of an .obj file, exactly as they are on the file (no
+ * welding of the face indices is done here).
+ */
+struct ObjData {
+    // "v" records, x y z
+    std::vector<float> vertices;
+
+    // "vt" records, u v
+    std::vector<float> uvtextures;
+
+    // "vn" records, x y z
+    std::vector<float> normals;
+
+    // corners of the triangles, always three values per corner: vertex,
+    // texture and normal index. The indices are zero based and -1 when
+    // the corner does not have that attribute (e.g. "1//3" has no
+    // texture) or the attribute was not asked for
+    std::vector<int> elements;
+
+    // the names of the "o"/"g" and "usemtl" records, each one once
+    std::vector<std::string> names;
+    std::vector<std::string> materials;
+
+    // every triangle is on exactly one submesh, in the order of the file
+    std::vector<ObjSubmesh> submeshes;
+
+    // the files of the "mtllib" records, as they are written on the file
+    std::vector<std::string> materialLibraries;
+
+    /*
+     * clear
+     *
+     * DESCRIPTION:
+     *         Empties every vector.
+     *
+     */
+    void clear ();
+};
+
+/*
+ * A material of an .mtl file, what the Phong model of the shaders needs.
+ */
+struct ObjMaterial {
+    // the name "usemtl" records refer to
+    std::string name;
+
+    // "Ka", "Kd" and "Ks" colors and the "Ns" exponent
+    float ambient[3];
+    float diffuse[3];
+    float specular[3];
+    float specExp;
+
+    // "map_Kd", "map_Ks" and "map_Bump" (or "bump", "norm") files, as they
+    // are written on the .mtl, empty if there is none
+    std::string diffuseMap;
+    std::string specularMap;
+    std::string normalMap;
+    /*
+     * ObjMaterial
+     *
+     * DESCRIPTION:
+     *         Creates a material with the defaults of the .mtl format (Ka
+     *         0.2, Kd 0.8), no specular and no textures.
+     *
+     */
+    ObjMaterial ();
+};
+
+/*
+ * The number of records of an .obj text, the first pass of the parser.
+ */
+struct ObjCounts {
+    // "v", "vt" and "vn" records
+    size_t vertices;
+    size_t uvtextures;
+    size_t normals;
+
+    // corners of the triangles, every one takes three entries of
+    // ObjData::elements (a face of n corners gives n - 2 triangles)
+    size_t corners;
+
+    // faces with more than 3 corners
+    size_t polygons;
+
+    // "o", "g", "usemtl" and "mtllib" records
+    size_t marks;
+};
+
+/*
+ * countObjRecords
+ *
+ * INPUT:
+ *         begin - the first character of the text.
+ *         end - one past the last character of the text.
+ *         counts - where the numbers of records are written.
+ *
+ * DESCRIPTION:
+ *         The first pass of the parser. Counts the "v", "vt" and "vn"
+ *         records, the triangles the faces become, the faces with more
+ *         than 3 corners and the "o", "g", "usemtl" and "mtllib" records,
+ *         without converting any number, so the arrays can be allocated
+ *         once at their final size.
+ *         Lines are found with memchr, and only face lines are scanned, 8
+ *         characters at a time (every group of non blank characters after
+ *         the "f" is a corner).
+ *
+ */
+void countObjRecords (const char* begin, const char* end, ObjCounts& counts);
+
+/*
+ * parseObjBuffer
+ *
+ * INPUT:
+ *         begin - the first character of the text.
+ *         end - one past the last character of the text.
+ *         data - where the records are appended.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * DESCRIPTION:
+ *         Tokenizes the .obj text in place and appends its "v", "vt", "vn"
+ *         and "f" records to data. The "o", "g" and "usemtl" records split
+ *         the triangles in data.submeshes, a new submesh starts whenever
+ *         the name or the material changes (the same name or material used
+ *         again gets the same index). The files of the "mtllib" records
+ *         go to data.materialLibraries. Every other record is skipped, and so
+ *         are the records and corner indices of attributes not in the
+ *         mask. Faces can mix the patterns "1", "1/2", "1//3" and "1/2/3".
+ *         Negative (relative) face indices are resolved against what is
+ *         already in data, so the same ObjData can be fed several
+ *         consecutive buffers.
+ *
+ *         Faces with more than 3 corners are triangulated while they are
+ *         read, as a fan from their first corner. Once the positions are
+ *         all known the concave ones are triangulated again by ear
+ *         clipping, in place. Faces with less than 3 corners are dropped.
+ *
+ *         The text is read twice: countObjRecords sizes every array of
+ *         data once, then the records are written straight into them.
+ *         There is one parser per mask, chosen once per call, so the
+ *         inner loop never checks the mask.
+ *
+ */
+void parseObjBuffer (const char* begin, const char* end, ObjData& data,
+                     unsigned int attributes = OBJ_ALL);
+
+/*
+ * parseObjFile
+ *
+ * INPUT:
+ *         file - an .obj file that is already mapped.
+ *         data - where the records are written.
+ *         numThreads - how many threads parse the file. 1 parses it on the
+ *                      calling thread, 0 uses every core of the machine.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * DESCRIPTION:
+ *         Runs parseObjBuffer over all of the file. With more than one
+ *         thread the file is split in chunks at newline boundaries and
+ *         both passes run on every chunk in parallel. In between, the
+ *         counts tell where each chunk starts on the final arrays, so the
+ *         chunks are parsed straight into place and data ends up exactly
+ *         the same as on the serial parse.
+ *
+ */
+void parseObjFile (const MappedFile& file, ObjData& data, int numThreads = 1,
+                   unsigned int attributes = OBJ_ALL);
+
+/*
+ * parseObjStream
+ *
+ * INPUT:
+ *         reader - an entry of a .zip archive, open and not read yet.
+ *         data - where the records are appended.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * RETURN:
+ *         False if the entry could not be inflated.
+ *
+ * DESCRIPTION:
+ *         Parses an .obj while it is inflated. A second thread inflates
+ *         the entry in blocks of whole lines while this one runs
+ *         parseObjBuffer on the block before, so inflating overlaps
+ *         parsing and the whole text is never in memory. data ends up the
+ *         same as if the text was parsed at once, except for concave faces
+ *         using positions that come after them on the file (they keep
+ *         their fan).
+ *
+ */
+bool parseObjStream (ZipEntryReader& reader, ObjData& data, unsigned int attributes = OBJ_ALL);
+
+/*
+ * readObjFile
+ *
+ * INPUT:
+ *         filename - the .obj file we want to read.
+ *         data - where the records are written.
+ *         numThreads - how many threads parse the file. 1 parses it on the
+ *                      calling thread, 0 uses every core of the machine.
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *
+ * RETURN:
+ *         True if the file could be read, false otherwise.
+ *
+ * DESCRIPTION:
+ *         Maps the file and parses it with parseObjFile. Entries of .zip
+ *         archives (e.g. "objects/teapot.zip/teapot.obj") are parsed while
+ *         they are inflated, with parseObjStream.
+ *
+ */
+bool readObjFile (const char* filename, ObjData& data, int numThreads = 1,
+                  unsigned int attributes = OBJ_ALL);
+
+/*
+ * parseMtlBuffer
+ *
+ * INPUT:
+ *         begin - the first character of the text.
+ *         end - one past the last character of the text.
+ *         materials - where the materials are appended.
+ *
+ * DESCRIPTION:
+ *         Reads the "newmtl" records of an .mtl text and the colors,
+ *         exponent and texture files of each one. Values a material does
+ *         not have keep the defaults of ObjMaterial. The options of the texture records (e.g. "-s 1 1 1")
+ *         are skipped, the file is the last word of the line.
+ *
+ */
+void parseMtlBuffer (const char* begin, const char* end, std::vector<ObjMaterial>& materials);
+
+/*
+ * readMtlFile
+ *
+ * INPUT:
+ *         filename - the .mtl file we want to read.
+ *         materials - where the materials are appended.
+ *
+ * RETURN:
+ *         True if the file could be read, false otherwise.
+ *
+ * DESCRIPTION:
+ *         Maps the file and parses it with parseMtlBuffer.
+ *
+ */
+bool readMtlFile (const char* filename, std::vector<ObjMaterial>& materials);
+
+} // end namespace
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * primitiveCache.cpp
+ *
+ * The geometry of the primitives made so far, kept by their parameters.
+ * A cube, cylinder or sphere is made once for the whole program and every
+ * shape that asks for the same one shares it, the arrays are never
+ * changed after they are made.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "primitiveCache.h"
+
+#include <map>
+#include <mutex>
+
+#include "vertexBuffer.h"
+
+/*
+ * operator<
+ *
+ * RETURN:
+ *         True if this key goes before other, so keys can index a map.
+ *
+ */
+bool PrimitiveKey::operator<(const PrimitiveKey& other) const {
+    if (type != other.type) {
+        return type < other.type;
+    }
+    if (subDiv != other.subDiv) {
+        return subDiv < other.subDiv;
+    }
+    if (subDivHeight != other.subDivHeight) {
+        return subDivHeight < other.subDivHeight;
+    }
+    return normalType < other.normalType;
+}
+
+/*
+ * makePrimitiveKey
+ *
+ * INPUT:
+ *         type - PRIMITIVE_CUBE, PRIMITIVE_CYLINDER or PRIMITIVE_SPHERE.
+ *         subDiv - subdivisions of the cube and the sphere, or of the
+ *                  bases of the cylinder.
+ *         subDivHeight - subdivisions on the height of the cylinder.
+ *         normalType - FLAT or SMOOTH, for the cylinder and the sphere.
+ *
+ * RETURN:
+ *         The key, with the parameters the primitive does not use set to
+ *         0 and any normalType that is not FLAT made SMOOTH, so the same
+ *         geometry always has the same key.
+ *
+ */
+PrimitiveKey makePrimitiveKey(int type, int subDiv, int subDivHeight, int normalType) {
+    PrimitiveKey key;
+    key.type = type;
+    key.subDiv = subDiv;
+    key.subDivHeight = (type == PRIMITIVE_CYLINDER) ? subDivHeight : 0;
+    key.normalType = (type == PRIMITIVE_CUBE || normalType == FLAT) ? FLAT : SMOOTH;
+    return key;
+}
+
+// Makes the geometry of a primitive, with its elements packed
+static std::shared_ptr<PrimitiveGeometry> makeGeometry(const PrimitiveKey& key, int numThreads) {
+    size_t numVertices, numElements;
+    if (key.type == PRIMITIVE_CUBE) {
+        getCubeSize(key.subDiv, numVertices, numElements);
+    } else if (key.type == PRIMITIVE_CYLINDER) {
+        getCylinderSize(key.subDiv, key.subDivHeight, key.normalType, numVertices, numElements);
+    } else {
+        getSphereSize(key.subDiv, key.normalType, numVertices, numElements);
+    }
+
+    std::shared_ptr<PrimitiveGeometry> geometry = std::make_shared<PrimitiveGeometry>();
+    geometry->key = key;
+    geometry->vertices.resize(numVertices * 3);
+    geometry->normals.resize(numVertices * 3);
+    geometry->elements.resize(numElements);
+
+    PrimitiveTarget target;
+    target.vertices = &geometry->vertices[0];
+    target.normals = &geometry->normals[0];
+    target.elements = &geometry->elements[0];
+    target.firstVertex = 0;
+
+    if (key.type == PRIMITIVE_CUBE) {
+        makeCubeGeometry(key.subDiv, target, numThreads);
+    } else if (key.type == PRIMITIVE_CYLINDER) {
+        makeCylinderGeometry(key.subDiv, key.subDivHeight, key.normalType, target, numThreads);
+    } else {
+        makeSphereGeometry(key.subDiv, key.normalType, target, numThreads);
+    }
+
+    geometry->elementType = packElementData(&geometry->elements[0], numElements,
+                                            geometry->elementData);
+    return geometry;
+}
+
+// The bytes of the arrays of a primitive
+static size_t geometryBytes(const PrimitiveGeometry& geometry) {
+    return (geometry.vertices.size() + geometry.normals.size()) * sizeof(float) +
+           geometry.elements.size() * sizeof(GLuint) + geometry.elementData.size();
+}
+
+// The primitives made so far, by key, and how the cache was used
+static std::mutex primitivesMutex;
+static std::map<PrimitiveKey, std::shared_ptr<const PrimitiveGeometry> > primitives;
+static size_t primitiveHits = 0;
+static size_t primitiveMisses = 0;
+
+/*
+ * getCachedPrimitive
+ *
+ * INPUT:
+ *         key - the primitive, from makePrimitiveKey. The parameters must
+ *               already be in the ranges of primitives.h.
+ *         numThreads - how many threads make it if it is not in the cache,
+ *                      0 uses every core.
+ *
+ * RETURN:
+ *         The geometry of the primitive.
+ *
+ * DESCRIPTION:
+ *         The first call with a key makes the primitive, the next ones
+ *         return the same geometry. It is safe to call from any thread,
+ *         a primitive is made without holding the cache, so two threads
+ *         asking for different ones make them at the same time.
+ *
+ */
+std::shared_ptr<const PrimitiveGeometry> getCachedPrimitive(const PrimitiveKey& key, int numThreads) {
+    {
+        std::lock_guard<std::mutex> lock(primitivesMutex);
+        std::map<PrimitiveKey, std::shared_ptr<const PrimitiveGeometry> >::iterator it =
+            primitives.find(key);
+        if (it != primitives.end()) {
+            ++primitiveHits;
+            return it->second;
+        }
+        ++primitiveMisses;
+    }
+
+    std::shared_ptr<const PrimitiveGeometry> geometry = makeGeometry(key, numThreads);
+
+    // another thread may have made the same one meanwhile, the first one
+    // in the cache is the one everybody shares
+    std::lock_guard<std::mutex> lock(primitivesMutex);
+    std::pair<std::map<PrimitiveKey, std::shared_ptr<const PrimitiveGeometry> >::iterator, bool>
+        inserted = primitives.insert(std::make_pair(key, geometry));
+    return inserted.first->second;
+}
+
+/*
+ * releasePrimitives
+ *
+ * DESCRIPTION:
+ *         Forgets every primitive made so far, their memory is freed once
+ *         the shapes still sharing them let them go.
+ *
+ */
+void releasePrimitives() {
+    std::lock_guard<std::mutex> lock(primitivesMutex);
+    primitives.clear();
+}
+
+/*
+ * getPrimitiveCacheStats
+ *
+ * RETURN:
+ *         The hits and misses of getCachedPrimitive and what the cache
+ *         holds now.
+ *
+ */
+PrimitiveCacheStats getPrimitiveCacheStats() {
+    std::lock_guard<std::mutex> lock(primitivesMutex);
+
+    PrimitiveCacheStats stats;
+    stats.hits = primitiveHits;
+    stats.misses = primitiveMisses;
+    stats.numPrimitives = primitives.size();
+    stats.numBytes = 0;
+
+    std::map<PrimitiveKey, std::shared_ptr<const PrimitiveGeometry> >::iterator it;
+    for (it = primitives.begin(); it != primitives.end(); ++it) {
+        stats.numBytes += geometryBytes(*it->second);
+    }
+    return stats;
+}
@@ -0,0 +1,135 @@
+/*
+ * primitiveCache.h
+ *
+ * The geometry of the primitives made so far, kept by their parameters.
+ * A cube, cylinder or sphere is made once for the whole program and every
+ * shape that asks for the same one shares it, the arrays are never
+ * changed after they are made.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _PRIMITIVECACHE_H
+#define _PRIMITIVECACHE_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+#include "primitives.h"
+
+// The primitives of primitives.h
+#define PRIMITIVE_CUBE      0
+#define PRIMITIVE_CYLINDER  1
+#define PRIMITIVE_SPHERE    2
+
+/*
+ * What a primitive is made of. The parameters a primitive does not use
+ * are 0 (subDivHeight and normalType of the cube, subDivHeight of the
+ * sphere), see makePrimitiveKey.
+ */
+struct PrimitiveKey {
+    int type;
+    int subDiv;
+    int subDivHeight;
+    int normalType;
+
+    bool operator<(const PrimitiveKey& other) const;
+};
+
+/*
+ * A primitive as a shape has it: the x y z of the position and of the
+ * normal of every vertex, three elements per triangle and the elements
+ * packed with the narrowest type that holds them (elementType).
+ */
+struct PrimitiveGeometry {
+    PrimitiveKey key;
+
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<GLuint> elements;
+    std::vector<GLubyte> elementData;
+    GLenum elementType;
+};
+
+/*
+ * How the cache was used since the program started: the times a primitive
+ * was found, the times it had to be made, and the primitives and bytes it
+ * keeps now.
+ */
+struct PrimitiveCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t numPrimitives;
+    size_t numBytes;
+};
+
+/*
+ * makePrimitiveKey
+ *
+ * INPUT:
+ *         type - PRIMITIVE_CUBE, PRIMITIVE_CYLINDER or PRIMITIVE_SPHERE.
+ *         subDiv - subdivisions of the cube and the sphere, or of the
+ *                  bases of the cylinder.
+ *         subDivHeight - subdivisions on the height of the cylinder.
+ *         normalType - FLAT or SMOOTH, for the cylinder and the sphere.
+ *
+ * RETURN:
+ *         The key, with the parameters the primitive does not use set to
+ *         0 and any normalType that is not FLAT made SMOOTH, so the same
+ *         geometry always has the same key.
+ *
+ */
+PrimitiveKey makePrimitiveKey(int type, int subDiv, int subDivHeight, int normalType);
+
+/*
+ * getCachedPrimitive
+ *
+ * INPUT:
+ *         key - the primitive, from makePrimitiveKey. The parameters must
+ *               already be in the ranges of primitives.h.
+ *         numThreads - how many threads make it if it is not in the cache,
+ *                      0 uses every core.
+ *
+ * RETURN:
+ *         The geometry of the primitive.
+ *
+ * DESCRIPTION:
+ *         The first call with a key makes the primitive, the next ones
+ *         return the same geometry. It is safe to call from any thread,
+ *         a primitive is made without holding the cache, so two threads
+ *         asking for different ones make them at the same time.
+ *
+ */
+std::shared_ptr<const PrimitiveGeometry> getCachedPrimitive(const PrimitiveKey& key, int numThreads);
+
+/*
+ * releasePrimitives
+ *
+ * DESCRIPTION:
+ *         Forgets every primitive made so far, their memory is freed once
+ *         the shapes still sharing them let them go.
+ *
+ */
+void releasePrimitives();
+
+/*
+ * getPrimitiveCacheStats
+ *
+ * RETURN:
+ *         The hits and misses of getCachedPrimitive and what the cache
+ *         holds now.
+ *
+ */
+PrimitiveCacheStats getPrimitiveCacheStats();
+
+#endif
@@ -0,0 +1,681 @@
+/*
+ * primitives.cpp
+ *
+ * The geometry of the cube, cylinder and sphere of Shape, made straight
+ * into arrays sized up front. Every primitive is split in parts that are
+ * written to their own ranges of the arrays, so the parts can be made on
+ * several threads and the result is the same with any number of them.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "primitives.h"
+
+#include <string.h>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "mathHelper.h"
+
+// Runs function on every part, the last one on this thread
+template <class Part>
+static void runOnParts (void (*function)(Part*), std::vector<Part>& parts) {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < parts.size(); ++i) {
+        workers.push_back(std::thread(function, &parts[i]));
+    }
+    function(&parts.back());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+// How many parts a primitive is split in: one per thread, but no more
+// than it has units (rows, faces) and none too small to be worth it
+static size_t countParts (size_t numTriangles, size_t numUnits, int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+
+    size_t numParts = numThreads > 1 ? (size_t) numThreads : 1;
+    size_t maxParts = numTriangles / PRIMITIVE_MIN_THREAD_TRIANGLES;
+    if (numParts > maxParts) {
+        numParts = maxParts;
+    }
+    if (numParts > numUnits) {
+        numParts = numUnits;
+    }
+    return numParts > 0 ? numParts : 1;
+}
+
+/*
+ * Cube
+ */
+
+// "Anchor" point of every face and the two directions its squares go
+// from it (front, back, right, left, top and bottom). The normal of a
+// face is down x right.
+static const float cubeAnchor[6][3] = {{-0.5, 0.5, 0.5}, { 0.5, 0.5,-0.5}, { 0.5, 0.5, 0.5},
+                                       {-0.5, 0.5,-0.5}, {-0.5, 0.5,-0.5}, {-0.5,-0.5, 0.5}};
+static const float cubeRight[6][3]  = {{ 1, 0, 0}, {-1, 0, 0}, { 0, 0,-1},
+                                       { 0, 0, 1}, { 1, 0, 0}, { 1, 0, 0}};
+static const float cubeDown[6][3]   = {{ 0,-1, 0}, { 0,-1, 0}, { 0,-1, 0},
+                                       { 0,-1, 0}, { 0, 0, 1}, { 0, 0,-1}};
+
+// A range of the rows of the faces of a cube, every face has subDiv + 1
+struct CubePart {
+    int subDiv;
+    size_t firstRow;
+    size_t endRow;
+    PrimitiveTarget target;
+};
+
+// Writes the vertices of the rows of the part, and the squares between
+// each row and the next one
+static void makeCubeRows (CubePart* part) {
+    int subDiv = part->subDiv;
+    int row = subDiv + 1;
+    float side = 1.0f/subDiv;
+    const PrimitiveTarget& target = part->target;
+
+    for (size_t r = part->firstRow; r < part->endRow; ++r) {
+        int face = (int) (r / row);
+        int i = (int) (r % row);
+
+        const float* p = cubeAnchor[face];
+        const float* u = cubeRight[face];
+        const float* v = cubeDown[face];
+        float n[] = {v[1]*u[2] - v[2]*u[1], v[2]*u[0] - v[0]*u[2], v[0]*u[1] - v[1]*u[0]};
+
+        size_t first = (size_t) face * row * row + (size_t) i * row;
+        for (int j = 0; j <= subDiv; ++j) {
+            float* vertex = target.vertices + 3*(first + j);
+            vertex[0] = p[0] + u[0]*(i*side) + v[0]*(j*side);
+            vertex[1] = p[1] + u[1]*(i*side) + v[1]*(j*side);
+            vertex[2] = p[2] + u[2]*(i*side) + v[2]*(j*side);
+            memcpy(target.normals + 3*(first + j), n, 3 * sizeof(float));
+        }
+
+        if (i == subDiv) {
+            continue;
+        }
+
+        GLuint* elements = target.elements + ((size_t) face * subDiv + i) * subDiv * 6;
+        for (int j = 0; j < subDiv; ++j) {
+            GLuint e = target.firstVertex + (GLuint) (first + j);
+            GLuint* square = elements + 6*j;
+            square[0] = e;     square[1] = e + 1;       square[2] = e + row;
+            square[3] = e + 1; square[4] = e + row + 1; square[5] = e + row;
+        }
+    }
+}
+
+/*
+ * getCubeSize
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the squares, at least 1.
+ *         numVertices - where the number of vertices is written.
+ *         numElements - where the number of elements is written.
+ *
+ */
+void getCubeSize(int subDiv, size_t& numVertices, size_t& numElements) {
+    numVertices = 6 * (size_t) (subDiv + 1) * (subDiv + 1);
+    numElements = 36 * (size_t) subDiv * subDiv;
+}
+
+/*
+ * makeCubeGeometry
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the squares, at least 1.
+ *         target - arrays with room for getCubeSize.
+ *         numThreads - how many threads write it, 0 uses every core.
+ *
+ * DESCRIPTION:
+ *         A cube centered at the origin with sides of length 1. Each face
+ *         is a grid of vertices with its normal, split in rows that the
+ *         threads make.
+ *
+ */
+void makeCubeGeometry(int subDiv, const PrimitiveTarget& target, int numThreads) {
+    size_t numRows = 6 * (size_t) (subDiv + 1);
+    size_t numParts = countParts(12 * (size_t) subDiv * subDiv, numRows, numThreads);
+
+    std::vector<CubePart> parts(numParts);
+    for (size_t i = 0; i < numParts; ++i) {
+        parts[i].subDiv = subDiv;
+        parts[i].firstRow = numRows * i / numParts;
+        parts[i].endRow = numRows * (i + 1) / numParts;
+        parts[i].target = target;
+    }
+    runOnParts(makeCubeRows, parts);
+}
+
+/*
+ * Cylinder
+ *
+ * The vertices are the bottom center and ring, the top center and ring,
+ * and then the columns of the sides from top to bottom. The triangles go
+ * side by side, each with its bottom and top triangles first.
+ */
+
+// A range of the rows of the sides of a cylinder, every side has
+// subDivHeight + 1
+struct CylinderPart {
+    int subDivBase;
+    int subDivHeight;
+    int normalType;
+    size_t firstRow;
+    size_t endRow;
+    PrimitiveTarget target;
+};
+
+static inline void setVertex (const PrimitiveTarget& target, size_t index,
+                              float x, float y, float z, float nx, float ny, float nz) {
+    float* vertex = target.vertices + 3*index;
+    float* normal = target.normals + 3*index;
+    vertex[0] = x;  vertex[1] = y;  vertex[2] = z;
+    normal[0] = nx; normal[1] = ny; normal[2] = nz;
+}
+
+static inline void setTriangle (GLuint* elements, GLuint e0, GLuint e1, GLuint e2) {
+    elements[0] = e0;
+    elements[1] = e1;
+    elements[2] = e2;
+}
+
+// Writes the vertices of the rows of the part and the squares below them,
+// the first row of a side also writes its points of the rings and its
+// bottom and top triangles
+static void makeCylinderRows (CylinderPart* part) {
+    int subDivBase = part->subDivBase;
+    int subDivHeight = part->subDivHeight;
+    const PrimitiveTarget& target = part->target;
+
+    float theta = (2*PI)/subDivBase;
+    float side = 1.0f/subDivHeight;
+    float r = 0.5f;
+
+    GLuint bot = 0;
+    GLuint top = subDivBase + 1;
+    GLuint sides = 2*subDivBase + 2;
+    int columns = subDivHeight + 1;
+
+    // The side the last row was on, and its corners and normal
+    int lastSide = -1;
+    float cosI = 0, sinI = 0, cosK1 = 0, sinK1 = 0;
+    float n[3] = {0, 0, 0};
+
+    for (size_t row = part->firstRow; row < part->endRow; ++row) {
+        int i = (int) (row / columns);
+        int j = (int) (row % columns);
+        int k1 = (i+1) % subDivBase;
+
+        if (i != lastSide) {
+            cosI = std::cos(i * theta);
+            sinI = std::sin(i * theta);
+            cosK1 = std::cos(k1 * theta);
+            sinK1 = std::sin(k1 * theta);
+
+            n[0] = -(r * (sinI - sinK1));
+            n[1] = 0.0f;
+            n[2] = r * (cosI - cosK1);
+            normalize(n);
+            lastSide = i;
+        }
+
+        GLuint* elements = target.elements + (size_t) i * (2 + 2*subDivHeight) * 3;
+
+        if (j == 0) {
+            setVertex(target, bot + 1 + i, r * cosI, -0.5f, r * sinI, 0.0f, -1.0f, 0.0f);
+            setVertex(target, top + 1 + i, r * cosI,  0.5f, r * sinI, 0.0f,  1.0f, 0.0f);
+            if (i == 0) {
+                setVertex(target, bot, 0.0f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f);
+                setVertex(target, top, 0.0f,  0.5f, 0.0f, 0.0f,  1.0f, 0.0f);
+            }
+
+            GLuint first = target.firstVertex;
+            setTriangle(elements, first + bot, first + bot + 1 + i, first + bot + 1 + k1);
+            setTriangle(elements + 3, first + top, first + top + 1 + k1, first + top + 1 + i);
+        }
+
+        // p1 is the column at (i+1) theta and p2 the one at i theta
+        GLuint p1, p2;
+        float y = 0.5f-(j*side);
+        if (part->normalType == FLAT) {
+            p1 = sides + 2*i*columns;
+            p2 = p1 + columns;
+
+            setVertex(target, p1 + j, r * cosK1, y, r * sinK1, n[0], n[1], n[2]);
+            setVertex(target, p2 + j, r * cosI, y, r * sinI, n[0], n[1], n[2]);
+        } else {
+            p1 = sides + k1*columns;
+            p2 = sides + i*columns;
+
+            setVertex(target, p2 + j, r * cosI, y, r * sinI, cosI, 0.0f, sinI);
+        }
+
+        if (j < subDivHeight) {
+            p1 += target.firstVertex;
+            p2 += target.firstVertex;
+            GLuint* square = elements + 6 + 6*j;
+            setTriangle(square, p1 + j, p1 + j + 1, p2 + j);
+            setTriangle(square + 3, p1 + j + 1, p2 + j + 1, p2 + j);
+        }
+    }
+}
+
+/*
+ * getCylinderSize
+ *
+ * INPUT:
+ *         subDivBase - number of subdivisions on the bases, at least 3.
+ *         subDivHeight - number of subdivisions on height, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         numVertices - where the number of vertices is written.
+ *         numElements - where the number of elements is written.
+ *
+ */
+void getCylinderSize(int subDivBase, int subDivHeight, int normalType,
+                     size_t& numVertices, size_t& numElements) {
+    size_t numColumns = normalType == FLAT ? 2 * (size_t) subDivBase : (size_t) subDivBase;
+    numVertices = 2 * (size_t) subDivBase + 2 + numColumns * (subDivHeight + 1);
+    numElements = (size_t) subDivBase * (2 + 2 * (size_t) subDivHeight) * 3;
+}
+
+/*
+ * makeCylinderGeometry
+ *
+ * INPUT:
+ *         subDivBase - number of subdivisions on the bases, at least 3.
+ *         subDivHeight - number of subdivisions on height, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         target - arrays with room for getCylinderSize.
+ *         numThreads - how many threads write it, 0 uses every core.
+ *
+ * DESCRIPTION:
+ *         A cylinder of radius 0.5 and height 1 centered at the origin.
+ *         The bases are a center and a ring of vertices each. The sides
+ *         are columns of vertices shared around the cylinder with SMOOTH
+ *         normals, and a pair of columns for each side with FLAT ones.
+ *         The threads make ranges of the rows of every side.
+ *
+ */
+void makeCylinderGeometry(int subDivBase, int subDivHeight, int normalType,
+                          const PrimitiveTarget& target, int numThreads) {
+    size_t numRows = (size_t) subDivBase * (subDivHeight + 1);
+    size_t numTriangles = (size_t) subDivBase * (2 + 2 * (size_t) subDivHeight);
+    size_t numParts = countParts(numTriangles, numRows, numThreads);
+
+    std::vector<CylinderPart> parts(numParts);
+    for (size_t i = 0; i < numParts; ++i) {
+        parts[i].subDivBase = subDivBase;
+        parts[i].subDivHeight = subDivHeight;
+        parts[i].normalType = normalType;
+        parts[i].firstRow = numRows * i / numParts;
+        parts[i].endRow = numRows * (i + 1) / numParts;
+        parts[i].target = target;
+    }
+    runOnParts(makeCylinderRows, parts);
+}
+
+/*
+ * Sphere
+ *
+ * Every face of the icosahedron is a grid of n = 2^subDiv points a side:
+ * the point (i, j) is corner 0 moved i steps towards corner 1 and j steps
+ * towards corner 2. Splitting the triangles once halves the steps, and
+ * every new point is the middle of one edge of the grid before it, so
+ * where the middle of an edge goes is known without looking it up.
+ *
+ * The vertices are the 12 corners, then the n - 1 points inside each of
+ * the 30 edges (from the corner with the lowest index), then the points
+ * inside each of the 20 faces row by row.
+ */
+
+// The triangles of the icosahedron, by its vertices
+static const int icosahedronFaces[20][3] = {{1, 2, 0}, {2, 3, 0}, {3, 4, 0}, {4, 5, 0}, {5, 1, 0},
+                                            {6, 2, 1}, {6, 7, 2}, {7, 3, 2}, {7, 8, 3}, {8, 4, 3},
+                                            {8, 9, 4}, {9, 5, 4}, {9,10, 5}, {10,1, 5}, {10,6, 1},
+                                            {11,7, 6}, {11,8, 7}, {11,9, 8}, {11,10,9}, {11,6,10}};
+
+// Where the points of every face are
+struct SphereGrid {
+    int subDiv;
+    GLuint n;
+
+    // the edge of every side of a face (corners 0-1, 1-2 and 2-0) and the
+    // corners of every edge, lowest first
+    int faceEdges[20][3];
+    int edgeCorners[30][2];
+
+    GLuint firstEdgePoint;
+    GLuint firstFacePoint;
+    GLuint facePoints;
+};
+
+// The vertex k steps from corner a on the edge from a to b
+static inline GLuint getEdgePoint (const SphereGrid& grid, int a, int b, int edge, GLuint k) {
+    GLuint first = grid.firstEdgePoint + edge * (grid.n - 1);
+    return a < b ? first + k - 1 : first + (grid.n - k) - 1;
+}
+
+// The vertex of the point (i, j) of a face
+static inline GLuint getGridPoint (const SphereGrid& grid, int face, GLuint i, GLuint j) {
+    const int* c = icosahedronFaces[face];
+    const int* edges = grid.faceEdges[face];
+    GLuint n = grid.n;
+
+    if (j == 0) {
+        if (i == 0) {
+            return c[0];
+        }
+        return i == n ? c[1] : getEdgePoint(grid, c[0], c[1], edges[0], i);
+    }
+    if (i == 0) {
+        return j == n ? c[2] : getEdgePoint(grid, c[0], c[2], edges[2], j);
+    }
+    if (i + j == n) {
+        return getEdgePoint(grid, c[1], c[2], edges[1], j);
+    }
+    return grid.firstFacePoint + face * grid.facePoints + (i-1)*(n-1) - (i-1)*i/2 + (j-1);
+}
+
+// Puts the middle of a and b, pushed onto the sphere, on middle
+static inline void setMiddle (const float* positions, GLuint a, GLuint b, GLuint middle,
+                              float* destination) {
+    float* p = destination + 3*middle;
+    p[0] = positions[3*a]   + positions[3*b];
+    p[1] = positions[3*a+1] + positions[3*b+1];
+    p[2] = positions[3*a+2] + positions[3*b+2];
+    normalize(p);
+}
+
+// A range of the faces of the sphere. positions holds the shared vertices,
+// where the part writes the points inside its faces, and triangles their
+// elements. With FLAT normals both are scratch arrays the part expands
+// onto the target.
+struct SpherePart {
+    const SphereGrid* grid;
+    int normalType;
+    int firstFace;
+    int endFace;
+    float* positions;
+    GLuint* triangles;
+    PrimitiveTarget target;
+};
+
+// Writes the points inside the faces of the part and their triangles
+static void makeSphereFaces (SpherePart* part) {
+    const SphereGrid& grid = *part->grid;
+    const PrimitiveTarget& target = part->target;
+    GLuint n = grid.n;
+    size_t faceTriangles = (size_t) n * n;
+
+    // The vertex of every point (i, j) of the face, at i * (n + 1) + j
+    GLuint row = n + 1;
+    std::vector<GLuint> gridPoints((size_t) row * row);
+
+    for (int face = part->firstFace; face < part->endFace; ++face) {
+        for (GLuint i = 0; i <= n; ++i) {
+            for (GLuint j = 0; i + j <= n; ++j) {
+                gridPoints[i*row + j] = getGridPoint(grid, face, i, j);
+            }
+        }
+
+        // The points inside the face, from the widest steps to the finest
+        for (GLuint h = n / 2; h >= 1; h /= 2) {
+            for (GLuint i = h; i + h < n; i += h) {
+                for (GLuint j = h; i + j < n; j += h) {
+                    bool oddI = (i / h) % 2 == 1;
+                    bool oddJ = (j / h) % 2 == 1;
+                    if (!oddI && !oddJ) {
+                        continue;
+                    }
+
+                    GLuint a, b;
+                    if (oddI && oddJ) {
+                        a = (i + h)*row + (j - h);
+                        b = (i - h)*row + (j + h);
+                    } else if (oddI) {
+                        a = (i - h)*row + j;
+                        b = (i + h)*row + j;
+                    } else {
+                        a = i*row + (j - h);
+                        b = i*row + (j + h);
+                    }
+                    setMiddle(part->positions, gridPoints[a], gridPoints[b], gridPoints[i*row + j],
+                              part->positions);
+                }
+            }
+        }
+
+        // The triangles, as points of the grid (i * (n + 1) + j), split one
+        // level at a time in place: going from the last triangle to the
+        // first, the 4 triangles of a triangle never overwrite one that
+        // was not split yet. They end up in the order the recursive
+        // subdivision made them. The middle of two points is half their
+        // sum, both coordinates are even steps of the level.
+        //              0
+        //          3       5
+        //      1       4       2
+        GLuint* triangles = part->triangles + face * faceTriangles * 3;
+        triangles[0] = 0;
+        triangles[1] = n * row;
+        triangles[2] = n;
+
+        size_t numTriangles = 1;
+        for (int level = 0; level < grid.subDiv; ++level) {
+            for (size_t t = numTriangles; t-- > 0; ) {
+                GLuint e0 = triangles[3*t];
+                GLuint e1 = triangles[3*t + 1];
+                GLuint e2 = triangles[3*t + 2];
+                GLuint m0 = (e0 + e1) / 2;
+                GLuint m1 = (e1 + e2) / 2;
+                GLuint m2 = (e2 + e0) / 2;
+
+                GLuint* out = triangles + 12*t;
+                out[0] = e0; out[1]  = m0; out[2]  = m2;
+                out[3] = m0; out[4]  = e1; out[5]  = m1;
+                out[6] = m2; out[7]  = m1; out[8]  = e2;
+                out[9] = m0; out[10] = m1; out[11] = m2;
+            }
+            numTriangles *= 4;
+        }
+
+        for (size_t i = 0; i < faceTriangles * 3; ++i) {
+            triangles[i] = gridPoints[triangles[i]];
+        }
+
+        if (part->normalType == FLAT) {
+            // Every triangle has its own three vertices, with its normal
+            for (size_t t = 0; t < faceTriangles; ++t) {
+                const GLuint* e = triangles + 3*t;
+                const float* v0 = part->positions + 3*e[0];
+                const float* v1 = part->positions + 3*e[1];
+                const float* v2 = part->positions + 3*e[2];
+
+                float vec1[] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+                float vec2[] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+                float normal[] = {(vec1[1] * vec2[2]) - (vec1[2] * vec2[1]),
+                                  (vec1[2] * vec2[0]) - (vec1[0] * vec2[2]),
+                                  (vec1[0] * vec2[1]) - (vec1[1] * vec2[0])};
+                normalize(normal);
+
+                size_t first = (face * faceTriangles + t) * 3;
+                const float* corners[] = {v0, v1, v2};
+                for (int k = 0; k < 3; ++k) {
+                    memcpy(target.vertices + 3*(first + k), corners[k], 3 * sizeof(float));
+                    memcpy(target.normals + 3*(first + k), normal, 3 * sizeof(float));
+                    target.elements[first + k] = target.firstVertex + (GLuint) (first + k);
+                }
+            }
+        } else {
+            // On the unit sphere the normal is the position
+            size_t first = grid.firstFacePoint + face * grid.facePoints;
+            memcpy(target.normals + 3*first, target.vertices + 3*first,
+                   grid.facePoints * 3 * sizeof(float));
+            if (target.firstVertex > 0) {
+                for (size_t i = 0; i < faceTriangles * 3; ++i) {
+                    triangles[i] += target.firstVertex;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * getSphereSize
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the triangles, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         numVertices - where the number of vertices is written.
+ *         numElements - where the number of elements is written.
+ *
+ */
+void getSphereSize(int subDiv, int normalType, size_t& numVertices, size_t& numElements) {
+    size_t numTriangles = (size_t) 20 << (2*subDiv);
+    numVertices = normalType == FLAT ? numTriangles * 3 : numTriangles / 2 + 2;
+    numElements = numTriangles * 3;
+}
+
+/*
+ * makeSphereGeometry
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the triangles, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         target - arrays with room for getSphereSize.
+ *         numThreads - how many threads write it, 0 uses every core.
+ *
+ * DESCRIPTION:
+ *         A unit sphere made by splitting every triangle of an icosahedron
+ *         in 4, subDiv times, and pushing the new vertices onto the
+ *         sphere (Hoffmann, Sphere Tesselation by Icosahedron
+ *         Subdivision). With SMOOTH normals the vertices are shared and
+ *         the normal is the position, with FLAT normals every triangle has
+ *         its own three.
+ *
+ *         The points on the edges of the icosahedron are made first, then
+ *         each of its 20 faces is made on its own: its triangles split
+ *         into a grid, where the middle of every edge has a fixed place,
+ *         so the faces can be made on different threads.
+ *
+ */
+void makeSphereGeometry(int subDiv, int normalType, const PrimitiveTarget& target, int numThreads) {
+    SphereGrid grid;
+    grid.subDiv = subDiv;
+    grid.n = 1u << subDiv;
+    grid.firstEdgePoint = 12;
+    grid.firstFacePoint = grid.firstEdgePoint + 30 * (grid.n - 1);
+    grid.facePoints = (grid.n - 1) * (grid.n - 2) / 2;
+
+    // Numbering the edges in the order the faces reach them
+    int edgeOf[12][12];
+    memset(edgeOf, -1, sizeof(edgeOf));
+    int numEdges = 0;
+    for (int face = 0; face < 20; ++face) {
+        for (int k = 0; k < 3; ++k) {
+            int a = icosahedronFaces[face][k];
+            int b = icosahedronFaces[face][(k+1)%3];
+            if (a > b) {
+                int swap = a;
+                a = b;
+                b = swap;
+            }
+            if (edgeOf[a][b] < 0) {
+                edgeOf[a][b] = numEdges;
+                grid.edgeCorners[numEdges][0] = a;
+                grid.edgeCorners[numEdges][1] = b;
+                numEdges++;
+            }
+            grid.faceEdges[face][k] = edgeOf[a][b];
+        }
+    }
+
+    size_t numTriangles = (size_t) 20 << (2*subDiv);
+    size_t numPositions = numTriangles / 2 + 2;
+
+    // With FLAT normals the shared vertices are only a step
+    std::vector<float> scratchPositions;
+    std::vector<GLuint> scratchTriangles;
+    float* positions = target.vertices;
+    GLuint* triangles = target.elements;
+    if (normalType == FLAT) {
+        scratchPositions.resize(numPositions * 3);
+        scratchTriangles.resize(numTriangles * 3);
+        positions = &scratchPositions[0];
+        triangles = &scratchTriangles[0];
+    }
+
+    // Icosahedron vertices
+    float theta = 26.565 * PI / 180.0f;
+    float sth = std::sin(theta);
+    float cth = std::cos(theta);
+    float dps = 2 * PI / 5.0f;
+
+    // top vertex
+    positions[0] = 0;
+    positions[1] = 0;
+    positions[2] = 1;
+
+    // upper pentagon
+    float psi = 0;
+    for( int i = 1; i < 6; ++i ) {
+        positions[3*i]   = cth * std::cos(psi);
+        positions[3*i+1] = cth * std::sin(psi);
+        positions[3*i+2] = sth;
+
+        psi += dps;
+    }
+
+    // lower pentagon
+    psi = PI / 5.0f;
+    for( int i = 6; i < 11; ++i ) {
+        positions[3*i]   = cth * std::cos(psi);
+        positions[3*i+1] = cth * std::sin(psi);
+        positions[3*i+2] = -sth;
+
+        psi += dps;
+    }
+
+    // lower vertex
+    positions[33] = 0;
+    positions[34] = 0;
+    positions[35] = -1;
+
+    // The points inside the edges, from the widest steps to the finest
+    GLuint n = grid.n;
+    for (int edge = 0; edge < 30; ++edge) {
+        int a = grid.edgeCorners[edge][0];
+        int b = grid.edgeCorners[edge][1];
+        for (GLuint h = n / 2; h >= 1; h /= 2) {
+            for (GLuint k = h; k < n; k += 2*h) {
+                GLuint from = k == h ? (GLuint) a : getEdgePoint(grid, a, b, edge, k - h);
+                GLuint to = k + h == n ? (GLuint) b : getEdgePoint(grid, a, b, edge, k + h);
+                setMiddle(positions, from, to, getEdgePoint(grid, a, b, edge, k), positions);
+            }
+        }
+    }
+    if (normalType != FLAT) {
+        memcpy(target.normals, target.vertices, grid.firstFacePoint * 3 * sizeof(float));
+    }
+
+    size_t numParts = countParts(numTriangles, 20, numThreads);
+    std::vector<SpherePart> parts(numParts);
+    for (size_t i = 0; i < numParts; ++i) {
+        parts[i].grid = &grid;
+        parts[i].normalType = normalType;
+        parts[i].firstFace = (int) (20 * i / numParts);
+        parts[i].endFace = (int) (20 * (i + 1) / numParts);
+        parts[i].positions = positions;
+        parts[i].triangles = triangles;
+        parts[i].target = target;
+    }
+    runOnParts(makeSphereFaces, parts);
+}
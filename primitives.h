@@ -0,0 +1,143 @@
+/*
+ * primitives.h
+ *
+ * The geometry of the cube, cylinder and sphere of Shape, made straight
+ * into arrays sized up front. Every primitive is split in parts that are
+ * written to their own ranges of the arrays, so the parts can be made on
+ * several threads and the result is the same with any number of them.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _PRIMITIVES_H
+#define _PRIMITIVES_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+
+// The types of normals a primitive can have
+#define FLAT    0
+#define SMOOTH  1
+
+// Parts with fewer triangles than this are not worth a thread of their own
+#define PRIMITIVE_MIN_THREAD_TRIANGLES  32768
+
+/*
+ * Where a primitive is written: x y z of the position and of the normal
+ * of every vertex, and three elements per triangle. The elements start at
+ * firstVertex, so a primitive can go after other geometry.
+ */
+struct PrimitiveTarget {
+    float* vertices;
+    float* normals;
+    GLuint* elements;
+    GLuint firstVertex;
+};
+
+/*
+ * getCubeSize
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the squares, at least 1.
+ *         numVertices - where the number of vertices is written.
+ *         numElements - where the number of elements is written.
+ *
+ */
+void getCubeSize(int subDiv, size_t& numVertices, size_t& numElements);
+
+/*
+ * makeCubeGeometry
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the squares, at least 1.
+ *         target - arrays with room for getCubeSize.
+ *         numThreads - how many threads write it, 0 uses every core.
+ *
+ * DESCRIPTION:
+ *         A cube centered at the origin with sides of length 1. Each face
+ *         is a grid of vertices with its normal, split in rows that the
+ *         threads make.
+ *
+ */
+void makeCubeGeometry(int subDiv, const PrimitiveTarget& target, int numThreads);
+
+/*
+ * getCylinderSize
+ *
+ * INPUT:
+ *         subDivBase - number of subdivisions on the bases, at least 3.
+ *         subDivHeight - number of subdivisions on height, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         numVertices - where the number of vertices is written.
+ *         numElements - where the number of elements is written.
+ *
+ */
+void getCylinderSize(int subDivBase, int subDivHeight, int normalType,
+                     size_t& numVertices, size_t& numElements);
+
+/*
+ * makeCylinderGeometry
+ *
+ * INPUT:
+ *         subDivBase - number of subdivisions on the bases, at least 3.
+ *         subDivHeight - number of subdivisions on height, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         target - arrays with room for getCylinderSize.
+ *         numThreads - how many threads write it, 0 uses every core.
+ *
+ * DESCRIPTION:
+ *         A cylinder of radius 0.5 and height 1 centered at the origin.
+ *         The bases are a center and a ring of vertices each. The sides
+ *         are columns of vertices shared around the cylinder with SMOOTH
+ *         normals, and a pair of columns for each side with FLAT ones.
+ *         The threads make ranges of the rows of every side.
+ *
+ */
+void makeCylinderGeometry(int subDivBase, int subDivHeight, int normalType,
+                          const PrimitiveTarget& target, int numThreads);
+
+/*
+ * getSphereSize
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the triangles, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         numVertices - where the number of vertices is written.
+ *         numElements - where the number of elements is written.
+ *
+ */
+void getSphereSize(int subDiv, int normalType, size_t& numVertices, size_t& numElements);
+
+/*
+ * makeSphereGeometry
+ *
+ * INPUT:
+ *         subDiv - number of subdivisions for the triangles, at least 1.
+ *         normalType - FLAT or SMOOTH.
+ *         target - arrays with room for getSphereSize.
+ *         numThreads - how many threads write it, 0 uses every core.
+ *
+ * DESCRIPTION:
+ *         A unit sphere made by splitting every triangle of an icosahedron
+ *         in 4, subDiv times, and pushing the new vertices onto the
+ *         sphere (Hoffmann, Sphere Tesselation by Icosahedron
+ *         Subdivision). With SMOOTH normals the vertices are shared and
+ *         the normal is the position, with FLAT normals every triangle has
+ *         its own three.
+ *
+ *         The points on the edges of the icosahedron are made first, then
+ *         each of its 20 faces is made on its own: its triangles split
+ *         into a grid, where the middle of every edge has a fixed place,
+ *         so the faces can be made on different threads.
+ *
+ */
+void makeSphereGeometry(int subDiv, int normalType, const PrimitiveTarget& target, int numThreads);
+
+#endif
@@ -17,4 +17,44 @@ float quadTextures[] = {
 GLshort quadElements[] = {
     0, 1, 2,
     0, 2, 3
-};
\ No newline at end of file
+};
+
+/*
+ * uploadScreenQuad
+ *
+ * RETURN:
+ *         The buffers of the screen quad, its vertices interleaved (X Y U V)
+ *         like the ones of uploadShape, ready for makeVertexArray.
+ *
+ */
+ShapeBuffers uploadScreenQuad() {
+    ShapeBuffers buffers;
+
+    // positions are only x y
+    buffers.layout = makeVertexLayout(VERTEX_POSITION | VERTEX_UV);
+    buffers.layout.attributes[ATTRIBUTE_POSITION].size = 2;
+    buffers.layout.attributes[ATTRIBUTE_UV].offset = 2 * sizeof(GLfloat);
+    buffers.layout.stride = 4 * sizeof(GLfloat);
+
+    buffers.numVertices = 4;
+    buffers.numElements = 6;
+    buffers.elementType = GL_UNSIGNED_SHORT;
+
+    float stream[4 * 4];
+    for (int i = 0; i < 4; ++i) {
+        stream[i * 4 + 0] = quadVertices[i * 2 + 0];
+        stream[i * 4 + 1] = quadVertices[i * 2 + 1];
+        stream[i * 4 + 2] = quadTextures[i * 2 + 0];
+        stream[i * 4 + 3] = quadTextures[i * 2 + 1];
+    }
+
+    glGenBuffers(1, &buffers.vbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(stream), stream, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &buffers.ebuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.numElements * sizeof(GLshort), quadElements, GL_STATIC_DRAW);
+
+    return buffers;
+}
@@ -1,3 +1,5 @@
+#ifndef _SCREENQUADHELPER_H
+#define _SCREENQUADHELPER_H
 
 #ifdef __APPLE__
 #include <OpenGL/gl3.h>
@@ -6,6 +8,20 @@
 #include <GL/gl.h>
 #endif
 
+#include "vertexBuffer.h"
+
 extern float quadVertices[];
 extern float quadTextures[];
-extern GLshort quadElements[];
\ No newline at end of file
+extern GLshort quadElements[];
+
+/*
+ * uploadScreenQuad
+ *
+ * RETURN:
+ *         The buffers of the screen quad, its vertices interleaved (X Y U V)
+ *         like the ones of uploadShape, ready for makeVertexArray.
+ *
+ */
+ShapeBuffers uploadScreenQuad();
+
+#endif
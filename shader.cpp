@@ -11,6 +11,8 @@
 
 #include "shader.h"
 
+#include <string.h>
+
 namespace shader
 {
 
@@ -58,6 +60,83 @@ GLchar* readFile(const char* filename) {
     return fileContent;
 }
 
+// How deep included files can include others, so a file that includes
+// itself is an error instead of a crash
+#define MAX_INCLUDE_DEPTH 8
+
+// Appends the contents of filename to source, with its includes expanded
+static bool appendShaderFile(const std::string& filename, int depth, std::string& source) {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        fprintf( stderr, "error: too many nested includes in %s\n", filename.c_str());
+        return false;
+    }
+
+    GLchar* fileContent = readFile(filename.c_str());
+    if (fileContent == NULL) {
+        return false;
+    }
+
+    // the includes are relative to the file that has them
+    std::string directory;
+    size_t slash = filename.find_last_of('/');
+    if (slash != std::string::npos) {
+        directory = filename.substr(0, slash + 1);
+    }
+
+    const char* line = fileContent;
+    bool ok = true;
+    while (ok && *line != '\0') {
+        const char* end = strchr(line, '\n');
+        size_t length = (end != NULL) ? (size_t) (end - line) + 1 : strlen(line);
+
+        const char* text = line;
+        while (*text == ' ' || *text == '\t') {
+            ++text;
+        }
+        const char* open = strchr(text, '"');
+        const char* close = (open != NULL) ? strchr(open + 1, '"') : NULL;
+        if (strncmp(text, "#include", 8) == 0 && close != NULL && close < line + length) {
+            std::string name(open + 1, close - open - 1);
+            ok = appendShaderFile(directory + name, depth + 1, source);
+            source += '\n';
+        } else {
+            source.append(line, length);
+        }
+        line += length;
+    }
+
+    delete[] fileContent;
+    return ok;
+}
+
+/*
+ * readShaderFile
+ *
+ * INPUT:
+ *         filename - the filename of the shader we want to read.
+ *
+ * RETURN:
+ *         The contents of the shader in a dinamycally alocated string
+ *         of GLchar, or NULL if there was an error.
+ *
+ * DESCRIPTION:
+ *         Reads the shader like readFile, and replaces every line
+ *         #include "name" with the contents of name, next to the
+ *         shader, so the shaders can share functions (GLSL does not
+ *         have includes). Included files can include others.
+ *
+ */
+GLchar* readShaderFile(const char* filename) {
+    std::string source;
+    if (!appendShaderFile(filename, 0, source)) {
+        return NULL;
+    }
+
+    GLchar* fileContent = new GLchar[source.size() + 1];
+    memcpy(fileContent, source.c_str(), source.size() + 1);
+    return fileContent;
+}
+
 /*
  * readFile
  *
@@ -105,8 +184,9 @@ void printShaderLog(GLuint shaderID) {
  *
  * DESCRIPTION:
  *         This function reads the vertex shader file and the
- *         the fragment shader file, and links those together
- *         into a "program", then its ID is returned.
+ *         the fragment shader file, with their includes (see
+ *         readShaderFile), and links those together into a
+ *         "program", then its ID is returned.
  *
  */
 GLuint makeShaderProgram(const char *vert, const char *frag) {
@@ -119,13 +199,13 @@ GLuint makeShaderProgram(const char *vert, const char *frag) {
     fragID = glCreateShader( GL_FRAGMENT_SHADER );
 
     // Reading the files
-    vertContent = readFile(vert);
+    vertContent = readShaderFile(vert);
     if (vertContent == NULL) {
         fprintf( stderr, "error: error reading vertex shader file %s\n", vert);
         return 0;
     }
 
-    fragContent = readFile(frag);
+    fragContent = readShaderFile(frag);
     if (fragContent == NULL) {
         fprintf( stderr, "error: error reading fragment shader file %s\n", frag);
         delete[] vertContent;
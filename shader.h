@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <stdio.h>
+#include <string>
 
 namespace shader
 {
@@ -40,6 +41,25 @@ namespace shader
  */
 GLchar* readFile(const char* filename);
 
+/*
+ * readShaderFile
+ *
+ * INPUT:
+ *         filename - the filename of the shader we want to read.
+ *
+ * RETURN:
+ *         The contents of the shader in a dinamycally alocated string
+ *         of GLchar, or NULL if there was an error.
+ *
+ * DESCRIPTION:
+ *         Reads the shader like readFile, and replaces every line
+ *         #include "name" with the contents of name, next to the
+ *         shader, so the shaders can share functions (GLSL does not
+ *         have includes). Included files can include others.
+ *
+ */
+GLchar* readShaderFile(const char* filename);
+
 /*
  * readFile
  *
@@ -66,8 +86,9 @@ void printShaderLog(GLuint shaderID);
  *
  * DESCRIPTION:
  *         This function reads the vertex shader file and the
- *         the fragment shader file, and links those together
- *         into a "program", then its ID is returned.
+ *         the fragment shader file, with their includes (see
+ *         readShaderFile), and links those together into a
+ *         "program", then its ID is returned.
  *
  */
 GLuint makeShaderProgram(const char *vert, const char *frag);
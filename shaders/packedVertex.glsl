@@ -0,0 +1,31 @@
+// Decodes the vertices uploaded with VERTEX_PACKED (see vertexBuffer.h).
+// Include it after the #version of a vertex shader:
+//     #include "packedVertex.glsl"
+// and set the uniforms with setPackedVertexUniforms.
+
+// The bounding box of the positions and the range of the uvs
+uniform vec3 uPositionScale;
+uniform vec3 uPositionOffset;
+uniform vec2 uUvScale;
+uniform vec2 uUvOffset;
+
+// The position, from the 16 bit integers inside the bounding box
+vec3 decodePosition (vec4 packedPosition) {
+    return uPositionOffset + uPositionScale * packedPosition.xyz;
+}
+
+// The uv, from the 16 bit integers inside the range of the uvs
+vec2 decodeTexCoord (vec2 packedTexCoord) {
+    return uUvOffset + uUvScale * packedTexCoord;
+}
+
+// A normal, tangent or bitangent, from the two 16 bit integers of the
+// octahedral encoding: the square is folded back onto the octahedron
+vec3 decodeOctahedral (vec2 packedDirection) {
+    vec2 e = packedDirection / 32767.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -fold : fold;
+    n.y += (n.y >= 0.0) ? -fold : fold;
+    return normalize(n);
+}
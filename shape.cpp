@@ -10,263 +10,154 @@
 #include "shape.h"
 
 /*
- * addTriangle
+ * addPrimitive
  *
  * INPUT:
- *         xN - the x value of the Nth point of the triangle.
- *         yN - the y value of the Nth point of the triangle.
- *         zN - the z value of the Nth point of the triangle.
+ *         numVertices - how many vertices the primitive has.
+ *         numElements - how many elements the primitive has.
+ *
+ * RETURN:
+ *         Where the primitive is written, after the geometry the shape
+ *         already has.
  *
  * DESCRIPTION:
- *         This function gets as input three (x,y,z) points
- *         that will create a polygon (triangle). These points
- *         are required to be in counter clockwise order. This function
- *         will also calculate normals for the vertices, however every vertex
- *         of the triangle will have the same normal.
- *         The variables numVertices, numNormals andnumElements are also
- *         changed accordingly.
+ *         Makes room for a primitive of primitives.h on vertices,
+ *         normals and elements.
  *
  */
-void Shape::addTriangle(float x0, float y0, float z0,
-                        float x1, float y1, float z1,
-                        float x2, float y2, float z2){
-
-    // Vertices
-    vertices.push_back(x0);
-    vertices.push_back(y0);
-    vertices.push_back(z0);
-
-    vertices.push_back(x1);
-    vertices.push_back(y1);
-    vertices.push_back(z1);
-
-    vertices.push_back(x2);
-    vertices.push_back(y2);
-    vertices.push_back(z2);
-
-    // Normals
-    float vec1[] = {x1 - x0, y1 - y0, z1 - z0};
-    float vec2[] = {x2 - x0, y2 - y0, z2 - z0};
-
-    float nx = (vec1[1] * vec2[2]) - (vec1[2] * vec2[1]);
-    float ny = (vec1[2] * vec2[0]) - (vec1[0] * vec2[2]);
-    float nz = (vec1[0] * vec2[1]) - (vec1[1] * vec2[0]);
-
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
-
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
-
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
+PrimitiveTarget Shape::addPrimitive(size_t numVertices, size_t numElements) {
+    detachPrimitive();
+
+    size_t firstVertex = vertices.size()/3;
+    size_t firstElement = elements.size();
+
+    vertices.resize(vertices.size() + numVertices * 3);
+    normals.resize(vertices.size());
+    elements.resize(elements.size() + numElements);
+
+    PrimitiveTarget target;
+    target.vertices = &vertices[firstVertex * 3];
+    target.normals = &normals[firstVertex * 3];
+    target.elements = &elements[firstElement];
+    target.firstVertex = (GLuint) firstVertex;
+    return target;
 }
 
 /*
- * addTriangle
- *
- * INPUT:
- *         v0 - the first vertex of the triangle.
- *         v1 - the second vertex of the triangle.
- *         v2 - the third vertex of the triangle.
+ * finishPrimitive
  *
  * DESCRIPTION:
- *         This function works exactly like the previous addTriangle,
- *         with the exception that instead of using as arguments the x, y,
- *         and z of each vertex, we use three arrays of size 3 that hold
- *         those values. In other words, v0[3] = {x, y, z}.
+ *         Updates the counts once a primitive is made and packs its
+ *         elements.
  *
  */
-void Shape::addTriangle(float v0[], float v1[], float v2[]) {
-    // Vertices
-    vertices.push_back(v0[0]);
-    vertices.push_back(v0[1]);
-    vertices.push_back(v0[2]);
-
-    vertices.push_back(v1[0]);
-    vertices.push_back(v1[1]);
-    vertices.push_back(v1[2]);
-
-    vertices.push_back(v2[0]);
-    vertices.push_back(v2[1]);
-    vertices.push_back(v2[2]);
-
-    // Normals
-    float vec1[] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
-    float vec2[] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
-
-    float nx = (vec1[1] * vec2[2]) - (vec1[2] * vec2[1]);
-    float ny = (vec1[2] * vec2[0]) - (vec1[0] * vec2[2]);
-    float nz = (vec1[0] * vec2[1]) - (vec1[1] * vec2[0]);
-
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
-
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
-
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
+void Shape::finishPrimitive() {
+    numVertices = vertices.size()/3;
+    numNormals = normals.size()/3;
+    numElements = elements.size();
+    packElements();
 }
 
 /*
- * addTriangleAndNormals
+ * makePrimitive
  *
  * INPUT:
- *         xN - the x value of the Nth point of the triangle.
- *         yN - the y value of the Nth point of the triangle.
- *         zN - the z value of the Nth point of the triangle.
- *         nxN - the x value of the normal of the Nth point of the triangle.
- *         nyN - the y value of the normal of the Nth point of the triangle.
- *         nzN - the z value of the normal of the Nth point of the triangle.
+ *         key - the primitive, with its parameters already clamped.
  *
  * DESCRIPTION:
- *         This function works just like addTriangle, but with it you can also
- *         tell the normals of each vertex.
+ *         Gets the primitive from the cache. An empty shape shares it,
+ *         one with geometry gets a copy of it after its own.
  *
  */
-void Shape::addTriangleAndNormals(float x0, float y0, float z0,
-                                  float x1, float y1, float z1,
-                                  float x2, float y2, float z2,
-                                  float nx0, float ny0, float nz0,
-                                  float nx1, float ny1, float nz1,
-                                  float nx2, float ny2, float nz2){
-
-    vertices.push_back(x0);
-    vertices.push_back(y0);
-    vertices.push_back(z0);
-
-    vertices.push_back(x1);
-    vertices.push_back(y1);
-    vertices.push_back(z1);
-
-    vertices.push_back(x2);
-    vertices.push_back(y2);
-    vertices.push_back(z2);
-
-    normals.push_back(nx0);
-    normals.push_back(ny0);
-    normals.push_back(nz0);
-
-    normals.push_back(nx1);
-    normals.push_back(ny1);
-    normals.push_back(nz1);
+void Shape::makePrimitive(const PrimitiveKey& key) {
+    shared_ptr<const PrimitiveGeometry> geometry = getCachedPrimitive(key, generatorThreads);
+
+    if (numVertices == 0 && numElements == 0 && !primitive) {
+        primitive = geometry;
+        numVertices = geometry->vertices.size()/3;
+        numNormals = numVertices;
+        numElements = geometry->elements.size();
+        elementType = geometry->elementType;
+        return;
+    }
 
-    normals.push_back(nx2);
-    normals.push_back(ny2);
-    normals.push_back(nz2);
+    PrimitiveTarget target = addPrimitive(geometry->vertices.size()/3, geometry->elements.size());
+    memcpy(target.vertices, &geometry->vertices[0], geometry->vertices.size() * sizeof(float));
+    memcpy(target.normals, &geometry->normals[0], geometry->normals.size() * sizeof(float));
+    for (size_t i = 0; i < geometry->elements.size(); ++i) {
+        target.elements[i] = geometry->elements[i] + target.firstVertex;
+    }
+    finishPrimitive();
 }
 
 /*
- * addTriangleAndNormals
- *
- * INPUT:
- *         v0 - the first vertex of the triangle.
- *         v1 - the second vertex of the triangle.
- *         v2 - the third vertex of the triangle.
- *         n0 - the normal of the first vertex of the triangle.
- *         n1 - the normal of the second vertex of the triangle.
- *         n2 - the normal of the third vertex of the triangle.
+ * detachPrimitive
  *
  * DESCRIPTION:
- *         This function works exactly like the previous addTriangleAndNormals,
- *         with the exception that instead of using as arguments the x, y,
- *         and z of each vertex, we use three arrays of size 3 that hold
- *         those values. In other words, v0[3] = {x, y, z}.
+ *         Copies the shared primitive into the arrays of the shape and
+ *         stops sharing it. Everything that changes the geometry calls
+ *         it first, nothing is done if the shape shares nothing.
  *
  */
-void Shape::addTriangleAndNormals(float v0[], float v1[], float v2[],
-                                  float n0[], float n1[], float n2[]){
-
-    // Vertices
-    vertices.push_back(v0[0]);
-    vertices.push_back(v0[1]);
-    vertices.push_back(v0[2]);
-
-    vertices.push_back(v1[0]);
-    vertices.push_back(v1[1]);
-    vertices.push_back(v1[2]);
-
-    vertices.push_back(v2[0]);
-    vertices.push_back(v2[1]);
-    vertices.push_back(v2[2]);
+void Shape::detachPrimitive() {
+    if (!primitive) {
+        return;
+    }
 
-    normals.push_back(n0[0]);
-    normals.push_back(n0[1]);
-    normals.push_back(n0[2]);
+    vertices = primitive->vertices;
+    normals = primitive->normals;
+    elements = primitive->elements;
+    elementData = primitive->elementData;
+    elementType = primitive->elementType;
+    primitive.reset();
+}
 
-    normals.push_back(n1[0]);
-    normals.push_back(n1[1]);
-    normals.push_back(n1[2]);
+/*
+ * getVertexArray
+ *
+ * RETURN:
+ *         The positions the shape is drawn with, those of the shared
+ *         primitive or its own.
+ *
+ */
+const vector<float>& Shape::getVertexArray() const {
+    return primitive ? primitive->vertices : vertices;
+}
 
-    normals.push_back(n2[0]);
-    normals.push_back(n2[1]);
-    normals.push_back(n2[2]);
+/*
+ * getNormalArray
+ *
+ * RETURN:
+ *         The normals the shape is drawn with.
+ *
+ */
+const vector<float>& Shape::getNormalArray() const {
+    return primitive ? primitive->normals : normals;
 }
 
 /*
- * addTriangleWithSubdivision
+ * getElementArray
  *
- * INPUT:
- *         v0 - the first vertex of the triangle.
- *         v1 - the second vertex of the triangle.
- *         v2 - the third vertex of the triangle.
- *         subDiv - number of subdivisions for the triangles.
+ * RETURN:
+ *         The elements the shape is drawn with, not packed.
+ *
+ */
+const vector<GLuint>& Shape::getElementArray() const {
+    return primitive ? primitive->elements : elements;
+}
+
+/*
+ * packElements
  *
  * DESCRIPTION:
- *         This function is used together with the makeSphere function.
- *         It's responsible for subdividing the triangles of the sphere so that
- *         we get a better result. Essentially the triangle "0, 1, 2" will
- *         become triangles "0,3,5", "3,1,4", "5,4,2" and "3,4,5".
- *
- *                      0
- *                  3       5
- *              1       4       2
- *
- *         It's a recursive function so it can keep sub dividing the triangles.
- *         This function will also be different depending on the type of
- *         normals. If you want the FLAT normals, then for each triangles,
- *         the vertices will have the same normals. If you want the SMOOTH normals
- *         then another function will be called where we tell it what
- *         are the normals, in the case of the sphere you can consider the normals
- *         of the points as the same as the points (they are vertices coming from
- *         the origin).
- *
- */
-void Shape::addTriangleWithSubdivision(float v0[], float v1[], float v2[], int subDiv, int normalType) {
-    float v3[] = {v0[0] + v1[0], v0[1] + v1[1], v0[2] + v1[2]};
-    float v4[] = {v1[0] + v2[0], v1[1] + v2[1], v1[2] + v2[2]};
-    float v5[] = {v2[0] + v0[0], v2[1] + v0[1], v2[2] + v0[2]};
-
-    normalize(v3);
-    normalize(v4);
-    normalize(v5);
-
-    if (subDiv == 1) {
-        if (normalType == FLAT) {
-            addTriangle(v0,v3,v5);
-            addTriangle(v3,v1,v4);
-            addTriangle(v5,v4,v2);
-            addTriangle(v3,v4,v5);
-        } else {
-            addTriangleAndNormals(v0,v3,v5,v0,v3,v5);
-            addTriangleAndNormals(v3,v1,v4,v3,v1,v4);
-            addTriangleAndNormals(v5,v4,v2,v5,v4,v2);
-            addTriangleAndNormals(v3,v4,v5,v3,v4,v5);
-        }
-    } else {
-        subDiv--;
-        addTriangleWithSubdivision(v0,v3,v5,subDiv,normalType);
-        addTriangleWithSubdivision(v3,v1,v4,subDiv,normalType);
-        addTriangleWithSubdivision(v5,v4,v2,subDiv,normalType);
-        addTriangleWithSubdivision(v3,v4,v5,subDiv,normalType);
-    }
+ *         Chooses the narrowest type that can hold every element (8, 16 or
+ *         32 bits) and copies the elements to elementData with that type.
+ *         It has to be called every time elements changes.
+ *
+ */
+void Shape::packElements() {
+    elementType = packElementData(elements.empty() ? NULL : &elements[0], elements.size(),
+                                  elementData);
 }
 
 /*
@@ -277,7 +168,10 @@ void Shape::addTriangleWithSubdivision(float v0[], float v1[], float v2[], int s
  *         variables to 0 such as the number of vertices of the shape.
  *
  */
-Shape::Shape () : numVertices(0), numColors(0), numNormals(0), numElements(0) {
+Shape::Shape () : numVertices(0), numColors(0), numTextures(0), textureID(0), textureDiffMapID(0),
+                   textureSpecMapID(0), textureNormalMapID(0), numNormals(0), numElements(0),
+                   elementType(GL_UNSIGNED_BYTE), numTangents(0), numBitangents(0),
+                   loaderThreads(1), generatorThreads(0), useMeshCache(true), lodDiameter(0.0f) {
 }
 
 /*
@@ -304,11 +198,35 @@ void Shape::clearShape () {
     colors.clear();
     numColors = 0;
 
+    uvtextures.clear();
+    numTextures = 0;
+
     normals.clear();
     numNormals = 0;
 
+    tangents.clear();
+    numTangents = 0;
+
+    bitangents.clear();
+    numBitangents = 0;
+
     elements.clear();
+    elementData.clear();
+    elementType = GL_UNSIGNED_BYTE;
     numElements = 0;
+    primitive.reset();
+
+    submeshes.clear();
+    submeshNames.clear();
+    materials.clear();
+    materialBatches.clear();
+    materialDiffTextureIDs.clear();
+    materialSpecTextureIDs.clear();
+    materialNormalMapIDs.clear();
+
+    lods.clear();
+    lodDiameter = 0.0f;
+    meshlets.clear();
 
     ambientMaterial.clear();
     diffuseMaterial.clear();
@@ -325,11 +243,31 @@ void Shape::clearShape () {
  * RETURN:
  *         The vector/array of the vertices.
  *
+ * DESCRIPTION:
+ *         The array can be written, so a shape sharing a cached
+ *         primitive gets its own copy of it first. To only read it use
+ *         getVertexData, which does not copy.
+ *
  */
 float* Shape::getVertices() {
+    detachPrimitive();
     return &vertices[0];
 }
 
+/*
+ * getVertexData
+ *
+ * RETURN:
+ *         The vertices, only to be read. A shape sharing a cached
+ *         primitive returns those of the primitive and keeps sharing
+ *         it. NULL if there are none.
+ *
+ */
+const float* Shape::getVertexData() const {
+    const vector<float>& positions = getVertexArray();
+    return positions.empty() ? NULL : &positions[0];
+}
+
 /*
  * getNumVertices
  *
@@ -386,124 +324,938 @@ GLuint Shape::getNumUV() {
 }
 
 /*
- * getDiffTextureID
+ * getDiffTextureID
+ *
+ * RETURN:
+ *         The ID of the diffuse texture map.
+ *
+ */
+GLuint Shape::getDiffTextureID(){
+    return textureDiffMapID;
+}
+
+/*
+ * getSpecTextureID
+ *
+ * RETURN:
+ *         The ID of the specular texture map.
+ *
+ */
+GLuint Shape::getSpecTextureID(){
+    return textureSpecMapID;
+}
+
+/*
+ * getTextureNormalMapID
+ *
+ * RETURN:
+ *         The ID of the normal texture map.
+ *
+ */
+GLuint Shape::getTextureNormalMapID(){
+    return textureNormalMapID;
+}
+
+/*
+ * getNormals
+ *
+ * RETURN:
+ *         The vector/array of the normals.
+ *
+ * DESCRIPTION:
+ *         The array can be written, so a shape sharing a cached
+ *         primitive gets its own copy of it first. To only read it use
+ *         getNormalData, which does not copy.
+ *
+ */
+float* Shape::getNormals() {
+    detachPrimitive();
+    return &normals[0];
+}
+
+/*
+ * getNormalData
+ *
+ * RETURN:
+ *         The normals, only to be read, like getVertexData. NULL if
+ *         there are none.
+ *
+ */
+const float* Shape::getNormalData() const {
+    const vector<float>& directions = getNormalArray();
+    return directions.empty() ? NULL : &directions[0];
+}
+
+/*
+ * getNumNormals
+ *
+ * RETURN:
+ *         The number of the normals.
+ *
+ */
+GLuint Shape::getNumNormals() {
+    return numNormals;
+}
+
+/*
+ * getElements
+ *
+ * RETURN:
+ *         The vector/array of elements, stored with the type returned
+ *         by getElementType.
+ *
+ * DESCRIPTION:
+ *         Like getVertices, a shape sharing a cached primitive gets its
+ *         own copy of the elements first, getElementData does not.
+ *
+ */
+GLvoid* Shape::getElements() {
+    detachPrimitive();
+    return &elementData[0];
+}
+
+/*
+ * getElementData
+ *
+ * RETURN:
+ *         The elements with the type of getElementType, only to be
+ *         read, like getVertexData. NULL if there are none.
+ *
+ */
+const GLvoid* Shape::getElementData() const {
+    const vector<GLubyte>& data = primitive ? primitive->elementData : elementData;
+    return data.empty() ? NULL : &data[0];
+}
+
+/*
+ * getSharedPrimitive
+ *
+ * RETURN:
+ *         The cached primitive the shape shares, NULL if its geometry
+ *         is its own.
+ *
+ */
+shared_ptr<const PrimitiveGeometry> Shape::getSharedPrimitive() {
+    return primitive;
+}
+
+/*
+ * getElementType
+ *
+ * RETURN:
+ *         The type of the elements, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or
+ *         GL_UNSIGNED_INT. This is what should be used on glDrawElements.
+ *
+ */
+GLenum Shape::getElementType() {
+    return elementType;
+}
+
+/*
+ * getElementSize
+ *
+ * RETURN:
+ *         The size in bytes of each element (1, 2 or 4).
+ *
+ */
+GLuint Shape::getElementSize() {
+    if (elementType == GL_UNSIGNED_INT) {
+        return sizeof(GLuint);
+    } else if (elementType == GL_UNSIGNED_SHORT) {
+        return sizeof(GLushort);
+    }
+    return sizeof(GLubyte);
+}
+
+/*
+ * getNumElements
+ *
+ * RETURN:
+ *         The number of the elements.
+ *
+ */
+GLuint Shape::getNumElements() {
+    return numElements;
+}
+
+/*
+ * getNumSubmeshes
+ *
+ * RETURN:
+ *         The number of submeshes, 0 if the shape is only one piece.
+ *
+ */
+GLuint Shape::getNumSubmeshes() {
+    return submeshes.size();
+}
+
+/*
+ * getSubmesh
+ *
+ * INPUT:
+ *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+ *
+ * RETURN:
+ *         The range of elements of the submesh and its name and material
+ *         indices.
+ *
+ */
+Submesh Shape::getSubmesh( GLuint index ) {
+    return submeshes[index];
+}
+
+/*
+ * getSubmeshOffset
+ *
+ * INPUT:
+ *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+ *
+ * RETURN:
+ *         Where the submesh starts on the element buffer, in bytes. This
+ *         is what should be used as the last argument of glDrawElements.
+ *
+ */
+GLvoid* Shape::getSubmeshOffset( GLuint index ) {
+    return (GLvoid*) ((size_t) submeshes[index].firstElement * getElementSize());
+}
+
+/*
+ * getSubmeshName
+ *
+ * INPUT:
+ *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+ *
+ * RETURN:
+ *         The name of the object or group of the submesh, "" if it has none.
+ *
+ */
+const char* Shape::getSubmeshName( GLuint index ) {
+    GLint name = submeshes[index].name;
+    return name < 0 ? "" : submeshNames[name].c_str();
+}
+
+/*
+ * getSubmeshMaterial
+ *
+ * INPUT:
+ *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+ *
+ * RETURN:
+ *         The name of the material of the submesh, "" if it has none.
+ *
+ */
+const char* Shape::getSubmeshMaterial( GLuint index ) {
+    GLint material = submeshes[index].material;
+    return material < 0 ? "" : materials[material].name.c_str();
+}
+
+/*
+ * getNumMaterials
+ *
+ * RETURN:
+ *         The number of materials the submeshes use.
+ *
+ */
+GLuint Shape::getNumMaterials() {
+    return materials.size();
+}
+
+/*
+ * getMaterial
+ *
+ * INPUT:
+ *         index - which material, e.g. Submesh::material.
+ *
+ * RETURN:
+ *         The colors, exponent and texture files of the material.
+ *
+ */
+const obj::ObjMaterial& Shape::getMaterial( GLuint index ) {
+    return materials[index];
+}
+
+/*
+ * getNumMaterialBatches
+ *
+ * RETURN:
+ *         The number of material batches, 0 if the shape is only one piece.
+ *
+ */
+GLuint Shape::getNumMaterialBatches() {
+    return materialBatches.size();
+}
+
+/*
+ * getMaterialBatch
+ *
+ * INPUT:
+ *         index - which batch, from 0 to getNumMaterialBatches() - 1.
+ *
+ * RETURN:
+ *         The range of elements of every submesh with one material. The
+ *         .obj loaders sort the triangles by material, so each material
+ *         has a single batch and its textures are bound once per frame.
+ *
+ */
+Submesh Shape::getMaterialBatch( GLuint index ) {
+    return materialBatches[index];
+}
+
+/*
+ * getElementOffset
+ *
+ * INPUT:
+ *         element - an element, e.g. Submesh::firstElement.
+ *
+ * RETURN:
+ *         Where the element is on the element buffer, in bytes. This is
+ *         what should be used as the last argument of glDrawElements.
+ *
+ */
+GLvoid* Shape::getElementOffset( GLuint element ) {
+    return (GLvoid*) ((size_t) element * getElementSize());
+}
+
+// The texture of a file, loaded only the first time it is seen
+static GLuint loadTextureOnce ( const string& filename, map<string, GLuint>& loaded ) {
+    if (filename.empty()) {
+        return 0;
+    }
+
+    map<string, GLuint>::iterator it = loaded.find(filename);
+    if (it != loaded.end()) {
+        return it->second;
+    }
+
+    GLuint id = load_png(filename.c_str());
+    if (id == 0) {
+        printf( "Error loading texture %s\n", filename.c_str() );
+    }
+    loaded[filename] = id;
+    return id;
+}
+
+/*
+ * loadMaterialTextures
+ *
+ * DESCRIPTION:
+ *         Creates the textures of every material, a file used by several
+ *         materials is only loaded once.
+ *
+ */
+void Shape::loadMaterialTextures() {
+    map<string, GLuint> loaded;
+
+    materialDiffTextureIDs.resize(materials.size());
+    materialSpecTextureIDs.resize(materials.size());
+    materialNormalMapIDs.resize(materials.size());
+
+    for (size_t i = 0; i < materials.size(); ++i) {
+        materialDiffTextureIDs[i] = loadTextureOnce(materials[i].diffuseMap, loaded);
+        materialSpecTextureIDs[i] = loadTextureOnce(materials[i].specularMap, loaded);
+        materialNormalMapIDs[i] = loadTextureOnce(materials[i].normalMap, loaded);
+    }
+}
+
+/*
+ * getMaterialDiffTextureID, getMaterialSpecTextureID, getMaterialNormalMapID
+ *
+ * INPUT:
+ *         index - which material.
+ *
+ * RETURN:
+ *         The diffuse, specular or normal map of the material, 0 if it has
+ *         none or loadMaterialTextures was not called.
+ *
+ */
+GLuint Shape::getMaterialDiffTextureID( GLuint index ) {
+    return index < materialDiffTextureIDs.size() ? materialDiffTextureIDs[index] : 0;
+}
+
+GLuint Shape::getMaterialSpecTextureID( GLuint index ) {
+    return index < materialSpecTextureIDs.size() ? materialSpecTextureIDs[index] : 0;
+}
+
+GLuint Shape::getMaterialNormalMapID( GLuint index ) {
+    return index < materialNormalMapIDs.size() ? materialNormalMapIDs[index] : 0;
+}
+
+/*
+ * getTangents
+ *
+ * RETURN:
+ *         The vector/array of the tangents.
+ *
+ */
+float* Shape::getTangents() {
+    return &tangents[0];
+}
+
+/*
+ * getNumTangents
+ *
+ * RETURN:
+ *         The number of the tangents.
+ *
+ */
+GLuint Shape::getNumTangents() {
+    return numTangents;
+}
+
+/*
+ * getBitangents
+ *
+ * RETURN:
+ *         The vector/array of the bitangents.
+ *
+ */
+float* Shape::getBitangents() {
+    return &bitangents[0];
+}
+
+/*
+ * getNumBitangents
+ *
+ * RETURN:
+ *         The number of the bitangents.
+ *
+ */
+GLuint Shape::getNumBitangents() {
+    return numBitangents;
+}
+
+// Writes the smallest and the largest value of every component of count
+// values with components each, all 0 if there are none
+static void getBounds ( const float* values, GLuint count, int components, float* low, float* high ) {
+    for (int c = 0; c < components; ++c) {
+        low[c] = 0.0f;
+        high[c] = 0.0f;
+    }
+    for (GLuint v = 0; v < count; ++v) {
+        for (int c = 0; c < components; ++c) {
+            float value = values[v * components + c];
+            low[c] = (v == 0 || value < low[c]) ? value : low[c];
+            high[c] = (v == 0 || value > high[c]) ? value : high[c];
+        }
+    }
+}
+
+/*
+ * getVertexLayout
+ *
+ * INPUT:
+ *         mask - the VERTEX_* attributes wanted, plus VERTEX_PACKED for
+ *                the packed format.
+ *
+ * RETURN:
+ *         The layout of the interleaved vertices with the wanted attributes
+ *         the shape has, one entry per vertex. The others are left out. A
+ *         packed layout gets the scale and the offset of the bounding box
+ *         of the positions and of the range of the uvs.
+ *
+ */
+VertexLayout Shape::getVertexLayout( unsigned int mask ) {
+    if (numNormals < numVertices) {
+        mask &= ~VERTEX_NORMAL;
+    }
+    if (numTextures < numVertices) {
+        mask &= ~VERTEX_UV;
+    }
+    if (numColors < numVertices) {
+        mask &= ~VERTEX_COLOR;
+    }
+    if (numTangents < numVertices) {
+        mask &= ~VERTEX_TANGENT;
+    }
+    if (numBitangents < numVertices) {
+        mask &= ~VERTEX_BITANGENT;
+    }
+    VertexLayout layout = makeVertexLayout(mask);
+    if (!(mask & VERTEX_PACKED)) {
+        return layout;
+    }
+
+    // the positions go from -32767 to 32767 over the bounding box, a flat
+    // side keeps a scale that is not 0
+    const vector<float>& positions = getVertexArray();
+    float low[3];
+    float high[3];
+    getBounds(positions.empty() ? NULL : &positions[0], numVertices, 3, low, high);
+    for (int c = 0; c < 3; ++c) {
+        float half = (high[c] - low[c]) * 0.5f;
+        layout.positionOffset[c] = low[c] + half;
+        layout.positionScale[c] = ((half > 0.0f) ? half : 1.0f) / 32767.0f;
+    }
+
+    if (mask & VERTEX_UV) {
+        getBounds(uvtextures.empty() ? NULL : &uvtextures[0], numVertices, 2, low, high);
+        for (int c = 0; c < 2; ++c) {
+            layout.uvOffset[c] = low[c];
+            layout.uvScale[c] = (high[c] > low[c]) ? high[c] - low[c] : 1.0f;
+        }
+    }
+    return layout;
+}
+
+/*
+ * buildInterleavedVertices
+ *
+ * INPUT:
+ *         layout - the layout of the vertices, from getVertexLayout
+ *                  without VERTEX_PACKED.
+ *         stream - where the vertices are written.
+ *
+ * DESCRIPTION:
+ *         Fills stream with every vertex of the shape, its attributes one
+ *         after the other as layout says (XYZ NXNYNZ UV | XYZ NXNYNZ UV |
+ *         ...), so a vertex is read from one place of the vertex buffer
+ *         instead of one place per attribute.
+ *
+ */
+void Shape::buildInterleavedVertices( const VertexLayout& layout, vector<float>& stream ) {
+    const vector<float>& positions = getVertexArray();
+    const vector<float>& directions = getNormalArray();
+    const float* sources[NUM_VERTEX_ATTRIBUTES] = {
+        positions.empty() ? NULL : &positions[0],
+        directions.empty() ? NULL : &directions[0],
+        uvtextures.empty() ? NULL : &uvtextures[0],
+        colors.empty() ? NULL : &colors[0],
+        tangents.empty() ? NULL : &tangents[0],
+        bitangents.empty() ? NULL : &bitangents[0]
+    };
+
+    size_t floatsPerVertex = layout.stride / sizeof(float);
+    stream.resize(numVertices * floatsPerVertex);
+
+    // one attribute at a time, every source array is read in order
+    for (int i = 0; i < NUM_VERTEX_ATTRIBUTES; ++i) {
+        const VertexAttribute& attribute = layout.attributes[i];
+        if (attribute.size == 0 || sources[i] == NULL) {
+            continue;
+        }
+
+        const float* source = sources[i];
+        float* destination = &stream[0] + attribute.offset / sizeof(float);
+        for (GLuint v = 0; v < numVertices; ++v) {
+            for (GLint c = 0; c < attribute.size; ++c) {
+                destination[c] = source[c];
+            }
+            source += attribute.size;
+            destination += floatsPerVertex;
+        }
+    }
+}
+
+/*
+ * buildPackedVertices
+ *
+ * INPUT:
+ *         layout - a packed layout, from getVertexLayout with
+ *                  VERTEX_PACKED.
+ *         stream - where the vertices are written.
+ *
+ * DESCRIPTION:
+ *         Fills stream with every vertex of the shape in the packed format
+ *         of layout: the positions inside the bounding box and the uvs
+ *         inside their range as 16 bit integers, the normals, tangents and
+ *         bitangents octahedral encoded and the colors as bytes. A vertex
+ *         of positions, normals and uvs takes 16 bytes instead of 32.
+ *
+ */
+void Shape::buildPackedVertices( const VertexLayout& layout, vector<GLubyte>& stream ) {
+    stream.assign(numVertices * layout.stride, 0);
+    if (stream.empty()) {
+        return;
+    }
+
+    const vector<float>& positions = getVertexArray();
+    const VertexAttribute& position = layout.attributes[ATTRIBUTE_POSITION];
+    if (position.size > 0) {
+        GLubyte* destination = &stream[0] + position.offset;
+        for (GLuint v = 0; v < numVertices; ++v) {
+            GLshort packed[4] = { 0, 0, 0, 0 };
+            for (int c = 0; c < 3; ++c) {
+                float scale = layout.positionScale[c] * 32767.0f;
+                packed[c] = packSnorm16((positions[v * 3 + c] - layout.positionOffset[c]) / scale);
+            }
+            memcpy(destination, packed, sizeof(packed));
+            destination += layout.stride;
+        }
+    }
+
+    // the three directions are encoded the same way
+    const int directions[3] = { ATTRIBUTE_NORMAL, ATTRIBUTE_TANGENT, ATTRIBUTE_BITANGENT };
+    const vector<float>& shapeNormals = getNormalArray();
+    const float* sources[3] = {
+        shapeNormals.empty() ? NULL : &shapeNormals[0],
+        tangents.empty() ? NULL : &tangents[0],
+        bitangents.empty() ? NULL : &bitangents[0]
+    };
+    for (int i = 0; i < 3; ++i) {
+        const VertexAttribute& attribute = layout.attributes[directions[i]];
+        if (attribute.size == 0 || sources[i] == NULL) {
+            continue;
+        }
+
+        GLubyte* destination = &stream[0] + attribute.offset;
+        for (GLuint v = 0; v < numVertices; ++v) {
+            GLshort packed[2];
+            encodeOctahedral(sources[i] + v * 3, packed);
+            memcpy(destination, packed, sizeof(packed));
+            destination += layout.stride;
+        }
+    }
+
+    const VertexAttribute& uv = layout.attributes[ATTRIBUTE_UV];
+    if (uv.size > 0 && !uvtextures.empty()) {
+        GLubyte* destination = &stream[0] + uv.offset;
+        for (GLuint v = 0; v < numVertices; ++v) {
+            GLushort packed[2];
+            for (int c = 0; c < 2; ++c) {
+                packed[c] = packUnorm16((uvtextures[v * 2 + c] - layout.uvOffset[c]) / layout.uvScale[c]);
+            }
+            memcpy(destination, packed, sizeof(packed));
+            destination += layout.stride;
+        }
+    }
+
+    const VertexAttribute& color = layout.attributes[ATTRIBUTE_COLOR];
+    if (color.size > 0 && !colors.empty()) {
+        GLubyte* destination = &stream[0] + color.offset;
+        for (GLuint v = 0; v < numVertices; ++v) {
+            for (int c = 0; c < 4; ++c) {
+                float value = colors[v * 4 + c];
+                value = (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+                destination[c] = (GLubyte) (value * 255.0f + 0.5f);
+            }
+            destination += layout.stride;
+        }
+    }
+}
+
+/*
+ * optimizeVertexCache
+ *
+ * RETURN:
+ *         The ACMR of the shape before and after.
+ *
+ * DESCRIPTION:
+ *         Reorders the triangles of every submesh so the GPU runs the
+ *         vertex shader fewer times (see meshOptimizer.h). The shapes
+ *         loaded from .obj files are already optimized.
+ *
+ */
+VertexCacheStats Shape::optimizeVertexCache() {
+    MeshData mesh;
+    swapMeshData(mesh);
+    VertexCacheStats stats = ::optimizeVertexCache(mesh);
+    swapMeshData(mesh);
+
+    packElements();
+    meshlets.clear();
+    return stats;
+}
+
+/*
+ * getAcmr
+ *
+ * INPUT:
+ *         cacheSize - the entries of the simulated post-transform cache.
+ *
+ * RETURN:
+ *         How many times the vertex shader runs per triangle when the
+ *         shape is drawn, from a simulation of the cache on the CPU.
+ *
+ */
+float Shape::getAcmr( int cacheSize ) {
+    const vector<GLuint>& triangles = getElementArray();
+    if (triangles.empty()) {
+        return 0.0f;
+    }
+    return computeAcmr(&triangles[0], triangles.size(), numVertices, cacheSize);
+}
+
+/*
+ * optimizeVertexFetch
+ *
+ * RETURN:
+ *         The overfetch of the shape before and after.
+ *
+ * DESCRIPTION:
+ *         Moves the vertices (and their normals, uvs, colors, tangents
+ *         and bitangents) to the order the elements use them first, so
+ *         drawing the shape reads the vertex buffer forward. Call it
+ *         after optimizeVertexCache, it does not move the triangles.
+ *
+ */
+VertexFetchStats Shape::optimizeVertexFetch() {
+    detachPrimitive();
+
+    bool hasColors = (numColors == numVertices && numVertices > 0);
+    vector<GLuint> oldElements;
+    if (hasColors) {
+        oldElements = elements;
+    }
+
+    MeshData mesh;
+    swapMeshData(mesh);
+    VertexFetchStats stats = ::optimizeVertexFetch(mesh);
+    swapMeshData(mesh);
+
+    // the colors are not part of MeshData, they follow the same order
+    if (hasColors && stats.overfetchAfter < stats.overfetchBefore) {
+        vector<GLuint> remap;
+        buildVertexFetchRemap(&oldElements[0], oldElements.size(), numVertices, remap);
+        remapVertexArray(colors, 4, remap);
+    }
+
+    packElements();
+    return stats;
+}
+
+/*
+ * optimizeOverdraw
+ *
+ * INPUT:
+ *         threshold - how much the ACMR may grow (1.05 is about 5%), the
+ *                     larger the less overdraw.
  *
  * RETURN:
- *         The ID of the diffuse texture map.
+ *         The overdraw and the ACMR of the shape before and after.
+ *
+ * DESCRIPTION:
+ *         Draws first the parts of every submesh that are usually in
+ *         front of the others, so fewer fragments are shaded and then
+ *         covered (see meshOptimizer.h). It goes after
+ *         optimizeVertexCache and before optimizeVertexFetch. Worth it for
+ *         shapes drawn with expensive fragment shaders, like the gBuffer
+ *         pass of deferred shading.
  *
  */
-GLuint Shape::getDiffTextureID(){
-    return textureDiffMapID;
+OverdrawStats Shape::optimizeOverdraw( float threshold ) {
+    MeshData mesh;
+    swapMeshData(mesh);
+    OverdrawStats stats = ::optimizeOverdraw(mesh, threshold);
+    swapMeshData(mesh);
+
+    packElements();
+    meshlets.clear();
+    return stats;
 }
 
 /*
- * getSpecTextureID
+ * getOverdraw
  *
  * RETURN:
- *         The ID of the specular texture map.
+ *         How many times the fragment shader runs per pixel the shape
+ *         covers, from a rendering of its six sides on the CPU.
  *
  */
-GLuint Shape::getSpecTextureID(){
-    return textureSpecMapID;
+float Shape::getOverdraw() {
+    const vector<GLuint>& triangles = getElementArray();
+    if (triangles.empty()) {
+        return 0.0f;
+    }
+    return computeOverdraw(&triangles[0], triangles.size(), &getVertexArray()[0], numVertices);
 }
 
 /*
- * getTextureNormalMapID
+ * generateLods
+ *
+ * INPUT:
+ *         numLevels - how many levels of detail after the full shape.
+ *         reduction - how many of the triangles of a level the next
+ *                     one keeps.
  *
  * RETURN:
- *         The ID of the normal texture map.
+ *         How many levels the shape has, including the full shape (it
+ *         stops early when a level cannot be simplified any more).
+ *
+ * DESCRIPTION:
+ *         Simplifies the shape (see meshSimplifier.h) and adds the
+ *         elements of every level after its own, so all the levels
+ *         use the same vertex buffer and the same element buffer.
+ *         After this, getNumElements() counts the elements of every
+ *         level: draw the ranges of getLod instead. It goes after the
+ *         other optimize* calls, except optimizeVertexFetch.
  *
  */
-GLuint Shape::getTextureNormalMapID(){
-    return textureNormalMapID;
+GLuint Shape::generateLods( int numLevels, float reduction ) {
+    detachPrimitive();
+
+    // the levels of a previous call are dropped first
+    if (!lods.empty()) {
+        elements.resize(lods[0].numElements);
+        numElements = elements.size();
+    }
+
+    MeshData mesh;
+    swapMeshData(mesh);
+    buildLodChain(mesh, numLevels, reduction, lods);
+    swapMeshData(mesh);
+
+    packElements();
+    getMaterialBatches(submeshes, materialBatches);
+
+    float low[3];
+    float high[3];
+    getBounds(vertices.empty() ? NULL : &vertices[0], numVertices, 3, low, high);
+    lodDiameter = sqrtf((high[0] - low[0]) * (high[0] - low[0]) +
+                        (high[1] - low[1]) * (high[1] - low[1]) +
+                        (high[2] - low[2]) * (high[2] - low[2]));
+
+    return lods.size();
 }
 
 /*
- * getNormals
+ * getNumLods
  *
  * RETURN:
- *         The vector/array of the normals.
+ *         How many levels of detail the shape has, 0 if generateLods
+ *         was not called.
  *
  */
-float* Shape::getNormals() {
-    return &normals[0];
+GLuint Shape::getNumLods() {
+    return lods.size();
 }
 
 /*
- * getNumNormals
+ * getLod
+ *
+ * INPUT:
+ *         level - which level, 0 is the full shape.
  *
  * RETURN:
- *         The number of the normals.
+ *         The range of elements of the level and of its submeshes, use
+ *         getElementOffset(lod.firstElement) when drawing it.
  *
  */
-GLuint Shape::getNumNormals() {
-    return numNormals;
+const MeshLod& Shape::getLod( GLuint level ) {
+    return lods[level];
 }
 
 /*
- * getElements
+ * getLodDiameter
  *
  * RETURN:
- *         The vector/array of elements.
+ *         The diagonal of the bounding box of the shape, what the
+ *         screenSize of selectLod measures.
  *
  */
-GLshort* Shape::getElements() {
-    return &elements[0];
+float Shape::getLodDiameter() {
+    return lodDiameter;
 }
 
 /*
- * getNumElements
+ * selectLod
+ *
+ * INPUT:
+ *         screenSize - how many pixels getLodDiameter() covers on the
+ *                      screen, e.g. from computeScreenSize.
+ *         pixelError - how many pixels the level may be off.
  *
  * RETURN:
- *         The number of the elements.
+ *         The coarsest level whose error is at most pixelError pixels
+ *         at that size, 0 if the shape has no levels.
  *
  */
-GLuint Shape::getNumElements() {
-    return numElements;
+GLuint Shape::selectLod( float screenSize, float pixelError ) {
+    if (lods.empty() || lodDiameter <= 0.0f) {
+        return 0;
+    }
+
+    // the errors grow with the level, so the first one that is too
+    // large ends the search
+    float pixelsPerUnit = screenSize / lodDiameter;
+    GLuint level = 0;
+    while (level + 1 < lods.size() && lods[level + 1].error * pixelsPerUnit <= pixelError) {
+        ++level;
+    }
+    return level;
 }
 
 /*
- * getTangents
+ * buildMeshlets
+ *
+ * INPUT:
+ *         maxVertices - the most vertices of a meshlet.
+ *         maxTriangles - the most triangles of a meshlet.
  *
  * RETURN:
- *         The vector/array of the tangents.
+ *         How many meshlets the shape has.
+ *
+ * DESCRIPTION:
+ *         Splits the triangles of the full shape in meshlets (see
+ *         meshlet.h), each one a range of elements, for cullMeshlets. It
+ *         goes after optimizeVertexCache and optimizeOverdraw, which
+ *         drop the meshlets since they move the triangles.
  *
  */
-float* Shape::getTangents() {
-    return &tangents[0];
+GLuint Shape::buildMeshlets( GLuint maxVertices, GLuint maxTriangles ) {
+    MeshData mesh;
+    swapMeshData(mesh);
+    ::buildMeshlets(mesh, meshlets, maxVertices, maxTriangles);
+    swapMeshData(mesh);
+
+    packElements();
+    return meshlets.size();
 }
 
 /*
- * getNumTangents
+ * getNumMeshlets
  *
  * RETURN:
- *         The number of the tangents.
+ *         How many meshlets the shape has, 0 if buildMeshlets was not
+ *         called.
  *
  */
-GLuint Shape::getNumTangents() {
-    return numTangents;
+GLuint Shape::getNumMeshlets() {
+    return meshlets.size();
 }
 
 /*
- * getBitangents
+ * getMeshlet
+ *
+ * INPUT:
+ *         index - which meshlet.
  *
  * RETURN:
- *         The vector/array of the bitangents.
+ *         Its range of elements and its bounds.
  *
  */
-float* Shape::getBitangents() {
-    return &bitangents[0];
+const Meshlet& Shape::getMeshlet( GLuint index ) {
+    return meshlets[index];
 }
 
 /*
- * getNumBitangents
+ * cullMeshlets
+ *
+ * INPUT:
+ *         modelView - the view times the transform of the shape.
+ *         projection - the projection matrix.
+ *         draws - where the draws of the visible meshlets are written.
  *
  * RETURN:
- *         The number of the bitangents.
+ *         How many meshlets were culled and how many were kept, to
+ *         profile the culling.
+ *
+ * DESCRIPTION:
+ *         Drops the meshlets outside of the frustum and those that face
+ *         away from the camera. Draw what is left with
+ *         glMultiDrawElements, getElementOffset(draw.firstIndex) is the
+ *         offset of every draw.
  *
  */
-GLuint Shape::getNumBitangents() {
-    return numBitangents;
+MeshletCullStats Shape::cullMeshlets( const Matrix4& modelView, const Matrix4& projection,
+                                     vector<DrawElementsIndirectCommand>& draws ) {
+    Matrix4 modelViewProjection = projection * modelView;
+
+    // the camera is at the origin of the view, in the space of the shape
+    // it is the last column of the inverse
+    Matrix4 inverse = !modelView;
+    float camera[3] = { inverse[0][3], inverse[1][3], inverse[2][3] };
+
+    return ::cullMeshlets(meshlets, camera, &modelViewProjection[0][0], draws);
 }
 
 /*
@@ -676,89 +1428,18 @@ float Shape::getSpecExp() {
  *         side of total length 1, and squares with certain
  *         sub divisions.
  *
+ *         The primitives come from primitiveCache.h: the first cube of
+ *         each subDiv is made and kept, the next ones share its arrays
+ *         (and its buffers, see uploadShape) if the shape is empty, or
+ *         copy them after the geometry the shape already has.
+ *
  */
 void Shape::makeCube (int subDiv) {
     if (subDiv < 1) {
         subDiv = 1;
     }
 
-    // Length of each side depends on the sub division
-    float side = 1.0f/subDiv;
-
-    // "Anchor" points to start the cube subdivisions
-    float p1[] = {-0.5, 0.5, 0.5};
-    float p2[] = { 0.5, 0.5,-0.5};
-    float p3[] = { 0.5, 0.5, 0.5};
-    float p4[] = {-0.5, 0.5,-0.5};
-    float p5[] = {-0.5,-0.5, 0.5};
-
-    for(int i = 0; i < subDiv; ++i) {
-        for(int j = 0; j < subDiv; ++j) {
-            // Front (z = 0.5)
-            addTriangle(p1[0]+(i*side)    , p1[1]-(j*side)    , p1[2],
-                        p1[0]+(i*side)    , p1[1]-((j+1)*side), p1[2],
-                        p1[0]+((i+1)*side), p1[1]-(j*side)    , p1[2]);
-
-            addTriangle(p1[0]+(i*side)    , p1[1]-((j+1)*side), p1[2],
-                        p1[0]+((i+1)*side), p1[1]-((j+1)*side), p1[2],
-                        p1[0]+((i+1)*side), p1[1]-(j*side)    , p1[2]);
-
-            // Back (z = -0.5)
-            addTriangle(p2[0]-(i*side)    , p2[1]-(j*side)    , p2[2],
-                        p2[0]-(i*side)    , p2[1]-((j+1)*side), p2[2],
-                        p2[0]-((i+1)*side), p2[1]-(j*side)    , p2[2]);
-
-            addTriangle(p2[0]-(i*side)    , p2[1]-((j+1)*side), p2[2],
-                        p2[0]-((i+1)*side), p2[1]-((j+1)*side), p2[2],
-                        p2[0]-((i+1)*side), p2[1]-(j*side)    , p2[2]);
-
-            // Right (x = 0.5)
-            addTriangle(p3[0], p3[1]-(j*side)    , p3[2]-(i*side),
-                        p3[0], p3[1]-((j+1)*side), p3[2]-(i*side),
-                        p3[0], p3[1]-(j*side)    , p3[2]-((i+1)*side));
-
-            addTriangle(p3[0], p3[1]-((j+1)*side), p3[2]-(i*side),
-                        p3[0], p3[1]-((j+1)*side), p3[2]-((i+1)*side),
-                        p3[0], p3[1]-(j*side)    , p3[2]-((i+1)*side));
-
-            // Left (x = -0.5)
-            addTriangle(p4[0], p4[1]-(j*side)    , p4[2]+(i*side),
-                        p4[0], p4[1]-((j+1)*side), p4[2]+(i*side),
-                        p4[0], p4[1]-(j*side)    , p4[2]+((i+1)*side));
-
-            addTriangle(p4[0], p4[1]-((j+1)*side), p4[2]+(i*side),
-                        p4[0], p4[1]-((j+1)*side), p4[2]+((i+1)*side),
-                        p4[0], p4[1]-(j*side)    , p4[2]+((i+1)*side));
-
-            // Top (y = 0.5) (obs: yep, same point as p4)
-            addTriangle(p4[0]+(i*side)    , p4[1], p4[2]+(j*side),
-                        p4[0]+(i*side)    , p4[1], p4[2]+((j+1)*side),
-                        p4[0]+((i+1)*side), p4[1], p4[2]+(j*side));
-
-            addTriangle(p4[0]+(i*side)    , p4[1], p4[2]+((j+1)*side),
-                        p4[0]+((i+1)*side), p4[1], p4[2]+((j+1)*side),
-                        p4[0]+((i+1)*side), p4[1], p4[2]+(j*side));
-
-            // Bottom (y = -0.5)
-            addTriangle(p5[0]+(i*side)    , p5[1], p5[2]-(j*side),
-                        p5[0]+(i*side)    , p5[1], p5[2]-((j+1)*side),
-                        p5[0]+((i+1)*side), p5[1], p5[2]-(j*side));
-
-            addTriangle(p5[0]+(i*side)    , p5[1], p5[2]-((j+1)*side),
-                        p5[0]+((i+1)*side), p5[1], p5[2]-((j+1)*side),
-                        p5[0]+((i+1)*side), p5[1], p5[2]-(j*side));
-
-        }
-    }
-
-    numVertices = vertices.size()/3;
-    numNormals = normals.size()/3;
-    numElements = numVertices; // in this case elements is the same size as vertices
-
-    // Elements
-    for(int i = 0; i < numElements; ++i){
-        elements.push_back(i);
-    }
+    makePrimitive(makePrimitiveKey(PRIMITIVE_CUBE, subDiv, 0, FLAT));
 }
 
 /*
@@ -772,7 +1453,8 @@ void Shape::makeCube (int subDiv) {
  * DESCRIPTION:
  *         This function creates a cylinder tesselation with different
  *         subdivisions for the bases and for the height. It's also possible
- *         to choose flat or smooth normals.
+ *         to choose flat or smooth normals. A cylinder with the same
+ *         parameters as one made before shares its geometry, see makeCube.
  *
  */
 void Shape::makeCylinder ( int subDivBase, int subDivHeight, int normalType ) {
@@ -783,93 +1465,7 @@ void Shape::makeCylinder ( int subDivBase, int subDivHeight, int normalType ) {
         subDivHeight = 3;
     }
 
-    // Data
-    float theta = (2*PI)/subDivBase;
-    float side = 1.0f/subDivHeight;
-    float r = 0.5f;
-
-    // Top and bottom center points
-    float top[] = { 0.0, 0.5, 0.0};
-    float bot[] = { 0.0,-0.5, 0.0};
-
-    // Somne aux points
-    float p1[3];
-    float p2[3];
-
-    if(normalType == FLAT) {
-        for (int i = 0; i < subDivBase; ++i) {
-            p1[0] = r * cos((i+1) * theta);
-            p1[2] = r * sin((i+1) * theta);
-
-            p2[0] = r * cos(i * theta);
-            p2[2] = r * sin(i * theta);
-
-            // Bottom
-            p1[1] = -0.5f;
-            p2[1] = -0.5f;
-            addTriangle(bot, p2, p1);
-
-            // Top
-            p1[1] = 0.5f;
-            p2[1] = 0.5f;
-            addTriangle(top, p1, p2);
-
-            // Sides
-            for (int j = 0; j < subDivHeight; ++j) {
-                addTriangle(p1[0], p1[1]-(j*side)    , p1[2],
-                            p1[0], p1[1]-((j+1)*side), p1[2],
-                            p2[0], p2[1]-(j*side)    , p2[2]);
-
-                addTriangle(p1[0], p1[1]-((j+1)*side), p1[2],
-                            p2[0], p2[1]-((j+1)*side), p2[2],
-                            p2[0], p2[1]-(j*side)    , p2[2]);
-            }
-        }
-    } else {
-        for (int i = 0; i < subDivBase; ++i) {
-            p1[0] = r * cos((i+1) * theta);
-            p1[2] = r * sin((i+1) * theta);
-
-            p2[0] = r * cos(i * theta);
-            p2[2] = r * sin(i * theta);
-
-            // Bottom
-            p1[1] = -0.5f;
-            p2[1] = -0.5f;
-            addTriangle(bot, p2, p1);
-
-            // Top
-            p1[1] = 0.5f;
-            p2[1] = 0.5f;
-            addTriangle(top, p1, p2);
-
-            // Sides
-            for (int j = 0; j < subDivHeight; ++j) {
-                addTriangleAndNormals(p1[0], p1[1]-(j*side)    , p1[2],
-                                      p1[0], p1[1]-((j+1)*side), p1[2],
-                                      p2[0], p2[1]-(j*side)    , p2[2],
-                                      p1[0], 0                 , p1[2],
-                                      p1[0], 0                 , p1[2],
-                                      p2[0], 0                 , p2[2]);
-
-                addTriangleAndNormals(p1[0], p1[1]-((j+1)*side), p1[2],
-                                      p2[0], p2[1]-((j+1)*side), p2[2],
-                                      p2[0], p2[1]-(j*side)    , p2[2],
-                                      p1[0], 0                 , p1[2],
-                                      p2[0], 0                 , p2[2],
-                                      p2[0], 0                 , p2[2]);
-            }
-        }
-    }
-
-    numVertices = vertices.size()/3;
-    numNormals = normals.size()/3;
-    numElements = numVertices; // in this case elements is the same size as vertices
-
-    // Elements
-    for(int i = 0; i < numElements; ++i){
-        elements.push_back(i);
-    }
+    makePrimitive(makePrimitiveKey(PRIMITIVE_CYLINDER, subDivBase, subDivHeight, normalType));
 }
 
 /*
@@ -882,7 +1478,12 @@ void Shape::makeCylinder ( int subDivBase, int subDivHeight, int normalType ) {
  * DESCRIPTION:
  *         This function creates a sphere tesselation by icosahedron
  *         subdivision. It can also have two types of normals, FLAT or
- *         SMOOTH.
+ *         SMOOTH. With SMOOTH normals every vertex is shared by the
+ *         triangles around it, with FLAT normals every triangle has its
+ *         own three.
+ *
+ *         Only the first sphere of each subDiv and normalType is made,
+ *         see makeCube.
  *
  *         Reference:
  *         Hoffmann, Gernot. Sphere Tesselation by Icosahedron Subdivision.
@@ -894,77 +1495,126 @@ void Shape::makeSphere ( int subDiv, int normalType ) {
         subDiv = 1;
     }
 
-    // Icosahedron vertices
-    float vert[12][3];
+    makePrimitive(makePrimitiveKey(PRIMITIVE_SPHERE, subDiv, 0, normalType));
+}
 
-    // Needed values
-    float theta = 26.565 * PI / 180.0f;
-    float sth = sin(theta);
-    float cth = cos(theta);
-    float dps = 2 * PI / 5.0f;
+/*
+ * setLoaderThreads
+ *
+ * INPUT:
+ *         numThreads - number of threads used to parse .obj files, 0
+ *                      uses every core of the machine.
+ *
+ * DESCRIPTION:
+ *         By default the readObj* functions parse the file on the calling
+ *         thread. With more threads the file is split in chunks at newline
+ *         boundaries and the chunks are parsed in parallel, the resulting
+ *         shape is exactly the same.
+ *
+ */
+void Shape::setLoaderThreads ( int numThreads ) {
+    loaderThreads = numThreads < 0 ? 1 : numThreads;
+}
 
-    // top vertex
-    vert[0][0] = 0;
-    vert[0][1] = 0;
-    vert[0][2] = 1;
+/*
+ * setGeneratorThreads
+ *
+ * INPUT:
+ *         numThreads - number of threads used to make the cube,
+ *                      cylinder and sphere, 0 uses every core of the
+ *                      machine.
+ *
+ * DESCRIPTION:
+ *         The make* functions split the primitive in parts (rows of the
+ *         faces of the cube and of the sides of the cylinder, faces of
+ *         the icosahedron of the sphere) written to their own ranges of
+ *         the arrays, so they are made in parallel and the shape is
+ *         exactly the same as on one thread. Small primitives are
+ *         always made on the calling thread. By default every core is
+ *         used.
+ *
+ */
+void Shape::setGeneratorThreads ( int numThreads ) {
+    generatorThreads = numThreads < 0 ? 1 : numThreads;
+}
 
-    // upper pentagon
-    float psi = 0;
-    for( int i = 1; i < 6; ++i ) {
-        vert[i][0] = cth * cos(psi);
-        vert[i][1] = cth * sin(psi);
-        vert[i][2] = sth;
+/*
+ * setMeshCache
+ *
+ * INPUT:
+ *         enabled - true to use the binary mesh cache.
+ *
+ * DESCRIPTION:
+ *         The readObj* functions save the welded geometry on a ".meshcache"
+ *         file next to the .obj and use it the next time the same .obj is
+ *         loaded the same way (every mask of attributes, with or without
+ *         tangents, has its own file). The cache is only used if it was
+ *         made from a file with exactly the same contents. It is on by
+ *         default.
+ *
+ */
+void Shape::setMeshCache ( bool enabled ) {
+    useMeshCache = enabled;
+}
 
-        psi += dps;
-    }
+/*
+ * getLoaderThreads
+ *
+ * RETURN:
+ *         How many threads the .obj loaders use (0 means every core).
+ *
+ */
+int Shape::getLoaderThreads () {
+    return loaderThreads;
+}
+
+/*
+ * getGeneratorThreads
+ *
+ * RETURN:
+ *         How many threads make the primitives (0 means every core).
+ *
+ */
+int Shape::getGeneratorThreads () {
+    return generatorThreads;
+}
 
-    // lower pentagon
-    psi = PI / 5.0f;
-    for( int i = 6; i < 11; ++i ) {
-        vert[i][0] = cth * cos(psi);
-        vert[i][1] = cth * sin(psi);
-        vert[i][2] = -sth;
+/*
+ * getMeshCache
+ *
+ * RETURN:
+ *         True if the .obj loaders use the binary mesh cache.
+ *
+ */
+bool Shape::getMeshCache () {
+    return useMeshCache;
+}
 
-        psi += dps;
-    }
+/*
+ * setTextureID, setDiffTextureID, setSpecTextureID, setTextureNormalMapID
+ *
+ * INPUT:
+ *         id - an OpenGL texture, e.g. one created by create_texture.
+ *
+ * DESCRIPTION:
+ *         Sets the texture, diffuse map, specular map or normal map of the
+ *         shape. Used when the textures are not read by the shape itself.
+ *
+ */
+void Shape::setTextureID ( GLuint id ) {
+    textureID = id;
+}
 
-    // lower vertex
-    vert[11][0] = 0;
-    vert[11][1] = 0;
-    vert[11][2] = -1;
-
-    // Creating the triangles
-    addTriangleWithSubdivision(vert[1], vert[2], vert[0], subDiv, normalType);
-    addTriangleWithSubdivision(vert[2], vert[3], vert[0], subDiv, normalType);
-    addTriangleWithSubdivision(vert[3], vert[4], vert[0], subDiv, normalType);
-    addTriangleWithSubdivision(vert[4], vert[5], vert[0], subDiv, normalType);
-    addTriangleWithSubdivision(vert[5], vert[1], vert[0], subDiv, normalType);
-
-    addTriangleWithSubdivision(vert[6], vert[2], vert[1], subDiv, normalType);
-    addTriangleWithSubdivision(vert[6], vert[7], vert[2], subDiv, normalType);
-    addTriangleWithSubdivision(vert[7], vert[3], vert[2], subDiv, normalType);
-    addTriangleWithSubdivision(vert[7], vert[8], vert[3], subDiv, normalType);
-    addTriangleWithSubdivision(vert[8], vert[4], vert[3], subDiv, normalType);
-    addTriangleWithSubdivision(vert[8], vert[9], vert[4], subDiv, normalType);
-    addTriangleWithSubdivision(vert[9], vert[5], vert[4], subDiv, normalType);
-    addTriangleWithSubdivision(vert[9], vert[10], vert[5], subDiv, normalType);
-    addTriangleWithSubdivision(vert[10], vert[1], vert[5], subDiv, normalType);
-    addTriangleWithSubdivision(vert[10], vert[6], vert[1], subDiv, normalType);
-
-    addTriangleWithSubdivision(vert[11], vert[7], vert[6], subDiv, normalType);
-    addTriangleWithSubdivision(vert[11], vert[8], vert[7], subDiv, normalType);
-    addTriangleWithSubdivision(vert[11], vert[9], vert[8], subDiv, normalType);
-    addTriangleWithSubdivision(vert[11], vert[10], vert[9], subDiv, normalType);
-    addTriangleWithSubdivision(vert[11], vert[6], vert[10], subDiv, normalType);
+void Shape::setDiffTextureID ( GLuint id ) {
+    textureDiffMapID = id;
+}
 
-    numVertices = vertices.size()/3;
-    numNormals = normals.size()/3;
-    numElements = numVertices; // in this case elements is the same size as vertices
+void Shape::setSpecTextureID ( GLuint id ) {
+    textureSpecMapID = id;
+}
 
-    // Elements
-    for(int i = 0; i < numElements; ++i){
-        elements.push_back(i);
-    }
+void Shape::setTextureNormalMapID ( GLuint id ) {
+    textureNormalMapID = id;
 }
 
 /*
@@ -975,38 +1625,12 @@ void Shape::makeSphere ( int subDiv, int normalType ) {
  *
  * DESCRIPTION:
  *         This function reads an .obj file and creates the geometry for the
- *         object it describes. In particular this function will only work
- *         for .objs that have only vertex and face data of order 3.
+ *         object it describes, only the positions of the vertices are used.
+ *         Faces can use any pattern, the other indices are ignored.
  *
  */
 void Shape::readObjVert ( char* filename ) {
-    std::ifstream ifs(filename, std::ifstream::in);
-    std::string line, firstWord;
-    float values[3];
-
-    while(std::getline(ifs, line)) {
-        if(!line.empty()) {
-            std::istringstream ss(line);
-            ss >> firstWord >> values[0] >> values[1] >> values[2];
-
-            // vertices
-            if (!firstWord.compare("v")) {
-                vertices.push_back(values[0]);
-                vertices.push_back(values[1]);
-                vertices.push_back(values[2]);
-            }  // faces
-            else if (!firstWord.compare("f")) {
-                // Wavefront .obj files start counting from 1
-                elements.push_back((int) values[0]-1);
-                elements.push_back((int) values[1]-1);
-                elements.push_back((int) values[2]-1);
-            }
-        }
-        firstWord.clear();
-    }
-
-    numVertices = vertices.size()/3;
-    numElements = elements.size();
+    loadObj(filename, OBJ_POSITION, false);
 }
 
 /*
@@ -1017,213 +1641,39 @@ void Shape::readObjVert ( char* filename ) {
  *
  * DESCRIPTION:
  *         This function reads an .obj file and creates the geometry for the
- *         object it describes. In particular this function will only work
- *         for .objs that have vertex, normals and face data of order 3 with
- *         the pattern "number//number"
+ *         object it describes, with the positions and normals of the
+ *         vertices. Faces can use any pattern, e.g. "number//number" or
+ *         "number/number/number" (the texture index is ignored).
  *
  */
 void Shape::readObjVertNorm ( char* filename ) {
-    std::ifstream ifs(filename, std::ifstream::in);
-    std::string line, firstWord, aux, aux2;;
-    float values[3];
-
-    // aux values
-    vector<float> in_vertices;
-    vector<float> in_uvtextures;
-    vector<float> in_normals;
-    vector<float> in_elements;
-
-    while(std::getline(ifs, line)) {
-        if(!line.empty()) {
-            std::istringstream ss(line);
-            ss >> firstWord;// >> values[0] >> values[1] >> values[2];
-
-            // vertices
-            if (!firstWord.compare("v")) {
-                ss >> values[0] >> values[1] >> values[2];
-                in_vertices.push_back(values[0]);
-                in_vertices.push_back(values[1]);
-                in_vertices.push_back(values[2]);
-            } // textures
-            else if (!firstWord.compare("vt")) {
-                ss >> values[0] >> values[1];
-                in_uvtextures.push_back(values[0]);
-                in_uvtextures.push_back(values[1]);
-            } // normals
-            else if (!firstWord.compare("vn")) {
-                ss >> values[0] >> values[1] >> values[2];
-                in_normals.push_back(values[0]);
-                in_normals.push_back(values[1]);
-                in_normals.push_back(values[2]);
-            } // faces
-            else if (!firstWord.compare("f")) {
-                while(ss >> aux) { // aux is like "1//3"
-                    std::istringstream ss2(aux);
-                    while(std::getline(ss2, aux2, '/')) {
-                        if(!aux2.empty()) {
-                            in_elements.push_back( atoi(aux2.c_str()) - 1); // Wavefront .obj files start counting from 1
-                        }
-                    }
-                }
-            }
-        }
-        firstWord.clear();
-    }
-
-    // Filling the index the correct way, we make a map of the faces. IF we see "1/2/3" for the
-    // first time we add on the final "elements" vector, if we see it again we check on this
-    // map what is the index of it, then we add the same index on "elements" again
-    std::map<vector<int>,int> facesValues;
-    int index = 0;
-
-    // we will see each input vertex, so we will for every 3 values on our in_vertices vector
-    for(int i = 0; i < in_elements.size(); i+=2) {
-        vector<int> auxVec;
-        auxVec.push_back(in_elements[i]);
-        auxVec.push_back(in_elements[i+1]);
-
-        // if "1//3" is not on the map
-        if(facesValues.find(auxVec) == facesValues.end()){
-            // lets put the values on the actual vectors we will output
-            int vectorIndex = in_elements[i]*3;
-            int normalIndex = in_elements[i+1]*3;
-
-            vertices.push_back(in_vertices[vectorIndex]);
-            vertices.push_back(in_vertices[vectorIndex+1]);
-            vertices.push_back(in_vertices[vectorIndex+2]);
-
-            normals.push_back(in_normals[normalIndex]);
-            normals.push_back(in_normals[normalIndex+1]);
-            normals.push_back(in_normals[normalIndex+2]);
-
-            index = (vertices.size()/3) - 1;
-            elements.push_back(index);
-            facesValues.insert( std::pair<vector<int>,int> (auxVec,index) );
-        } // if it is on the map, just add it again
-        else {
-            elements.push_back(facesValues.find(auxVec)->second);
-        }
-    }
-
-    numVertices = vertices.size()/3;
-    numNormals = normals.size()/3;
-    numElements = elements.size();
+    loadObj(filename, OBJ_POSITION | OBJ_NORMAL, false);
 }
 
 /*
- * readObjVertNorm
+ * readObjVertTexNorm
  *
  * INPUT:
  *         filename - the .obj file you want to load
- *         filetexture - the texture file, can be of any extension readable
- *                       by SOIL
+ *         filetexture - the texture file, .png extension, or NULL to use
+ *                       the "map_Kd" of the first material of the file
  *
  * DESCRIPTION:
  *         This function reads an .obj file and creates the geometry for the
- *         object it describes. In particular this function will only work
- *         for .objs that have vertex, texture, normals and face data of
- *         order 3 with the pattern "number/number/number"
+ *         object it describes, with the positions, texture coordinates and
+ *         normals of the vertices. Faces can use any pattern, corners
+ *         without a texture or normal index get zeros for it.
+ *
+ *         Note: the texture is loaded with load_png (imageHelper.h).
  *
  */
 void Shape::readObjVertTexNorm ( char* filename , char* filetexture ) {
-    std::ifstream ifs(filename, std::ifstream::in);
-    std::string line, firstWord, aux, aux2;
-    float values[3];
-
-    // aux values
-    vector<float> in_vertices;
-    vector<float> in_uvtextures;
-    vector<float> in_normals;
-    vector<float> in_elements;
-
-    if (!ifs.is_open()) {
-        fprintf(stderr, "error while opening file %s \n", filename);
-    }
-
-    // Reading the file
-    while(std::getline(ifs, line)) {
-        if(!line.empty()) {
-            std::istringstream ss(line);
-            ss >> firstWord;// >> values[0] >> values[1] >> values[2];
-
-            // vertices
-            if (!firstWord.compare("v")) {
-                ss >> values[0] >> values[1] >> values[2];
-                in_vertices.push_back(values[0]);
-                in_vertices.push_back(values[1]);
-                in_vertices.push_back(values[2]);
-            } // textures
-            else if (!firstWord.compare("vt")) {
-                ss >> values[0] >> values[1];
-                in_uvtextures.push_back(values[0]);
-                in_uvtextures.push_back(values[1]);
-            } // normals
-            else if (!firstWord.compare("vn")) {
-                ss >> values[0] >> values[1] >> values[2];
-                in_normals.push_back(values[0]);
-                in_normals.push_back(values[1]);
-                in_normals.push_back(values[2]);
-            } // faces
-            else if (!firstWord.compare("f")) {
-                while(ss >> aux) { // aux is like "1/2/3"
-                    std::istringstream ss2(aux);
-                    while(std::getline(ss2, aux2, '/')) {
-                        in_elements.push_back( atoi(aux2.c_str()) - 1); // Wavefront .obj files start counting from 1
-                    }
-                }
-            }
-        }
-        firstWord.clear();
-    }
-
-    // Filling the index the correct way, we make a map of the faces. IF we see "1/2/3" for the
-    // first time we add on the final "elements" vector, if we see it again we check on this
-    // map what is the index of it, then we add the same index on "elements" again
-    std::map<vector<int>,int> facesValues;
-    int index = 0;
-
-    // we will see each input vertex, so we will for every 3 values on our in_vertices vector
-    for(int i = 0; i < in_elements.size(); i+=3) {
-        vector<int> auxVec;
-        auxVec.push_back(in_elements[i]);
-        auxVec.push_back(in_elements[i+1]);
-        auxVec.push_back(in_elements[i+2]);
-
-        // if "1/2/3" is not on the map
-        if(facesValues.find(auxVec) == facesValues.end()){
-            // lets put the values on the actual vectors we will output
-            int vectorIndex = in_elements[i]*3;
-            int textureIndex = in_elements[i+1]*2;
-            int normalIndex = in_elements[i+2]*3;
-
-            vertices.push_back(in_vertices[vectorIndex]);
-            vertices.push_back(in_vertices[vectorIndex+1]);
-            vertices.push_back(in_vertices[vectorIndex+2]);
-
-            uvtextures.push_back(in_uvtextures[textureIndex]);
-            uvtextures.push_back(in_uvtextures[textureIndex+1]);
-
-            normals.push_back(in_normals[normalIndex]);
-            normals.push_back(in_normals[normalIndex+1]);
-            normals.push_back(in_normals[normalIndex+2]);
-
-            index = (vertices.size()/3) - 1;
-            elements.push_back(index);
-            facesValues.insert( std::pair<vector<int>,int> (auxVec,index) );
-        } // if it is on the map, just add it again
-        else {
-            elements.push_back(facesValues.find(auxVec)->second);
-        }
-    }
-
-    numVertices = vertices.size()/3;
-    numTextures = uvtextures.size()/2;
-    numNormals = normals.size()/3;
-    numElements = elements.size();
+    // Reading the file (or its cache)
+    loadObj(filename, OBJ_ALL, false);
 
     // Now, reading the texture using SOIL directly as a new OpenGL texture
     //textureID = load_bmp(filetexture);
-    textureID = load_png(filetexture);
+    textureID = load_png(materialTexture(filetexture, MATERIAL_DIFFUSE_MAP).c_str());
 
     // check for an error during the load process
     if( 0 == textureID ) {
@@ -1236,8 +1686,10 @@ void Shape::readObjVertTexNorm ( char* filename , char* filetexture ) {
  *
  * INPUT:
  *         filename - the .obj file you want to load
- *         filetextureDiff - the texture file for diffuse map, .png extension
- *         filetextureSpec - the texture file for specular map, .png extension
+ *         filetextureDiff - the texture file for diffuse map, .png extension, or
+ *                           NULL to use the "map_Kd" of the first material
+ *         filetextureSpec - the texture file for specular map, .png extension, or
+ *                           NULL to use the "map_Ks" of the first material
  *
  * DESCRIPTION:
  *         Reads an obj file with vertex, normal and texture data, and also receives
@@ -1245,109 +1697,146 @@ void Shape::readObjVertTexNorm ( char* filename , char* filetexture ) {
  *
  */
  void Shape::readObjLightMap ( char* filename , char* filetextureDiff, char* filetextureSpec ) {
-    std::ifstream ifs(filename, std::ifstream::in);
-    std::string line, firstWord, aux, aux2;
-    float values[3];
+    // Reading the file (or its cache)
+    loadObj(filename, OBJ_ALL, true);
 
-    // aux values
-    vector<float> in_vertices;
-    vector<float> in_uvtextures;
-    vector<float> in_normals;
-    vector<float> in_elements;
+    // Now, reading the texture using libpng directly as a new OpenGL texture
+    textureDiffMapID = load_png(materialTexture(filetextureDiff, MATERIAL_DIFFUSE_MAP).c_str());
+    textureSpecMapID = load_png(materialTexture(filetextureSpec, MATERIAL_SPECULAR_MAP).c_str());
 
-    if (!ifs.is_open()) {
-        fprintf(stderr, "error while opening file %s \n", filename);
+    // check for an error during the load process
+    if( 0 == textureDiffMapID || 0 == textureSpecMapID ) {
+        printf( "Error loading textures\n" );
     }
+}
 
-    // Reading the file
-    while(std::getline(ifs, line)) {
-        if(!line.empty()) {
-            std::istringstream ss(line);
-            ss >> firstWord;// >> values[0] >> values[1] >> values[2];
-
-            // vertices
-            if (!firstWord.compare("v")) {
-                ss >> values[0] >> values[1] >> values[2];
-                in_vertices.push_back(values[0]);
-                in_vertices.push_back(values[1]);
-                in_vertices.push_back(values[2]);
-            } // textures
-            else if (!firstWord.compare("vt")) {
-                ss >> values[0] >> values[1];
-                in_uvtextures.push_back(values[0]);
-                in_uvtextures.push_back(values[1]);
-            } // normals
-            else if (!firstWord.compare("vn")) {
-                ss >> values[0] >> values[1] >> values[2];
-                in_normals.push_back(values[0]);
-                in_normals.push_back(values[1]);
-                in_normals.push_back(values[2]);
-            } // faces
-            else if (!firstWord.compare("f")) {
-                while(ss >> aux) { // aux is like "1/2/3"
-                    std::istringstream ss2(aux);
-                    while(std::getline(ss2, aux2, '/')) {
-                        in_elements.push_back( atoi(aux2.c_str()) - 1); // Wavefront .obj files start counting from 1
-                    }
-                }
-            }
-        }
-        firstWord.clear();
-    }
+/*
+ * computeTangents
+ *
+ * DESCRIPTION:
+ *         Calculates the tangent and bitangent of every vertex from the
+ *         positions and texture coordinates of the triangles around it.
+ *         They are needed for normal mapping.
+ *
+ */
+void Shape::computeTangents () {
+    MeshData mesh;
+    swapMeshData(mesh);
+    ::computeTangents(mesh);
+    swapMeshData(mesh);
+}
 
-    // Filling the index the correct way, we make a map of the faces. IF we see "1/2/3" for the
-    // first time we add on the final "elements" vector, if we see it again we check on this
-    // map what is the index of it, then we add the same index on "elements" again
-    std::map<vector<int>,int> facesValues;
-    int index = 0;
-
-    // we will see each input vertex, so we will for every 3 values on our in_vertices vector
-    for(int i = 0; i < in_elements.size(); i+=3) {
-        vector<int> auxVec;
-        auxVec.push_back(in_elements[i]);
-        auxVec.push_back(in_elements[i+1]);
-        auxVec.push_back(in_elements[i+2]);
-
-        // if "1/2/3" is not on the map
-        if(facesValues.find(auxVec) == facesValues.end()){
-            // lets put the values on the actual vectors we will output
-            int vectorIndex = in_elements[i]*3;
-            int textureIndex = in_elements[i+1]*2;
-            int normalIndex = in_elements[i+2]*3;
-
-            vertices.push_back(in_vertices[vectorIndex]);
-            vertices.push_back(in_vertices[vectorIndex+1]);
-            vertices.push_back(in_vertices[vectorIndex+2]);
-
-            uvtextures.push_back(in_uvtextures[textureIndex]);
-            uvtextures.push_back(in_uvtextures[textureIndex+1]);
-
-            normals.push_back(in_normals[normalIndex]);
-            normals.push_back(in_normals[normalIndex+1]);
-            normals.push_back(in_normals[normalIndex+2]);
-
-            index = (vertices.size()/3) - 1;
-            elements.push_back(index);
-            facesValues.insert( std::pair<vector<int>,int> (auxVec,index) );
-        } // if it is on the map, just add it again
-        else {
-            elements.push_back(facesValues.find(auxVec)->second);
-        }
-    }
+/*
+ * swapMeshData
+ *
+ * INPUT:
+ *         mesh - the geometry we want to exchange with the shape.
+ *
+ * DESCRIPTION:
+ *         Swaps the vertices, normals, uvtextures, tangents, bitangents,
+ *         elements and submeshes of the shape with the ones in mesh (no
+ *         copies are made)
+ *         and updates the counts. packElements still has to be called if
+ *         the shape is going to be drawn.
+ *
+ */
+void Shape::swapMeshData ( MeshData& mesh ) {
+    detachPrimitive();
+
+    vertices.swap(mesh.vertices);
+    normals.swap(mesh.normals);
+    uvtextures.swap(mesh.uvtextures);
+    tangents.swap(mesh.tangents);
+    bitangents.swap(mesh.bitangents);
+    elements.swap(mesh.elements);
+    submeshes.swap(mesh.submeshes);
+    submeshNames.swap(mesh.names);
+    materials.swap(mesh.materials);
 
     numVertices = vertices.size()/3;
-    numTextures = uvtextures.size()/2;
     numNormals = normals.size()/3;
+    numTextures = uvtextures.size()/2;
+    numTangents = tangents.size()/3;
+    numBitangents = bitangents.size()/3;
     numElements = elements.size();
+}
 
-    // Now, reading the texture using libpng directly as a new OpenGL texture
-    textureDiffMapID = load_png(filetextureDiff);
-    textureSpecMapID = load_png(filetextureSpec);
+/*
+ * setMeshData
+ *
+ * INPUT:
+ *         mesh - the new geometry of the shape, it is left with the
+ *                previous geometry of the shape.
+ *
+ * DESCRIPTION:
+ *         Replaces the geometry of the shape without copying it, e.g. with
+ *         a mesh loaded on another thread, and packs the elements. If the
+ *         mesh has materials the first one becomes the material of the
+ *         shape (see setMaterials).
+ *
+ */
+void Shape::setMeshData ( MeshData& mesh ) {
+    swapMeshData(mesh);
+    packElements();
+    lods.clear();
+    meshlets.clear();
+
+    getMaterialBatches(submeshes, materialBatches);
+    materialDiffTextureIDs.clear();
+    materialSpecTextureIDs.clear();
+    materialNormalMapIDs.clear();
+
+    // the first material of the file is the material of the whole shape
+    if (!materials.empty()) {
+        obj::ObjMaterial& material = materials[0];
+        setMaterials(material.ambient, 1.0f, material.diffuse, 1.0f,
+                     material.specular, 1.0f, material.specExp);
+    }
+}
 
-    // check for an error during the load process
-    if( 0 == textureDiffMapID || 0 == textureSpecMapID ) {
-        printf( "Error loading textures\n" );
+/*
+ * loadObj
+ *
+ * INPUT:
+ *         filename - the .obj file you want to load, faces can use any
+ *                    pattern ("1", "1/2", "1//3" or "1/2/3").
+ *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+ *         withTangents - true to also calculate tangents and bitangents.
+ *
+ * DESCRIPTION:
+ *         What every readObj* function does: replaces the geometry of the
+ *         shape with the one on the file (or on its mesh cache), keeping
+ *         only the attributes in the mask.
+ *
+ */
+void Shape::loadObj ( char* filename, unsigned int attributes, bool withTangents ) {
+    MeshData mesh;
+    if (!loadWeldedObj(filename, attributes, withTangents, useMeshCache, loaderThreads, mesh)) {
+        fprintf(stderr, "error while opening file %s \n", filename);
+    }
+    setMeshData(mesh);
+}
+
+/*
+ * materialTexture
+ *
+ * INPUT:
+ *         filetexture - a texture file given to a readObj* function, or NULL.
+ *         map - which map of the material we want if it is NULL.
+ *
+ * RETURN:
+ *         filetexture, or that map of the first material of the shape ("" if
+ *         there is none).
+ *
+ */
+string Shape::materialTexture ( const char* filetexture, int map ) {
+    if (filetexture != NULL) {
+        return filetexture;
+    }
+    if (materials.empty()) {
+        return string();
     }
+    return map == MATERIAL_DIFFUSE_MAP ? materials[0].diffuseMap : materials[0].specularMap;
 }
 
 /*
@@ -1361,68 +1850,11 @@ void Shape::readObjVertTexNorm ( char* filename , char* filetexture ) {
  *
  */
 void Shape::readNormalMap ( char* filetexture ) {
-    // bitangent and tangent will have the same size as the shape's vectices
-    tangents.resize(vertices.size());
-    bitangents.resize(vertices.size());
-
-    // iterate through elements, every 3 elements is a triangle face
-    for( int i = 0; i < elements.size(); i+=3 ) {
-        int vecPos1 = elements[i]*3;
-        int texPos1 = elements[i]*2;
-        float pos1[] = { vertices[vecPos1], vertices[vecPos1+1] , vertices[vecPos1+2]};
-        float uv1[] = { uvtextures[texPos1], uvtextures[texPos1+1] };
-
-        int vecPos2 = elements[i+1]*3;
-        int texPos2 = elements[i+1]*2;
-        float pos2[] = { vertices[vecPos2], vertices[vecPos2+1] , vertices[vecPos2+2]};
-        float uv2[] = { uvtextures[texPos2], uvtextures[texPos2+1] };
-
-        int vecPos3 = elements[i+2]*3;
-        int texPos3 = elements[i+2]*2;
-        float pos3[] = { vertices[vecPos3], vertices[vecPos3+1] , vertices[vecPos3+2]};
-        float uv3[] = { uvtextures[texPos3], uvtextures[texPos3+1] };
-
-        // Our actual values used for the canculations of tangent and bitangent
-        float edge1[] =  { pos2[0] -  pos1[0], pos2[1] -  pos1[1], pos2[2] -  pos1[2] };
-        float edge2[] =  { pos3[0] -  pos1[0], pos3[1] -  pos1[1], pos3[2] -  pos1[2] };
-        float deltaUV1[] =  { uv2[0] -  uv1[0], uv2[1] -  uv1[1] };
-        float deltaUV2[] =  { uv3[0] -  uv1[0], uv3[1] -  uv1[1] };
-
-        // Calculating it
-        float f = 1.0f / (deltaUV1[0] * deltaUV2[1] - deltaUV2[0] * deltaUV1[1]);
-
-        float tangent[] = {
-            f * (deltaUV2[1] * edge1[0] - deltaUV1[1] * edge2[0]),
-            f * (deltaUV2[1] * edge1[1] - deltaUV1[1] * edge2[1]),
-            f * (deltaUV2[1] * edge1[2] - deltaUV1[1] * edge2[2]) };
-        normalize(tangent);
-
-        float bitangent[] = {
-            f * (-deltaUV2[0] * edge1[0] + deltaUV1[0] * edge2[0]),
-            f * (-deltaUV2[0] * edge1[1] + deltaUV1[0] * edge2[1]),
-            f * (-deltaUV2[0] * edge1[2] + deltaUV1[0] * edge2[2]) };
-        normalize(bitangent);
-
-        // all three vertices from the triangle will share the same
-        // tangent and bitangent, so we add those values three times
-        for (int j = 0; j < 3; ++j) {
-            // if element = 0, index used will be 0, 1, 2
-            // if element = 1, index used will be 3, 4, 5
-            int index = elements[i+j]*3;
-
-            // TODO: actually double check these averages
-            tangents[index] = (tangents[index] + tangent[0]) / 2.0f;
-            tangents[index+1] = (tangents[index+1] + tangent[1]) / 2.0f;
-            tangents[index+2] = (tangents[index+2] + tangent[2]) / 2.0f;
-
-            bitangents[index] = (bitangents[index] + bitangent[0]) / 2.0f;
-            bitangents[index+1] = (bitangents[index+1] + bitangent[1]) / 2.0f;
-            bitangents[index+2] = (bitangents[index+2] + bitangent[2]) / 2.0f;
-
-        }
+    // the tangents may already be there, e.g. from the mesh cache
+    size_t numFloats = getVertexArray().size();
+    if (tangents.size() != numFloats || bitangents.size() != numFloats) {
+        computeTangents();
     }
-    numTangents = tangents.size()/3;
-    numBitangents = bitangents.size()/3;
 
     textureNormalMapID = load_png(filetexture);
 
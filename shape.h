@@ -18,24 +18,38 @@
 #endif
 
 #include <vector>
+#include <memory>
 #include <map>
 #include <cmath>
 #include <iostream>
 #include <stdio.h>
+#include <string.h>
 
 #include <fstream>
 #include <string>
 
 #include "mathHelper.h"
 #include "imageHelper.h"
+#include "objReader.h"
+#include "vertexWelder.h"
+#include "meshData.h"
+#include "meshLoader.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "meshlet.h"
+#include "vertexBuffer.h"
+#include "primitives.h"
+#include "primitiveCache.h"
 
 using namespace std;
 
-// Some helpful definitions
-#define FLAT    0
-#define SMOOTH  1
+// Some helpful definitions (FLAT and SMOOTH are in primitives.h)
 #define PI      3.14159265
 
+// The maps of a material Shape can use instead of a texture file
+#define MATERIAL_DIFFUSE_MAP   0
+#define MATERIAL_SPECULAR_MAP  1
+
 /*
  * The Shader class
  */
@@ -62,9 +76,36 @@ class Shape {
     GLuint numNormals;
 
     // the element vector of the shape, and the number of elements
-    vector<GLshort> elements;
+    vector<GLuint> elements;
     GLuint numElements;
 
+    // the elements again, packed with the narrowest type that can hold
+    // them (elementType), this is what goes to the element buffer
+    vector<GLubyte> elementData;
+    GLenum elementType;
+
+    // the cached primitive the shape shares with every other shape made
+    // with the same parameters (see primitiveCache.h). While it is set,
+    // vertices, normals, elements and elementData are empty and its
+    // arrays are used instead
+    shared_ptr<const PrimitiveGeometry> primitive;
+
+    // ranges of the elements that are drawn with the same material (e.g.
+    // the objects of an .obj file), plus the names of the parts and their
+    // materials
+    vector<Submesh> submeshes;
+    vector<string> submeshNames;
+    vector<obj::ObjMaterial> materials;
+
+    // the submeshes joined by material, one range per material
+    vector<Submesh> materialBatches;
+
+    // the textures of every material (0 if it has none), created by
+    // loadMaterialTextures
+    vector<GLuint> materialDiffTextureIDs;
+    vector<GLuint> materialSpecTextureIDs;
+    vector<GLuint> materialNormalMapIDs;
+
     // the tangent vector of each shape vertex, and the number of tangent vertices
     vector<float> tangents;
     GLuint numTangents;
@@ -79,119 +120,172 @@ class Shape {
     vector<float> specularMaterial;
     float Ka, Kd, Ks, specExp;
 
+    // how many threads the .obj loaders use to parse a file (0 means every core)
+    int loaderThreads;
+
+    // how many threads make the cube, cylinder and sphere (0 means every core)
+    int generatorThreads;
+
+    // true if the .obj loaders read and write the binary mesh cache
+    bool useMeshCache;
+
+    // the levels of detail, ranges of elements after the ones of the full
+    // shape (empty if generateLods was not called), and the diagonal of
+    // the bounding box they are selected with
+    vector<MeshLod> lods;
+    float lodDiameter;
+
+    // the meshlets of the full shape, empty if buildMeshlets was not called
+    // or the triangles moved after it
+    vector<Meshlet> meshlets;
+
     /*
-     * addTriangle
+     * addPrimitive
      *
      * INPUT:
-     *         xN - the x value of the Nth point of the triangle.
-     *         yN - the y value of the Nth point of the triangle.
-     *         zN - the z value of the Nth point of the triangle.
+     *         numVertices - how many vertices the primitive has.
+     *         numElements - how many elements the primitive has.
+     *
+     * RETURN:
+     *         Where the primitive is written, after the geometry the shape
+     *         already has.
+     *
+     * DESCRIPTION:
+     *         Makes room for a primitive of primitives.h on vertices,
+     *         normals and elements.
+     *
+     */
+    PrimitiveTarget addPrimitive(size_t numVertices, size_t numElements);
+
+    /*
+     * finishPrimitive
      *
      * DESCRIPTION:
-     *         This function gets as input three (x,y,z) points
-     *         that will create a polygon (triangle). These points
-     *         are required to be in counter clockwise order. This function
-     *         will also calculate normals for the vertices, however every vertex
-     *         of the triangle will have the same normal.
-     *         The variables numVertices, numNormals andnumElements are also
-     *         changed accordingly.
+     *         Updates the counts once a primitive is made and packs its
+     *         elements.
      *
      */
-    void addTriangle(float x0, float y0, float z0,
-                     float x1, float y1, float z1,
-                     float x2, float y2, float z2);
+    void finishPrimitive();
 
     /*
-     * addTriangle
+     * makePrimitive
      *
      * INPUT:
-     *         v0 - the first vertex of the triangle.
-     *         v1 - the second vertex of the triangle.
-     *         v2 - the third vertex of the triangle.
+     *         key - the primitive, with its parameters already clamped.
      *
      * DESCRIPTION:
-     *         This function works exactly like the previous addTriangle,
-     *         with the exception that instead of using as arguments the x, y,
-     *         and z of each vertex, we use three arrays of size 3 that hold
-     *         those values. In other words, v0[3] = {x, y, z}.
+     *         Gets the primitive from the cache. An empty shape shares it,
+     *         one with geometry gets a copy of it after its own.
      *
      */
-    void addTriangle(float v0[], float v1[], float v2[]);
+    void makePrimitive(const PrimitiveKey& key);
 
     /*
-     * addTriangleAndNormals
+     * detachPrimitive
      *
-     * INPUT:
-     *         xN - the x value of the Nth point of the triangle.
-     *         yN - the y value of the Nth point of the triangle.
-     *         zN - the z value of the Nth point of the triangle.
-     *         nxN - the x value of the normal of the Nth point of the triangle.
-     *         nyN - the y value of the normal of the Nth point of the triangle.
-     *         nzN - the z value of the normal of the Nth point of the triangle.
+     * DESCRIPTION:
+     *         Copies the shared primitive into the arrays of the shape and
+     *         stops sharing it. Everything that changes the geometry calls
+     *         it first, nothing is done if the shape shares nothing.
+     *
+     */
+    void detachPrimitive();
+
+    /*
+     * getVertexArray
+     *
+     * RETURN:
+     *         The positions the shape is drawn with, those of the shared
+     *         primitive or its own.
+     *
+     */
+    const vector<float>& getVertexArray() const;
+
+    /*
+     * getNormalArray
+     *
+     * RETURN:
+     *         The normals the shape is drawn with.
+     *
+     */
+    const vector<float>& getNormalArray() const;
+
+    /*
+     * getElementArray
+     *
+     * RETURN:
+     *         The elements the shape is drawn with, not packed.
+     *
+     */
+    const vector<GLuint>& getElementArray() const;
+
+    /*
+     * packElements
+     *
+     * DESCRIPTION:
+     *         Chooses the narrowest type that can hold every element (8, 16 or
+     *         32 bits) and copies the elements to elementData with that type.
+     *         It has to be called every time elements changes.
+     *
+     */
+    void packElements();
+
+    /*
+     * computeTangents
      *
      * DESCRIPTION:
-     *         This function works just like addTriangle, but with it you can also
-     *         tell the normals of each vertex.
+     *         Calculates the tangent and bitangent of every vertex from the
+     *         positions and texture coordinates of the triangles around it.
+     *         They are needed for normal mapping.
      *
      */
-    void addTriangleAndNormals(float x0, float y0, float z0,
-                               float x1, float y1, float z1,
-                               float x2, float y2, float z2,
-                               float nx0, float ny0, float nz0,
-                               float nx1, float ny1, float nz1,
-                               float nx2, float ny2, float nz2);
+    void computeTangents ();
 
     /*
-     * addTriangleAndNormals
+     * swapMeshData
      *
      * INPUT:
-     *         v0 - the first vertex of the triangle.
-     *         v1 - the second vertex of the triangle.
-     *         v2 - the third vertex of the triangle.
-     *         n0 - the normal of the first vertex of the triangle.
-     *         n1 - the normal of the second vertex of the triangle.
-     *         n2 - the normal of the third vertex of the triangle.
+     *         mesh - the geometry we want to exchange with the shape.
      *
      * DESCRIPTION:
-     *         This function works exactly like the previous addTriangleAndNormals,
-     *         with the exception that instead of using as arguments the x, y,
-     *         and z of each vertex, we use three arrays of size 3 that hold
-     *         those values. In other words, v0[3] = {x, y, z}.
+     *         Swaps the vertices, normals, uvtextures, tangents, bitangents,
+     *         elements and submeshes of the shape with the ones in mesh (no
+     *         copies are made) and updates the counts. packElements still has to be called if
+     *         the shape is going to be drawn.
      *
      */
-    void addTriangleAndNormals(float v0[], float v1[], float v2[],
-                               float n0[], float n1[], float n2[]);
+    void swapMeshData ( MeshData& mesh );
 
     /*
-     * addTriangleWithSubdivision
+     * loadObj
      *
      * INPUT:
-     *         v0 - the first vertex of the triangle.
-     *         v1 - the second vertex of the triangle.
-     *         v2 - the third vertex of the triangle.
-     *         subDiv - number of subdivisions for the triangles.
+     *         filename - the .obj file you want to load, faces can use any
+     *                    pattern ("1", "1/2", "1//3" or "1/2/3").
+     *         attributes - mask of OBJ_POSITION, OBJ_TEXCOORD and OBJ_NORMAL.
+     *         withTangents - true to also calculate tangents and bitangents.
      *
      * DESCRIPTION:
-     *         This function is used together with the makeSphere function.
-     *         It's responsible for subdividing the triangles of the sphere so that
-     *         we get a better result. Essentially the triangle "0, 1, 2" will
-     *         become triangles "0,3,5", "3,1,4", "5,4,2" and "3,4,5".
+     *         What every readObj* function does: replaces the geometry of the
+     *         shape with the one on the file (or on its mesh cache), keeping
+     *         only the attributes in the mask.
+     *
+     */
+    void loadObj ( char* filename, unsigned int attributes, bool withTangents );
+
+    /*
+     * materialTexture
      *
-     *                      0
-     *                  3       5
-     *              1       4       2
+     * INPUT:
+     *         filetexture - a texture file given to a readObj* function, or NULL.
+     *         map - which map of the material we want if it is NULL.
      *
-     *         It's a recursive function so it can keep sub dividing the triangles.
-     *         This function will also be different depending on the type of
-     *         normals. If you want the FLAT normals, then for each triangles,
-     *         the vertices will have the same normals. If you want the SMOOTH normals
-     *         then another function will be called where we tell it what
-     *         are the normals, in the case of the sphere you can consider the normals
-     *         of the points as the same as the points (they are vertices coming from
-     *         the origin).
+     * RETURN:
+     *         filetexture, or that map of the first material of the shape ("" if
+     *         there is none).
      *
      */
-    void addTriangleWithSubdivision(float v0[], float v1[], float v2[], int subDiv, int normalType);
+    string materialTexture ( const char* filetexture, int map );
 
 public:
 
@@ -229,9 +323,25 @@ public:
      * RETURN:
      *         The vector/array of the vertices.
      *
+     * DESCRIPTION:
+     *         The array can be written, so a shape sharing a cached
+     *         primitive gets its own copy of it first. To only read it use
+     *         getVertexData, which does not copy.
+     *
      */
     float* getVertices();
 
+    /*
+     * getVertexData
+     *
+     * RETURN:
+     *         The vertices, only to be read. A shape sharing a cached
+     *         primitive returns those of the primitive and keeps sharing
+     *         it. NULL if there are none.
+     *
+     */
+    const float* getVertexData() const;
+
     /*
      * getNumVertices
      *
@@ -310,9 +420,24 @@ public:
      * RETURN:
      *         The vector/array of the normals.
      *
+     * DESCRIPTION:
+     *         The array can be written, so a shape sharing a cached
+     *         primitive gets its own copy of it first. To only read it use
+     *         getNormalData, which does not copy.
+     *
      */
     float* getNormals();
 
+    /*
+     * getNormalData
+     *
+     * RETURN:
+     *         The normals, only to be read, like getVertexData. NULL if
+     *         there are none.
+     *
+     */
+    const float* getNormalData() const;
+
     /*
      * getNumNormals
      *
@@ -326,10 +451,54 @@ public:
      * getElements
      *
      * RETURN:
-     *         The vector/array of elements.
+     *         The vector/array of elements, stored with the type returned
+     *         by getElementType.
+     *
+     * DESCRIPTION:
+     *         Like getVertices, a shape sharing a cached primitive gets its
+     *         own copy of the elements first, getElementData does not.
+     *
+     */
+    GLvoid* getElements();
+
+    /*
+     * getElementData
+     *
+     * RETURN:
+     *         The elements with the type of getElementType, only to be
+     *         read, like getVertexData. NULL if there are none.
+     *
+     */
+    const GLvoid* getElementData() const;
+
+    /*
+     * getSharedPrimitive
+     *
+     * RETURN:
+     *         The cached primitive the shape shares, NULL if its geometry
+     *         is its own.
+     *
+     */
+    shared_ptr<const PrimitiveGeometry> getSharedPrimitive();
+
+    /*
+     * getElementType
+     *
+     * RETURN:
+     *         The type of the elements, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or
+     *         GL_UNSIGNED_INT. This is what should be used on glDrawElements.
+     *
+     */
+    GLenum getElementType();
+
+    /*
+     * getElementSize
+     *
+     * RETURN:
+     *         The size in bytes of each element (1, 2 or 4).
      *
      */
-    GLshort* getElements();
+    GLuint getElementSize();
 
     /*
      * getNumElements
@@ -340,6 +509,147 @@ public:
      */
     GLuint getNumElements();
 
+    /*
+     * getNumSubmeshes
+     *
+     * RETURN:
+     *         The number of submeshes, 0 if the shape is only one piece.
+     *
+     */
+    GLuint getNumSubmeshes();
+
+    /*
+     * getSubmesh
+     *
+     * INPUT:
+     *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+     *
+     * RETURN:
+     *         The range of elements of the submesh and its name and material
+     *         indices.
+     *
+     */
+    Submesh getSubmesh( GLuint index );
+
+    /*
+     * getSubmeshOffset
+     *
+     * INPUT:
+     *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+     *
+     * RETURN:
+     *         Where the submesh starts on the element buffer, in bytes. This
+     *         is what should be used as the last argument of glDrawElements.
+     *
+     */
+    GLvoid* getSubmeshOffset( GLuint index );
+
+    /*
+     * getSubmeshName
+     *
+     * INPUT:
+     *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+     *
+     * RETURN:
+     *         The name of the object or group of the submesh, "" if it has none.
+     *
+     */
+    const char* getSubmeshName( GLuint index );
+
+    /*
+     * getSubmeshMaterial
+     *
+     * INPUT:
+     *         index - which submesh, from 0 to getNumSubmeshes() - 1.
+     *
+     * RETURN:
+     *         The name of the material of the submesh, "" if it has none.
+     *
+     */
+    const char* getSubmeshMaterial( GLuint index );
+
+    /*
+     * getNumMaterials
+     *
+     * RETURN:
+     *         The number of materials the submeshes use.
+     *
+     */
+    GLuint getNumMaterials();
+
+    /*
+     * getMaterial
+     *
+     * INPUT:
+     *         index - which material, e.g. Submesh::material.
+     *
+     * RETURN:
+     *         The colors, exponent and texture files of the material.
+     *
+     */
+    const obj::ObjMaterial& getMaterial( GLuint index );
+
+    /*
+     * getNumMaterialBatches
+     *
+     * RETURN:
+     *         The number of material batches, 0 if the shape is only one piece.
+     *
+     */
+    GLuint getNumMaterialBatches();
+
+    /*
+     * getMaterialBatch
+     *
+     * INPUT:
+     *         index - which batch, from 0 to getNumMaterialBatches() - 1.
+     *
+     * RETURN:
+     *         The range of elements of every submesh with one material. The
+     *         .obj loaders sort the triangles by material, so each material
+     *         has a single batch and its textures are bound once per frame.
+     *
+     */
+    Submesh getMaterialBatch( GLuint index );
+
+    /*
+     * getElementOffset
+     *
+     * INPUT:
+     *         element - an element, e.g. Submesh::firstElement.
+     *
+     * RETURN:
+     *         Where the element is on the element buffer, in bytes. This is
+     *         what should be used as the last argument of glDrawElements.
+     *
+     */
+    GLvoid* getElementOffset( GLuint element );
+
+    /*
+     * loadMaterialTextures
+     *
+     * DESCRIPTION:
+     *         Creates the textures of every material, a file used by several
+     *         materials is only loaded once.
+     *
+     */
+    void loadMaterialTextures();
+
+    /*
+     * getMaterialDiffTextureID, getMaterialSpecTextureID, getMaterialNormalMapID
+     *
+     * INPUT:
+     *         index - which material.
+     *
+     * RETURN:
+     *         The diffuse, specular or normal map of the material, 0 if it has
+     *         none or loadMaterialTextures was not called.
+     *
+     */
+    GLuint getMaterialDiffTextureID( GLuint index );
+    GLuint getMaterialSpecTextureID( GLuint index );
+    GLuint getMaterialNormalMapID( GLuint index );
+
     /*
     * getTangents
     *
@@ -376,6 +686,265 @@ public:
     */
     GLuint getNumBitangents();
 
+    /*
+     * getVertexLayout
+     *
+     * INPUT:
+     *         mask - the VERTEX_* attributes wanted, plus VERTEX_PACKED for
+     *                the packed format.
+     *
+     * RETURN:
+     *         The layout of the interleaved vertices with the wanted attributes
+     *         the shape has, one entry per vertex. The others are left out. A
+     *         packed layout gets the scale and the offset of the bounding box
+     *         of the positions and of the range of the uvs.
+     *
+     */
+    VertexLayout getVertexLayout( unsigned int mask );
+
+    /*
+     * buildInterleavedVertices
+     *
+     * INPUT:
+     *         layout - the layout of the vertices, from getVertexLayout
+     *                  without VERTEX_PACKED.
+     *         stream - where the vertices are written.
+     *
+     * DESCRIPTION:
+     *         Fills stream with every vertex of the shape, its attributes one
+     *         after the other as layout says (XYZ NXNYNZ UV | XYZ NXNYNZ UV |
+     *         ...), so a vertex is read from one place of the vertex buffer
+     *         instead of one place per attribute.
+     *
+     */
+    void buildInterleavedVertices( const VertexLayout& layout, vector<float>& stream );
+
+    /*
+     * buildPackedVertices
+     *
+     * INPUT:
+     *         layout - a packed layout, from getVertexLayout with
+     *                  VERTEX_PACKED.
+     *         stream - where the vertices are written.
+     *
+     * DESCRIPTION:
+     *         Fills stream with every vertex of the shape in the packed format
+     *         of layout: the positions inside the bounding box and the uvs
+     *         inside their range as 16 bit integers, the normals, tangents and
+     *         bitangents octahedral encoded and the colors as bytes. A vertex
+     *         of positions, normals and uvs takes 16 bytes instead of 32.
+     *
+     */
+    void buildPackedVertices( const VertexLayout& layout, vector<GLubyte>& stream );
+
+    /*
+     * optimizeVertexCache
+     *
+     * RETURN:
+     *         The ACMR of the shape before and after.
+     *
+     * DESCRIPTION:
+     *         Reorders the triangles of every submesh so the GPU runs the
+     *         vertex shader fewer times (see meshOptimizer.h). The shapes
+     *         loaded from .obj files are already optimized.
+     *
+     */
+    VertexCacheStats optimizeVertexCache();
+
+    /*
+     * getAcmr
+     *
+     * INPUT:
+     *         cacheSize - the entries of the simulated post-transform cache.
+     *
+     * RETURN:
+     *         How many times the vertex shader runs per triangle when the
+     *         shape is drawn, from a simulation of the cache on the CPU.
+     *
+     */
+    float getAcmr( int cacheSize = VERTEX_CACHE_SIZE );
+
+    /*
+     * optimizeVertexFetch
+     *
+     * RETURN:
+     *         The overfetch of the shape before and after.
+     *
+     * DESCRIPTION:
+     *         Moves the vertices (and their normals, uvs, colors, tangents
+     *         and bitangents) to the order the elements use them first, so
+     *         drawing the shape reads the vertex buffer forward. Call it
+     *         after optimizeVertexCache, it does not move the triangles.
+     *
+     */
+    VertexFetchStats optimizeVertexFetch();
+
+    /*
+     * optimizeOverdraw
+     *
+     * INPUT:
+     *         threshold - how much the ACMR may grow (1.05 is about 5%), the
+     *                     larger the less overdraw.
+     *
+     * RETURN:
+     *         The overdraw and the ACMR of the shape before and after.
+     *
+     * DESCRIPTION:
+     *         Draws first the parts of every submesh that are usually in
+     *         front of the others, so fewer fragments are shaded and then
+     *         covered (see meshOptimizer.h). It goes after
+     *         optimizeVertexCache and before optimizeVertexFetch. Worth it for
+     *         shapes drawn with expensive fragment shaders, like the gBuffer
+     *         pass of deferred shading.
+     *
+     */
+    OverdrawStats optimizeOverdraw( float threshold = OVERDRAW_THRESHOLD );
+
+    /*
+     * getOverdraw
+     *
+     * RETURN:
+     *         How many times the fragment shader runs per pixel the shape
+     *         covers, from a rendering of its six sides on the CPU.
+     *
+     */
+    float getOverdraw();
+
+    /*
+     * generateLods
+     *
+     * INPUT:
+     *         numLevels - how many levels of detail after the full shape.
+     *         reduction - how many of the triangles of a level the next
+     *                     one keeps.
+     *
+     * RETURN:
+     *         How many levels the shape has, including the full shape (it
+     *         stops early when a level cannot be simplified any more).
+     *
+     * DESCRIPTION:
+     *         Simplifies the shape (see meshSimplifier.h) and adds the
+     *         elements of every level after its own, so all the levels
+     *         use the same vertex buffer and the same element buffer.
+     *         After this, getNumElements() counts the elements of every
+     *         level: draw the ranges of getLod instead. It goes after the
+     *         other optimize* calls, except optimizeVertexFetch.
+     *
+     */
+    GLuint generateLods( int numLevels, float reduction = LOD_REDUCTION );
+
+    /*
+     * getNumLods
+     *
+     * RETURN:
+     *         How many levels of detail the shape has, 0 if generateLods
+     *         was not called.
+     *
+     */
+    GLuint getNumLods();
+
+    /*
+     * getLod
+     *
+     * INPUT:
+     *         level - which level, 0 is the full shape.
+     *
+     * RETURN:
+     *         The range of elements of the level and of its submeshes, use
+     *         getElementOffset(lod.firstElement) when drawing it.
+     *
+     */
+    const MeshLod& getLod( GLuint level );
+
+    /*
+     * getLodDiameter
+     *
+     * RETURN:
+     *         The diagonal of the bounding box of the shape, what the
+     *         screenSize of selectLod measures.
+     *
+     */
+    float getLodDiameter();
+
+    /*
+     * selectLod
+     *
+     * INPUT:
+     *         screenSize - how many pixels getLodDiameter() covers on the
+     *                      screen, e.g. from computeScreenSize.
+     *         pixelError - how many pixels the level may be off.
+     *
+     * RETURN:
+     *         The coarsest level whose error is at most pixelError pixels
+     *         at that size, 0 if the shape has no levels.
+     *
+     */
+    GLuint selectLod( float screenSize, float pixelError = LOD_PIXEL_ERROR );
+
+    /*
+     * buildMeshlets
+     *
+     * INPUT:
+     *         maxVertices - the most vertices of a meshlet.
+     *         maxTriangles - the most triangles of a meshlet.
+     *
+     * RETURN:
+     *         How many meshlets the shape has.
+     *
+     * DESCRIPTION:
+     *         Splits the triangles of the full shape in meshlets (see
+     *         meshlet.h), each one a range of elements, for cullMeshlets. It
+     *         goes after optimizeVertexCache and optimizeOverdraw, which
+     *         drop the meshlets since they move the triangles.
+     *
+     */
+    GLuint buildMeshlets( GLuint maxVertices = MESHLET_MAX_VERTICES,
+                          GLuint maxTriangles = MESHLET_MAX_TRIANGLES );
+
+    /*
+     * getNumMeshlets
+     *
+     * RETURN:
+     *         How many meshlets the shape has, 0 if buildMeshlets was not
+     *         called.
+     *
+     */
+    GLuint getNumMeshlets();
+
+    /*
+     * getMeshlet
+     *
+     * INPUT:
+     *         index - which meshlet.
+     *
+     * RETURN:
+     *         Its range of elements and its bounds.
+     *
+     */
+    const Meshlet& getMeshlet( GLuint index );
+
+    /*
+     * cullMeshlets
+     *
+     * INPUT:
+     *         modelView - the view times the transform of the shape.
+     *         projection - the projection matrix.
+     *         draws - where the draws of the visible meshlets are written.
+     *
+     * RETURN:
+     *         How many meshlets were culled and how many were kept, to
+     *         profile the culling.
+     *
+     * DESCRIPTION:
+     *         Drops the meshlets outside of the frustum and those that face
+     *         away from the camera. Draw what is left with
+     *         glMultiDrawElements, getElementOffset(draw.firstIndex) is the
+     *         offset of every draw.
+     *
+     */
+    MeshletCullStats cullMeshlets( const Matrix4& modelView, const Matrix4& projection,
+                                   vector<DrawElementsIndirectCommand>& draws );
+
     /*
      * setMaterials
      *
@@ -494,6 +1063,11 @@ public:
      *         side of total length 1, and squares with certain
      *         sub divisions.
      *
+     *         The primitives come from primitiveCache.h: the first cube of
+     *         each subDiv is made and kept, the next ones share its arrays
+     *         (and its buffers, see uploadShape) if the shape is empty, or
+     *         copy them after the geometry the shape already has.
+     *
      */
     void makeCube (int subDiv);
 
@@ -508,7 +1082,8 @@ public:
      * DESCRIPTION:
      *         This function creates a cylinder tesselation with different
      *         subdivisions for the bases and for the height. It's also possible
-     *         to choose flat or smooth normals.
+     *         to choose flat or smooth normals. A cylinder with the same
+     *         parameters as one made before shares its geometry, see makeCube.
      *
      */
     void makeCylinder ( int subDivBase, int subDivHeight, int normalType );
@@ -525,6 +1100,9 @@ public:
      *         subdivision. It can also have two types of normals, FLAT or
      *         SMOOTH.
      *
+     *         Only the first sphere of each subDiv and normalType is made,
+     *         see makeCube.
+     *
      *         Reference:
      *         Hoffmann, Gernot. Sphere Tesselation by Icosahedron Subdivision.
      *         http://docs-hoffmann.de/ikos27042002.pdf
@@ -532,6 +1110,118 @@ public:
      */
     void makeSphere ( int subDiv, int normalType );
 
+    /*
+     * setLoaderThreads
+     *
+     * INPUT:
+     *         numThreads - number of threads used to parse .obj files, 0
+     *                      uses every core of the machine.
+     *
+     * DESCRIPTION:
+     *         By default the readObj* functions parse the file on the calling
+     *         thread. With more threads the file is split in chunks at newline
+     *         boundaries and the chunks are parsed in parallel, the resulting
+     *         shape is exactly the same.
+     *
+     */
+    void setLoaderThreads ( int numThreads );
+
+    /*
+     * setGeneratorThreads
+     *
+     * INPUT:
+     *         numThreads - number of threads used to make the cube,
+     *                      cylinder and sphere, 0 uses every core of the
+     *                      machine.
+     *
+     * DESCRIPTION:
+     *         The make* functions split the primitive in parts (rows of the
+     *         faces of the cube and of the sides of the cylinder, faces of
+     *         the icosahedron of the sphere) written to their own ranges of
+     *         the arrays, so they are made in parallel and the shape is
+     *         exactly the same as on one thread. Small primitives are
+     *         always made on the calling thread. By default every core is
+     *         used.
+     *
+     */
+    void setGeneratorThreads ( int numThreads );
+
+    /*
+     * setMeshCache
+     *
+     * INPUT:
+     *         enabled - true to use the binary mesh cache.
+     *
+     * DESCRIPTION:
+     *         The readObj* functions save the welded geometry on a ".meshcache"
+     *         file next to the .obj and use it the next time the same .obj is
+     *         loaded the same way (every mask of attributes, with or without
+     *         tangents, has its own file). The cache is only used if it was
+     *         made from a file with exactly the same contents. It is on by
+     *         default.
+     *
+     */
+    void setMeshCache ( bool enabled );
+
+    /*
+     * getLoaderThreads
+     *
+     * RETURN:
+     *         How many threads the .obj loaders use (0 means every core).
+     *
+     */
+    int getLoaderThreads ();
+
+    /*
+     * getGeneratorThreads
+     *
+     * RETURN:
+     *         How many threads make the primitives (0 means every core).
+     *
+     */
+    int getGeneratorThreads ();
+
+    /*
+     * getMeshCache
+     *
+     * RETURN:
+     *         True if the .obj loaders use the binary mesh cache.
+     *
+     */
+    bool getMeshCache ();
+
+    /*
+     * setMeshData
+     *
+     * INPUT:
+     *         mesh - the new geometry of the shape, it is left with the
+     *                previous geometry of the shape.
+     *
+     * DESCRIPTION:
+     *         Replaces the geometry of the shape without copying it, e.g. with
+     *         a mesh loaded on another thread, and packs the elements. If the
+     *         mesh has materials the first one becomes the material of the
+     *         shape (see setMaterials).
+     *
+     */
+    void setMeshData ( MeshData& mesh );
+
+    /*
+     * setTextureID, setDiffTextureID, setSpecTextureID, setTextureNormalMapID
+     *
+     * INPUT:
+     *         id - an OpenGL texture, e.g. one created by create_texture.
+     *
+     * DESCRIPTION:
+     *         Sets the texture, diffuse map, specular map or normal map of the
+     *         shape. Used when the textures are not read by the shape itself.
+     *
+     */
+    void setTextureID ( GLuint id );
+    void setDiffTextureID ( GLuint id );
+    void setSpecTextureID ( GLuint id );
+    void setTextureNormalMapID ( GLuint id );
+
     /*
      * readObjVert
      *
@@ -540,8 +1230,8 @@ public:
      *
      * DESCRIPTION:
      *         This function reads an .obj file and creates the geometry for the
-     *         object it describes. In particular this function will only work
-     *         for .objs that have only vertex and face data of order 3.
+     *         object it describes, only the positions of the vertices are used.
+     *         Faces can use any pattern, the other indices are ignored.
      *
      */
     void readObjVert ( char* filename );
@@ -554,46 +1244,48 @@ public:
      *
      * DESCRIPTION:
      *         This function reads an .obj file and creates the geometry for the
-     *         object it describes. In particular this function will only work
-     *         for .objs that have vertex, normals and face data of order 3 with
-     *         the pattern "number//number"
+     *         object it describes, with the positions and normals of the
+     *         vertices. Faces can use any pattern, e.g. "number//number" or
+     *         "number/number/number" (the texture index is ignored).
      *
      */
     void readObjVertNorm ( char* filename );
 
     /*
-     * readObjVertNorm
+     * readObjVertTexNorm
      *
      * INPUT:
      *         filename - the .obj file you want to load
-     *         filetexture - the texture file, can be of any extension readable
-     *                       by SOIL
+     *         filetexture - the texture file, .png extension, or NULL to use
+     *                       the "map_Kd" of the first material of the file
      *
      * DESCRIPTION:
      *         This function reads an .obj file and creates the geometry for the
-     *         object it describes. In particular this function will only work
-     *         for .objs that have vertex, texture, normals and face data of
-     *         order 3 with the pattern "number/number/number"
+     *         object it describes, with the positions, texture coordinates and
+     *         normals of the vertices. Faces can use any pattern, corners
+     *         without a texture or normal index get zeros for it.
      *
-     *         Note: Uses SOIL to load images: http://www.lonesock.net/soil.html
+     *         Note: the texture is loaded with load_png (imageHelper.h).
      *
      */
-    void readObjVertTexNorm ( char* filename, char* filetexture );
+    void readObjVertTexNorm ( char* filename, char* filetexture = NULL );
 
     /*
      * readObjLightMap
      *
      * INPUT:
      *         filename - the .obj file you want to load
-     *         filetextureDiff - the texture file for diffuse map, .png extension
-     *         filetextureSpec - the texture file for specular map, .png extension
+     *         filetextureDiff - the texture file for diffuse map, .png extension, or
+     *                           NULL to use the "map_Kd" of the first material
+     *         filetextureSpec - the texture file for specular map, .png extension, or
+     *                           NULL to use the "map_Ks" of the first material
      *
      * DESCRIPTION:
      *         Reads an obj file with vertex, normal and texture data, and also receives
      *         texture files in png for diffuse and specular mapping.
      *
      */
-    void readObjLightMap ( char* filename , char* filetextureDiff, char* filetextureSpec );
+    void readObjLightMap ( char* filename , char* filetextureDiff = NULL, char* filetextureSpec = NULL );
 
     /*
      * readNormalMap
@@ -0,0 +1,449 @@
+/*
+ * vertexBuffer.cpp
+ *
+ * Interleaved vertex streams: the layout of the attributes of a vertex
+ * (XYZ NXNYNZ UV ... one vertex after the other) and the helpers that
+ * upload a Shape with it and set up the vertex array objects.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "vertexBuffer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "shape.h"
+#include "primitiveCache.h"
+
+// How to calculate an offset into the vertex buffer
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+// The shader input and the number of floats of each attribute, in the
+// order of VertexAttributeIndex
+static const char* attributeNames[NUM_VERTEX_ATTRIBUTES] = {
+    "vPosition", "vNormal", "vTexCoord", "vColor", "vTangent", "vBitangent"
+};
+static const GLint attributeSizes[NUM_VERTEX_ATTRIBUTES] = { 3, 3, 2, 4, 3, 3 };
+
+// The same for the packed format: the position has a fourth component so
+// the next attribute stays 4 byte aligned, the directions have the two of
+// the octahedral encoding
+static const GLint packedSizes[NUM_VERTEX_ATTRIBUTES] = { 4, 2, 2, 4, 2, 2 };
+static const GLenum packedTypes[NUM_VERTEX_ATTRIBUTES] = {
+    GL_SHORT, GL_SHORT, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE, GL_SHORT, GL_SHORT
+};
+
+// The signed attributes are read as integers and divided in the shader:
+// OpenGL before 4.2 maps -32768..32767 to -1..1 with no exact 0, and macOS
+// stops at 4.1, so the shader does not depend on how the driver does it
+static const GLboolean packedNormalized[NUM_VERTEX_ATTRIBUTES] = {
+    GL_FALSE, GL_FALSE, GL_TRUE, GL_TRUE, GL_FALSE, GL_FALSE
+};
+
+// The bytes of a component of every type a layout uses
+static GLuint typeSize (GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+/*
+ * makeVertexLayout
+ *
+ * INPUT:
+ *         mask - the VERTEX_* attributes the stream has, plus
+ *                VERTEX_PACKED for the packed format.
+ *
+ * RETURN:
+ *         The layout of a vertex with those attributes, packed one after
+ *         the other in the order of VertexAttributeIndex. A packed layout
+ *         decodes with scale 1 and offset 0 until they are set, see
+ *         Shape::getVertexLayout.
+ *
+ */
+VertexLayout makeVertexLayout(unsigned int mask) {
+    VertexLayout layout;
+    layout.stride = 0;
+    layout.mask = mask & (VERTEX_ALL | VERTEX_PACKED);
+    bool packed = (mask & VERTEX_PACKED) != 0;
+
+    for (int i = 0; i < NUM_VERTEX_ATTRIBUTES; ++i) {
+        VertexAttribute& attribute = layout.attributes[i];
+        attribute.name = attributeNames[i];
+        attribute.offset = layout.stride;
+        attribute.type = packed ? packedTypes[i] : GL_FLOAT;
+        attribute.normalized = packed ? packedNormalized[i] : GL_FALSE;
+
+        if (mask & (1u << i)) {
+            attribute.size = packed ? packedSizes[i] : attributeSizes[i];
+        } else {
+            attribute.size = 0;
+        }
+        layout.stride += attribute.size * typeSize(attribute.type);
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        layout.positionScale[c] = 1.0f;
+        layout.positionOffset[c] = 0.0f;
+    }
+    for (int c = 0; c < 2; ++c) {
+        layout.uvScale[c] = 1.0f;
+        layout.uvOffset[c] = 0.0f;
+    }
+    return layout;
+}
+
+/*
+ * packSnorm16
+ *
+ * INPUT:
+ *         value - a value from -1 to 1, clamped if it is not.
+ *
+ * RETURN:
+ *         The value as a 16 bit integer from -32767 to 32767.
+ *
+ */
+GLshort packSnorm16(float value) {
+    value = (value < -1.0f) ? -1.0f : ((value > 1.0f) ? 1.0f : value);
+    return (GLshort) floorf(value * 32767.0f + 0.5f);
+}
+
+/*
+ * packUnorm16
+ *
+ * INPUT:
+ *         value - a value from 0 to 1, clamped if it is not.
+ *
+ * RETURN:
+ *         The value as a 16 bit integer from 0 to 65535.
+ *
+ */
+GLushort packUnorm16(float value) {
+    value = (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+    return (GLushort) floorf(value * 65535.0f + 0.5f);
+}
+
+/*
+ * encodeOctahedral
+ *
+ * INPUT:
+ *         direction - x y z of a direction, it does not need to be
+ *                     normalized.
+ *         packed - where the two components are written.
+ *
+ * DESCRIPTION:
+ *         Projects the direction onto an octahedron and unfolds it onto a
+ *         square (Cigolle et al., A Survey of Efficient Representations
+ *         for Independent Unit Vectors), so a unit vector fits in two 16
+ *         bit integers with an error well under a hundredth of a degree. A
+ *         zero vector comes back as 0 0 1.
+ *
+ */
+void encodeOctahedral(const float* direction, GLshort* packed) {
+    float length = fabsf(direction[0]) + fabsf(direction[1]) + fabsf(direction[2]);
+    if (length == 0.0f) {
+        packed[0] = 0;
+        packed[1] = 0;
+        return;
+    }
+
+    float x = direction[0] / length;
+    float y = direction[1] / length;
+
+    // the lower half is folded over the diagonals onto the corners
+    if (direction[2] < 0.0f) {
+        float foldedX = (1.0f - fabsf(y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+        float foldedY = (1.0f - fabsf(x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    packed[0] = packSnorm16(x);
+    packed[1] = packSnorm16(y);
+}
+
+/*
+ * decodeOctahedral
+ *
+ * INPUT:
+ *         packed - the two components from encodeOctahedral.
+ *         direction - where the unit vector is written.
+ *
+ * DESCRIPTION:
+ *         The same as decodeOctahedral of shaders/packedVertex.glsl, to
+ *         check the packed vertices on the CPU.
+ *
+ */
+void decodeOctahedral(const GLshort* packed, float* direction) {
+    float x = packed[0] / 32767.0f;
+    float y = packed[1] / 32767.0f;
+    float z = 1.0f - fabsf(x) - fabsf(y);
+
+    // unfold the corners back onto the lower half
+    float fold = (z < 0.0f) ? -z : 0.0f;
+    x += (x >= 0.0f) ? -fold : fold;
+    y += (y >= 0.0f) ? -fold : fold;
+
+    float length = sqrtf(x * x + y * y + z * z);
+    direction[0] = x / length;
+    direction[1] = y / length;
+    direction[2] = z / length;
+}
+
+/*
+ * packElementData
+ *
+ * INPUT:
+ *         elements - the elements.
+ *         numElements - how many there are.
+ *         data - where the packed elements are written.
+ *
+ * RETURN:
+ *         The narrowest type that holds every element, GL_UNSIGNED_BYTE,
+ *         GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, the one data has.
+ *
+ */
+GLenum packElementData(const GLuint* elements, size_t numElements, std::vector<GLubyte>& data) {
+    GLuint maxElement = 0;
+    for (size_t i = 0; i < numElements; ++i) {
+        if (elements[i] > maxElement) {
+            maxElement = elements[i];
+        }
+    }
+
+    if (maxElement <= 0xFF) {
+        data.assign(elements, elements + numElements);
+        return GL_UNSIGNED_BYTE;
+    }
+
+    if (maxElement <= 0xFFFF) {
+        data.resize(numElements * sizeof(GLushort));
+
+        GLushort* packed = (GLushort*) &data[0];
+        for (size_t i = 0; i < numElements; ++i) {
+            packed[i] = (GLushort) elements[i];
+        }
+        return GL_UNSIGNED_SHORT;
+    }
+
+    data.resize(numElements * sizeof(GLuint));
+    memcpy(&data[0], elements, numElements * sizeof(GLuint));
+    return GL_UNSIGNED_INT;
+}
+
+/*
+ * setVertexAttributes
+ *
+ * INPUT:
+ *         program - the program whose attribute locations are used.
+ *         layout - the layout of the vertices.
+ *         baseOffset - where the first vertex is in the buffer, in bytes.
+ *
+ * DESCRIPTION:
+ *         Points every attribute of the layout that program reads to the
+ *         vertex buffer bound to GL_ARRAY_BUFFER and enables it, on the
+ *         vertex array object that is bound. Attributes the program does
+ *         not read are skipped.
+ *
+ */
+void setVertexAttributes(GLuint program, const VertexLayout& layout, GLuint baseOffset) {
+    for (int i = 0; i < NUM_VERTEX_ATTRIBUTES; ++i) {
+        const VertexAttribute& attribute = layout.attributes[i];
+        if (attribute.size == 0) {
+            continue;
+        }
+
+        GLint location = glGetAttribLocation(program, attribute.name);
+        if (location < 0) {
+            continue;
+        }
+
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, attribute.size, attribute.type, attribute.normalized,
+                              layout.stride, BUFFER_OFFSET(baseOffset + attribute.offset));
+    }
+}
+
+/*
+ * setPackedVertexUniforms
+ *
+ * INPUT:
+ *         program - the program that draws the vertices, in use.
+ *         layout - the layout of the vertices.
+ *
+ * DESCRIPTION:
+ *         Sets the uniforms of shaders/packedVertex.glsl (uPositionScale,
+ *         uPositionOffset, uUvScale and uUvOffset) from the layout. The
+ *         uniforms program does not have are skipped.
+ *
+ */
+void setPackedVertexUniforms(GLuint program, const VertexLayout& layout) {
+    GLint location = glGetUniformLocation(program, "uPositionScale");
+    if (location >= 0) {
+        glUniform3fv(location, 1, layout.positionScale);
+    }
+    location = glGetUniformLocation(program, "uPositionOffset");
+    if (location >= 0) {
+        glUniform3fv(location, 1, layout.positionOffset);
+    }
+    location = glGetUniformLocation(program, "uUvScale");
+    if (location >= 0) {
+        glUniform2fv(location, 1, layout.uvScale);
+    }
+    location = glGetUniformLocation(program, "uUvOffset");
+    if (location >= 0) {
+        glUniform2fv(location, 1, layout.uvOffset);
+    }
+}
+
+// The buffers uploaded for the cached primitives, by geometry and mask,
+// and how many uploadShape calls got them. Only the thread of the OpenGL
+// context uses them. The geometry is kept alive with them, so its address
+// is not given to another primitive while they are here.
+typedef std::pair<const PrimitiveGeometry*, unsigned int> SharedBuffersKey;
+struct SharedBuffers {
+    std::shared_ptr<const PrimitiveGeometry> primitive;
+    ShapeBuffers buffers;
+    int users;
+};
+static std::map<SharedBuffersKey, SharedBuffers> sharedBuffers;
+
+/*
+ * uploadShape
+ *
+ * INPUT:
+ *         shape - the shape that is uploaded.
+ *         mask - the VERTEX_* attributes wanted, those the shape does not
+ *                have are left out. With VERTEX_PACKED the vertices are
+ *                packed, about half the bytes of the floats.
+ *
+ * RETURN:
+ *         The buffers, with one glBufferData call for the interleaved
+ *         vertices and one for the elements.
+ *
+ * DESCRIPTION:
+ *         A shape that shares a cached primitive (primitiveCache.h) gets
+ *         the buffers already uploaded for it with the same mask, if any,
+ *         so every shape made with the same parameters draws from the
+ *         same buffers. They must be used from the thread of the OpenGL
+ *         context, like every other call here.
+ *
+ */
+ShapeBuffers uploadShape(Shape& shape, unsigned int mask) {
+    std::shared_ptr<const PrimitiveGeometry> primitive = shape.getSharedPrimitive();
+    SharedBuffersKey sharedKey(primitive.get(), mask);
+    if (primitive) {
+        std::map<SharedBuffersKey, SharedBuffers>::iterator it = sharedBuffers.find(sharedKey);
+        if (it != sharedBuffers.end()) {
+            ++it->second.users;
+            return it->second.buffers;
+        }
+    }
+
+    ShapeBuffers buffers;
+    buffers.layout = shape.getVertexLayout(mask);
+    buffers.numVertices = shape.getNumVertices();
+    buffers.numElements = shape.getNumElements();
+    buffers.elementType = shape.getElementType();
+
+    glGenBuffers(1, &buffers.vbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbuffer);
+    if (buffers.layout.mask & VERTEX_PACKED) {
+        std::vector<GLubyte> stream;
+        shape.buildPackedVertices(buffers.layout, stream);
+        glBufferData(GL_ARRAY_BUFFER, stream.size(), stream.empty() ? NULL : &stream[0],
+                     GL_STATIC_DRAW);
+    } else {
+        std::vector<float> stream;
+        shape.buildInterleavedVertices(buffers.layout, stream);
+        glBufferData(GL_ARRAY_BUFFER, stream.size() * sizeof(GLfloat),
+                     stream.empty() ? NULL : &stream[0], GL_STATIC_DRAW);
+    }
+
+    glGenBuffers(1, &buffers.ebuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.numElements * shape.getElementSize(),
+                 shape.getElementData(), GL_STATIC_DRAW);
+
+    if (primitive) {
+        SharedBuffers& shared = sharedBuffers[sharedKey];
+        shared.primitive = primitive;
+        shared.buffers = buffers;
+        shared.users = 1;
+    }
+    return buffers;
+}
+
+/*
+ * makeVertexArray
+ *
+ * INPUT:
+ *         buffers - the buffers of a shape, from uploadShape.
+ *         program - the program that draws them.
+ *
+ * RETURN:
+ *         A new vertex array object with the attributes of program and
+ *         the element buffer set up, ready for glDrawElements. A shape can
+ *         have one per program that draws it.
+ *
+ */
+GLuint makeVertexArray(const ShapeBuffers& buffers, GLuint program) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.vbuffer);
+    setVertexAttributes(program, buffers.layout);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebuffer);
+
+    return vao;
+}
+
+/*
+ * deleteShapeBuffers
+ *
+ * INPUT:
+ *         buffers - the buffers of a shape, from uploadShape.
+ *
+ * DESCRIPTION:
+ *         Deletes the buffers and sets their names to 0. Buffers shared by
+ *         the shapes of a cached primitive are only deleted when the last
+ *         of them lets them go. The vertex array objects made with them
+ *         are not deleted.
+ *
+ */
+void deleteShapeBuffers(ShapeBuffers& buffers) {
+    std::map<SharedBuffersKey, SharedBuffers>::iterator it;
+    for (it = sharedBuffers.begin(); it != sharedBuffers.end(); ++it) {
+        if (it->second.buffers.vbuffer == buffers.vbuffer) {
+            break;
+        }
+    }
+
+    if (it != sharedBuffers.end()) {
+        if (--it->second.users > 0) {
+            buffers.vbuffer = 0;
+            buffers.ebuffer = 0;
+            return;
+        }
+        sharedBuffers.erase(it);
+    }
+
+    glDeleteBuffers(1, &buffers.vbuffer);
+    glDeleteBuffers(1, &buffers.ebuffer);
+    buffers.vbuffer = 0;
+    buffers.ebuffer = 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * vertexBuffer.h
+ *
+ * Interleaved vertex streams: the layout of the attributes of a vertex
+ * (XYZ NXNYNZ UV ... one vertex after the other) and the helpers that
+ * upload a Shape with it and set up the vertex array objects.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _VERTEXBUFFER_H
+#define _VERTEXBUFFER_H
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+
+#include <vector>
+
+class Shape;
+
+// The attributes a vertex stream can have, they can be or'd together
+#define VERTEX_POSITION   1
+#define VERTEX_NORMAL     2
+#define VERTEX_UV         4
+#define VERTEX_COLOR      8
+#define VERTEX_TANGENT    16
+#define VERTEX_BITANGENT  32
+#define VERTEX_ALL        63
+
+// Asks for the packed format: positions as 16 bit integers inside the
+// bounding box of the shape, normals, tangents and bitangents octahedral
+// encoded in two 16 bit integers, uvs as 16 bit integers inside their
+// range and colors as bytes. The vertex shader decodes them with the
+// functions of shaders/packedVertex.glsl
+#define VERTEX_PACKED     64
+
+// The attributes in the order they are stored in a vertex
+enum VertexAttributeIndex {
+    ATTRIBUTE_POSITION = 0,
+    ATTRIBUTE_NORMAL,
+    ATTRIBUTE_UV,
+    ATTRIBUTE_COLOR,
+    ATTRIBUTE_TANGENT,
+    ATTRIBUTE_BITANGENT,
+    NUM_VERTEX_ATTRIBUTES
+};
+
+/*
+ * Where one attribute is inside a vertex.
+ */
+struct VertexAttribute {
+    // the input of the vertex shaders that reads it, e.g. "vPosition"
+    const char* name;
+
+    // how many components it has, 0 if the stream does not have it
+    GLint size;
+
+    // the type of the components and whether integers are read as values
+    // from 0 to 1 (-1 to 1 if signed), what glVertexAttribPointer needs
+    GLenum type;
+    GLboolean normalized;
+
+    // bytes from the start of the vertex
+    GLuint offset;
+};
+
+/*
+ * The VertexLayout struct. Every attribute is 4 byte aligned, floats or
+ * packed, and the stride is the size of one vertex.
+ */
+struct VertexLayout {
+    VertexAttribute attributes[NUM_VERTEX_ATTRIBUTES];
+
+    // bytes from one vertex to the next
+    GLuint stride;
+
+    // the VERTEX_* attributes the stream has, plus VERTEX_PACKED
+    unsigned int mask;
+
+    // how the packed positions and uvs are decoded: value = offset +
+    // scale * input, the input of the vertex shader going from -32767 to
+    // 32767 for positions and from 0 to 1 for uvs. Scale 1 and offset 0
+    // for floats
+    float positionScale[3];
+    float positionOffset[3];
+    float uvScale[2];
+    float uvOffset[2];
+};
+
+/*
+ * The buffers of a Shape on the GPU, made by uploadShape.
+ */
+struct ShapeBuffers {
+    // the interleaved vertices and the elements
+    GLuint vbuffer;
+    GLuint ebuffer;
+
+    VertexLayout layout;
+    GLuint numVertices;
+
+    // what glDrawElements needs
+    GLuint numElements;
+    GLenum elementType;
+};
+
+/*
+ * makeVertexLayout
+ *
+ * INPUT:
+ *         mask - the VERTEX_* attributes the stream has, plus
+ *                VERTEX_PACKED for the packed format.
+ *
+ * RETURN:
+ *         The layout of a vertex with those attributes, packed one after
+ *         the other in the order of VertexAttributeIndex. A packed layout
+ *         decodes with scale 1 and offset 0 until they are set, see
+ *         Shape::getVertexLayout.
+ *
+ */
+VertexLayout makeVertexLayout(unsigned int mask);
+
+/*
+ * packSnorm16
+ *
+ * INPUT:
+ *         value - a value from -1 to 1, clamped if it is not.
+ *
+ * RETURN:
+ *         The value as a 16 bit integer from -32767 to 32767.
+ *
+ */
+GLshort packSnorm16(float value);
+
+/*
+ * packUnorm16
+ *
+ * INPUT:
+ *         value - a value from 0 to 1, clamped if it is not.
+ *
+ * RETURN:
+ *         The value as a 16 bit integer from 0 to 65535.
+ *
+ */
+GLushort packUnorm16(float value);
+
+/*
+ * encodeOctahedral
+ *
+ * INPUT:
+ *         direction - x y z of a direction, it does not need to be
+ *                     normalized.
+ *         packed - where the two components are written.
+ *
+ * DESCRIPTION:
+ *         Projects the direction onto an octahedron and unfolds it onto a
+ *         square (Cigolle et al., A Survey of Efficient Representations
+ *         for Independent Unit Vectors), so a unit vector fits in two 16
+ *         bit integers with an error well under a hundredth of a degree. A
+ *         zero vector comes back as 0 0 1.
+ *
+ */
+void encodeOctahedral(const float* direction, GLshort* packed);
+
+/*
+ * decodeOctahedral
+ *
+ * INPUT:
+ *         packed - the two components from encodeOctahedral.
+ *         direction - where the unit vector is written.
+ *
+ * DESCRIPTION:
+ *         The same as decodeOctahedral of shaders/packedVertex.glsl, to
+ *         check the packed vertices on the CPU.
+ *
+ */
+void decodeOctahedral(const GLshort* packed, float* direction);
+
+/*
+ * packElementData
+ *
+ * INPUT:
+ *         elements - the elements.
+ *         numElements - how many there are.
+ *         data - where the packed elements are written.
+ *
+ * RETURN:
+ *         The narrowest type that holds every element, GL_UNSIGNED_BYTE,
+ *         GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, the one data has.
+ *
+ */
+GLenum packElementData(const GLuint* elements, size_t numElements, std::vector<GLubyte>& data);
+
+/*
+ * setVertexAttributes
+ *
+ * INPUT:
+ *         program - the program whose attribute locations are used.
+ *         layout - the layout of the vertices.
+ *         baseOffset - where the first vertex is in the buffer, in bytes.
+ *
+ * DESCRIPTION:
+ *         Points every attribute of the layout that program reads to the
+ *         vertex buffer bound to GL_ARRAY_BUFFER and enables it, on the
+ *         vertex array object that is bound. Attributes the program does
+ *         not read are skipped.
+ *
+ */
+void setVertexAttributes(GLuint program, const VertexLayout& layout, GLuint baseOffset = 0);
+
+/*
+ * setPackedVertexUniforms
+ *
+ * INPUT:
+ *         program - the program that draws the vertices, in use.
+ *         layout - the layout of the vertices.
+ *
+ * DESCRIPTION:
+ *         Sets the uniforms of shaders/packedVertex.glsl (uPositionScale,
+ *         uPositionOffset, uUvScale and uUvOffset) from the layout. The
+ *         uniforms program does not have are skipped.
+ *
+ */
+void setPackedVertexUniforms(GLuint program, const VertexLayout& layout);
+
+/*
+ * uploadShape
+ *
+ * INPUT:
+ *         shape - the shape that is uploaded.
+ *         mask - the VERTEX_* attributes wanted, those the shape does not
+ *                have are left out. With VERTEX_PACKED the vertices are
+ *                packed, about half the bytes of the floats.
+ *
+ * RETURN:
+ *         The buffers, with one glBufferData call for the interleaved
+ *         vertices and one for the elements.
+ *
+ * DESCRIPTION:
+ *         A shape that shares a cached primitive (primitiveCache.h) gets
+ *         the buffers already uploaded for it with the same mask, if any,
+ *         so every shape made with the same parameters draws from the
+ *         same buffers. They must be used from the thread of the OpenGL
+ *         context, like every other call here.
+ *
+ */
+ShapeBuffers uploadShape(Shape& shape, unsigned int mask);
+
+/*
+ * makeVertexArray
+ *
+ * INPUT:
+ *         buffers - the buffers of a shape, from uploadShape.
+ *         program - the program that draws them.
+ *
+ * RETURN:
+ *         A new vertex array object with the attributes of program and
+ *         the element buffer set up, ready for glDrawElements. A shape can
+ *         have one per program that draws it.
+ *
+ */
+GLuint makeVertexArray(const ShapeBuffers& buffers, GLuint program);
+
+/*
+ * deleteShapeBuffers
+ *
+ * INPUT:
+ *         buffers - the buffers of a shape, from uploadShape.
+ *
+ * DESCRIPTION:
+ *         Deletes the buffers and sets their names to 0. Buffers shared by
+ *         the shapes of a cached primitive are only deleted when the last
+ *         of them lets them go. The vertex array objects made with them
+ *         are not deleted.
+ *
+ */
+void deleteShapeBuffers(ShapeBuffers& buffers);
+
+#endif
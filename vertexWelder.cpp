@@ -0,0 +1,173 @@
+/*
+ * vertexWelder.cpp
+ *
+ * VertexWelder class, finds the unique vertices of a mesh given by index
+ * triples (vertex, texture, normal), like the face corners of an .obj file.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "vertexWelder.h"
+
+// Marks a free slot
+static const unsigned int EMPTY_SLOT = 0xFFFFFFFFu;
+
+// Smallest table we allocate
+static const size_t MIN_CAPACITY = 16;
+
+// Mixes the three indices of a triple into a well distributed hash
+static inline size_t hashTriple (int v, int vt, int vn) {
+    unsigned long long h = (unsigned int) v;
+    h = h * 0x9E3779B97F4A7C15ull + (unsigned int) vt;
+    h = h * 0x9E3779B97F4A7C15ull + (unsigned int) vn;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return (size_t) h;
+}
+
+// Smallest power of 2 that holds n entries at half load, the table grows
+// when it gets more than half full
+static inline size_t capacityFor (size_t n) {
+    size_t capacity = MIN_CAPACITY;
+    while (capacity < n * 2) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/*
+ * VertexWelder
+ *
+ * INPUT:
+ *         expectedVertices - how many unique vertices we expect to see.
+ *
+ * DESCRIPTION:
+ *         Creates the table already sized for expectedVertices entries,
+ *         so it does not need to grow while welding. It still grows if
+ *         the estimate was too low.
+ *
+ */
+VertexWelder::VertexWelder ( size_t expectedVertices ) : mask(0), count(0) {
+    Slot empty = { 0, 0, 0, EMPTY_SLOT };
+    slots.assign(capacityFor(expectedVertices), empty);
+    mask = slots.size() - 1;
+}
+
+/*
+ * reserve
+ *
+ * INPUT:
+ *         expectedVertices - how many unique vertices we expect to see.
+ *
+ * DESCRIPTION:
+ *         Makes sure the table can hold expectedVertices entries without
+ *         growing.
+ *
+ */
+void VertexWelder::reserve ( size_t expectedVertices ) {
+    size_t capacity = capacityFor(expectedVertices);
+    if (capacity > slots.size()) {
+        rehash(capacity);
+    }
+}
+
+/*
+ * rehash
+ *
+ * INPUT:
+ *         capacity - the new number of slots, a power of 2.
+ *
+ * DESCRIPTION:
+ *         Moves every entry to a new table with the given capacity.
+ *
+ */
+void VertexWelder::rehash ( size_t capacity ) {
+    Slot empty = { 0, 0, 0, EMPTY_SLOT };
+    std::vector<Slot> previous;
+    previous.swap(slots);
+    slots.assign(capacity, empty);
+    mask = capacity - 1;
+
+    for (size_t i = 0; i < previous.size(); ++i) {
+        if (previous[i].index == EMPTY_SLOT) {
+            continue;
+        }
+
+        size_t position = hashTriple(previous[i].v, previous[i].vt, previous[i].vn) & mask;
+        while (slots[position].index != EMPTY_SLOT) {
+            position = (position + 1) & mask;
+        }
+        slots[position] = previous[i];
+    }
+}
+
+/*
+ * weld
+ *
+ * INPUT:
+ *         v - the vertex index of the corner.
+ *         vt - the texture index of the corner (-1 if there is none).
+ *         vn - the normal index of the corner (-1 if there is none).
+ *         isNew - set to true if this is the first time we see the triple.
+ *
+ * RETURN:
+ *         The index of the welded vertex. New triples get the next
+ *         index (0, 1, 2, ...), so the caller only has to append the
+ *         vertex data when isNew is true.
+ *
+ * DESCRIPTION:
+ *         Looks up the triple only once, inserting it if needed.
+ *
+ */
+unsigned int VertexWelder::weld ( int v, int vt, int vn, bool& isNew ) {
+    if ((count + 1) * 2 > slots.size()) {
+        rehash(slots.size() * 2);
+    }
+
+    size_t position = hashTriple(v, vt, vn) & mask;
+    while (true) {
+        Slot& slot = slots[position];
+
+        if (slot.index == EMPTY_SLOT) {
+            slot.v = v;
+            slot.vt = vt;
+            slot.vn = vn;
+            slot.index = (unsigned int) count++;
+            isNew = true;
+            return slot.index;
+        }
+
+        if (slot.v == v && slot.vt == vt && slot.vn == vn) {
+            isNew = false;
+            return slot.index;
+        }
+
+        position = (position + 1) & mask;
+    }
+}
+
+/*
+ * getNumVertices
+ *
+ * RETURN:
+ *         The number of unique vertices welded so far.
+ *
+ */
+size_t VertexWelder::getNumVertices () {
+    return count;
+}
+
+/*
+ * clear
+ *
+ * DESCRIPTION:
+ *         Removes every entry, keeping the allocated table.
+ *
+ */
+void VertexWelder::clear () {
+    Slot empty = { 0, 0, 0, EMPTY_SLOT };
+    slots.assign(slots.size(), empty);
+    count = 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * vertexWelder.h
+ *
+ * VertexWelder class, finds the unique vertices of a mesh given by index
+ * triples (vertex, texture, normal), like the face corners of an .obj file.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _VERTEXWELDER_H
+#define _VERTEXWELDER_H
+
+#include <vector>
+#include <stddef.h>
+
+/*
+ * The VertexWelder class. It is an open addressing hash table (linear
+ * probing) where every slot holds a packed index triple and the index of
+ * the welded vertex it became. Nothing is allocated per lookup.
+ */
+class VertexWelder {
+    // one slot of the table, index is EMPTY_SLOT when the slot is free
+    struct Slot {
+        int v, vt, vn;
+        unsigned int index;
+    };
+
+    // the table, its size is always a power of 2
+    std::vector<Slot> slots;
+    size_t mask;
+
+    // how many welded vertices the table holds
+    size_t count;
+
+    /*
+     * rehash
+     *
+     * INPUT:
+     *         capacity - the new number of slots, a power of 2.
+     *
+     * DESCRIPTION:
+     *         Moves every entry to a new table with the given capacity.
+     *
+     */
+    void rehash ( size_t capacity );
+
+public:
+
+    /*
+     * VertexWelder
+     *
+     * INPUT:
+     *         expectedVertices - how many unique vertices we expect to see.
+     *
+     * DESCRIPTION:
+     *         Creates the table already sized for expectedVertices entries,
+     *         so it does not need to grow while welding. It still grows if
+     *         the estimate was too low.
+     *
+     */
+    VertexWelder ( size_t expectedVertices = 0 );
+
+    /*
+     * reserve
+     *
+     * INPUT:
+     *         expectedVertices - how many unique vertices we expect to see.
+     *
+     * DESCRIPTION:
+     *         Makes sure the table can hold expectedVertices entries without
+     *         growing.
+     *
+     */
+    void reserve ( size_t expectedVertices );
+
+    /*
+     * weld
+     *
+     * INPUT:
+     *         v - the vertex index of the corner.
+     *         vt - the texture index of the corner (-1 if there is none).
+     *         vn - the normal index of the corner (-1 if there is none).
+     *         isNew - set to true if this is the first time we see the triple.
+     *
+     * RETURN:
+     *         The index of the welded vertex. New triples get the next
+     *         index (0, 1, 2, ...), so the caller only has to append the
+     *         vertex data when isNew is true.
+     *
+     * DESCRIPTION:
+     *         Looks up the triple only once, inserting it if needed.
+     *
+     */
+    unsigned int weld ( int v, int vt, int vn, bool& isNew );
+
+    /*
+     * getNumVertices
+     *
+     * RETURN:
+     *         The number of unique vertices welded so far.
+     *
+     */
+    size_t getNumVertices ();
+
+    /*
+     * clear
+     *
+     * DESCRIPTION:
+     *         Removes every entry, keeping the allocated table.
+     *
+     */
+    void clear ();
+};
+
+#endif
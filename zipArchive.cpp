@@ -0,0 +1,666 @@
+/*
+ * zipArchive.cpp
+ *
+ * Read only access to the files inside .zip archives, without unzipping
+ * them to disk. A path like "objects/teapot.zip/teapot.obj" names the
+ * entry "teapot.obj" of the archive "objects/teapot.zip", and the loaders
+ * (readObjFile, readMtlFile, loadWeldedObj, load_png) accept those paths
+ * like any other file.
+ *
+ * The central directory of an archive is read once, the first time one
+ * of its entries is used. Entries are inflated a block at a time while
+ * they are read, never to a temporary file.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#include "zipArchive.h"
+
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include <limits.h>
+#include <map>
+#include <mutex>
+
+// Signatures of the records we read
+static const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static const uint32_t END_SIGNATURE = 0x06054b50;
+static const uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+static const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+
+// Sizes of the fixed part of the records
+static const size_t LOCAL_HEADER_SIZE = 30;
+static const size_t CENTRAL_HEADER_SIZE = 46;
+static const size_t END_SIZE = 22;
+static const size_t ZIP64_END_SIZE = 56;
+static const size_t ZIP64_LOCATOR_SIZE = 20;
+
+// The end record is followed by a comment of up to 64KB
+static const size_t MAX_COMMENT_SIZE = 0xFFFF;
+
+// The extra field with the 64 bit values of an entry
+static const uint16_t ZIP64_EXTRA_ID = 0x0001;
+
+// Methods and flags
+static const unsigned int METHOD_STORED = 0;
+static const unsigned int METHOD_DEFLATED = 8;
+static const uint16_t FLAG_ENCRYPTED = 0x0001;
+
+// zlib takes at most this many bytes at once
+static const size_t MAX_ZLIB_INPUT = 1 << 30;
+
+// Little endian values, the archive is not aligned
+static inline uint16_t readU16 (const char* p) {
+    const unsigned char* b = (const unsigned char*) p;
+    return (uint16_t) (b[0] | (b[1] << 8));
+}
+
+static inline uint32_t readU32 (const char* p) {
+    const unsigned char* b = (const unsigned char*) p;
+    return (uint32_t) b[0] | ((uint32_t) b[1] << 8) | ((uint32_t) b[2] << 16) | ((uint32_t) b[3] << 24);
+}
+
+static inline uint64_t readU64 (const char* p) {
+    return (uint64_t) readU32(p) | ((uint64_t) readU32(p + 4) << 32);
+}
+
+/*
+ * ZipArchive
+ *
+ * DESCRIPTION:
+ *         Default constructor, creates an archive with no entries.
+ *
+ */
+ZipArchive::ZipArchive () {
+}
+
+// Replaces the values of entry that are 0xFFFFFFFF by the ones of its
+// ZIP64 extra field, they come in this order and only if needed
+static bool readZip64Extra (const char* extra, size_t extraSize, ZipEntry& entry,
+                            bool sizeMissing, bool compressedMissing, bool offsetMissing) {
+    const char* p = extra;
+    const char* end = extra + extraSize;
+
+    while (end - p >= 4) {
+        uint16_t id = readU16(p);
+        uint16_t fieldSize = readU16(p + 2);
+        const char* field = p + 4;
+        if ((size_t) (end - field) < fieldSize) {
+            return false;
+        }
+
+        if (id == ZIP64_EXTRA_ID) {
+            const char* value = field;
+            const char* valueEnd = field + fieldSize;
+            if (sizeMissing) {
+                if (valueEnd - value < 8) return false;
+                entry.size = readU64(value);
+                value += 8;
+            }
+            if (compressedMissing) {
+                if (valueEnd - value < 8) return false;
+                entry.compressedSize = readU64(value);
+                value += 8;
+            }
+            if (offsetMissing) {
+                if (valueEnd - value < 8) return false;
+                entry.headerOffset = readU64(value);
+            }
+            return true;
+        }
+        p = field + fieldSize;
+    }
+    return !sizeMissing && !compressedMissing && !offsetMissing;
+}
+
+/*
+ * open
+ *
+ * INPUT:
+ *         filename - the .zip file.
+ *
+ * RETURN:
+ *         True if the file could be mapped and its central directory
+ *         read, false otherwise.
+ *
+ * DESCRIPTION:
+ *         Maps the archive and reads its central directory (ZIP64
+ *         archives included). No entry is inflated.
+ *
+ */
+bool ZipArchive::open (const char* filename) {
+    entries.clear();
+    if (!file.open(filename) || file.getSize() < END_SIZE) {
+        file.close();
+        return false;
+    }
+
+    const char* begin = file.begin();
+    const char* end = file.end();
+
+    // the end record is the last one, before a comment we do not know
+    // the size of, so we look for it backwards
+    const char* lowest = (file.getSize() > END_SIZE + MAX_COMMENT_SIZE) ? end - END_SIZE - MAX_COMMENT_SIZE
+                                                                         : begin;
+    const char* record = NULL;
+    for (const char* p = end - END_SIZE; p >= lowest; --p) {
+        if (readU32(p) == END_SIGNATURE) {
+            record = p;
+            break;
+        }
+    }
+    if (record == NULL) {
+        file.close();
+        return false;
+    }
+
+    uint64_t numEntries = readU16(record + 10);
+    uint64_t directorySize = readU32(record + 12);
+    uint64_t directoryOffset = readU32(record + 16);
+
+    // ZIP64, the real values are on another end record
+    if (record - begin >= (ptrdiff_t) ZIP64_LOCATOR_SIZE &&
+        readU32(record - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+        uint64_t zip64Offset = readU64(record - ZIP64_LOCATOR_SIZE + 8);
+        if (zip64Offset + ZIP64_END_SIZE > file.getSize() ||
+            readU32(begin + zip64Offset) != ZIP64_END_SIGNATURE) {
+            file.close();
+            return false;
+        }
+        const char* zip64 = begin + zip64Offset;
+        numEntries = readU64(zip64 + 32);
+        directorySize = readU64(zip64 + 40);
+        directoryOffset = readU64(zip64 + 48);
+    }
+
+    if (directoryOffset > file.getSize() || directorySize > file.getSize() - directoryOffset) {
+        file.close();
+        return false;
+    }
+
+    // the central directory, one header per entry
+    const char* p = begin + directoryOffset;
+    const char* directoryEnd = p + directorySize;
+    entries.reserve(numEntries < directorySize / CENTRAL_HEADER_SIZE ? numEntries
+                                                                     : directorySize / CENTRAL_HEADER_SIZE);
+
+    for (uint64_t i = 0; i < numEntries; ++i) {
+        if ((size_t) (directoryEnd - p) < CENTRAL_HEADER_SIZE || readU32(p) != CENTRAL_HEADER_SIGNATURE) {
+            entries.clear();
+            file.close();
+            return false;
+        }
+
+        uint16_t flags = readU16(p + 8);
+        size_t nameSize = readU16(p + 28);
+        size_t extraSize = readU16(p + 30);
+        size_t commentSize = readU16(p + 32);
+        if ((size_t) (directoryEnd - p) < CENTRAL_HEADER_SIZE + nameSize + extraSize + commentSize) {
+            entries.clear();
+            file.close();
+            return false;
+        }
+
+        ZipEntry entry;
+        entry.name.assign(p + CENTRAL_HEADER_SIZE, nameSize);
+        entry.method = readU16(p + 10);
+        entry.crc = readU32(p + 16);
+        entry.compressedSize = readU32(p + 20);
+        entry.size = readU32(p + 24);
+        entry.headerOffset = readU32(p + 42);
+
+        if (!readZip64Extra(p + CENTRAL_HEADER_SIZE + nameSize, extraSize, entry,
+                            entry.size == 0xFFFFFFFF, entry.compressedSize == 0xFFFFFFFF,
+                            entry.headerOffset == 0xFFFFFFFF)) {
+            entries.clear();
+            file.close();
+            return false;
+        }
+
+        // encrypted entries can be listed but never read
+        if (flags & FLAG_ENCRYPTED) {
+            entry.method = ~0u;
+        }
+
+        entries.push_back(entry);
+        p += CENTRAL_HEADER_SIZE + nameSize + extraSize + commentSize;
+    }
+
+    return true;
+}
+
+/*
+ * findEntry
+ *
+ * INPUT:
+ *         name - the name of the entry, e.g. "teapot.obj".
+ *
+ * RETURN:
+ *         Index of the entry, -1 if the archive has none with that name.
+ *
+ */
+int ZipArchive::findEntry (const std::string& name) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].name == name) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * getNumEntries
+ *
+ * RETURN:
+ *         How many entries the archive has.
+ *
+ */
+size_t ZipArchive::getNumEntries () const {
+    return entries.size();
+}
+
+/*
+ * getEntry
+ *
+ * INPUT:
+ *         index - an entry of the archive.
+ *
+ * RETURN:
+ *         The entry, as the central directory describes it.
+ *
+ */
+const ZipEntry& ZipArchive::getEntry (size_t index) const {
+    return entries[index];
+}
+
+/*
+ * getEntryData
+ *
+ * INPUT:
+ *         index - an entry of the archive.
+ *
+ * RETURN:
+ *         Pointer to the compressed bytes of the entry (compressedSize
+ *         of them) on the mapping, NULL if its local header is broken.
+ *
+ */
+const char* ZipArchive::getEntryData (size_t index) const {
+    const ZipEntry& entry = entries[index];
+    size_t archiveSize = file.getSize();
+
+    if (entry.headerOffset > archiveSize || archiveSize - entry.headerOffset < LOCAL_HEADER_SIZE) {
+        return NULL;
+    }
+
+    const char* header = file.begin() + entry.headerOffset;
+    if (readU32(header) != LOCAL_HEADER_SIGNATURE) {
+        return NULL;
+    }
+
+    // the local header has its own name and extra field, the sizes come
+    // from the central directory
+    uint64_t dataOffset = entry.headerOffset + LOCAL_HEADER_SIZE + readU16(header + 26) + readU16(header + 28);
+    if (dataOffset > archiveSize || archiveSize - dataOffset < entry.compressedSize) {
+        return NULL;
+    }
+    return file.begin() + dataOffset;
+}
+
+/*
+ * ZipEntryReader
+ *
+ * DESCRIPTION:
+ *         Default constructor, creates a reader with nothing to read.
+ *
+ */
+ZipEntryReader::ZipEntryReader () : next(NULL), end(NULL), method(METHOD_STORED), expectedCrc(0),
+                                    size(0), crc(0), produced(0), streamOpen(false),
+                                    finished(true), failed(false) {
+    memset(&stream, 0, sizeof(stream));
+}
+
+/*
+ * ~ZipEntryReader
+ *
+ * DESCRIPTION:
+ *         Closes the entry, if one is open.
+ *
+ */
+ZipEntryReader::~ZipEntryReader () {
+    close();
+}
+
+/*
+ * open
+ *
+ * INPUT:
+ *         path - an entry of an archive, e.g. "objects/teapot.zip/teapot.obj".
+ *
+ * RETURN:
+ *         True if the archive has the entry and it can be read.
+ *
+ */
+bool ZipEntryReader::open (const char* path) {
+    close();
+
+    std::string archivePath, entryName;
+    if (!splitZipPath(path, archivePath, entryName)) {
+        return false;
+    }
+
+    std::shared_ptr<const ZipArchive> found = getZipArchive(archivePath);
+    if (!found) {
+        return false;
+    }
+
+    int index = found->findEntry(entryName);
+    if (index < 0) {
+        return false;
+    }
+
+    const ZipEntry& entry = found->getEntry(index);
+    const char* data = found->getEntryData(index);
+    if (data == NULL || (entry.method != METHOD_STORED && entry.method != METHOD_DEFLATED)) {
+        return false;
+    }
+
+    // raw deflate, zip entries have no zlib header
+    if (entry.method == METHOD_DEFLATED) {
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            return false;
+        }
+        streamOpen = true;
+    }
+
+    archive = found;
+    next = data;
+    end = data + entry.compressedSize;
+    method = entry.method;
+    expectedCrc = entry.crc;
+    size = entry.size;
+    crc = crc32(0L, Z_NULL, 0);
+    produced = 0;
+    finished = false;
+    failed = false;
+    return true;
+}
+
+/*
+ * close
+ *
+ * DESCRIPTION:
+ *         Releases the zlib stream and the archive.
+ *
+ */
+void ZipEntryReader::close () {
+    if (streamOpen) {
+        inflateEnd(&stream);
+        streamOpen = false;
+    }
+    archive.reset();
+    next = end = NULL;
+    finished = true;
+    failed = false;
+}
+
+/*
+ * read
+ *
+ * INPUT:
+ *         buffer - where the bytes are written.
+ *         length - how many bytes we want.
+ *
+ * RETURN:
+ *         How many bytes were written, less than length only at the
+ *         end of the entry (or on an error, see hasFailed).
+ *
+ * DESCRIPTION:
+ *         Inflates the next bytes of the entry straight into buffer.
+ *         Once the last byte is read its CRC and size are checked.
+ *
+ */
+size_t ZipEntryReader::read (char* buffer, size_t length) {
+    size_t written = 0;
+
+    while (written < length && !finished) {
+        // zlib counts in 32 bits
+        size_t wanted = length - written;
+        if (wanted > MAX_ZLIB_INPUT) {
+            wanted = MAX_ZLIB_INPUT;
+        }
+
+        size_t count = 0;
+        if (method == METHOD_STORED) {
+            count = (size_t) (end - next) < wanted ? (size_t) (end - next) : wanted;
+            memcpy(buffer + written, next, count);
+            next += count;
+            finished = (next == end);
+        } else {
+            if (stream.avail_in == 0 && next < end) {
+                size_t input = (size_t) (end - next) < MAX_ZLIB_INPUT ? (size_t) (end - next) : MAX_ZLIB_INPUT;
+                stream.next_in = (Bytef*) next;
+                stream.avail_in = (uInt) input;
+                next += input;
+            }
+
+            stream.next_out = (Bytef*) (buffer + written);
+            stream.avail_out = (uInt) wanted;
+            int status = inflate(&stream, Z_NO_FLUSH);
+            count = wanted - stream.avail_out;
+
+            if (status == Z_STREAM_END) {
+                finished = true;
+            } else if ((status != Z_OK && status != Z_BUF_ERROR) ||
+                       (count == 0 && stream.avail_in == 0 && next == end)) {
+                // broken data, or it ends before the deflate stream does
+                finished = true;
+                failed = true;
+            }
+        }
+
+        crc = crc32(crc, (const Bytef*) (buffer + written), (uInt) count);
+        produced += count;
+        written += count;
+    }
+
+    if (finished && !failed && (crc != expectedCrc || produced != size)) {
+        failed = true;
+    }
+    return written;
+}
+
+/*
+ * hasFailed
+ *
+ * RETURN:
+ *         True if the compressed data was broken or did not match the
+ *         CRC or size of the central directory.
+ *
+ */
+bool ZipEntryReader::hasFailed () const {
+    return failed;
+}
+
+/*
+ * getSize
+ *
+ * RETURN:
+ *         The size of the entry once inflated.
+ *
+ */
+unsigned long long ZipEntryReader::getSize () const {
+    return size;
+}
+
+/*
+ * splitZipPath
+ *
+ * INPUT:
+ *         path - any path.
+ *         archivePath - where the path of the archive is written.
+ *         entryName - where the name of the entry is written.
+ *
+ * RETURN:
+ *         True if path goes through a .zip file (that exists), e.g.
+ *         "objects/teapot.zip/teapot.obj" gives "objects/teapot.zip" and
+ *         "teapot.obj". False for every other path, even if the file does
+ *         not exist.
+ *
+ */
+bool splitZipPath(const char* path, std::string& archivePath, std::string& entryName) {
+    if (path == NULL) {
+        return false;
+    }
+
+    // every ".zip/" in the path, a directory may have that name too
+    size_t length = strlen(path);
+    for (size_t i = 0; i + 5 < length; ++i) {
+        if (path[i] != '.' || tolower(path[i + 1]) != 'z' || tolower(path[i + 2]) != 'i' ||
+            tolower(path[i + 3]) != 'p' || path[i + 4] != '/') {
+            continue;
+        }
+
+        std::string archive(path, i + 4);
+        struct stat info;
+        if (stat(archive.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            archivePath = archive;
+            entryName.assign(path + i + 5);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * isZipPath
+ *
+ * INPUT:
+ *         path - any path.
+ *
+ * RETURN:
+ *         True if path is an entry of a .zip file, see splitZipPath.
+ *
+ */
+bool isZipPath(const char* path) {
+    std::string archivePath, entryName;
+    return splitZipPath(path, archivePath, entryName);
+}
+
+// The archives opened so far, by path
+static std::mutex archivesMutex;
+static std::map<std::string, std::shared_ptr<const ZipArchive> > archives;
+
+/*
+ * getZipArchive
+ *
+ * INPUT:
+ *         filename - the .zip file.
+ *
+ * RETURN:
+ *         The archive, NULL if it could not be opened.
+ *
+ * DESCRIPTION:
+ *         Archives are opened once and kept, so the central directory is
+ *         only read the first time. It is safe to call from any thread.
+ *
+ */
+std::shared_ptr<const ZipArchive> getZipArchive(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(archivesMutex);
+
+    std::map<std::string, std::shared_ptr<const ZipArchive> >::iterator it = archives.find(filename);
+    if (it != archives.end()) {
+        return it->second;
+    }
+
+    std::shared_ptr<ZipArchive> archive = std::make_shared<ZipArchive>();
+    if (!archive->open(filename.c_str())) {
+        return std::shared_ptr<const ZipArchive>();
+    }
+
+    archives[filename] = archive;
+    return archive;
+}
+
+/*
+ * releaseZipArchives
+ *
+ * DESCRIPTION:
+ *         Forgets every archive opened so far, they are unmapped once the
+ *         readers still using them are done. Needed if an archive changes
+ *         on disk.
+ *
+ */
+void releaseZipArchives() {
+    std::lock_guard<std::mutex> lock(archivesMutex);
+    archives.clear();
+}
+
+/*
+ * findZipEntry
+ *
+ * INPUT:
+ *         path - an entry of an archive, e.g. "objects/teapot.zip/teapot.obj".
+ *         entry - where its description is written.
+ *
+ * RETURN:
+ *         True if the archive has the entry.
+ *
+ * DESCRIPTION:
+ *         Only looks at the central directory, nothing is inflated.
+ *
+ */
+bool findZipEntry(const char* path, ZipEntry& entry) {
+    std::string archivePath, entryName;
+    if (!splitZipPath(path, archivePath, entryName)) {
+        return false;
+    }
+
+    std::shared_ptr<const ZipArchive> archive = getZipArchive(archivePath);
+    if (!archive) {
+        return false;
+    }
+
+    int index = archive->findEntry(entryName);
+    if (index < 0) {
+        return false;
+    }
+
+    entry = archive->getEntry(index);
+    return true;
+}
+
+/*
+ * readZipEntry
+ *
+ * INPUT:
+ *         path - an entry of an archive, e.g. "objects/teapot.zip/teapot.obj".
+ *         contents - where the inflated entry is written.
+ *
+ * RETURN:
+ *         True if the whole entry could be read.
+ *
+ */
+bool readZipEntry(const char* path, std::vector<char>& contents) {
+    ZipEntryReader reader;
+    contents.clear();
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    contents.resize(reader.getSize());
+    size_t length = contents.empty() ? 0 : reader.read(&contents[0], contents.size());
+
+    // the entry may be larger than the directory says, that is an error
+    // too, so one more byte is asked for
+    char extra;
+    if (length != contents.size() || reader.read(&extra, 1) != 0 || reader.hasFailed()) {
+        contents.clear();
+        return false;
+    }
+    return true;
+}
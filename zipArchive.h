@@ -0,0 +1,330 @@
+/*
+ * zipArchive.h
+ *
+ * Read only access to the files inside .zip archives, without unzipping
+ * them to disk. A path like "objects/teapot.zip/teapot.obj" names the
+ * entry "teapot.obj" of the archive "objects/teapot.zip", and the loaders
+ * (readObjFile, readMtlFile, loadWeldedObj, load_png) accept those paths
+ * like any other file.
+ *
+ * The central directory of an archive is read once, the first time one
+ * of its entries is used. Entries are inflated a block at a time while
+ * they are read, never to a temporary file.
+ *
+ * Authors: Felipe Victorino Caputo
+ *
+ */
+
+#ifndef _ZIPARCHIVE_H
+#define _ZIPARCHIVE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zlib.h>
+
+#include "objReader.h"
+
+/*
+ * One file of an archive, as its central directory describes it.
+ */
+struct ZipEntry {
+    std::string name;
+
+    // 0 is stored, 8 is deflated, nothing else is supported
+    unsigned int method;
+
+    uint32_t crc;
+    unsigned long long compressedSize;
+    unsigned long long size;
+
+    // where its local header starts on the archive
+    unsigned long long headerOffset;
+};
+
+/*
+ * The ZipArchive class, an archive mapped in memory plus its central
+ * directory.
+ */
+class ZipArchive {
+    obj::MappedFile file;
+    std::vector<ZipEntry> entries;
+
+    // the copy constructor and assignment are not allowed, like the
+    // mapping they hold
+    ZipArchive (const ZipArchive&);
+    ZipArchive& operator= (const ZipArchive&);
+
+public:
+
+    /*
+     * ZipArchive
+     *
+     * DESCRIPTION:
+     *         Default constructor, creates an archive with no entries.
+     *
+     */
+    ZipArchive ();
+
+    /*
+     * open
+     *
+     * INPUT:
+     *         filename - the .zip file.
+     *
+     * RETURN:
+     *         True if the file could be mapped and its central directory
+     *         read, false otherwise.
+     *
+     * DESCRIPTION:
+     *         Maps the archive and reads its central directory (ZIP64
+     *         archives included). No entry is inflated.
+     *
+     */
+    bool open (const char* filename);
+
+    /*
+     * findEntry
+     *
+     * INPUT:
+     *         name - the name of the entry, e.g. "teapot.obj".
+     *
+     * RETURN:
+     *         Index of the entry, -1 if the archive has none with that name.
+     *
+     */
+    int findEntry (const std::string& name) const;
+
+    /*
+     * getNumEntries
+     *
+     * RETURN:
+     *         How many entries the archive has.
+     *
+     */
+    size_t getNumEntries () const;
+
+    /*
+     * getEntry
+     *
+     * INPUT:
+     *         index - an entry of the archive.
+     *
+     * RETURN:
+     *         The entry, as the central directory describes it.
+     *
+     */
+    const ZipEntry& getEntry (size_t index) const;
+
+    /*
+     * getEntryData
+     *
+     * INPUT:
+     *         index - an entry of the archive.
+     *
+     * RETURN:
+     *         Pointer to the compressed bytes of the entry (compressedSize
+     *         of them) on the mapping, NULL if its local header is broken.
+     *
+     */
+    const char* getEntryData (size_t index) const;
+};
+
+/*
+ * The ZipEntryReader class, reads an entry from start to end and
+ * inflates it on the way.
+ */
+class ZipEntryReader {
+    // keeps the mapping alive while we read from it
+    std::shared_ptr<const ZipArchive> archive;
+
+    // compressed bytes not given to zlib yet
+    const char* next;
+    const char* end;
+
+    unsigned int method;
+    uint32_t expectedCrc;
+    unsigned long long size;
+
+    // what was read so far
+    uint32_t crc;
+    unsigned long long produced;
+
+    z_stream stream;
+    bool streamOpen;
+    bool finished;
+    bool failed;
+
+    // the copy constructor and assignment are not allowed, the zlib
+    // stream is owned by a single object
+    ZipEntryReader (const ZipEntryReader&);
+    ZipEntryReader& operator= (const ZipEntryReader&);
+
+public:
+
+    /*
+     * ZipEntryReader
+     *
+     * DESCRIPTION:
+     *         Default constructor, creates a reader with nothing to read.
+     *
+     */
+    ZipEntryReader ();
+
+    /*
+     * ~ZipEntryReader
+     *
+     * DESCRIPTION:
+     *         Closes the entry, if one is open.
+     *
+     */
+    ~ZipEntryReader ();
+
+    /*
+     * open
+     *
+     * INPUT:
+     *         path - an entry of an archive, e.g. "objects/teapot.zip/teapot.obj".
+     *
+     * RETURN:
+     *         True if the archive has the entry and it can be read.
+     *
+     */
+    bool open (const char* path);
+
+    /*
+     * close
+     *
+     * DESCRIPTION:
+     *         Releases the zlib stream and the archive.
+     *
+     */
+    void close ();
+
+    /*
+     * read
+     *
+     * INPUT:
+     *         buffer - where the bytes are written.
+     *         length - how many bytes we want.
+     *
+     * RETURN:
+     *         How many bytes were written, less than length only at the
+     *         end of the entry (or on an error, see hasFailed).
+     *
+     * DESCRIPTION:
+     *         Inflates the next bytes of the entry straight into buffer.
+     *         Once the last byte is read its CRC and size are checked.
+     *
+     */
+    size_t read (char* buffer, size_t length);
+
+    /*
+     * hasFailed
+     *
+     * RETURN:
+     *         True if the compressed data was broken or did not match the
+     *         CRC or size of the central directory.
+     *
+     */
+    bool hasFailed () const;
+
+    /*
+     * getSize
+     *
+     * RETURN:
+     *         The size of the entry once inflated.
+     *
+     */
+    unsigned long long getSize () const;
+};
+
+/*
+ * splitZipPath
+ *
+ * INPUT:
+ *         path - any path.
+ *         archivePath - where the path of the archive is written.
+ *         entryName - where the name of the entry is written.
+ *
+ * RETURN:
+ *         True if path goes through a .zip file (that exists), e.g.
+ *         "objects/teapot.zip/teapot.obj" gives "objects/teapot.zip" and
+ *         "teapot.obj". False for every other path, even if the file does
+ *         not exist.
+ *
+ */
+bool splitZipPath(const char* path, std::string& archivePath, std::string& entryName);
+
+/*
+ * isZipPath
+ *
+ * INPUT:
+ *         path - any path.
+ *
+ * RETURN:
+ *         True if path is an entry of a .zip file, see splitZipPath.
+ *
+ */
+bool isZipPath(const char* path);
+
+/*
+ * getZipArchive
+ *
+ * INPUT:
+ *         filename - the .zip file.
+ *
+ * RETURN:
+ *         The archive, NULL if it could not be opened.
+ *
+ * DESCRIPTION:
+ *         Archives are opened once and kept, so the central directory is
+ *         only read the first time. It is safe to call from any thread.
+ *
+ */
+std::shared_ptr<const ZipArchive> getZipArchive(const std::string& filename);
+
+/*
+ * releaseZipArchives
+ *
+ * DESCRIPTION:
+ *         Forgets every archive opened so far, they are unmapped once the
+ *         readers still using them are done. Needed if an archive changes
+ *         on disk.
+ *
+ */
+void releaseZipArchives();
+
+/*
+ * findZipEntry
+ *
+ * INPUT:
+ *         path - an entry of an archive, e.g. "objects/teapot.zip/teapot.obj".
+ *         entry - where its description is written.
+ *
+ * RETURN:
+ *         True if the archive has the entry.
+ *
+ * DESCRIPTION:
+ *         Only looks at the central directory, nothing is inflated.
+ *
+ */
+bool findZipEntry(const char* path, ZipEntry& entry);
+
+/*
+ * readZipEntry
+ *
+ * INPUT:
+ *         path - an entry of an archive, e.g. "objects/teapot.zip/teapot.obj".
+ *         contents - where the inflated entry is written.
+ *
+ * RETURN:
+ *         True if the whole entry could be read.
+ *
+ */
+bool readZipEntry(const char* path, std::vector<char>& contents);
+
+#endif